@@ -0,0 +1,103 @@
+/*
+* Copyright (c) 2016-2019 Irlan Robson
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef LIST_MAT33_H
+#define LIST_MAT33_H
+
+#include <bounce_softbody/common/math/mat33.h>
+#include <bounce_softbody/sparse/dense_vec3.h>
+
+// The previous sparse matrix layout kept for comparison. 
+// Each row is a doubly linked list of blocks, one allocation per block.
+struct ListEntry
+{
+	uint32 column;
+	b3Mat33 value;
+	ListEntry* prev;
+	ListEntry* next;
+};
+
+struct ListMat33
+{
+	ListMat33(uint32 m)
+	{
+		rowCount = m;
+		rows = (ListEntry**)b3Alloc(rowCount * sizeof(ListEntry*));
+		for (uint32 i = 0; i < rowCount; ++i)
+		{
+			rows[i] = nullptr;
+		}
+	}
+
+	~ListMat33()
+	{
+		for (uint32 i = 0; i < rowCount; ++i)
+		{
+			ListEntry* e = rows[i];
+			while (e)
+			{
+				ListEntry* e0 = e->next;
+				b3Free(e);
+				e = e0;
+			}
+		}
+		b3Free(rows);
+	}
+
+	b3Mat33& operator()(uint32 i, uint32 j)
+	{
+		for (ListEntry* e = rows[i]; e; e = e->next)
+		{
+			if (e->column == j)
+			{
+				return e->value;
+			}
+		}
+
+		ListEntry* e = (ListEntry*)b3Alloc(sizeof(ListEntry));
+		e->column = j;
+		e->value.SetZero();
+		e->prev = nullptr;
+		e->next = rows[i];
+		if (rows[i])
+		{
+			rows[i]->prev = e;
+		}
+		rows[i] = e;
+
+		return e->value;
+	}
+
+	uint32 rowCount;
+	ListEntry** rows;
+};
+
+inline void Mul(b3DenseVec3& out, const ListMat33& A, const b3DenseVec3& v)
+{
+	out.SetZero();
+
+	for (uint32 i = 0; i < A.rowCount; ++i)
+	{
+		for (ListEntry* e = A.rows[i]; e; e = e->next)
+		{
+			out[i] += e->value * v[e->column];
+		}
+	}
+}
+
+#endif
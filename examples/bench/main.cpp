@@ -0,0 +1,984 @@
+/*
+* Copyright (c) 2016-2019 Irlan Robson
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "micro.h"
+
+#include <bounce_softbody/bounce_softbody.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+// This is a headless benchmark of the body step. 
+// It builds a scene at a given resolution, steps it for a number of frames and 
+// writes the step timings, the solver statistics, the allocation counts and the memory usage 
+// in JSON or CSV format. 
+// The micro-benchmarks in micro.cpp are run with --micro.
+// Run it with --help for the options.
+
+typedef std::chrono::steady_clock Clock;
+
+static double ElapsedMs(const Clock::time_point& t1, const Clock::time_point& t2)
+{
+	return std::chrono::duration<double, std::milli>(t2 - t1).count();
+}
+
+// Get the index of a vertex in a n x n grid mesh.
+static uint32 GetGridVertex(uint32 n, uint32 i, uint32 j)
+{
+	return i * (n + 1) + j;
+}
+
+// A benchmark scene. 
+class Scene
+{
+public:
+	Scene(bool shuffle) : m_shuffle(shuffle) { }
+
+	virtual ~Scene() 
+	{
+		free(m_particles);
+	}
+
+	// Called after each step.
+	virtual void PostStep() { }
+
+	b3Body m_body;
+protected:
+	// Create a particle per vertex. 
+	// Attach a sphere to each particle if the radius is positive.
+	// The particles are created in a random order if shuffling is enabled, 
+	// like the vertices of a mesh with a poor vertex order.
+	void CreateParticles(const b3Vec3* vertices, uint32 vertexCount, scalar radius, scalar friction)
+	{
+		uint32* order = (uint32*)malloc(vertexCount * sizeof(uint32));
+		for (uint32 i = 0; i < vertexCount; ++i)
+		{
+			order[i] = i;
+		}
+
+		if (m_shuffle)
+		{
+			// Fisher-Yates shuffle with a fixed seed
+			uint32 seed = 1;
+			for (uint32 i = vertexCount; i > 1; --i)
+			{
+				seed = 1664525 * seed + 1013904223;
+				uint32 j = (seed >> 8) % i;
+				b3Swap(order[i - 1], order[j]);
+			}
+		}
+
+		b3ParticleDef* pds = new b3ParticleDef[vertexCount];
+		for (uint32 i = 0; i < vertexCount; ++i)
+		{
+			b3ParticleDef* pd = pds + i;
+			pd->type = e_dynamicParticle;
+			pd->position = vertices[order[i]];
+			pd->userIndex = order[i];
+		}
+
+		b3Particle** particles = (b3Particle**)malloc(vertexCount * sizeof(b3Particle*));
+		m_body.CreateParticles(particles, pds, vertexCount);
+
+		m_particles = (b3Particle**)malloc(vertexCount * sizeof(b3Particle*));
+		for (uint32 i = 0; i < vertexCount; ++i)
+		{
+			m_particles[order[i]] = particles[i];
+		}
+
+		free(particles);
+		delete[] pds;
+		free(order);
+
+		if (radius > scalar(0))
+		{
+			b3SphereFixtureDef* sds = new b3SphereFixtureDef[vertexCount];
+			for (uint32 i = 0; i < vertexCount; ++i)
+			{
+				b3SphereFixtureDef* sd = sds + i;
+				sd->p = m_particles[i];
+				sd->radius = radius;
+				sd->friction = friction;
+				sd->userIndex = i;
+			}
+
+			b3SphereFixture** spheres = (b3SphereFixture**)malloc(vertexCount * sizeof(b3SphereFixture*));
+			m_body.CreateSpheres(spheres, sds, vertexCount);
+
+			free(spheres);
+			delete[] sds;
+		}
+	}
+
+	// Create the triangles of a mesh.
+	void CreateTriangles(const b3Mesh& mesh, scalar density)
+	{
+		b3TriangleFixtureDef* tds = new b3TriangleFixtureDef[mesh.triangleCount];
+		for (uint32 i = 0; i < mesh.triangleCount; ++i)
+		{
+			const b3Triangle* t = mesh.GetTriangle(i);
+
+			b3TriangleFixtureDef* td = tds + i;
+			td->p1 = m_particles[t->v1];
+			td->p2 = m_particles[t->v2];
+			td->p3 = m_particles[t->v3];
+			td->v1 = td->p1->GetPosition();
+			td->v2 = td->p2->GetPosition();
+			td->v3 = td->p3->GetPosition();
+			td->density = density;
+			td->userIndex = i;
+		}
+
+		b3TriangleFixture** triangles = (b3TriangleFixture**)malloc(mesh.triangleCount * sizeof(b3TriangleFixture*));
+		m_body.CreateTriangles(triangles, tds, mesh.triangleCount);
+
+		free(triangles);
+		delete[] tds;
+	}
+
+	// Create the triangles and the stretch forces of a cloth.
+	void CreateCloth(const b3Mesh& mesh, scalar density, scalar stiffness)
+	{
+		CreateTriangles(mesh, density);
+
+		for (uint32 i = 0; i < mesh.triangleCount; ++i)
+		{
+			const b3Triangle* t = mesh.GetTriangle(i);
+			
+			b3Particle* p1 = m_particles[t->v1];
+			b3Particle* p2 = m_particles[t->v2];
+			b3Particle* p3 = m_particles[t->v3];
+
+			b3StretchForceDef fd;
+			fd.Initialize(p1->GetPosition(), p2->GetPosition(), p3->GetPosition());
+			fd.p1 = p1;
+			fd.p2 = p2;
+			fd.p3 = p3;
+			fd.stiffness_u = stiffness;
+			fd.stiffness_v = stiffness;
+			fd.userIndex = i;
+
+			m_body.CreateForce(fd);
+		}
+	}
+
+	bool m_shuffle;
+	b3Particle** m_particles = nullptr;
+};
+
+// A cloth pinned at its borders.
+class PinnedCloth : public Scene
+{
+public:
+	PinnedCloth(uint32 size, bool shuffle) : Scene(shuffle)
+	{
+		b3BuildGridMesh(&m_mesh, size, size);
+		m_mesh.Scale(b3Vec3(scalar(10) / scalar(size), scalar(1), scalar(10) / scalar(size)));
+
+		CreateParticles(m_mesh.vertices, m_mesh.vertexCount, scalar(0), scalar(0));
+		CreateCloth(m_mesh, scalar(0.2), scalar(100000));
+
+		for (uint32 i = 0; i <= size; ++i)
+		{
+			m_particles[GetGridVertex(size, i, 0)]->SetType(e_staticParticle);
+			m_particles[GetGridVertex(size, i, size)]->SetType(e_staticParticle);
+			m_particles[GetGridVertex(size, 0, i)]->SetType(e_staticParticle);
+			m_particles[GetGridVertex(size, size, i)]->SetType(e_staticParticle);
+		}
+
+		m_body.SetGravity(b3Vec3(scalar(0), scalar(-9.8), scalar(0)));
+	}
+
+	~PinnedCloth()
+	{
+		b3FreeMesh(&m_mesh);
+	}
+
+	b3Mesh m_mesh;
+};
+
+// A cloth falling on a triangle mesh.
+class SheetOnMesh : public Scene
+{
+public:
+	SheetOnMesh(uint32 size, bool shuffle) : Scene(shuffle)
+	{
+		b3BuildGridMesh(&m_mesh, size, size);
+		m_mesh.Scale(b3Vec3(scalar(10) / scalar(size), scalar(1), scalar(10) / scalar(size)));
+		m_mesh.Translate(b3Vec3(scalar(0), scalar(2), scalar(0)));
+
+		CreateParticles(m_mesh.vertices, m_mesh.vertexCount, scalar(0.1), scalar(0.8));
+		CreateCloth(m_mesh, scalar(0.1), scalar(1000));
+
+		b3BuildGridMesh(&m_groundMesh, 16, 16);
+		m_groundMesh.BuildTree();
+		m_groundMesh.BuildAdjacency();
+
+		b3MeshShape meshShape;
+		meshShape.m_radius = scalar(0.05);
+		meshShape.m_mesh = &m_groundMesh;
+		meshShape.m_scale.Set(scalar(1), scalar(1), scalar(1));
+
+		b3WorldFixtureDef fd;
+		fd.shape = &meshShape;
+		fd.friction = scalar(0.5);
+
+		m_body.CreateFixture(fd);
+
+		m_body.SetGravity(b3Vec3(scalar(0), scalar(-9.8), scalar(0)));
+	}
+
+	~SheetOnMesh()
+	{
+		b3FreeMesh(&m_mesh);
+		b3FreeMesh(&m_groundMesh);
+	}
+
+	b3Mesh m_mesh;
+	b3Mesh m_groundMesh;
+};
+
+// A tetrahedral block falling on a signed distance field of a sphere.
+class TetOnSDF : public Scene
+{
+public:
+	TetOnSDF(uint32 size, bool shuffle) : Scene(shuffle)
+	{
+		b3BuildBoxTetMesh(&m_mesh, b3Max(size / 4, 1u), size, size);
+		
+		scalar cellSize = scalar(6) / scalar(size);
+		for (uint32 i = 0; i < m_mesh.vertexCount; ++i)
+		{
+			m_mesh.vertices[i] = cellSize * m_mesh.vertices[i] + b3Vec3(scalar(0), scalar(5), scalar(0));
+		}
+
+		CreateParticles(m_mesh.vertices, m_mesh.vertexCount, scalar(0.05), scalar(0.3));
+
+		uint32 tetrahedronCount = m_mesh.tetrahedronCount;
+
+		b3TetrahedronFixtureDef* tds = new b3TetrahedronFixtureDef[tetrahedronCount];
+		for (uint32 i = 0; i < tetrahedronCount; ++i)
+		{
+			const b3Tetrahedron* t = m_mesh.tetrahedrons + i;
+
+			b3TetrahedronFixtureDef* td = tds + i;
+			td->p1 = m_particles[t->v1];
+			td->p2 = m_particles[t->v2];
+			td->p3 = m_particles[t->v3];
+			td->p4 = m_particles[t->v4];
+			td->v1 = td->p1->GetPosition();
+			td->v2 = td->p2->GetPosition();
+			td->v3 = td->p3->GetPosition();
+			td->v4 = td->p4->GetPosition();
+			td->density = scalar(0.1);
+			td->userIndex = i;
+		}
+
+		b3TetrahedronFixture** tetrahedrons = (b3TetrahedronFixture**)malloc(tetrahedronCount * sizeof(b3TetrahedronFixture*));
+		m_body.CreateTetrahedrons(tetrahedrons, tds, tetrahedronCount);
+		free(tetrahedrons);
+
+		for (uint32 i = 0; i < tetrahedronCount; ++i)
+		{
+			const b3TetrahedronFixtureDef& td = tds[i];
+
+			b3TetrahedronElementForceDef fd;
+			fd.p1 = td.p1;
+			fd.p2 = td.p2;
+			fd.p3 = td.p3;
+			fd.p4 = td.p4;
+			fd.v1 = td.v1;
+			fd.v2 = td.v2;
+			fd.v3 = td.v3;
+			fd.v4 = td.v4;
+			fd.youngModulus = scalar(1000);
+			fd.poissonRatio = scalar(0.3);
+			fd.userIndex = i;
+
+			m_body.CreateForce(fd);
+		}
+
+		delete[] tds;
+
+		b3BuildSphereMesh(&m_sphereMesh, 10, 10);
+		m_sphereMesh.Scale(b3Vec3(scalar(3), scalar(3), scalar(3)));
+		b3BuildSDF(&m_sdf, &m_sphereMesh, b3Vec3(scalar(0.5), scalar(0.5), scalar(0.5)), scalar(1));
+
+		b3SDFShape sdfShape;
+		sdfShape.m_sdf = &m_sdf;
+		sdfShape.m_radius = scalar(0.05);
+
+		b3WorldFixtureDef fd;
+		fd.shape = &sdfShape;
+		fd.friction = scalar(0.5);
+
+		m_body.CreateFixture(fd);
+
+		m_body.SetGravity(b3Vec3(scalar(0), scalar(-9.8), scalar(0)));
+	}
+
+	~TetOnSDF()
+	{
+		b3FreeTetMesh(&m_mesh);
+		b3FreeMesh(&m_sphereMesh);
+	}
+
+	b3TetMesh m_mesh;
+	b3Mesh m_sphereMesh;
+	b3SDF m_sdf;
+};
+
+// A spring cloth pinned at the top and pulled at the bottom center. 
+// The springs stretched beyond a limit are destroyed after each step, so 
+// the topology of the system changes while the cloth tears.
+class ClothTearing : public Scene
+{
+public:
+	ClothTearing(uint32 size, bool shuffle) : Scene(shuffle)
+	{
+		b3BuildGridMesh(&m_mesh, size, size);
+
+		// Hang the cloth on the x-y plane.
+		scalar h = scalar(10) / scalar(size);
+		for (uint32 i = 0; i < m_mesh.vertexCount; ++i)
+		{
+			b3Vec3 v = m_mesh.vertices[i];
+			m_mesh.vertices[i].Set(h * v.x, -h * v.z, scalar(0));
+		}
+
+		CreateParticles(m_mesh.vertices, m_mesh.vertexCount, scalar(0), scalar(0));
+
+		CreateTriangles(m_mesh, scalar(0.1));
+
+		// Connect each particle to its right, bottom and diagonal neighbours.
+		for (uint32 i = 0; i <= size; ++i)
+		{
+			for (uint32 j = 0; j <= size; ++j)
+			{
+				b3Particle* p1 = m_particles[GetGridVertex(size, i, j)];
+
+				if (j < size)
+				{
+					CreateSpring(p1, m_particles[GetGridVertex(size, i, j + 1)]);
+				}
+				if (i < size)
+				{
+					CreateSpring(p1, m_particles[GetGridVertex(size, i + 1, j)]);
+				}
+				if (i < size && j < size)
+				{
+					CreateSpring(p1, m_particles[GetGridVertex(size, i + 1, j + 1)]);
+				}
+			}
+		}
+
+		uint32 n = size + 1;
+		for (uint32 j = 0; j < n; ++j)
+		{
+			m_particles[GetGridVertex(size, 0, j)]->SetType(e_staticParticle);
+		}
+
+		for (uint32 j = n / 4; j < n - n / 4; ++j)
+		{
+			b3Particle* p = m_particles[GetGridVertex(size, size, j)];
+			p->SetType(e_kinematicParticle);
+			p->SetVelocity(b3Vec3(scalar(0), scalar(-2), scalar(0)));
+		}
+
+		m_body.SetGravity(b3Vec3(scalar(0), scalar(-9.8), scalar(0)));
+	}
+
+	~ClothTearing()
+	{
+		b3FreeMesh(&m_mesh);
+	}
+
+	void CreateSpring(b3Particle* p1, b3Particle* p2)
+	{
+		b3SpringForceDef sd;
+		sd.Initialize(p1, p2, scalar(1000), scalar(10));
+		m_body.CreateForce(sd);
+	}
+
+	void PostStep() override
+	{
+		b3Force* f = m_body.GetForceList();
+		while (f)
+		{
+			b3Force* next = f->GetNext();
+
+			b3SpringForce* s = (b3SpringForce*)f;
+
+			scalar L = b3Distance(s->GetParticle1()->GetPosition(), s->GetParticle2()->GetPosition());
+			if (L > scalar(1.5) * s->GetLength())
+			{
+				m_body.DestroyForce(f);
+			}
+
+			f = next;
+		}
+	}
+
+	b3Mesh m_mesh;
+};
+
+static Scene* CreateScene(const char* name, uint32 size, bool shuffle)
+{
+	if (strcmp(name, "pinned") == 0)
+	{
+		return new PinnedCloth(size, shuffle);
+	}
+	if (strcmp(name, "sheet") == 0)
+	{
+		return new SheetOnMesh(size, shuffle);
+	}
+	if (strcmp(name, "tet") == 0)
+	{
+		return new TetOnSDF(size, shuffle);
+	}
+	if (strcmp(name, "tearing") == 0)
+	{
+		return new ClothTearing(size, shuffle);
+	}
+	return nullptr;
+}
+
+static const char* s_sceneNames[] = { "pinned", "sheet", "tet", "tearing" };
+static const uint32 s_sceneCount = sizeof(s_sceneNames) / sizeof(const char*);
+
+static const char* s_preconditionerNames[] = { "jacobi", "block_jacobi", "ic0", "multigrid" };
+
+static const char* s_orderingNames[] = { "none", "rcm", "morton" };
+
+enum Format
+{
+	e_json,
+	e_csv
+};
+
+struct Settings
+{
+	const char* scene = "all";
+	uint32 size = 32;
+	uint32 steps = 120;
+	uint32 warmup = 2;
+	uint32 threads = 1;
+	b3PreconditionerType preconditioner = e_jacobiPreconditioner;
+	uint32 forceIterations = 1;
+	uint32 forceSubIterations = 40;
+	bool warmStarting = false;
+	bool adaptiveSubTolerance = false;
+	bool lineSearch = false;
+	bool matrixFree = false;
+	bool direct = false;
+	b3ParticleOrdering ordering = e_creationOrdering;
+	bool shuffle = false;
+	bool symmetric = false;
+	bool mixedPrecision = false;
+	uint32 refinement = 0;
+	scalar hertz = scalar(60);
+	Format format = e_json;
+	const char* output = nullptr;
+	const char* micro = nullptr;
+};
+
+// The record of a step.
+struct StepRecord
+{
+	b3Profile profile;
+	b3SolverStats stats;
+	b3MemoryStats memory;
+};
+
+// Per step mean, min and max of a value.
+struct Summary
+{
+	Summary() : sum(0.0), min(0.0), max(0.0), count(0) { }
+
+	void Add(double x)
+	{
+		if (count == 0 || x < min) min = x;
+		if (count == 0 || x > max) max = x;
+		sum += x;
+		++count;
+	}
+
+	double Mean() const
+	{
+		return count > 0 ? sum / double(count) : 0.0;
+	}
+
+	double sum, min, max;
+	uint32 count;
+};
+
+static const uint32 s_fieldCount = 22;
+
+static const char* s_fieldNames[s_fieldCount] = 
+{
+	"step", "update_contacts", "clear_forces", "solve", "solve_forces", "assembly", "solve_cg", "friction", "synchronize", "find_contacts",
+	"iterations", "min_sub_iterations", "max_sub_iterations", "particle_count", "force_count", "contact_count", "block_count", 
+	"alloc_calls", "free_calls", "alloc_bytes", "memory_bytes", "line_search_failures"
+};
+
+static void GetFields(double fields[s_fieldCount], const StepRecord& r)
+{
+	fields[0] = r.profile.step;
+	fields[1] = r.profile.updateContacts;
+	fields[2] = r.profile.clearForces;
+	fields[3] = r.profile.solve;
+	fields[4] = r.profile.solveForces;
+	fields[5] = r.profile.assembly;
+	fields[6] = r.profile.solveCG;
+	fields[7] = r.profile.friction;
+	fields[8] = r.profile.synchronize;
+	fields[9] = r.profile.findContacts;
+	fields[10] = double(r.stats.iterations);
+	fields[11] = double(r.stats.iterations > 0 ? r.stats.minSubIterations : 0);
+	fields[12] = double(r.stats.maxSubIterations);
+	fields[13] = double(r.stats.particleCount);
+	fields[14] = double(r.stats.forceCount);
+	fields[15] = double(r.stats.contactCount);
+	fields[16] = double(r.stats.blockCount);
+	fields[17] = double(r.memory.stepAllocCalls);
+	fields[18] = double(r.memory.stepFreeCalls);
+	fields[19] = double(r.memory.stepAllocBytes);
+	fields[20] = double(r.memory.totalBytes);
+	fields[21] = double(r.stats.lineSearchFailures);
+}
+
+static void Run(FILE* file, const Settings& settings, const char* sceneName, bool first)
+{
+	uint64 allocCalls0 = b3GetAllocCounters().allocCalls;
+	Clock::time_point t0 = Clock::now();
+
+	Scene* scene = CreateScene(sceneName, settings.size, settings.shuffle);
+	
+	double createTime = ElapsedMs(t0, Clock::now());
+	uint32 createAllocCalls = uint32(b3GetAllocCounters().allocCalls - allocCalls0);
+
+	b3Body& body = scene->m_body;
+	body.SetThreadCount(settings.threads);
+	body.SetPreconditioner(settings.preconditioner);
+	body.SetWarmStarting(settings.warmStarting);
+	body.SetAdaptiveSubTolerance(settings.adaptiveSubTolerance);
+	body.SetLineSearch(settings.lineSearch);
+	body.SetMatrixFree(settings.matrixFree);
+	body.SetDirectSolver(settings.direct);
+	body.SetParticleOrdering(settings.ordering);
+	body.SetSymmetricStorage(settings.symmetric);
+	body.SetMixedPrecision(settings.mixedPrecision);
+	body.SetRefinementIterations(settings.refinement);
+
+	scalar dt = scalar(1) / settings.hertz;
+	
+	uint32 stepCount = settings.warmup + settings.steps;
+	StepRecord* records = (StepRecord*)malloc(stepCount * sizeof(StepRecord));
+	
+	for (uint32 i = 0; i < stepCount; ++i)
+	{
+		body.Step(dt, settings.forceIterations, settings.forceSubIterations);
+
+		records[i].profile = body.GetProfile();
+		records[i].stats = body.GetSolverStats();
+		body.GetMemoryStats(&records[i].memory);
+
+		scene->PostStep();
+	}
+
+	Summary summaries[s_fieldCount];
+	for (uint32 i = settings.warmup; i < stepCount; ++i)
+	{
+		double fields[s_fieldCount];
+		GetFields(fields, records[i]);
+
+		for (uint32 j = 0; j < s_fieldCount; ++j)
+		{
+			summaries[j].Add(fields[j]);
+		}
+	}
+
+	const char* preconditioner = s_preconditionerNames[settings.preconditioner];
+
+	if (settings.format == e_csv)
+	{
+		if (first)
+		{
+			fprintf(file, "scene,size,threads,preconditioner,force_iterations,force_sub_iterations,");
+			fprintf(file, "warm_starting,adaptive_sub_tolerance,line_search,matrix_free,direct_solver,ordering,shuffle,");
+			fprintf(file, "symmetric_storage,mixed_precision,refinement,hertz,frame,warmup");
+			for (uint32 j = 0; j < s_fieldCount; ++j)
+			{
+				fprintf(file, ",%s", s_fieldNames[j]);
+			}
+			fprintf(file, "\n");
+		}
+
+		for (uint32 i = 0; i < stepCount; ++i)
+		{
+			double fields[s_fieldCount];
+			GetFields(fields, records[i]);
+
+			fprintf(file, "%s,%u,%u,%s,%u,%u,", sceneName, settings.size, settings.threads, preconditioner, 
+				settings.forceIterations, settings.forceSubIterations);
+			fprintf(file, "%d,%d,%d,%d,%d,%s,%d,", settings.warmStarting, settings.adaptiveSubTolerance, settings.lineSearch, 
+				settings.matrixFree, settings.direct, s_orderingNames[settings.ordering], settings.shuffle);
+			fprintf(file, "%d,%d,%u,%g,%u,%d", settings.symmetric, settings.mixedPrecision, settings.refinement, 
+				double(settings.hertz), i, i < settings.warmup ? 1 : 0);
+			for (uint32 j = 0; j < s_fieldCount; ++j)
+			{
+				fprintf(file, ",%.6g", fields[j]);
+			}
+			fprintf(file, "\n");
+		}
+	}
+	else
+	{
+		if (first == false)
+		{
+			fprintf(file, ",\n");
+		}
+
+		fprintf(file, "  {\n");
+		fprintf(file, "    \"scene\": \"%s\",\n", sceneName);
+		fprintf(file, "    \"size\": %u,\n", settings.size);
+		fprintf(file, "    \"threads\": %u,\n", settings.threads);
+		fprintf(file, "    \"preconditioner\": \"%s\",\n", preconditioner);
+		fprintf(file, "    \"force_iterations\": %u,\n", settings.forceIterations);
+		fprintf(file, "    \"force_sub_iterations\": %u,\n", settings.forceSubIterations);
+		fprintf(file, "    \"warm_starting\": %s,\n", settings.warmStarting ? "true" : "false");
+		fprintf(file, "    \"adaptive_sub_tolerance\": %s,\n", settings.adaptiveSubTolerance ? "true" : "false");
+		fprintf(file, "    \"line_search\": %s,\n", settings.lineSearch ? "true" : "false");
+		fprintf(file, "    \"matrix_free\": %s,\n", settings.matrixFree ? "true" : "false");
+		fprintf(file, "    \"direct_solver\": %s,\n", settings.direct ? "true" : "false");
+		fprintf(file, "    \"ordering\": \"%s\",\n", s_orderingNames[settings.ordering]);
+		fprintf(file, "    \"shuffle\": %s,\n", settings.shuffle ? "true" : "false");
+		fprintf(file, "    \"symmetric_storage\": %s,\n", settings.symmetric ? "true" : "false");
+		fprintf(file, "    \"mixed_precision\": %s,\n", settings.mixedPrecision ? "true" : "false");
+		fprintf(file, "    \"refinement\": %u,\n", settings.refinement);
+		fprintf(file, "    \"hertz\": %g,\n", double(settings.hertz));
+		fprintf(file, "    \"warmup\": %u,\n", settings.warmup);
+		fprintf(file, "    \"steps\": %u,\n", settings.steps);
+		fprintf(file, "    \"create_time\": %.6g,\n", createTime);
+		fprintf(file, "    \"create_alloc_calls\": %u,\n", createAllocCalls);
+		
+		fprintf(file, "    \"summary\": {\n");
+		for (uint32 j = 0; j < s_fieldCount; ++j)
+		{
+			const Summary& s = summaries[j];
+			fprintf(file, "      \"%s\": { \"mean\": %.6g, \"min\": %.6g, \"max\": %.6g, \"total\": %.6g }%s\n", 
+				s_fieldNames[j], s.Mean(), s.min, s.max, s.sum, j + 1 < s_fieldCount ? "," : "");
+		}
+		fprintf(file, "    },\n");
+
+		fprintf(file, "    \"frames\": [\n");
+		for (uint32 i = 0; i < stepCount; ++i)
+		{
+			double fields[s_fieldCount];
+			GetFields(fields, records[i]);
+
+			fprintf(file, "      { \"frame\": %u, \"warmup\": %s", i, i < settings.warmup ? "true" : "false");
+			for (uint32 j = 0; j < s_fieldCount; ++j)
+			{
+				fprintf(file, ", \"%s\": %.6g", s_fieldNames[j], fields[j]);
+			}
+			fprintf(file, " }%s\n", i + 1 < stepCount ? "," : "");
+		}
+		fprintf(file, "    ]\n");
+		fprintf(file, "  }");
+	}
+
+	if (file != stdout)
+	{
+		printf("%s: %u particles, %.3f ms per step\n", sceneName, scene->m_body.GetParticleCount(), summaries[0].Mean());
+	}
+
+	free(records);
+	delete scene;
+}
+
+static void PrintUsage()
+{
+	printf("Usage: bench [options]\n");
+	printf("  --scene <name>           pinned, sheet, tet, tearing or all (default all)\n");
+	printf("  --size <n>               grid resolution (default 32)\n");
+	printf("  --steps <n>              number of measured steps (default 120)\n");
+	printf("  --warmup <n>             number of steps excluded from the summary (default 2)\n");
+	printf("  --threads <n>            number of solver threads (default 1)\n");
+	printf("  --preconditioner <name>  jacobi, block_jacobi, ic0 or multigrid (default jacobi)\n");
+	printf("  --iterations <n>         force iterations (default 1)\n");
+	printf("  --sub-iterations <n>     force sub-iterations (default 40)\n");
+	printf("  --warm-starting <0|1>    seed the solver with the last step (default 0)\n");
+	printf("  --adaptive-tol <0|1>     choose the sub-tolerance per iteration (default 0)\n");
+	printf("  --line-search <0|1>      backtrack the Newton steps (default 0)\n");
+	printf("  --matrix-free <0|1>      don't assemble the system matrix (default 0)\n");
+	printf("  --direct <0|1>           factor the system matrix instead of CG (default 0)\n");
+	printf("  --ordering <name>        particle ordering none, rcm or morton (default none)\n");
+	printf("  --shuffle <0|1>          create the particles in a random order (default 0)\n");
+	printf("  --symmetric <0|1>        store only the upper blocks of the system matrix (default 0)\n");
+	printf("  --mixed-precision <0|1>  accumulate the CG dot products in double precision (default 0)\n");
+	printf("  --refinement <n>         max iterative refinement steps of CG (default 0)\n");
+	printf("  --hertz <x>              step frequency (default 60)\n");
+	printf("  --format <name>          json or csv (default json)\n");
+	printf("  --output <file>          output file or - for the standard output (default bench.json or bench.csv)\n");
+	printf("  --micro <name>           run the micro-benchmark matrix, allocations, creation, destruction or all\n");
+	printf("                           instead of the scenes and print the results\n");
+}
+
+static bool ParseArgs(Settings* settings, int argc, char** args)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = args[i];
+		if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0)
+		{
+			return false;
+		}
+
+		if (i + 1 >= argc)
+		{
+			fprintf(stderr, "Missing value of %s.\n", arg);
+			return false;
+		}
+
+		const char* value = args[++i];
+		
+		if (strcmp(arg, "--scene") == 0)
+		{
+			settings->scene = value;
+		}
+		else if (strcmp(arg, "--size") == 0)
+		{
+			settings->size = b3Max(uint32(atoi(value)), 1u);
+		}
+		else if (strcmp(arg, "--steps") == 0)
+		{
+			settings->steps = uint32(atoi(value));
+		}
+		else if (strcmp(arg, "--warmup") == 0)
+		{
+			settings->warmup = uint32(atoi(value));
+		}
+		else if (strcmp(arg, "--threads") == 0)
+		{
+			settings->threads = b3Max(uint32(atoi(value)), 1u);
+		}
+		else if (strcmp(arg, "--preconditioner") == 0)
+		{
+			bool found = false;
+			for (uint32 j = 0; j < sizeof(s_preconditionerNames) / sizeof(const char*); ++j)
+			{
+				if (strcmp(value, s_preconditionerNames[j]) == 0)
+				{
+					settings->preconditioner = b3PreconditionerType(j);
+					found = true;
+				}
+			}
+			
+			if (found == false)
+			{
+				fprintf(stderr, "Unknown preconditioner %s.\n", value);
+				return false;
+			}
+		}
+		else if (strcmp(arg, "--iterations") == 0)
+		{
+			settings->forceIterations = uint32(atoi(value));
+		}
+		else if (strcmp(arg, "--sub-iterations") == 0)
+		{
+			settings->forceSubIterations = uint32(atoi(value));
+		}
+		else if (strcmp(arg, "--warm-starting") == 0)
+		{
+			settings->warmStarting = atoi(value) != 0;
+		}
+		else if (strcmp(arg, "--adaptive-tol") == 0)
+		{
+			settings->adaptiveSubTolerance = atoi(value) != 0;
+		}
+		else if (strcmp(arg, "--line-search") == 0)
+		{
+			settings->lineSearch = atoi(value) != 0;
+		}
+		else if (strcmp(arg, "--matrix-free") == 0)
+		{
+			settings->matrixFree = atoi(value) != 0;
+		}
+		else if (strcmp(arg, "--direct") == 0)
+		{
+			settings->direct = atoi(value) != 0;
+		}
+		else if (strcmp(arg, "--ordering") == 0)
+		{
+			bool found = false;
+			for (uint32 j = 0; j < sizeof(s_orderingNames) / sizeof(const char*); ++j)
+			{
+				if (strcmp(value, s_orderingNames[j]) == 0)
+				{
+					settings->ordering = b3ParticleOrdering(j);
+					found = true;
+				}
+			}
+			
+			if (found == false)
+			{
+				fprintf(stderr, "Unknown ordering %s.\n", value);
+				return false;
+			}
+		}
+		else if (strcmp(arg, "--shuffle") == 0)
+		{
+			settings->shuffle = atoi(value) != 0;
+		}
+		else if (strcmp(arg, "--symmetric") == 0)
+		{
+			settings->symmetric = atoi(value) != 0;
+		}
+		else if (strcmp(arg, "--mixed-precision") == 0)
+		{
+			settings->mixedPrecision = atoi(value) != 0;
+		}
+		else if (strcmp(arg, "--refinement") == 0)
+		{
+			settings->refinement = uint32(atoi(value));
+		}
+		else if (strcmp(arg, "--hertz") == 0)
+		{
+			settings->hertz = scalar(atof(value));
+		}
+		else if (strcmp(arg, "--format") == 0)
+		{
+			if (strcmp(value, "json") == 0)
+			{
+				settings->format = e_json;
+			}
+			else if (strcmp(value, "csv") == 0)
+			{
+				settings->format = e_csv;
+			}
+			else
+			{
+				fprintf(stderr, "Unknown format %s.\n", value);
+				return false;
+			}
+		}
+		else if (strcmp(arg, "--output") == 0)
+		{
+			settings->output = value;
+		}
+		else if (strcmp(arg, "--micro") == 0)
+		{
+			settings->micro = value;
+		}
+		else
+		{
+			fprintf(stderr, "Unknown option %s.\n", arg);
+			return false;
+		}
+	}
+	
+	if (strcmp(settings->scene, "all") != 0)
+	{
+		bool found = false;
+		for (uint32 i = 0; i < s_sceneCount; ++i)
+		{
+			if (strcmp(settings->scene, s_sceneNames[i]) == 0)
+			{
+				found = true;
+			}
+		}
+
+		if (found == false)
+		{
+			fprintf(stderr, "Unknown scene %s.\n", settings->scene);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int main(int argc, char** args)
+{
+	Settings settings;
+	if (ParseArgs(&settings, argc, args) == false)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	if (settings.micro)
+	{
+		if (RunMicroBenchmark(settings.micro) == false)
+		{
+			fprintf(stderr, "Unknown micro-benchmark %s.\n", settings.micro);
+			PrintUsage();
+			return 1;
+		}
+		return 0;
+	}
+
+	if (settings.output == nullptr)
+	{
+		// The library logs to the standard output.
+		settings.output = settings.format == e_json ? "bench.json" : "bench.csv";
+	}
+
+	FILE* file = stdout;
+	if (strcmp(settings.output, "-") != 0)
+	{
+		file = fopen(settings.output, "w");
+		if (file == nullptr)
+		{
+			fprintf(stderr, "Could not open %s.\n", settings.output);
+			return 1;
+		}
+	}
+
+	if (settings.format == e_json)
+	{
+		fprintf(file, "[\n");
+	}
+
+	bool first = true;
+	for (uint32 i = 0; i < s_sceneCount; ++i)
+	{
+		if (strcmp(settings.scene, "all") != 0 && strcmp(settings.scene, s_sceneNames[i]) != 0)
+		{
+			continue;
+		}
+
+		Run(file, settings, s_sceneNames[i], first);
+		first = false;
+	}
+
+	if (settings.format == e_json)
+	{
+		fprintf(file, "\n]\n");
+	}
+
+	if (file != stdout)
+	{
+		fclose(file);
+	}
+
+	return 0;
+}
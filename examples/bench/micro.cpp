@@ -0,0 +1,525 @@
+/*
+* Copyright (c) 2016-2019 Irlan Robson
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "micro.h"
+#include "list_mat33.h"
+
+#include <bounce_softbody/sparse/sparse_mat33.h>
+#include <bounce_softbody/dynamics/body.h>
+#include <bounce_softbody/dynamics/particle.h>
+#include <bounce_softbody/dynamics/forces/spring_force.h>
+#include <bounce_softbody/dynamics/fixtures/sphere_fixture.h>
+#include <bounce_softbody/dynamics/fixtures/triangle_fixture.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+// Micro-benchmarks of the building blocks of the body step.
+// The matrix benchmark compares the block compressed row layout of b3SparseMat33 
+// against the previous linked list layout. 
+// The matrix has the structure of the Jacobian of a grid cloth with one 
+// element per triangle.
+// The allocation benchmark counts the memory allocations of the steps of a grid cloth body. 
+// The creation benchmark compares the creation of the fixtures one by one against the creation in bulk.
+// The destruction benchmark measures the destruction of particles shared by fixtures and forces.
+
+typedef std::chrono::steady_clock Clock;
+
+static double ElapsedMs(const Clock::time_point& t1, const Clock::time_point& t2)
+{
+	return std::chrono::duration<double, std::milli>(t2 - t1).count();
+}
+
+struct Grid
+{
+	Grid(uint32 n)
+	{
+		size = n;
+		particleCount = (n + 1) * (n + 1);
+		triangleCount = 2 * n * n;
+		triangles = (uint32*)malloc(3 * triangleCount * sizeof(uint32));
+
+		uint32* t = triangles;
+		for (uint32 i = 0; i < n; ++i)
+		{
+			for (uint32 j = 0; j < n; ++j)
+			{
+				uint32 v1 = i * (n + 1) + j;
+				uint32 v2 = (i + 1) * (n + 1) + j;
+				uint32 v3 = (i + 1) * (n + 1) + j + 1;
+				uint32 v4 = i * (n + 1) + j + 1;
+
+				t[0] = v1; t[1] = v2; t[2] = v3; t += 3;
+				t[0] = v3; t[1] = v4; t[2] = v1; t += 3;
+			}
+		}
+	}
+
+	~Grid()
+	{
+		free(triangles);
+	}
+
+	uint32 size;
+	uint32 particleCount;
+	uint32 triangleCount;
+	uint32* triangles;
+};
+
+// Return a block that depends on the indices.
+static b3Mat33 ElementBlock(uint32 i, uint32 j)
+{
+	scalar s = scalar(1) / scalar(1 + i + j);
+	return b3Mat33Diagonal(s, scalar(2) * s, scalar(3) * s);
+}
+
+template<class T>
+static void Assemble(T& A, const Grid& grid)
+{
+	for (uint32 t = 0; t < grid.triangleCount; ++t)
+	{
+		const uint32* vs = grid.triangles + 3 * t;
+		for (uint32 i = 0; i < 3; ++i)
+		{
+			for (uint32 j = 0; j < 3; ++j)
+			{
+				A(vs[i], vs[j]) += ElementBlock(vs[i], vs[j]);
+			}
+		}
+	}
+}
+
+static void SetStructure(b3SparseMat33& A, const Grid& grid)
+{
+	uint32 indexCount = 9 * grid.triangleCount;
+	b3BlockIndex* indices = (b3BlockIndex*)malloc(indexCount * sizeof(b3BlockIndex));
+
+	uint32 index = 0;
+	for (uint32 t = 0; t < grid.triangleCount; ++t)
+	{
+		const uint32* vs = grid.triangles + 3 * t;
+		for (uint32 i = 0; i < 3; ++i)
+		{
+			for (uint32 j = 0; j < 3; ++j)
+			{
+				indices[index].row = vs[i];
+				indices[index].column = vs[j];
+				++index;
+			}
+		}
+	}
+
+	A.SetStructure(indices, indexCount);
+
+	free(indices);
+}
+
+static void Run(uint32 gridSize, uint32 assemblyCount, uint32 productCount)
+{
+	Grid grid(gridSize);
+
+	uint32 n = grid.particleCount;
+
+	b3DenseVec3 x(n), y1(n), y2(n);
+	for (uint32 i = 0; i < n; ++i)
+	{
+		x[i].Set(scalar(i % 7), scalar(i % 11), scalar(i % 13));
+	}
+
+	// List layout
+	double listAssembly = 0.0, listProduct = 0.0;
+	for (uint32 k = 0; k < assemblyCount; ++k)
+	{
+		Clock::time_point t1 = Clock::now();
+
+		ListMat33 A(n);
+		Assemble(A, grid);
+
+		Clock::time_point t2 = Clock::now();
+		
+		listAssembly += ElapsedMs(t1, t2);
+
+		if (k == 0)
+		{
+			for (uint32 p = 0; p < productCount; ++p)
+			{
+				Mul(y1, A, x);
+			}
+
+			listProduct = ElapsedMs(t2, Clock::now());
+		}
+	}
+
+	// Block compressed row layout.
+	// The structure is computed before every assembly.
+	double bsrStructure = 0.0, bsrAssembly = 0.0, bsrProduct = 0.0;
+	for (uint32 k = 0; k < assemblyCount; ++k)
+	{
+		Clock::time_point t0 = Clock::now();
+
+		b3SparseMat33 A(n);
+		SetStructure(A, grid);
+
+		Clock::time_point t1 = Clock::now();
+
+		Assemble(A, grid);
+
+		Clock::time_point t2 = Clock::now();
+
+		bsrStructure += ElapsedMs(t0, t1);
+		bsrAssembly += ElapsedMs(t1, t2);
+
+		if (k == 0)
+		{
+			for (uint32 p = 0; p < productCount; ++p)
+			{
+				b3Mul(y2, A, x);
+			}
+
+			bsrProduct = ElapsedMs(t2, Clock::now());
+		}
+	}
+
+	// Validate.
+	scalar maxError = scalar(0);
+	for (uint32 i = 0; i < n; ++i)
+	{
+		b3Vec3 d = y1[i] - y2[i];
+		maxError = b3Max(maxError, b3Max(b3Abs(d.x), b3Max(b3Abs(d.y), b3Abs(d.z))));
+	}
+
+	printf("%6u %10u %14.3f %14.3f %14.3f %14.3f %14.3f %12g\n", gridSize, n,
+		listAssembly / assemblyCount, bsrStructure / assemblyCount, bsrAssembly / assemblyCount,
+		listProduct / productCount, bsrProduct / productCount, maxError);
+}
+
+// Count the calls to b3Alloc in the steps of a pinned grid cloth made of springs 
+// after the solver memory has been allocated in the first steps.
+static void CountAllocations(uint32 gridSize, uint32 stepCount)
+{
+	Grid grid(gridSize);
+
+	b3Body body;
+	body.SetGravity(b3Vec3(scalar(0), scalar(-10), scalar(0)));
+
+	b3Particle** particles = (b3Particle**)malloc(grid.particleCount * sizeof(b3Particle*));
+	for (uint32 i = 0; i < grid.particleCount; ++i)
+	{
+		uint32 row = i / (gridSize + 1);
+		uint32 column = i % (gridSize + 1);
+
+		b3ParticleDef pd;
+		pd.type = row == 0 ? e_staticParticle : e_dynamicParticle;
+		pd.position.Set(scalar(column), scalar(0), scalar(row));
+
+		particles[i] = body.CreateParticle(pd);
+	}
+
+	// Connect each particle to its right, bottom and diagonal neighbours.
+	uint32 n = gridSize + 1;
+	for (uint32 row = 0; row < n; ++row)
+	{
+		for (uint32 column = 0; column < n; ++column)
+		{
+			b3Particle* p1 = particles[row * n + column];
+			
+			b3Particle* neighbours[3];
+			uint32 neighbourCount = 0;
+			if (column + 1 < n)
+			{
+				neighbours[neighbourCount++] = particles[row * n + column + 1];
+			}
+			if (row + 1 < n)
+			{
+				neighbours[neighbourCount++] = particles[(row + 1) * n + column];
+			}
+			if (row + 1 < n && column + 1 < n)
+			{
+				neighbours[neighbourCount++] = particles[(row + 1) * n + column + 1];
+			}
+
+			for (uint32 i = 0; i < neighbourCount; ++i)
+			{
+				b3SpringForceDef sd;
+				sd.Initialize(p1, neighbours[i], scalar(1000), scalar(10));
+				body.CreateForce(sd);
+			}
+		}
+	}
+
+	free(particles);
+
+	scalar dt = scalar(1) / scalar(60);
+	for (uint32 i = 0; i < 2; ++i)
+	{
+		body.Step(dt, 2, 40);
+	}
+
+	uint64 allocCalls = b3GetAllocCounters().allocCalls;
+
+	Clock::time_point t1 = Clock::now();
+
+	for (uint32 i = 0; i < stepCount; ++i)
+	{
+		body.Step(dt, 2, 40);
+	}
+
+	Clock::time_point t2 = Clock::now();
+
+	printf("%6u %10u %14.3f %14u\n", gridSize, grid.particleCount, ElapsedMs(t1, t2) / stepCount, uint32(b3GetAllocCounters().allocCalls - allocCalls));
+}
+
+// Return the time to create the particles, spheres and triangles of a grid cloth 
+// either one by one or in bulk.
+static double CreateBody(const Grid& grid, bool bulk)
+{
+	uint32 n = grid.size + 1;
+
+	b3ParticleDef* pds = new b3ParticleDef[grid.particleCount];
+	for (uint32 i = 0; i < grid.particleCount; ++i)
+	{
+		pds[i].position.Set(scalar(i % n), scalar(0), scalar(i / n));
+	}
+
+	b3SphereFixtureDef* sds = new b3SphereFixtureDef[grid.particleCount];
+	b3TriangleFixtureDef* tds = new b3TriangleFixtureDef[grid.triangleCount];
+
+	b3Particle** particles = (b3Particle**)malloc(grid.particleCount * sizeof(b3Particle*));
+	b3SphereFixture** spheres = (b3SphereFixture**)malloc(grid.particleCount * sizeof(b3SphereFixture*));
+	b3TriangleFixture** triangles = (b3TriangleFixture**)malloc(grid.triangleCount * sizeof(b3TriangleFixture*));
+
+	b3Body body;
+
+	Clock::time_point t1 = Clock::now();
+
+	if (bulk)
+	{
+		body.CreateParticles(particles, pds, grid.particleCount);
+	}
+	else
+	{
+		for (uint32 i = 0; i < grid.particleCount; ++i)
+		{
+			particles[i] = body.CreateParticle(pds[i]);
+		}
+	}
+
+	for (uint32 i = 0; i < grid.particleCount; ++i)
+	{
+		sds[i].p = particles[i];
+		sds[i].radius = scalar(0.1);
+	}
+
+	for (uint32 i = 0; i < grid.triangleCount; ++i)
+	{
+		const uint32* vs = grid.triangles + 3 * i;
+		tds[i].p1 = particles[vs[0]];
+		tds[i].p2 = particles[vs[1]];
+		tds[i].p3 = particles[vs[2]];
+		tds[i].v1 = pds[vs[0]].position;
+		tds[i].v2 = pds[vs[1]].position;
+		tds[i].v3 = pds[vs[2]].position;
+	}
+
+	if (bulk)
+	{
+		body.CreateSpheres(spheres, sds, grid.particleCount);
+		body.CreateTriangles(triangles, tds, grid.triangleCount);
+	}
+	else
+	{
+		for (uint32 i = 0; i < grid.particleCount; ++i)
+		{
+			spheres[i] = body.CreateSphere(sds[i]);
+		}
+
+		for (uint32 i = 0; i < grid.triangleCount; ++i)
+		{
+			triangles[i] = body.CreateTriangle(tds[i]);
+		}
+	}
+
+	Clock::time_point t2 = Clock::now();
+
+	free(particles);
+	free(spheres);
+	free(triangles);
+	delete[] pds;
+	delete[] sds;
+	delete[] tds;
+
+	return ElapsedMs(t1, t2);
+}
+
+// Return the time to destroy every other particle of a grid cloth 
+// with a sphere per particle and a spring per triangle edge.
+static double DestroyParticles(const Grid& grid)
+{
+	uint32 n = grid.size + 1;
+
+	b3ParticleDef* pds = new b3ParticleDef[grid.particleCount];
+	for (uint32 i = 0; i < grid.particleCount; ++i)
+	{
+		pds[i].type = e_dynamicParticle;
+		pds[i].position.Set(scalar(i % n), scalar(0), scalar(i / n));
+	}
+
+	b3Particle** particles = (b3Particle**)malloc(grid.particleCount * sizeof(b3Particle*));
+
+	b3Body body;
+	body.CreateParticles(particles, pds, grid.particleCount);
+
+	for (uint32 i = 0; i < grid.particleCount; ++i)
+	{
+		b3SphereFixtureDef sd;
+		sd.p = particles[i];
+		sd.radius = scalar(0.1);
+		body.CreateSphere(sd);
+	}
+
+	for (uint32 i = 0; i < grid.triangleCount; ++i)
+	{
+		const uint32* vs = grid.triangles + 3 * i;
+
+		b3TriangleFixtureDef td;
+		td.p1 = particles[vs[0]];
+		td.p2 = particles[vs[1]];
+		td.p3 = particles[vs[2]];
+		td.v1 = pds[vs[0]].position;
+		td.v2 = pds[vs[1]].position;
+		td.v3 = pds[vs[2]].position;
+		body.CreateTriangle(td);
+
+		for (uint32 j = 0; j < 3; ++j)
+		{
+			b3SpringForceDef sd;
+			sd.Initialize(particles[vs[j]], particles[vs[(j + 1) % 3]], scalar(100), scalar(0));
+			body.CreateForce(sd);
+		}
+	}
+
+	Clock::time_point t1 = Clock::now();
+
+	for (uint32 i = 0; i < grid.particleCount; i += 2)
+	{
+		body.DestroyParticle(particles[i]);
+	}
+
+	Clock::time_point t2 = Clock::now();
+
+	free(particles);
+	delete[] pds;
+
+	return ElapsedMs(t1, t2);
+}
+
+static const uint32 s_gridSizes[] = { 32, 64, 128, 224 };
+static const uint32 s_gridSizeCount = sizeof(s_gridSizes) / sizeof(uint32);
+
+static const uint32 s_creationSizes[] = { 32, 64, 128, 256, 512 };
+static const uint32 s_creationSizeCount = sizeof(s_creationSizes) / sizeof(uint32);
+
+static void RunMatrix()
+{
+	uint32 assemblyCount = 10;
+	uint32 productCount = 100;
+
+	printf("Sparse matrix layout benchmark. Times in ms.\n");
+	printf("%6s %10s %14s %14s %14s %14s %14s %12s\n", "grid", "particles", "list assembly", "bsr structure", "bsr assembly", "list product", "bsr product", "max error");
+
+	for (uint32 i = 0; i < s_gridSizeCount; ++i)
+	{
+		Run(s_gridSizes[i], assemblyCount, productCount);
+	}
+}
+
+static void RunAllocations()
+{
+	printf("Body step allocations. Times in ms.\n");
+	printf("%6s %10s %14s %14s\n", "grid", "particles", "step", "allocations");
+
+	for (uint32 i = 0; i < s_gridSizeCount; ++i)
+	{
+		CountAllocations(s_gridSizes[i], 10);
+	}
+}
+
+static void RunCreation()
+{
+	printf("Body creation. Times in ms.\n");
+	printf("%6s %10s %10s %14s %14s\n", "grid", "particles", "triangles", "one by one", "bulk");
+
+	for (uint32 i = 0; i < s_creationSizeCount; ++i)
+	{
+		Grid grid(s_creationSizes[i]);
+
+		double single = CreateBody(grid, false);
+		printf("%6u %10u %10u %14.3f %14.3f\n", grid.size, grid.particleCount, grid.triangleCount, single, CreateBody(grid, true));
+	}
+}
+
+static void RunDestruction()
+{
+	printf("Particle destruction. Times in ms.\n");
+	printf("%6s %10s %10s %14s\n", "grid", "particles", "destroyed", "destruction");
+
+	for (uint32 i = 0; i < s_creationSizeCount; ++i)
+	{
+		Grid grid(s_creationSizes[i]);
+		
+		printf("%6u %10u %10u %14.3f\n", grid.size, grid.particleCount, (grid.particleCount + 1) / 2, DestroyParticles(grid));
+	}
+}
+
+struct MicroBenchmark
+{
+	const char* name;
+	void (*run)();
+};
+
+static const MicroBenchmark s_microBenchmarks[] = 
+{
+	{ "matrix", RunMatrix },
+	{ "allocations", RunAllocations },
+	{ "creation", RunCreation },
+	{ "destruction", RunDestruction },
+};
+
+static const uint32 s_microBenchmarkCount = sizeof(s_microBenchmarks) / sizeof(MicroBenchmark);
+
+bool RunMicroBenchmark(const char* name)
+{
+	bool all = strcmp(name, "all") == 0;
+	bool found = false;
+	for (uint32 i = 0; i < s_microBenchmarkCount; ++i)
+	{
+		if (all || strcmp(name, s_microBenchmarks[i].name) == 0)
+		{
+			if (found)
+			{
+				printf("\n");
+			}
+
+			s_microBenchmarks[i].run();
+			found = true;
+		}
+	}
+	return found;
+}
@@ -58,15 +58,21 @@ public:
 			b3DrawSegment(m_debugDrawData, pA, pB, b3Color_white);
 		}
 
-		extern uint32 b3_forceSolverIterations;
-		extern uint32 b3_forceSolverMinSubIterations;
-		extern uint32 b3_forceSolverMaxSubIterations;
-
-		DrawString(b3Color_white, "Iterations = %d", b3_forceSolverIterations);
-		DrawString(b3Color_white, "Sub-iterations [min] [max] = [%d] [%d]", b3_forceSolverMinSubIterations, b3_forceSolverMaxSubIterations);
+		const b3SolverStats& stats = m_body->GetSolverStats();
+		DrawString(b3Color_white, "Iterations = %d", stats.iterations);
+		DrawString(b3Color_white, "Sub-iterations [min] [max] = [%d] [%d]", stats.minSubIterations, stats.maxSubIterations);
 
 		scalar E = m_body->GetEnergy();
 		DrawString(b3Color_white, "E = %f", E);
+
+		const b3Profile& profile = m_body->GetProfile();
+		DrawString(b3Color_white, "Step = %.2f ms", profile.step);
+		DrawString(b3Color_white, "Assembly [CG] = [%.2f] [%.2f] ms", profile.assembly, profile.solveCG);
+
+		b3MemoryStats memory;
+		m_body->GetMemoryStats(&memory);
+		DrawString(b3Color_white, "Memory = %.2f KB", scalar(memory.totalBytes) / scalar(1024));
+		DrawString(b3Color_white, "Step allocations = %u", memory.stepAllocCalls);
 	}
 	
 	virtual void Draw()
@@ -103,8 +103,10 @@ public:
 
 	b3SpringForce* FindSpringForce(b3Particle* p1, b3Particle* p2)
 	{
-		for (b3Force* f = m_body->GetForceList(); f; f = f->GetNext())
+		for (b3ForceEdge* e = p1->GetForceList(); e; e = e->next)
 		{
+			b3Force* f = e->force;
+
 			if (f->GetType() != e_springForce)
 			{
 				continue;
@@ -162,17 +164,14 @@ public:
 		b3Array<b3TriangleFixture*>& above,
 		b3Array<b3TriangleFixture*>& below)
 	{
-		for (b3TriangleFixture* t = m_body->GetTriangleList(); t; t = t->GetNext())
+		for (b3FixtureEdge* e = p->GetTriangleList(); e; e = e->next)
 		{
+			b3TriangleFixture* t = (b3TriangleFixture*)e->fixture;
+
 			b3Particle* p1 = t->GetParticle1();
 			b3Particle* p2 = t->GetParticle2();
 			b3Particle* p3 = t->GetParticle3();
 
-			if (p1 != p && p2 != p && p3 != p)
-			{
-				continue;
-			}
-
 			b3Vec3 x1 = p1->GetPosition();
 			b3Vec3 x2 = p2->GetPosition();
 			b3Vec3 x3 = p3->GetPosition();
@@ -173,8 +173,8 @@ inline void b3BroadPhase::FindPairs(T* callback)
 			continue;
 		}
 
-		const b3AABB& aabb = m_tree.GetAABB(m_queryProxyId);
-		m_tree.QueryAABB(this, aabb);
+		const b3AABB& aabb = m_tree.GetFatAABB(m_queryProxyId);
+		m_tree.Query(this, aabb);
 	}
 
 	// Reset the move buffer for the next step.
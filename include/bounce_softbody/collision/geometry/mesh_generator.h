@@ -0,0 +1,75 @@
+/*
+* Copyright (c) 2016-2019 Irlan Robson
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B3_MESH_GENERATOR_H
+#define B3_MESH_GENERATOR_H
+
+#include <bounce_softbody/collision/geometry/mesh.h>
+
+// These functions build meshes whose resolution is known only at runtime. 
+// They allocate the mesh arrays using b3Alloc. 
+// The vertices are laid out as in b3GridMesh, b3SphereMesh and b3CylinderMesh.
+// The triangle wing vertices are set to B3_NULL_VERTEX.
+
+// Build a (H + 1) x (W + 1) grid mesh stored in row-major order. 
+// The grid is centered at the origin, aligned with the world x-z axes 
+// and has unit cells.
+// v(i, j) = i * (W + 1) + j
+void b3BuildGridMesh(b3Mesh* mesh, uint32 H, uint32 W);
+
+// Build a (H + 1) x (W + 1) unit sphere mesh stored in row-major order.
+// v(i, j) = i * (W + 1) + j
+void b3BuildSphereMesh(b3Mesh* mesh, uint32 H, uint32 W);
+
+// Build a (H + 1) x (W + 1) cylinder mesh with unit radius and height 
+// stored in row-major order. The caps are closed.
+// v(i, j) = i * (W + 1) + j
+void b3BuildCylinderMesh(b3Mesh* mesh, uint32 H, uint32 W);
+
+// Free the arrays of a mesh built by one of the functions above.
+void b3FreeMesh(b3Mesh* mesh);
+
+// Tetrahedron.
+struct b3Tetrahedron
+{
+	// The tetrahedron vertices in the mesh.
+	uint32 v1, v2, v3, v4;
+};
+
+// A tetrahedral mesh and the triangles on its boundary.
+struct b3TetMesh
+{
+	uint32 vertexCount;
+	b3Vec3* vertices;
+	uint32 triangleCount;
+	b3Triangle* triangles;
+	uint32 tetrahedronCount;
+	b3Tetrahedron* tetrahedrons;
+};
+
+// Build a H x W x D box of unit cubes centered at the origin. 
+// Each cube is split into five tetrahedra. 
+// H is the number of cubes along the y axis, W along the x axis and D along 
+// the z axis.
+// v(i, j, k) = (i * (W + 1) + j) * (D + 1) + k
+void b3BuildBoxTetMesh(b3TetMesh* mesh, uint32 H, uint32 W, uint32 D);
+
+// Free the arrays of a tetrahedral mesh built by b3BuildBoxTetMesh.
+void b3FreeTetMesh(b3TetMesh* mesh);
+
+#endif
@@ -26,6 +26,29 @@ class b3BlockPool;
 // Number of blocks pools.
 const uint32 b3_blockSizeCount = 14;
 
+// Memory statistics of a block allocator.
+struct b3BlockAllocatorStats
+{
+	// Size of the blocks of each pool in bytes.
+	uint32 blockSizes[b3_blockSizeCount];
+
+	// Number of chunks allocated by each pool.
+	uint32 chunkCounts[b3_blockSizeCount];
+
+	// Number of blocks in use in each pool.
+	uint32 blockCounts[b3_blockSizeCount];
+
+	// Bytes allocated by the pools.
+	uint32 chunkBytes;
+
+	// Bytes of the blocks in use.
+	uint32 blockBytes;
+
+	// Number and bytes of the allocations larger than the maximum block size.
+	uint32 largeCount;
+	uint32 largeBytes;
+};
+
 /// This is a small object allocator used for allocating small
 /// objects that persist for more than one time step.
 /// See: http://www.codeproject.com/useritems/Small_Block_Allocator.asp
@@ -40,9 +63,16 @@ public:
 
 	// Free memory. This will use b3Free if the size is larger than b3_maxBlockSize.
 	void Free(void* p, uint32 size);
+
+	// Get the memory statistics.
+	void GetStats(b3BlockAllocatorStats* stats) const;
 private:
 	// One pool per block size.
 	b3BlockPool* m_blockPools;
+
+	// Allocations larger than the maximum block size.
+	uint32 m_largeCount;
+	uint32 m_largeBytes;
 };
 
 #endif
\ No newline at end of file
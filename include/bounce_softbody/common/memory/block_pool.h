@@ -33,6 +33,15 @@ public:
 
 	void* Allocate();
 	void Free(void* p);
+
+	// Get the size of a block in bytes.
+	uint32 GetBlockSize() const;
+
+	// Get the number of allocated chunks.
+	uint32 GetChunkCount() const;
+
+	// Get the number of blocks in use.
+	uint32 GetBlockCount() const;
 private:
 	struct b3Block
 	{
@@ -50,6 +59,23 @@ private:
 
 	b3Chunk* m_chunks;
 	uint32 m_chunkCount;
+
+	uint32 m_blockCount;
 };
 
+inline uint32 b3BlockPool::GetBlockSize() const
+{
+	return m_blockSize;
+}
+
+inline uint32 b3BlockPool::GetChunkCount() const
+{
+	return m_chunkCount;
+}
+
+inline uint32 b3BlockPool::GetBlockCount() const
+{
+	return m_blockCount;
+}
+
 #endif
@@ -21,19 +21,45 @@
 
 #include <bounce_softbody/common/settings.h>
 
-// Allocate 1 MiB from the stack. 
-// Increase as you want.
-const uint32 b3_maxStackSize = B3_MiB(1);
+// The default initial capacity of a stack allocator.
+// The memory is allocated on the first allocation.
+const uint32 b3_defaultStackCapacity = 0;
 
-// A stack allocator.
+// The alignment of the blocks returned by a stack allocator.
+const uint32 b3_stackAlignment = 16;
+
+// A stack allocator. 
+// The memory is allocated with b3Alloc and grows to the peak usage. 
+// An allocation that doesn't fit in the memory uses b3Alloc.  
+// When all blocks are freed the memory grows to the peak usage, 
+// so the next allocations of the same size fit.
 class b3StackAllocator 
 {
 public :
-	b3StackAllocator();
+	b3StackAllocator(uint32 capacity = b3_defaultStackCapacity);
 	~b3StackAllocator();
 
+	// Allocate a block of memory.
 	void* Allocate(uint32 size);
+
+	// Free the last allocated block.
 	void Free(void* p);
+
+	// Ensure the memory can hold a given number of bytes. 
+	// This must be called when no blocks are allocated.
+	void Reserve(uint32 capacity);
+
+	// Get the size of the memory in bytes.
+	uint32 GetCapacity() const;
+
+	// Get the number of bytes in use.
+	uint32 GetAllocation() const;
+
+	// Get the peak number of bytes in use, including the blocks allocated with b3Alloc.
+	uint32 GetMaxAllocation() const;
+
+	// Get the number of blocks that didn't fit in the memory and were allocated with b3Alloc.
+	uint32 GetParentAllocationCount() const;
 private :
 	struct b3Block 
 	{
@@ -46,8 +72,32 @@ private :
 	b3Block* m_blocks;
 	uint32 m_blockCount;
 
-	uint32 m_allocatedSize; // marker
-	uint8 m_memory[b3_maxStackSize];
+	uint8* m_memory;
+	uint32 m_capacity;
+	uint32 m_index; // marker
+	uint32 m_allocation; // bytes in use including the parent blocks
+	uint32 m_maxAllocation;
+	uint32 m_parentCount;
 };
 
+inline uint32 b3StackAllocator::GetCapacity() const
+{
+	return m_capacity;
+}
+
+inline uint32 b3StackAllocator::GetAllocation() const
+{
+	return m_allocation;
+}
+
+inline uint32 b3StackAllocator::GetMaxAllocation() const
+{
+	return m_maxAllocation;
+}
+
+inline uint32 b3StackAllocator::GetParentAllocationCount() const
+{
+	return m_parentCount;
+}
+
 #endif
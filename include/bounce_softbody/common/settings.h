@@ -94,6 +94,12 @@ typedef double scalar64;
 // to overshoot.
 #define B3_BAUMGARTE scalar(0.2)
 
+// Set this to zero to compile out the step profiler.
+// The profile times are zero in that case.
+#ifndef B3_PROFILE
+#define B3_PROFILE 1
+#endif
+
 // Memory
 
 #define B3_NOT_USED(x) ((void)(x))
@@ -112,12 +118,35 @@ typedef double scalar64;
 # endif
 #endif
 
-// You should implement this function to use your own memory allocator.
+// Memory allocation functions.
+typedef void* b3AllocFcn(uint32 size);
+typedef void b3FreeFcn(void* block);
+
+// Set the functions called by b3Alloc and b3Free to use your own memory allocator. 
+// Set both to null to restore malloc and free. 
+// This must be called when no memory allocated by b3Alloc is in use.
+void b3SetAllocator(b3AllocFcn* allocFcn, b3FreeFcn* freeFcn);
+
+// Allocate memory using the allocation function.
 void* b3Alloc(uint32 size);
 
-// You must implement this function if you have implemented b3Alloc.
+// Free memory allocated by b3Alloc.
 void b3Free(void* block);
 
+// Calls to b3Alloc and b3Free made by a thread.
+// Calls made by other threads, such as the workers of a thread pool, are not counted.
+struct b3AllocCounters
+{
+	uint64 allocCalls;
+	uint64 freeCalls;
+	uint64 allocBytes; // requested bytes
+};
+
+// Get the counters of the calling thread. 
+// The difference of the counters before and after a function 
+// gives the allocations done by the function.
+const b3AllocCounters& b3GetAllocCounters();
+
 // You should implement this function to visualize log messages coming 
 // from this software.
 void b3Log(const char* string, ...);
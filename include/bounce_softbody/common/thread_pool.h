@@ -0,0 +1,81 @@
+/*
+* Copyright (c) 2016-2019 Irlan Robson
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B3_THREAD_POOL_H
+#define B3_THREAD_POOL_H
+
+#include <bounce_softbody/common/settings.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+// A task executed over the index range [begin, end).
+typedef void b3ParallelForFcn(void* context, uint32 begin, uint32 end);
+
+// A pool of worker threads for data parallel loops.
+// The calling thread participates in every loop.
+class b3ThreadPool
+{
+public:
+	b3ThreadPool();
+	~b3ThreadPool();
+
+	// Set the number of threads including the calling thread.
+	// This blocks until the previous workers have exited.
+	void SetThreadCount(uint32 count);
+
+	// Get the number of threads including the calling thread.
+	uint32 GetThreadCount() const;
+
+	// Execute a task over [0, count) split into ranges of at most grainSize indices.
+	// Ranges may run in any order and on any thread.
+	// This returns after all ranges have been executed.
+	void ParallelFor(uint32 count, uint32 grainSize, b3ParallelForFcn* fcn, void* context);
+private:
+	void StartWorkers();
+	void StopWorkers();
+	void WorkerLoop(uint32 generation);
+	void Execute();
+
+	uint32 m_threadCount;
+	
+	uint32 m_workerCount;
+	std::thread* m_workers;
+
+	std::mutex m_mutex;
+	std::condition_variable m_workCondition;
+	std::condition_variable m_doneCondition;
+	uint32 m_generation;
+	uint32 m_busyCount;
+	bool m_exit;
+
+	// Current loop
+	b3ParallelForFcn* m_fcn;
+	void* m_context;
+	uint32 m_count;
+	uint32 m_grainSize;
+	std::atomic<uint32> m_next;
+};
+
+inline uint32 b3ThreadPool::GetThreadCount() const
+{
+	return m_threadCount;
+}
+
+#endif
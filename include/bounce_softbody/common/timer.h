@@ -0,0 +1,55 @@
+/*
+* Copyright (c) 2016-2019 Irlan Robson
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B3_TIMER_H
+#define B3_TIMER_H
+
+#include <bounce_softbody/common/settings.h>
+
+#if B3_PROFILE
+
+// A high resolution timer. 
+// This is used for profiling.
+class b3Timer
+{
+public:
+	// Start the timer.
+	b3Timer();
+
+	// Restart the timer.
+	void Reset();
+
+	// Get the time since the timer was started, in milliseconds.
+	scalar64 GetMilliseconds() const;
+private:
+	uint64 m_start;
+};
+
+#else
+
+// The timer does nothing if profiling is compiled out.
+class b3Timer
+{
+public:
+	void Reset() { }
+	scalar64 GetMilliseconds() const { return 0.0; }
+};
+
+#endif
+
+#endif
@@ -21,8 +21,17 @@
 
 #include <bounce_softbody/common/memory/stack_allocator.h>
 #include <bounce_softbody/common/memory/block_allocator.h>
+#include <bounce_softbody/common/thread_pool.h>
 #include <bounce_softbody/collision/trees/dynamic_tree.h>
 #include <bounce_softbody/dynamics/contact_manager.h>
+#include <bounce_softbody/dynamics/time_step.h>
+#include <bounce_softbody/dynamics/solver_stats.h>
+#include <bounce_softbody/dynamics/memory_stats.h>
+#include <bounce_softbody/dynamics/particle_storage.h>
+#include <bounce_softbody/sparse/sparse_mat33.h>
+#include <bounce_softbody/sparse/sparse_preconditioner.h>
+#include <bounce_softbody/sparse/sparse_cholesky.h>
+#include <bounce_softbody/sparse/sparse_workspace.h>
 
 class b3Draw;
 
@@ -67,6 +76,10 @@ public:
 	// Create a particle.
 	b3Particle* CreateParticle(const b3ParticleDef& def);
 
+	// Create a number of particles. 
+	// The new particles are written to the given array in the order of the definitions.
+	void CreateParticles(b3Particle** particles, const b3ParticleDef* defs, uint32 count);
+
 	// Destroy a given particle.
 	void DestroyParticle(b3Particle* particle);
 
@@ -80,6 +93,9 @@ public:
 	// Create a force.
 	b3Force* CreateForce(const b3ForceDef& def);
 
+	// Create a number of forces from an array of pointers to definitions of any type.
+	void CreateForces(b3Force** forces, const b3ForceDef* const* defs, uint32 count);
+
 	// Destroy a given force.
 	void DestroyForce(b3Force* force);
 
@@ -93,6 +109,10 @@ public:
 	// Create a sphere fixture.
 	b3SphereFixture* CreateSphere(const b3SphereFixtureDef& def);
 
+	// Create a number of sphere fixtures in linear time. 
+	// The existing sphere is returned for a particle that already has one.
+	void CreateSpheres(b3SphereFixture** spheres, const b3SphereFixtureDef* defs, uint32 count);
+
 	// Destroy a given sphere fixture.
 	void DestroySphere(b3SphereFixture* fixture);
 	
@@ -106,6 +126,11 @@ public:
 	// Create a triangle fixture.
 	b3TriangleFixture* CreateTriangle(const b3TriangleFixtureDef& def);
 
+	// Create a number of triangle fixtures in linear time. 
+	// The existing triangle is returned for duplicate particles. 
+	// The body mass is reset once.
+	void CreateTriangles(b3TriangleFixture** triangles, const b3TriangleFixtureDef* defs, uint32 count);
+
 	// Destroy a given triangle fixture.
 	void DestroyTriangle(b3TriangleFixture* fixture);
 
@@ -119,6 +144,11 @@ public:
 	// Create a tetrahedron fixture.
 	b3TetrahedronFixture* CreateTetrahedron(const b3TetrahedronFixtureDef& def);
 
+	// Create a number of tetrahedron fixtures in linear time. 
+	// The existing tetrahedron is returned for duplicate particles. 
+	// The body mass is reset once.
+	void CreateTetrahedrons(b3TetrahedronFixture** tetrahedrons, const b3TetrahedronFixtureDef* defs, uint32 count);
+
 	// Destroy a given tetrahedron fixture.
 	void DestroyTetrahedron(b3TetrahedronFixture* fixture);
 
@@ -148,6 +178,114 @@ public:
 	// Get the acceleration of gravity.
 	b3Vec3 GetGravity() const;
 
+	// Set the number of threads used to apply the forces and solve the linear systems. 
+	// The default is one. The simulation result does not depend on the number of threads.
+	void SetThreadCount(uint32 count);
+
+	// Get the number of threads used by the solver.
+	uint32 GetThreadCount() const;
+
+	// Set the preconditioner of the linear solver. The default is the Jacobi preconditioner.
+	void SetPreconditioner(b3PreconditionerType type);
+
+	// Get the preconditioner of the linear solver.
+	b3PreconditionerType GetPreconditioner() const;
+
+	// Set the number of steps a computed preconditioner is reused. 
+	// The default is one, which recomputes the preconditioner every step.
+	// Reusing a factorization pays off when the system matrix changes little between steps.
+	void SetPreconditionerInterval(uint32 steps);
+
+	// Get the number of steps a computed preconditioner is reused.
+	uint32 GetPreconditionerInterval() const;
+
+	// Enable/disable warm starting. The default is disabled.
+	// Warm starting seeds the linear solver with the velocity change predicted 
+	// from the last step, which saves iterations on slowly varying motion.
+	// The prediction is discarded when particles or forces are created or destroyed.
+	void SetWarmStarting(bool flag);
+
+	// Is warm starting enabled?
+	bool GetWarmStarting() const;
+
+	// Enable/disable the adaptive tolerance of the linear solver. The default is disabled.
+	// The tolerance of each Newton iteration then follows the decrease of the Newton residual, 
+	// so early iterations are solved loosely. This only pays off with several force iterations.
+	void SetAdaptiveSubTolerance(bool flag);
+
+	// Is the adaptive tolerance of the linear solver enabled?
+	bool GetAdaptiveSubTolerance() const;
+
+	// Enable/disable the line search of the Newton iterations. The default is disabled.
+	// The line search shortens a Newton step that does not decrease the residual, 
+	// which helps stiff forces converge at the cost of additional force evaluations.
+	void SetLineSearch(bool flag);
+
+	// Is the line search enabled?
+	bool GetLineSearch() const;
+
+	// Enable/disable the matrix-free solver. The default is disabled.
+	// The force Jacobians are then multiplied by vectors instead of being assembled into a matrix, 
+	// which saves memory on large bodies. The preconditioner falls back to block-Jacobi 
+	// unless it is Jacobi or block-Jacobi.
+	void SetMatrixFree(bool flag);
+
+	// Is the matrix-free solver enabled?
+	bool GetMatrixFree() const;
+
+	// Enable/disable the sparse direct solver. The default is disabled.
+	// The system matrix is then factored instead of being solved with CG, which 
+	// converges in one solve and suits small and medium bodies. Use CG for large bodies.
+	// The solver falls back to CG if the matrix isn't positive definite or in matrix-free mode.
+	void SetDirectSolver(bool flag);
+
+	// Is the sparse direct solver enabled?
+	bool GetDirectSolver() const;
+
+	// Set the ordering of the particle state in the solver. The default is the creation order.
+	// An ordering that keeps connected particles close in memory speeds up the assembly 
+	// and the matrix products on meshes with a poor vertex order. 
+	// The ordering is recomputed only when particles or forces are created or destroyed.
+	void SetParticleOrdering(b3ParticleOrdering ordering);
+
+	// Get the ordering of the particle state in the solver.
+	b3ParticleOrdering GetParticleOrdering() const;
+
+	// Enable/disable the symmetric storage of the system matrix. The default is disabled.
+	// Only the diagonal and upper blocks of the symmetric force Jacobians are then stored and assembled, 
+	// which halves the memory of the matrices and the blocks read by the matrix products. 
+	// The incomplete Cholesky and multigrid preconditioners fall back to block-Jacobi and 
+	// the direct solver is not used.
+	void SetSymmetricStorage(bool flag);
+
+	// Is the symmetric storage of the system matrix enabled?
+	bool GetSymmetricStorage() const;
+
+	// Enable/disable the mixed precision inner solver. The default is disabled.
+	// The vectors and matrices stay in single precision but the dot products 
+	// are accumulated in double precision, which keeps the inner solver converging on large bodies.
+	void SetMixedPrecision(bool flag);
+
+	// Is the mixed precision inner solver enabled?
+	bool GetMixedPrecision() const;
+
+	// Set the maximum number of iterative refinement steps of the inner solver. The default is zero.
+	// A step recomputes the residual of the solution and solves for a correction 
+	// if the residual is above the inner tolerance.
+	void SetRefinementIterations(uint32 iterations);
+
+	// Get the maximum number of iterative refinement steps of the inner solver.
+	uint32 GetRefinementIterations() const;
+
+	// Set the stack allocator used for the temporary memory of the solver. 
+	// An allocator can be shared by bodies that are stepped on the same thread. 
+	// Set to null to use the allocator of this body, which is the default.
+	void SetStackAllocator(b3StackAllocator* allocator);
+
+	// Get the stack allocator used for the temporary memory of the solver.
+	const b3StackAllocator* GetStackAllocator() const;
+	b3StackAllocator* GetStackAllocator();
+
 	// Perform a time step given the number of force solver and subsolver iterations. 
 	// Warning: Use one force solver iteration for reasonable performance. 
 	void Step(scalar dt, uint32 forceIterations, uint32 forceSubIterations);
@@ -158,6 +296,23 @@ public:
 	// Return the kinetic energy in this system.
 	scalar GetEnergy() const;
 
+	// Get the timings of the last step.
+	// The times are zero if B3_PROFILE is zero.
+	const b3Profile& GetProfile() const;
+
+	// Get the force solver statistics of the last step.
+	const b3SolverStats& GetSolverStats() const;
+
+	// Set the number of steps kept in the solver statistics history.
+	// The default is zero, which disables the history.
+	void SetSolverStatsHistoryCapacity(uint32 steps);
+
+	// Get the solver statistics of the last steps.
+	const b3SolverStatsHistory& GetSolverStatsHistory() const;
+
+	// Get the memory usage of this body and the allocations made by the stepping thread during the last step.
+	void GetMemoryStats(b3MemoryStats* stats) const;
+
 	// Debug draw the body entities.
 	void DebugDraw(b3Draw* draw) const;
 protected:
@@ -171,12 +326,40 @@ protected:
 	// Rest the mass data of the body.
 	void ResetMass();
 
+	// Create fixtures without checking for duplicates 
+	// or resetting the body mass.
+	b3SphereFixture* InsertSphere(const b3SphereFixtureDef& def);
+	b3TriangleFixture* InsertTriangle(const b3TriangleFixtureDef& def);
+	b3TetrahedronFixture* InsertTetrahedron(const b3TetrahedronFixtureDef& def);
+
+	// Set the block structure of the force Jacobians to a matrix.
+	// Only the diagonal and upper blocks are set if upper is true.
+	void SetPattern(b3SparseMat33* pattern, bool upper);
+
+	// Rebuild the block structure of the force Jacobians 
+	// and the Jacobian slots of each force.
+	void UpdatePattern();
+
+	// Color the forces such that no two forces 
+	// with the same color share a particle.
+	void ColorForces();
+
+	// Reorder the particle state and the solver ids.
+	void OrderParticles();
+
 	// Solve
 	void Solve(const b3TimeStep& step);
 
-	// Stack allocator
+	// Stack allocator of this body
 	b3StackAllocator m_stackAllocator;
 
+	// Stack allocator used by the solver. 
+	// This is either the allocator of this body or a shared allocator.
+	b3StackAllocator* m_solverAllocator;
+
+	// Persistent memory of the solver
+	b3SparseWorkspace m_workspace;
+
 	// Block allocator
 	b3BlockAllocator m_blockAllocator;
 
@@ -187,6 +370,9 @@ protected:
 	b3Particle* m_particleList;
 	uint32 m_particleCount;
 
+	// Particle state
+	b3ParticleStorage m_particleStorage;
+
 	// List of forces
 	b3Force* m_forceList;
 	uint32 m_forceCount;
@@ -212,6 +398,64 @@ protected:
 
 	// Dynamic tree.
 	b3DynamicTree m_tree;
+
+	// Thread pool
+	b3ThreadPool m_threadPool;
+
+	// Set when particles or forces are created or destroyed.
+	bool m_topologyChanged;
+
+	// Block structure of the force Jacobians.
+	b3SparseMat33 m_pattern;
+
+	// Forces sorted by color. 
+	// The forces of color i are in [m_colorOffsets[i], m_colorOffsets[i + 1]).
+	b3Force** m_colorForces;
+	uint32* m_colorOffsets;
+	uint32 m_colorCount;
+
+	// Preconditioner of the linear solver.
+	// This is recomputed every m_preconditionerInterval steps.
+	b3SparsePreconditioner m_preconditioner;
+	uint32 m_preconditionerInterval;
+	uint32 m_preconditionerAge;
+
+	// Seed the solver with the last step acceleration.
+	bool m_warmStarting;
+
+	// Inexact Newton options
+	bool m_adaptiveSubTolerance;
+	bool m_lineSearch;
+
+	// Don't assemble the system matrix.
+	bool m_matrixFree;
+
+	// Factor the system matrix instead of using CG.
+	// The symbolic factorization is kept until the topology changes.
+	b3SparseCholesky m_directSolver;
+	bool m_direct;
+
+	// Ordering of the particle state. 
+	// This is recomputed when the topology changes.
+	b3ParticleOrdering m_particleOrdering;
+
+	// Store only the upper blocks of the Jacobians.
+	bool m_symmetricStorage;
+
+	// Inner solver precision options
+	bool m_mixedPrecision;
+	uint32 m_refinementIterations;
+
+	// Timings of the last step
+	b3Profile m_profile;
+
+	// Solver statistics of the last step
+	b3SolverStats m_stats;
+	b3SolverStatsHistory m_statsHistory;
+
+	// Allocations of the last step
+	b3AllocCounters m_stepAllocCounters;
+	uint32 m_stepStackParentCount;
 };
 
 inline void b3Body::SetGravity(const b3Vec3& gravity)
@@ -224,6 +468,171 @@ inline b3Vec3 b3Body::GetGravity() const
 	return m_gravity;
 }
 
+inline const b3Profile& b3Body::GetProfile() const
+{
+	return m_profile;
+}
+
+inline const b3SolverStats& b3Body::GetSolverStats() const
+{
+	return m_stats;
+}
+
+inline void b3Body::SetSolverStatsHistoryCapacity(uint32 steps)
+{
+	m_statsHistory.SetCapacity(steps);
+}
+
+inline const b3SolverStatsHistory& b3Body::GetSolverStatsHistory() const
+{
+	return m_statsHistory;
+}
+
+inline void b3Body::SetThreadCount(uint32 count)
+{
+	m_threadPool.SetThreadCount(count);
+}
+
+inline uint32 b3Body::GetThreadCount() const
+{
+	return m_threadPool.GetThreadCount();
+}
+
+inline void b3Body::SetPreconditioner(b3PreconditionerType type)
+{
+	m_preconditioner.type = type;
+	m_preconditionerAge = m_preconditionerInterval;
+}
+
+inline b3PreconditionerType b3Body::GetPreconditioner() const
+{
+	return m_preconditioner.type;
+}
+
+inline void b3Body::SetPreconditionerInterval(uint32 steps)
+{
+	B3_ASSERT(steps > 0);
+	m_preconditionerInterval = steps;
+}
+
+inline uint32 b3Body::GetPreconditionerInterval() const
+{
+	return m_preconditionerInterval;
+}
+
+inline void b3Body::SetWarmStarting(bool flag)
+{
+	m_warmStarting = flag;
+}
+
+inline bool b3Body::GetWarmStarting() const
+{
+	return m_warmStarting;
+}
+
+inline void b3Body::SetAdaptiveSubTolerance(bool flag)
+{
+	m_adaptiveSubTolerance = flag;
+}
+
+inline bool b3Body::GetAdaptiveSubTolerance() const
+{
+	return m_adaptiveSubTolerance;
+}
+
+inline void b3Body::SetLineSearch(bool flag)
+{
+	m_lineSearch = flag;
+}
+
+inline bool b3Body::GetLineSearch() const
+{
+	return m_lineSearch;
+}
+
+inline void b3Body::SetMatrixFree(bool flag)
+{
+	m_matrixFree = flag;
+}
+
+inline bool b3Body::GetMatrixFree() const
+{
+	return m_matrixFree;
+}
+
+inline void b3Body::SetDirectSolver(bool flag)
+{
+	m_direct = flag;
+}
+
+inline bool b3Body::GetDirectSolver() const
+{
+	return m_direct;
+}
+
+inline void b3Body::SetParticleOrdering(b3ParticleOrdering ordering)
+{
+	if (ordering != m_particleOrdering)
+	{
+		m_particleOrdering = ordering;
+		m_topologyChanged = true;
+	}
+}
+
+inline b3ParticleOrdering b3Body::GetParticleOrdering() const
+{
+	return m_particleOrdering;
+}
+
+inline void b3Body::SetSymmetricStorage(bool flag)
+{
+	if (flag != m_symmetricStorage)
+	{
+		m_symmetricStorage = flag;
+		m_topologyChanged = true;
+	}
+}
+
+inline bool b3Body::GetSymmetricStorage() const
+{
+	return m_symmetricStorage;
+}
+
+inline void b3Body::SetMixedPrecision(bool flag)
+{
+	m_mixedPrecision = flag;
+}
+
+inline bool b3Body::GetMixedPrecision() const
+{
+	return m_mixedPrecision;
+}
+
+inline void b3Body::SetRefinementIterations(uint32 iterations)
+{
+	m_refinementIterations = iterations;
+}
+
+inline uint32 b3Body::GetRefinementIterations() const
+{
+	return m_refinementIterations;
+}
+
+inline void b3Body::SetStackAllocator(b3StackAllocator* allocator)
+{
+	m_solverAllocator = allocator ? allocator : &m_stackAllocator;
+}
+
+inline const b3StackAllocator* b3Body::GetStackAllocator() const
+{
+	return m_solverAllocator;
+}
+
+inline b3StackAllocator* b3Body::GetStackAllocator()
+{
+	return m_solverAllocator;
+}
+
 inline const b3Particle* b3Body::GetParticleList() const
 {
 	return m_particleList;
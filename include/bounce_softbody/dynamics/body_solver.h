@@ -22,16 +22,34 @@
 #include <bounce_softbody/common/math/vec3.h>
 
 class b3StackAllocator;
-class b3Particle;
+class b3SparseWorkspace;
+class b3ThreadPool;
 class b3Force;
 class b3Contact;
 
+struct b3SparseMat33;
+struct b3SparsePreconditioner;
+struct b3SparseCholesky;
+struct b3ParticleStorage;
+struct b3Profile;
+struct b3SolverStats;
+
 struct b3TimeStep;
 
 struct b3BodySolverDef
 {
 	b3StackAllocator* allocator;
-	uint32 particleCapacity;
+	b3SparseWorkspace* workspace;
+	b3Profile* profile;
+	b3SolverStats* stats;
+	const b3SparseMat33* pattern;
+	b3ThreadPool* threadPool;
+	uint32 colorCount;
+	const uint32* colorOffsets;
+	b3SparsePreconditioner* preconditioner;
+	bool updatePreconditioner;
+	b3SparseCholesky* directSolver;
+	b3ParticleStorage* particles;
 	uint32 forceCapacity;
 	uint32 contactCapacity;
 };
@@ -42,7 +60,6 @@ public:
 	b3BodySolver(const b3BodySolverDef& def);
 	~b3BodySolver();
 	
-	void Add(b3Particle* p);
 	void Add(b3Force* f);
 	void Add(b3Contact* c);
 	
@@ -50,9 +67,24 @@ public:
 private:
 	b3StackAllocator* m_allocator;
 
-	uint32 m_particleCapacity;
-	uint32 m_particleCount;
-	b3Particle** m_particles;
+	b3SparseWorkspace* m_workspace;
+
+	b3Profile* m_profile;
+
+	b3SolverStats* m_stats;
+
+	const b3SparseMat33* m_pattern;
+
+	b3ThreadPool* m_threadPool;
+
+	uint32 m_colorCount;
+	const uint32* m_colorOffsets;
+
+	b3SparsePreconditioner* m_preconditioner;
+	bool m_updatePreconditioner;
+	b3SparseCholesky* m_directSolver;
+
+	b3ParticleStorage* m_particles;
 
 	uint32 m_forceCapacity;
 	uint32 m_forceCount;
@@ -19,7 +19,7 @@
 #ifndef B3_CONTACT_MANAGER_H
 #define B3_CONTACT_MANAGER_H
 
-#include <bounce_softbody/common/settings.h>
+#include <bounce_softbody/collision/trees/dynamic_tree.h>
 
 class b3Body;
 class b3BlockAllocator;
@@ -29,10 +29,32 @@ class b3WorldFixture;
 class b3SphereAndShapeContact;
 
 // Contact delegator for b3Body.
+// World fixtures are kept in a dynamic tree. 
+// Spheres have a fat AABB and only the spheres that moved 
+// out of their fat AABB query the tree for new contacts.
 class b3ContactManager
 {
 public:
 	b3ContactManager();
+	~b3ContactManager();
+
+	// Add or remove a world fixture from the tree.
+	void AddFixture(b3WorldFixture* fixture);
+	void RemoveFixture(b3WorldFixture* fixture);
+
+	// Add or remove a sphere from the move buffer.
+	void AddSphere(b3SphereFixture* fixture);
+	void RemoveSphere(b3SphereFixture* fixture);
+
+	// Force a sphere to query the tree in the next call to FindNewContacts.
+	void TouchSphere(b3SphereFixture* fixture);
+
+	// Update the fat AABBs of the spheres 
+	// and buffer the spheres that moved out of them.
+	void SynchronizeSpheres();
+	
+	// Report the new overlapping pairs of the moved spheres.
+	bool Report(uint32 proxyId);
 
 	void AddPair(b3SphereFixture* fixture1, b3WorldFixture* fixture2);
 	void FindNewContacts();
@@ -40,10 +62,36 @@ public:
 
 	void Destroy(b3SphereAndShapeContact* contact);
 
+	// Get the number of bytes allocated by the move buffer and the pair hash table.
+	// The fixture tree and the contacts are not included.
+	uint32 GetByteCount() const;
+
 	b3Body* m_body;
 	b3BlockAllocator* m_allocator;
 	b3SphereAndShapeContact* m_contactList;
 	uint32 m_contactCount;
+
+	// Tree of world fixtures.
+	b3DynamicTree m_fixtureTree;
+
+	// Spheres that need to query the tree.
+	b3SphereFixture** m_moveBuffer;
+	uint32 m_moveCount;
+	uint32 m_moveCapacity;
+
+	// The sphere being queried.
+	b3SphereFixture* m_querySphere;
+
+	// Hash table of contacts for finding existing pairs.
+	b3SphereAndShapeContact** m_pairBuckets;
+	uint32 m_pairBucketCount;
+private:
+	void BufferMove(b3SphereFixture* fixture);
+	
+	b3SphereAndShapeContact* FindPair(b3SphereFixture* fixture1, b3WorldFixture* fixture2) const;
+	void InsertPair(b3SphereAndShapeContact* contact);
+	void RemovePair(b3SphereAndShapeContact* contact);
+	void RehashPairs(uint32 bucketCount);
 };
 
 #endif
\ No newline at end of file
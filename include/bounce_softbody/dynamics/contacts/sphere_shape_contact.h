@@ -44,6 +44,13 @@ public:
 	b3SphereAndShapeContact* m_prev;
 	b3SphereAndShapeContact* m_next;
 
+	// Links to the sphere list of contacts.
+	b3SphereAndShapeContact* m_spherePrev;
+	b3SphereAndShapeContact* m_sphereNext;
+
+	// Contact manager pair table link.
+	b3SphereAndShapeContact* m_hashNext;
+
 	b3SphereFixture* m_fixture1;
 	b3WorldFixture* m_fixture2;
 	
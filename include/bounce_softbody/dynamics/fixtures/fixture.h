@@ -22,6 +22,7 @@
 #include <bounce_softbody/common/math/math.h>
 
 class b3Body;
+class b3Fixture;
 
 enum b3FixtureType
 {
@@ -57,6 +58,15 @@ struct b3FixtureDef
 	uint32 userIndex;
 };
 
+// A fixture edge connects a particle to a triangle or tetrahedron containing it.
+// Each particle keeps a doubly linked list of the fixtures sharing it.
+struct b3FixtureEdge
+{
+	b3Fixture* fixture; // the fixture
+	b3FixtureEdge* prev; // the previous fixture edge in the particle list
+	b3FixtureEdge* next; // the next fixture edge in the particle list
+};
+
 // This is an internal body fixture.
 class b3Fixture
 {
@@ -23,6 +23,7 @@
 #include <bounce_softbody/collision/geometry/aabb.h>
 
 class b3Particle;
+class b3SphereAndShapeContact;
 
 // Sphere fixture definition.
 struct b3SphereFixtureDef : public b3FixtureDef
@@ -66,6 +67,16 @@ private:
 	// Particle
 	b3Particle* m_p;
 
+	// Fat AABB used for finding contacts.
+	b3AABB m_aabb;
+
+	// Index of the sphere in the contact manager move buffer. 
+	// This is B3_MAX_U32 if the sphere isn't in the buffer.
+	uint32 m_moveIndex;
+
+	// List of the contacts of this sphere.
+	b3SphereAndShapeContact* m_contactList;
+
 	// Links to the body list.
 	b3SphereFixture* m_prev;
 	b3SphereFixture* m_next;
@@ -80,6 +80,9 @@ private:
 	// Rest volume. Used for computing the mass of the particles.
 	scalar m_volume;
 
+	// Links to the tetrahedron lists of the particles.
+	b3FixtureEdge m_edges[4];
+
 	// Links to the body list.
 	b3TetrahedronFixture* m_prev;
 	b3TetrahedronFixture* m_next;
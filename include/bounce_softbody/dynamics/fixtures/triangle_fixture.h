@@ -91,6 +91,9 @@ private:
 	// Dynamic tree proxy.
 	uint32 m_proxyId;
 
+	// Links to the triangle lists of the particles.
+	b3FixtureEdge m_edges[3];
+
 	// Links to the body list.
 	b3TriangleFixture* m_prev;
 	b3TriangleFixture* m_next;
@@ -94,6 +94,9 @@ private:
 	// Coefficient of friction.
 	scalar m_friction;
 
+	// Contact manager tree proxy.
+	uint32 m_proxyId;
+
 	// Body.
 	b3Body* m_body;
 
@@ -23,8 +23,16 @@
 
 class b3BlockAllocator;
 class b3Particle;
+class b3Force;
 
 struct b3SparseForceSolverData;
+struct b3SparseForceProductData;
+struct b3SparseMat33;
+struct b3DiagMat33;
+struct b3Mat33;
+
+// Maximum number of particles a force can act on.
+const uint32 b3_maxForceParticles = 4;
 
 // Force types
 enum b3ForceType
@@ -54,6 +62,15 @@ struct b3ForceDef
 	uint32 userIndex;
 };
 
+// A force edge connects a particle to a force acting on it.
+// Each particle keeps a doubly linked list of the forces acting on it.
+struct b3ForceEdge
+{
+	b3Force* force; // the force
+	b3ForceEdge* prev; // the previous force edge in the particle list
+	b3ForceEdge* next; // the next force edge in the particle list
+};
+
 // Forces acting on a set of particles.
 class b3Force
 {
@@ -86,15 +103,35 @@ protected:
 	// Clear internal forces stored for the user.
 	virtual void ClearForces() = 0;
 
+	// Get the particles this force acts on. Return the number of particles.
+	virtual uint32 GetParticles(b3Particle* particles[b3_maxForceParticles]) const = 0;
+
 	// Apply forces and Jacobians.
 	virtual void ApplyForces(const b3SparseForceSolverData* data) = 0;
 
+	// Multiply the off-diagonal Jacobian blocks of the last call to ApplyForces by a vector.
+	virtual void MultiplyJacobians(const b3SparseForceProductData* data) const = 0;
+
+	// Add the Jacobian blocks K of this force to a Jacobian J. 
+	// The block (i, j) of the particles with solver indices i and j is K[i * count + j].
+	// If J is not given only the diagonal blocks are added to the diagonal Jacobian D.
+	// Blocks that are not in the structure of J are skipped.
+	void AddJacobian(b3SparseMat33* J, b3DiagMat33* D, const b3Mat33* K, const uint32* indices, uint32 count) const;
+
 	// Force type.
 	b3ForceType m_type;
 	
 	// User index.
 	uint32 m_userIndex;
 
+	// Slots of the Jacobian blocks of this force in the body Jacobian structure.
+	// The block (i, j) of the particles returned by GetParticles is at slot i * count + j.
+	// The slot is B3_MAX_U32 if the structure only stores the upper blocks and the block is below the diagonal.
+	uint32 m_slots[b3_maxForceParticles * b3_maxForceParticles];
+
+	// Links to the force lists of the particles returned by GetParticles.
+	b3ForceEdge m_edges[b3_maxForceParticles];
+
 	// Links to body list.
 	b3Force* m_prev;
 	b3Force* m_next;
@@ -20,7 +20,7 @@
 #define B3_MOUSE_FORCE_H
 
 #include <bounce_softbody/dynamics/forces/force.h>
-#include <bounce_softbody/common/math/vec3.h>
+#include <bounce_softbody/common/math/mat33.h>
 
 // Mouse force definition.
 // This requires defining a particle and a triangle 
@@ -125,7 +125,9 @@ private:
 	b3MouseForce(const b3MouseForceDef* def);
 	
 	void ClearForces();
+	uint32 GetParticles(b3Particle* particles[b3_maxForceParticles]) const;
 	void ApplyForces(const b3SparseForceSolverData* data);
+	void MultiplyJacobians(const b3SparseForceProductData* data) const;
 
 	// Particle 1
 	b3Particle* m_p1;
@@ -153,6 +155,9 @@ private:
 
 	// Action forces
 	b3Vec3 m_f1, m_f2, m_f3, m_f4;
+
+	// Position and velocity Jacobians for matrix-free products
+	b3Mat33 m_Kx, m_Kv;
 };
 
 inline void b3MouseForce::SetLength(scalar length)
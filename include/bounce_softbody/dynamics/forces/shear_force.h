@@ -113,7 +113,9 @@ private:
 	b3ShearForce(const b3ShearForceDef* def);
 	
 	void ClearForces();
+	uint32 GetParticles(b3Particle* particles[b3_maxForceParticles]) const;
 	void ApplyForces(const b3SparseForceSolverData* data);
+	void MultiplyJacobians(const b3SparseForceProductData* data) const;
 
 	// Particle 1
 	b3Particle* m_p1;
@@ -143,6 +145,9 @@ private:
 
 	// Action forces
 	b3Vec3 m_f1, m_f2, m_f3;
+
+	// Constraint Jacobian for matrix-free products
+	b3Vec3 m_dCdx[3];
 };
 
 inline void b3ShearForce::SetStiffness(scalar stiffness)
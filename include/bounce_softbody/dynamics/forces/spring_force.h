@@ -20,7 +20,7 @@
 #define B3_SPRING_FORCE_H
 
 #include <bounce_softbody/dynamics/forces/force.h>
-#include <bounce_softbody/common/math/vec3.h>
+#include <bounce_softbody/common/math/mat33.h>
 
 // Spring force definition.
 // This requires defining two particles, the 
@@ -98,7 +98,9 @@ private:
 	b3SpringForce(const b3SpringForceDef* def);
 	
 	void ClearForces();
+	uint32 GetParticles(b3Particle* particles[b3_maxForceParticles]) const;
 	void ApplyForces(const b3SparseForceSolverData* data);
+	void MultiplyJacobians(const b3SparseForceProductData* data) const;
 
 	// Particle 1
 	b3Particle* m_p1;
@@ -117,6 +119,9 @@ private:
 
 	// Action forces
 	b3Vec3 m_f1, m_f2;
+
+	// Position and velocity Jacobian blocks (1, 1) for matrix-free products
+	b3Mat33 m_Kx, m_Kv;
 };
 
 inline void b3SpringForce::SetLength(scalar length)
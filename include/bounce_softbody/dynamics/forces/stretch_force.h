@@ -156,7 +156,9 @@ private:
 	b3StretchForce(const b3StretchForceDef* def);
 	
 	void ClearForces();
+	uint32 GetParticles(b3Particle* particles[b3_maxForceParticles]) const;
 	void ApplyForces(const b3SparseForceSolverData* data);
+	void MultiplyJacobians(const b3SparseForceProductData* data) const;
 
 	// Particle 1
 	b3Particle* m_p1;
@@ -196,6 +198,12 @@ private:
 	// Desired strechiness in v direction
 	scalar m_b_v;
 
+	// Jacobians for matrix-free products. In each direction
+	// K_ij = dwdx_i * dwdx_j * (kn * n * n^T + kt * (I - n * n^T))
+	b3Vec3 m_n_u, m_n_v;
+	scalar m_kxn_u, m_kxt_u, m_kvn_u;
+	scalar m_kxn_v, m_kxt_v, m_kvn_v;
+
 	// Action forces
 	b3Vec3 m_f1, m_f2, m_f3;
 };
@@ -120,7 +120,9 @@ private:
 	void ResetElementData();
 
 	void ClearForces();
+	uint32 GetParticles(b3Particle* particles[b3_maxForceParticles]) const;
 	void ApplyForces(const b3SparseForceSolverData* data);
+	void MultiplyJacobians(const b3SparseForceProductData* data) const;
 
 	// Particle 1
 	b3Particle* m_p1;
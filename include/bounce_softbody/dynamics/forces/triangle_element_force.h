@@ -109,7 +109,9 @@ private:
 	void ResetElementData();
 
 	void ClearForces();
+	uint32 GetParticles(b3Particle* particles[b3_maxForceParticles]) const;
 	void ApplyForces(const b3SparseForceSolverData* data);
+	void MultiplyJacobians(const b3SparseForceProductData* data) const;
 
 	// Particle 1
 	b3Particle* m_p1;
@@ -141,6 +143,10 @@ private:
 
 	// Coefficient of stiffness damping.
 	scalar m_stiffnessDamping;
+
+	// Rotation and 2D basis of the last call to ApplyForces
+	b3Mat22 m_R;
+	b3Vec3 m_px, m_py;
 };
 
 inline void b3TriangleElementForce::SetStiffnessDamping(scalar damping)
@@ -0,0 +1,70 @@
+/*
+* Copyright (c) 2016-2019 Irlan Robson
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B3_MEMORY_STATS_H
+#define B3_MEMORY_STATS_H
+
+#include <bounce_softbody/common/memory/block_allocator.h>
+
+// Memory usage of a body. 
+// The dynamic trees are not included.
+struct b3MemoryStats
+{
+	// Particles, forces, fixtures and contacts.
+	b3BlockAllocatorStats blockAllocator;
+
+	// Size, peak usage and number of b3Alloc fallbacks 
+	// of the stack allocator used by the solver.
+	uint32 stackCapacity;
+	uint32 stackMaxAllocation;
+	uint32 stackParentAllocations;
+
+	// Bytes of the particle state arrays.
+	uint32 particleBytes;
+
+	// Bytes of the Jacobian block structure and the force colors.
+	uint32 patternBytes;
+
+	// Bytes of the persistent vectors and matrices of the solver.
+	uint32 workspaceBytes;
+
+	// Bytes of the factorization of the direct solver.
+	uint32 factorBytes;
+
+	// Bytes of the preconditioner, including the multigrid hierarchy.
+	uint32 preconditionerBytes;
+
+	// Bytes of the move buffer and the pair hash table of the contact manager.
+	uint32 contactBytes;
+
+	// Sum of the chunk and large bytes of the block allocator, the stack allocator capacity, 
+	// and the particle, pattern, workspace, factorization, preconditioner and contact bytes.
+	uint32 totalBytes;
+
+	// Calls to b3Alloc and b3Free and the allocated bytes during the last step.
+	// Only the calls made by the thread that stepped the body are counted.
+	// Calls made by the worker threads of the thread pool are excluded.
+	uint32 stepAllocCalls;
+	uint32 stepFreeCalls;
+	uint32 stepAllocBytes;
+
+	// Blocks of the stack allocator that didn't fit in its memory during the last step.
+	uint32 stepStackParentAllocations;
+};
+
+#endif
@@ -19,9 +19,13 @@
 #ifndef B3_PARTICLE_H
 #define B3_PARTICLE_H
 
-#include <bounce_softbody/common/math/vec3.h>
+#include <bounce_softbody/dynamics/particle_storage.h>
 
 class b3Body;
+class b3SphereFixture;
+
+struct b3ForceEdge;
+struct b3FixtureEdge;
 
 struct b3SparseForceSolverData;
 
@@ -68,6 +72,8 @@ struct b3ParticleDef
 };
 
 // A particle.
+// The particle state is stored contiguously in the body and 
+// the particle is a stable handle to its state.
 class b3Particle
 {
 public:
@@ -128,6 +134,22 @@ public:
 	const void* GetUserData() const;
 	void* GetUserData();
 
+	// Get the sphere fixture of this particle or null if the particle has no sphere.
+	b3SphereFixture* GetSphere();
+	const b3SphereFixture* GetSphere() const;
+
+	// Get the list of triangle fixtures sharing this particle.
+	b3FixtureEdge* GetTriangleList();
+	const b3FixtureEdge* GetTriangleList() const;
+
+	// Get the list of tetrahedron fixtures sharing this particle.
+	b3FixtureEdge* GetTetrahedronList();
+	const b3FixtureEdge* GetTetrahedronList() const;
+
+	// Get the list of forces acting on this particle.
+	b3ForceEdge* GetForceList();
+	const b3ForceEdge* GetForceList() const;
+
 	// Get the next particle in the body list of particles.
 	b3Particle* GetNext();
 	const b3Particle* GetNext() const;
@@ -149,6 +171,7 @@ private:
 	friend class b3MouseForce;
 	friend class b3TriangleElementForce;
 	friend class b3TetrahedronElementForce;
+	friend struct b3ParticleStorage;
 
 	b3Particle(const b3ParticleDef& def, b3Body* body);
 	
@@ -164,33 +187,25 @@ private:
 	// Destroy all contacts sharing the particle.
 	void DestroyContacts();
 	
+	// Recompute the mass of this particle from the fixtures sharing it.
+	void ResetMass();
+
 	// Apply forces and Jacobians due to particle.
 	void ApplyForces(const b3SparseForceSolverData* data);
 
 	// Type
 	b3ParticleType m_type;
 
-	// Position
-	b3Vec3 m_position;
-
-	// Velocity
-	b3Vec3 m_velocity;
-
-	// Applied external force
-	b3Vec3 m_force;
-
-	// Applied translation
-	b3Vec3 m_translation;
-
-	// Mass, inverse mass
-	scalar m_mass, m_invMass;
-
 	// Coefficient of damping.
 	scalar m_damping;
 
-	// Temporary solver identifier.
+	// Index of the particle state in the body storage.
+	// This is also the solver identifier.
 	uint32 m_solverId;
 
+	// Body particle storage.
+	b3ParticleStorage* m_storage;
+
 	// User index. 
 	uint32 m_userIndex;
 
@@ -200,6 +215,16 @@ private:
 	// Parent body
 	b3Body* m_body;
 
+	// Sphere fixture of this particle.
+	b3SphereFixture* m_sphere;
+
+	// Triangles and tetrahedrons sharing this particle.
+	b3FixtureEdge* m_triangleList;
+	b3FixtureEdge* m_tetrahedronList;
+
+	// Forces acting on this particle.
+	b3ForceEdge* m_forceList;
+
 	// Body list pointers.
 	b3Particle* m_prev;
 	b3Particle* m_next;
@@ -212,14 +237,14 @@ inline b3ParticleType b3Particle::GetType() const
 
 inline void b3Particle::SetPosition(const b3Vec3& position)
 {
-	m_position = position;
-	m_translation.SetZero();
+	m_storage->positions[m_solverId] = position;
+	m_storage->translations[m_solverId].SetZero();
 	SynchronizeFixtures();
 }
 
 inline const b3Vec3& b3Particle::GetPosition() const
 {
-	return m_position;
+	return m_storage->positions[m_solverId];
 }
 
 inline void b3Particle::SetVelocity(const b3Vec3& velocity)
@@ -228,22 +253,22 @@ inline void b3Particle::SetVelocity(const b3Vec3& velocity)
 	{
 		return;
 	}
-	m_velocity = velocity;
+	m_storage->velocities[m_solverId] = velocity;
 }
 
 inline const b3Vec3& b3Particle::GetVelocity() const
 {
-	return m_velocity;
+	return m_storage->velocities[m_solverId];
 }
 
 inline scalar b3Particle::GetMass() const
 {
-	return m_mass;
+	return m_storage->masses[m_solverId];
 }
 
 inline const b3Vec3& b3Particle::GetForce() const
 {
-	return m_force;
+	return m_storage->forces[m_solverId];
 }
 
 inline void b3Particle::ApplyForce(const b3Vec3& force)
@@ -252,7 +277,7 @@ inline void b3Particle::ApplyForce(const b3Vec3& force)
 	{
 		return;
 	}
-	m_force += force;
+	m_storage->forces[m_solverId] += force;
 }
 
 inline void b3Particle::ApplyImpulse(const b3Vec3& impulse)
@@ -261,17 +286,17 @@ inline void b3Particle::ApplyImpulse(const b3Vec3& impulse)
 	{
 		return;
 	}
-	m_velocity += m_invMass * impulse;
+	m_storage->velocities[m_solverId] += m_storage->invMasses[m_solverId] * impulse;
 }
 
 inline const b3Vec3& b3Particle::GetTranslation() const
 {
-	return m_translation;
+	return m_storage->translations[m_solverId];
 }
 
 inline void b3Particle::ApplyTranslation(const b3Vec3& translation)
 {
-	m_translation += translation;
+	m_storage->translations[m_solverId] += translation;
 }
 
 inline void b3Particle::SetDamping(scalar damping)
@@ -310,6 +335,46 @@ inline void* b3Particle::GetUserData()
 	return m_userData;
 }
 
+inline b3SphereFixture* b3Particle::GetSphere()
+{
+	return m_sphere;
+}
+
+inline const b3SphereFixture* b3Particle::GetSphere() const
+{
+	return m_sphere;
+}
+
+inline b3FixtureEdge* b3Particle::GetTriangleList()
+{
+	return m_triangleList;
+}
+
+inline const b3FixtureEdge* b3Particle::GetTriangleList() const
+{
+	return m_triangleList;
+}
+
+inline b3FixtureEdge* b3Particle::GetTetrahedronList()
+{
+	return m_tetrahedronList;
+}
+
+inline const b3FixtureEdge* b3Particle::GetTetrahedronList() const
+{
+	return m_tetrahedronList;
+}
+
+inline b3ForceEdge* b3Particle::GetForceList()
+{
+	return m_forceList;
+}
+
+inline const b3ForceEdge* b3Particle::GetForceList() const
+{
+	return m_forceList;
+}
+
 inline b3Particle* b3Particle::GetNext()
 {
 	return m_next;
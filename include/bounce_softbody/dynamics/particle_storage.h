@@ -0,0 +1,82 @@
+/*
+* Copyright (c) 2016-2019 Irlan Robson
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B3_PARTICLE_STORAGE_H
+#define B3_PARTICLE_STORAGE_H
+
+#include <bounce_softbody/common/math/vec3.h>
+
+class b3Particle;
+class b3StackAllocator;
+struct b3SparseMat33;
+
+// Orderings of the particle state.
+enum b3ParticleOrdering
+{
+	e_creationOrdering, // creation order of the particles
+	e_cuthillMcKeeOrdering, // reverse Cuthill-McKee ordering of the force graph, which reduces the matrix bandwidth
+	e_mortonOrdering, // Morton curve of the particle positions, which keeps close particles close in memory
+};
+
+// Contiguous storage of the particle state of a body.
+// The state of a particle is stored at the index given by its solver id, 
+// so the solver can read and write the state in place.
+// Removing a particle moves the last particle into its index.
+struct b3ParticleStorage
+{
+	b3ParticleStorage();
+	~b3ParticleStorage();
+
+	// Ensure the arrays can hold a given number of particles.
+	void Reserve(uint32 capacity);
+
+	// Add a particle and return its index.
+	// The state of the particle is undefined.
+	uint32 Add(b3Particle* particle);
+
+	// Remove the particle at a given index. 
+	void Remove(uint32 index);
+
+	// Move the particle at index order[i] to the index i for each index.
+	// The solver ids of the particles are updated.
+	void Permute(const uint32* order, b3StackAllocator* allocator);
+
+	// Get the number of bytes allocated by the arrays.
+	uint32 GetByteCount() const;
+
+	uint32 count;
+	uint32 capacity;
+	b3Particle** particles;
+	b3Vec3* positions;
+	b3Vec3* velocities;
+	b3Vec3* forces; // applied external forces
+	b3Vec3* translations; // applied translations
+	b3Vec3* accelerations; // average acceleration of the last step used for warm starting
+	scalar* masses;
+	scalar* invMasses;
+};
+
+// Compute the reverse Cuthill-McKee ordering of the rows of a symmetric block structure.
+// The row order[i] is moved to the row i.
+void b3ComputeCuthillMcKeeOrdering(uint32* order, const b3SparseMat33& pattern, b3StackAllocator* allocator);
+
+// Compute the order of a set of points along a Morton curve of their bounding box.
+// The point order[i] is moved to the index i.
+void b3ComputeMortonOrdering(uint32* order, const b3Vec3* points, uint32 count, b3StackAllocator* allocator);
+
+#endif
@@ -0,0 +1,107 @@
+/*
+* Copyright (c) 2016-2019 Irlan Robson
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B3_SOLVER_STATS_H
+#define B3_SOLVER_STATS_H
+
+#include <bounce_softbody/sparse/sparse_force_solver.h>
+
+// Maximum number of Newton iterations recorded in the solver statistics.
+const uint32 b3_maxSolverStatsIterations = 8;
+
+// Force solver statistics of a step.
+struct b3SolverStats
+{
+	// Number of Newton iterations.
+	uint32 iterations;
+
+	// CG iterations and residuals of the first Newton iterations.
+	b3SolveBEIteration history[b3_maxSolverStatsIterations];
+	uint32 historyCount;
+
+	// Min/max number of CG iterations.
+	uint32 minSubIterations;
+	uint32 maxSubIterations;
+
+	// Final Newton error.
+	scalar error;
+
+	// Number of Newton iterations where the line search failed.
+	uint32 lineSearchFailures;
+
+	// Number of non-zero blocks in the system matrix.
+	uint32 blockCount;
+
+	// Number of solved particles, forces and contacts.
+	uint32 particleCount;
+	uint32 forceCount;
+	uint32 contactCount;
+};
+
+// A rolling history of the solver statistics of the last steps.
+class b3SolverStatsHistory
+{
+public:
+	b3SolverStatsHistory();
+	~b3SolverStatsHistory();
+
+	// Set the number of steps kept in the history. 
+	// This clears the history. Zero disables the history.
+	void SetCapacity(uint32 capacity);
+
+	// Get the number of steps kept in the history.
+	uint32 GetCapacity() const;
+
+	// Get the number of steps in the history.
+	uint32 GetCount() const;
+
+	// Get the statistics of a step. 
+	// Index zero is the last step.
+	const b3SolverStats& GetStats(uint32 index) const;
+
+	// Add the statistics of a step. 
+	// This replaces the oldest step if the history is full.
+	void Add(const b3SolverStats& stats);
+
+	// Remove all steps.
+	void Clear();
+private:
+	b3SolverStats* m_stats;
+	uint32 m_capacity;
+	uint32 m_count;
+	uint32 m_head; // index of the next step 
+};
+
+inline uint32 b3SolverStatsHistory::GetCapacity() const
+{
+	return m_capacity;
+}
+
+inline uint32 b3SolverStatsHistory::GetCount() const
+{
+	return m_count;
+}
+
+inline const b3SolverStats& b3SolverStatsHistory::GetStats(uint32 index) const
+{
+	B3_ASSERT(index < m_count);
+	uint32 i = (m_head + m_capacity - 1 - index) % m_capacity;
+	return m_stats[i];
+}
+
+#endif
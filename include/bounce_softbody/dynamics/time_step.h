@@ -28,6 +28,28 @@ struct b3TimeStep
 	scalar inv_dt;
 	uint32 forceIterations;
 	uint32 forceSubIterations;
+	bool warmStarting;
+	bool adaptiveSubTolerance;
+	bool lineSearch;
+	bool matrixFree;
+	bool symmetricStorage;
+	bool mixedPrecision;
+	uint32 refinementIterations;
+};
+
+// Profiling data of a step. Times are in milliseconds.
+struct b3Profile
+{
+	scalar64 step;
+	scalar64 updateContacts;
+	scalar64 clearForces;
+	scalar64 solve;
+	scalar64 solveForces;
+	scalar64 assembly;
+	scalar64 solveCG;
+	scalar64 friction;
+	scalar64 synchronize;
+	scalar64 findContacts;
 };
 
 #endif
\ No newline at end of file
@@ -27,19 +27,33 @@ struct b3DenseVec3
 	{
 		n = _n;
 		v = (b3Vec3*)b3Alloc(n * sizeof(b3Vec3));
+		owner = true;
+	}
+
+	// Create a view of an external array. 
+	// The view doesn't own the array and can't be resized.
+	b3DenseVec3(b3Vec3* _v, uint32 _n)
+	{
+		n = _n;
+		v = _v;
+		owner = false;
 	}
 
 	b3DenseVec3(const b3DenseVec3& _v)
 	{
 		n = _v.n;
 		v = (b3Vec3*)b3Alloc(n * sizeof(b3Vec3));
+		owner = true;
 
 		Copy(_v);
 	}
 
 	~b3DenseVec3()
 	{
-		b3Free(v);
+		if (owner)
+		{
+			b3Free(v);
+		}
 	}
 
 	const b3Vec3& operator[](uint32 i) const
@@ -67,6 +81,7 @@ struct b3DenseVec3
 			return *this;
 		}
 
+		B3_ASSERT(owner);
 		b3Free(v);
 
 		n = _v.n;
@@ -77,6 +92,22 @@ struct b3DenseVec3
 		return *this;
 	}
 
+	// Set the number of elements. 
+	// The elements are undefined if the number of elements changes.
+	void Resize(uint32 _n)
+	{
+		if (_n == n)
+		{
+			return;
+		}
+
+		B3_ASSERT(owner);
+		b3Free(v);
+
+		n = _n;
+		v = (b3Vec3*)b3Alloc(n * sizeof(b3Vec3));
+	}
+
 	void Copy(const b3DenseVec3& _v)
 	{
 		B3_ASSERT(n == _v.n);
@@ -111,6 +142,7 @@ struct b3DenseVec3
 
 	b3Vec3* v;
 	uint32 n;
+	bool owner;
 };
 
 inline void b3Add(b3DenseVec3& out, const b3DenseVec3& a, const b3DenseVec3& b)
@@ -80,6 +80,21 @@ struct b3DiagMat33
 		return *this;
 	}
 
+	// Set the number of elements. 
+	// The elements are undefined if the number of elements changes.
+	void Resize(uint32 _n)
+	{
+		if (_n == n)
+		{
+			return;
+		}
+
+		b3Free(v);
+
+		n = _n;
+		v = (b3Mat33*)b3Alloc(n * sizeof(b3Mat33));
+	}
+
 	void Copy(const b3DiagMat33& _v)
 	{
 		B3_ASSERT(n == _v.n);
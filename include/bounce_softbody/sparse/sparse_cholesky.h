@@ -0,0 +1,88 @@
+/*
+* Copyright (c) 2016-2019 Irlan Robson
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B3_SPARSE_CHOLESKY_H
+#define B3_SPARSE_CHOLESKY_H
+
+#include <bounce_softbody/common/math/mat33.h>
+
+struct b3DenseVec3;
+struct b3SparseMat33;
+
+// Sparse direct solver for a symmetric positive definite matrix of 3x3 blocks.
+// The matrix is factored as P * A * P^T = L * D * L^T, where P is an approximate minimum degree permutation,
+// L is block unit lower triangular and D is block diagonal.
+// The ordering and the block structure of L (the symbolic factorization) are computed
+// once for the block structure of a matrix. Only the numerical factorization
+// is recomputed for a matrix with the same structure.
+struct b3SparseCholesky
+{
+	b3SparseCholesky();
+	~b3SparseCholesky();
+
+	// Return true if the symbolic factorization was computed for a matrix
+	// with the same dimension and number of blocks as a given matrix.
+	bool IsCompatible(const b3SparseMat33& A) const;
+
+	// Compute the ordering and the symbolic factorization of a matrix.
+	// The block structure of the matrix must be symmetric.
+	void Analyze(const b3SparseMat33& A);
+
+	// Compute the numerical factorization of a matrix with the analyzed structure.
+	// Return false if the matrix is not positive definite.
+	bool Factorize(const b3SparseMat33& A);
+
+	// Solve A * x = b using the last numerical factorization.
+	void Solve(b3DenseVec3& x, const b3DenseVec3& b);
+
+	// Free the factorization.
+	void Reset();
+
+	// Get the number of bytes allocated by this solver.
+	uint32 GetByteCount() const;
+
+	// Dimension and number of blocks of the analyzed matrix.
+	uint32 rowCount;
+	uint32 blockCount;
+
+	// The row of A for each row of P * A * P^T and its inverse.
+	uint32* permutation;
+	uint32* inversePermutation;
+
+	// The strictly lower blocks of L in block compressed column format.
+	// The row indices inside a column are sorted in increasing order.
+	uint32 factorBlockCount;
+	uint32* columnPtrs;
+	uint32* rows;
+	b3Mat33* values;
+
+	// The columns of the strictly lower blocks of L in each row.
+	uint32* rowPtrs;
+	uint32* rowColumns;
+
+	// The diagonal blocks of D and their inverses.
+	b3Mat33* diagonal;
+	b3Mat33* invDiagonal;
+
+	// Scratch arrays.
+	b3Mat33* work;
+	uint32* next;
+	b3Vec3* y;
+};
+
+#endif
@@ -26,8 +26,16 @@ struct b3Mat33;
 struct b3DenseVec3;
 struct b3DiagMat33;
 struct b3SparseMat33;
+struct b3SparsePreconditioner;
+struct b3SparseCholesky;
+
+class b3ThreadPool;
+class b3SparseWorkspace;
 
 // Output of force model.
+// In matrix-free mode dfdx and dfdv are null. Then the diagonal blocks of the Jacobians 
+// are added to dfdx_diag and dfdv_diag and the remaining blocks are applied by the force model 
+// in b3SparseForceModel::MultiplyJacobians.
 struct b3SparseForceSolverData
 {
 	scalar h, inv_h;
@@ -36,6 +44,17 @@ struct b3SparseForceSolverData
 	b3DenseVec3* f;
 	b3SparseMat33* dfdx;
 	b3SparseMat33* dfdv;
+	b3DiagMat33* dfdx_diag;
+	b3DiagMat33* dfdv_diag;
+};
+
+// Input of a matrix-free Jacobian product.
+struct b3SparseForceProductData
+{
+	scalar a; // coefficient of dfdx
+	scalar b; // coefficient of dfdv
+	const b3DenseVec3* p; // vector to multiply
+	b3DenseVec3* q; // q += (a * dfdx + b * dfdv) * p
 };
 
 // An implementation for this class must provide forces and derivatives to the integrator.
@@ -46,6 +65,14 @@ class b3SparseForceModel
 public:
 	// Apply forces and Jacobians.
 	virtual void ApplyForces(const b3SparseForceSolverData* data) = 0;
+
+	// Multiply the off-diagonal Jacobian blocks of the last call to ApplyForces by a vector.
+	// This must be implemented by force models used in matrix-free mode.
+	virtual void MultiplyJacobians(const b3SparseForceProductData* data)
+	{
+		B3_NOT_USED(data);
+		B3_ASSERT(false);
+	}
 };
 
 // Input for Backward Euler integrator.
@@ -58,6 +85,20 @@ struct b3SolveBEInput
 		tolerance = B3_EPSILON;
 		maxSubIterations = 20;
 		subTolerance = B3_EPSILON;
+		adaptiveSubTolerance = false;
+		maxSubTolerance = scalar(0.5);
+		lineSearch = false;
+		maxLineSearchIterations = 4;
+		matrixFree = false;
+		symmetric = false;
+		mixedPrecision = false;
+		refinementIterations = 0;
+		directSolver = nullptr;
+		preconditioner = nullptr;
+		updatePreconditioner = true;
+		threadPool = nullptr;
+		workspace = nullptr;
+		dv = nullptr;
 	}
 
 	scalar h; // time-step
@@ -74,23 +115,96 @@ struct b3SolveBEInput
 	const b3DenseVec3* y; // translation such that x(t + h) = x(t + h) + y
 	const b3DiagMat33* S; // constraint filter matrix
 	const b3DenseVec3* z; // desired subsolver solution (usually zero)
+	const b3SparseMat33* pattern; // zero matrix with the block structure of the force Jacobians
 
 	uint32 maxIterations; // max of outer iterations
 	scalar tolerance; // outer tolerance. units: m^2/s^2 
 	
 	uint32 maxSubIterations; // max of inner iterations
 	scalar subTolerance; // inner tolerance. units: m^2/s^2
+
+	// Choose the inner tolerance of each outer iteration from the decrease of the outer residual 
+	// using the forcing terms of Eisenstat and Walker. The tolerance is kept in [subTolerance, maxSubTolerance].
+	// Early outer iterations are then solved loosely, which saves inner iterations.
+	bool adaptiveSubTolerance;
+	scalar maxSubTolerance; // inner tolerance of the first outer iteration
+
+	// Backtrack along the Newton step until the norm of the non-linear residual decreases sufficiently.
+	// This costs one force evaluation per trial step but keeps stiff forces from diverging.
+	// The iterations start from positions consistent with the velocities. 
+	// If no trial step decreases the residual sufficiently the best trial step is taken 
+	// and the failure is reported.
+	bool lineSearch;
+	uint32 maxLineSearchIterations; // max of step halvings
+
+	// Multiply the force Jacobians by vectors instead of assembling the system matrix.
+	// Only the diagonal blocks are stored, which are used for a Jacobi or block-Jacobi preconditioner.
+	// Other preconditioner types fall back to block-Jacobi. The force model must implement MultiplyJacobians.
+	bool matrixFree;
+
+	// The pattern stores only the diagonal and upper blocks of the symmetric Jacobians, 
+	// and the forces only write these blocks. This halves the memory of the matrices.
+	// Other preconditioner types than Jacobi and block-Jacobi fall back to block-Jacobi
+	// and the direct solver is ignored.
+	bool symmetric;
+
+	// Accumulate the dot products of the inner solver in scalar64 while the vectors and matrices stay in scalar.
+	// Large systems then don't lose the convergence of the inner solver to round-off in the sums.
+	bool mixedPrecision;
+	uint32 refinementIterations; // max of iterative refinement steps of the inner solver
+
+	b3SparsePreconditioner* preconditioner; // optional preconditioner for the inner solver. The Jacobi preconditioner is used if none is given.
+	bool updatePreconditioner; // recompute the preconditioner in the first iteration instead of reusing it
+
+	// Optional sparse direct solver used instead of CG. This is ignored in matrix-free mode.
+	// The symbolic factorization is kept while the structure of the system matrix doesn't change.
+	b3SparseCholesky* directSolver;
+
+	b3ThreadPool* threadPool; // optional thread pool for the inner solver
+	
+	b3SparseWorkspace* workspace; // optional persistent memory for the temporary vectors and matrices
+
+	const b3DenseVec3* dv; // optional prediction of v(t + h) - v(t) used as the initial guess of the inner solver
+};
+
+// Statistics of an outer iteration of the Backward Euler integrator.
+struct b3SolveBEIteration
+{
+	uint32 subIterations; // number of inner iterations
+	scalar subTolerance; // inner tolerance
+	scalar subError; // inner error
+	scalar residual; // norm of the outer residual before the step
+	scalar stepLength; // fraction of the Newton step taken
+	bool lineSearchFailed; // no trial step decreased the residual sufficiently
+	scalar error; // outer error
 };
 
 // Output of Backward Euler integrator.
 struct b3SolveBEOutput
 {
-	b3DenseVec3* x; // x(t + h)
-	b3DenseVec3* v; // v(t + h)
+	// Default constructor sets some parameters for convenience.
+	b3SolveBEOutput()
+	{
+		minSubIterations = B3_MAX_U32;
+		maxSubIterations = 0;
+		history = nullptr;
+		historyCapacity = 0;
+		lineSearchFailures = 0;
+	}
+
+	b3DenseVec3* x; // x(t + h). it must have one element per degree of freedom.
+	b3DenseVec3* v; // v(t + h). it must have one element per degree of freedom.
 	uint32 iterations; // number of non-linear solver iterations
 	scalar error; // error
 	uint32 minSubIterations; // min of inner iterations
 	uint32 maxSubIterations; // max of inner iterations
+	uint32 blockCount; // number of blocks of the system matrix
+	b3SolveBEIteration* history; // optional statistics of the first outer iterations
+	uint32 historyCapacity; // capacity of the history
+	uint32 historyCount; // number of recorded outer iterations
+	uint32 lineSearchFailures; // number of outer iterations where the line search failed
+	scalar64 assemblyTime; // time spent applying forces and assembling the systems, in milliseconds
+	scalar64 solveTime; // time spent computing the preconditioner and solving the systems, in milliseconds
 };
 
 // Integrate F = ma over [t, t + h] using Backward Euler.
@@ -23,76 +23,22 @@
 #include <bounce_softbody/sparse/diag_mat33.h>
 #include <bounce_softbody/sparse/dense_vec3.h>
 
-// Sparse matrix row element.
-struct b3RowEntry
+// Row and column of a 3x3 block in a sparse matrix.
+struct b3BlockIndex
 {
+	uint32 row;
 	uint32 column;
-	b3Mat33 value;
-	b3RowEntry* prev;
-	b3RowEntry* next;
 };
 
-// Doubly linked list of row entries.
-struct b3RowEntryList
-{
-	b3RowEntryList() { }
-
-	void Insert(b3RowEntry* entry);
-
-	void Remove(b3RowEntry* entry);
-
-	b3RowEntry* Search(uint32 column);
-
-	b3RowEntry* head;
-	uint32 count;
-};
-
-inline void b3RowEntryList::Insert(b3RowEntry* entry)
-{
-	entry->prev = nullptr;
-	entry->next = head;
-	if (head)
-	{
-		head->prev = entry;
-	}
-	head = entry;
-	++count;
-}
-
-inline void b3RowEntryList::Remove(b3RowEntry* entry)
-{
-	if (entry->prev)
-	{
-		entry->prev->next = entry->next;
-	}
-	if (entry->next)
-	{
-		entry->next->prev = entry->prev;
-	}
-	if (entry == head)
-	{
-		head = entry->next;
-	}
-	--count;
-}
-
-inline b3RowEntry* b3RowEntryList::Search(uint32 column)
-{
-	// Make O(log).
-	for (b3RowEntry* e = head; e; e = e->next)
-	{
-		if (e->column == column)
-		{
-			return e;
-		}
-	}
-	return nullptr;
-}
-
-// A sparse matrix.
-// Each row is a list of non-zero elements in the row.
+// A sparse matrix of 3x3 blocks stored in block compressed row (BSR) format.
+// The non-zero blocks of all rows are stored contiguously in row order and 
+// the column indices inside a row are sorted in increasing order.
+// The block structure should be set before the matrix is filled. 
+// Accessing a block that is not in the structure inserts the block, which is slow.
 struct b3SparseMat33
 {
+	b3SparseMat33();
+
 	b3SparseMat33(uint32 m);
 
 	b3SparseMat33(const b3SparseMat33& _m);
@@ -103,7 +49,17 @@ struct b3SparseMat33
 
 	void Copy(const b3SparseMat33& _m);
 
-	void Destroy();
+	// Set the number of rows and remove all blocks.
+	void Resize(uint32 m);
+
+	// Set the block structure of this matrix given an array of block indices.
+	// Duplicated indices are merged. All blocks are set to zero.
+	void SetStructure(const b3BlockIndex* indices, uint32 indexCount);
+
+	// Return true if this matrix has the same block structure as a given matrix.
+	bool HasStructure(const b3SparseMat33& _m) const;
+
+	void SetZero();
 
 	void SetZero(uint32 i, uint32 j);
 
@@ -111,6 +67,10 @@ struct b3SparseMat33
 
 	void SetZeroColumn(uint32 j);
 
+	// Return the index of the block (i, j) in the block array.
+	// Return B3_MAX_U32 if the block is not in the structure.
+	uint32 SearchIndex(uint32 i, uint32 j) const;
+
 	b3Mat33* Search(uint32 i, uint32 j);
 
 	const b3Mat33* Search(uint32 i, uint32 j) const;
@@ -135,129 +95,230 @@ struct b3SparseMat33
 
 	void CreateMatrix(scalar* out) const;
 
+	// Insert a zero block (i, j) into the structure.
+	b3Mat33* Insert(uint32 i, uint32 j);
+
+	// Ensure the block arrays can hold a given number of blocks.
+	void Reserve(uint32 capacity);
+
+	// Merge the block structure of this matrix with a given matrix.
+	void Merge(const b3SparseMat33& m);
+
+	// Get the number of bytes allocated by this matrix.
+	uint32 GetByteCount() const;
+
 	uint32 rowCount;
-	b3RowEntryList* rows;
+	uint32* rowPtrs;
+	uint32 blockCapacity;
+	uint32 blockCount;
+	uint32* columns;
+	b3Mat33* values;
 };
 
+inline uint32 b3SparseMat33::GetByteCount() const
+{
+	return (rowCount + 1) * sizeof(uint32) + blockCapacity * (sizeof(uint32) + sizeof(b3Mat33));
+}
+
+inline b3SparseMat33::b3SparseMat33()
+{
+	rowCount = 0;
+	rowPtrs = (uint32*)b3Alloc(sizeof(uint32));
+	rowPtrs[0] = 0;
+	blockCapacity = 0;
+	blockCount = 0;
+	columns = nullptr;
+	values = nullptr;
+}
+
 inline b3SparseMat33::b3SparseMat33(uint32 m)
 {
 	rowCount = m;
-	rows = (b3RowEntryList*)b3Alloc(rowCount * sizeof(b3RowEntryList));
-	for (uint32 i = 0; i < rowCount; ++i)
+	rowPtrs = (uint32*)b3Alloc((rowCount + 1) * sizeof(uint32));
+	for (uint32 i = 0; i < rowCount + 1; ++i)
 	{
-		rows[i].head = nullptr;
-		rows[i].count = 0;
+		rowPtrs[i] = 0;
 	}
+	blockCapacity = 0;
+	blockCount = 0;
+	columns = nullptr;
+	values = nullptr;
 }
 
 inline b3SparseMat33::b3SparseMat33(const b3SparseMat33& m)
 {
 	rowCount = m.rowCount;
-	rows = (b3RowEntryList*)b3Alloc(rowCount * sizeof(b3RowEntryList));
-	for (uint32 i = 0; i < rowCount; ++i)
-	{
-		rows[i].head = nullptr;
-		rows[i].count = 0;
-	}
+	rowPtrs = (uint32*)b3Alloc((rowCount + 1) * sizeof(uint32));
+	blockCapacity = 0;
+	blockCount = 0;
+	columns = nullptr;
+	values = nullptr;
 
 	Copy(m);
 }
 
 inline b3SparseMat33::~b3SparseMat33()
 {
-	Destroy();
+	b3Free(values);
+	b3Free(columns);
+	b3Free(rowPtrs);
 }
 
-inline void b3SparseMat33::Destroy()
+inline b3SparseMat33& b3SparseMat33::operator=(const b3SparseMat33& _m)
 {
-	for (uint32 i = 0; i < rowCount; ++i)
+	if (_m.rowPtrs == rowPtrs)
 	{
-		b3RowEntryList* list = rows + i;
+		return *this;
+	}
 
-		b3RowEntry* e = list->head;
-		while (e)
-		{
-			b3RowEntry* e0 = e->next;
-			b3Free(e);
-			e = e0;
-		}
+	if (rowCount != _m.rowCount)
+	{
+		b3Free(rowPtrs);
+
+		rowCount = _m.rowCount;
+		rowPtrs = (uint32*)b3Alloc((rowCount + 1) * sizeof(uint32));
 	}
-	b3Free(rows);
+
+	Copy(_m);
+
+	return *this;
 }
 
-inline b3SparseMat33& b3SparseMat33::operator=(const b3SparseMat33& _m)
+inline void b3SparseMat33::Copy(const b3SparseMat33& _m)
 {
-	if (_m.rows == rows)
+	B3_ASSERT(rowCount == _m.rowCount);
+
+	Reserve(_m.blockCount);
+
+	blockCount = _m.blockCount;
+	memcpy(rowPtrs, _m.rowPtrs, (rowCount + 1) * sizeof(uint32));
+	if (blockCount > 0)
 	{
-		return *this;
+		memcpy(columns, _m.columns, blockCount * sizeof(uint32));
+		memcpy(values, _m.values, blockCount * sizeof(b3Mat33));
 	}
+}
 
-	Destroy();
+inline void b3SparseMat33::Resize(uint32 m)
+{
+	if (m != rowCount)
+	{
+		b3Free(rowPtrs);
+		rowCount = m;
+		rowPtrs = (uint32*)b3Alloc((rowCount + 1) * sizeof(uint32));
+	}
 
-	rowCount = _m.rowCount;
-	rows = (b3RowEntryList*)b3Alloc(rowCount * sizeof(b3RowEntryList));
-	for (uint32 i = 0; i < rowCount; ++i)
+	for (uint32 i = 0; i < rowCount + 1; ++i)
 	{
-		rows[i].head = nullptr;
-		rows[i].count = 0;
+		rowPtrs[i] = 0;
 	}
+	blockCount = 0;
+}
 
-	Copy(_m);
+inline void b3SparseMat33::Reserve(uint32 capacity)
+{
+	if (capacity <= blockCapacity)
+	{
+		return;
+	}
 
-	return *this;
+	uint32* oldColumns = columns;
+	b3Mat33* oldValues = values;
+
+	blockCapacity = capacity;
+	columns = (uint32*)b3Alloc(blockCapacity * sizeof(uint32));
+	values = (b3Mat33*)b3Alloc(blockCapacity * sizeof(b3Mat33));
+
+	if (blockCount > 0)
+	{
+		memcpy(columns, oldColumns, blockCount * sizeof(uint32));
+		memcpy(values, oldValues, blockCount * sizeof(b3Mat33));
+	}
+
+	b3Free(oldColumns);
+	b3Free(oldValues);
 }
 
-inline void b3SparseMat33::Copy(const b3SparseMat33& _m)
+inline bool b3SparseMat33::HasStructure(const b3SparseMat33& m) const
 {
-	B3_ASSERT(rowCount == _m.rowCount);
+	if (rowCount != m.rowCount || blockCount != m.blockCount)
+	{
+		return false;
+	}
 
-	for (uint32 i = 0; i < rowCount; ++i)
+	if (columns == m.columns)
 	{
-		b3RowEntryList* list1 = _m.rows + i;
-		b3RowEntryList* list2 = rows + i;
+		return true;
+	}
 
-		B3_ASSERT(list2->head == nullptr);
-		B3_ASSERT(list2->count == 0);
-		for (b3RowEntry* e1 = list1->head; e1; e1 = e1->next)
-		{
-			b3RowEntry* e2 = (b3RowEntry*)b3Alloc(sizeof(b3RowEntry));
-			e2->column = e1->column;
-			e2->value = e1->value;
+	if (memcmp(rowPtrs, m.rowPtrs, (rowCount + 1) * sizeof(uint32)) != 0)
+	{
+		return false;
+	}
 
-			list2->Insert(e2);
-		}
+	return memcmp(columns, m.columns, blockCount * sizeof(uint32)) == 0;
+}
+
+inline void b3SparseMat33::SetZero()
+{
+	for (uint32 k = 0; k < blockCount; ++k)
+	{
+		values[k].SetZero();
 	}
 }
 
-inline b3Mat33* b3SparseMat33::Search(uint32 i, uint32 j)
+inline uint32 b3SparseMat33::SearchIndex(uint32 i, uint32 j) const
 {
 	B3_ASSERT(i < rowCount);
 	B3_ASSERT(j < rowCount);
-	b3RowEntryList* list = rows + i;
-	b3RowEntry* e = list->Search(j);
-	if (e)
+
+	// Binary search the sorted row.
+	uint32 low = rowPtrs[i];
+	uint32 high = rowPtrs[i + 1];
+	while (low < high)
 	{
-		return &e->value;
+		uint32 mid = low + (high - low) / 2;
+		if (columns[mid] < j)
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+
+	if (low < rowPtrs[i + 1] && columns[low] == j)
+	{
+		return low;
+	}
+
+	return B3_MAX_U32;
+}
+
+inline b3Mat33* b3SparseMat33::Search(uint32 i, uint32 j)
+{
+	uint32 index = SearchIndex(i, j);
+	if (index != B3_MAX_U32)
+	{
+		return values + index;
 	}
 	return nullptr;
 }
 
 inline const b3Mat33* b3SparseMat33::Search(uint32 i, uint32 j) const
 {
-	B3_ASSERT(i < rowCount);
-	B3_ASSERT(j < rowCount);
-	b3RowEntryList* list = rows + i;
-	b3RowEntry* e = list->Search(j);
-	if (e)
+	uint32 index = SearchIndex(i, j);
+	if (index != B3_MAX_U32)
 	{
-		return &e->value;
+		return values + index;
 	}
 	return nullptr;
 }
 
 inline b3Mat33 b3SparseMat33::operator()(uint32 i, uint32 j) const
 {
-	const b3Mat33* v = ((b3SparseMat33*)this)->Search(i, j);
+	const b3Mat33* v = Search(i, j);
 	if (v)
 	{
 		return *v;
@@ -266,53 +327,67 @@ inline b3Mat33 b3SparseMat33::operator()(uint32 i, uint32 j) const
 }
 
 inline b3Mat33& b3SparseMat33::operator()(uint32 i, uint32 j)
+{
+	b3Mat33* v = Search(i, j);
+	if (v)
+	{
+		return *v;
+	}
+
+	return *Insert(i, j);
+}
+
+inline b3Mat33* b3SparseMat33::Insert(uint32 i, uint32 j)
 {
 	B3_ASSERT(i < rowCount);
 	B3_ASSERT(j < rowCount);
+	B3_ASSERT(SearchIndex(i, j) == B3_MAX_U32);
 
-	b3RowEntryList* list = rows + i;
+	if (blockCount == blockCapacity)
+	{
+		// Duplicate capacity.
+		Reserve(blockCapacity > 0 ? 2 * blockCapacity : rowCount + 1);
+	}
 
-	b3RowEntry* e = list->Search(j);
-	if (e)
+	// Find the sorted position in the row.
+	uint32 index = rowPtrs[i];
+	while (index < rowPtrs[i + 1] && columns[index] < j)
 	{
-		return e->value;
+		++index;
 	}
 
-	e = (b3RowEntry*)b3Alloc(sizeof(b3RowEntry));
-	e->column = j;
-	e->value.SetZero();
+	// Shift the subsequent blocks.
+	uint32 shiftCount = blockCount - index;
+	memmove(columns + index + 1, columns + index, shiftCount * sizeof(uint32));
+	memmove(values + index + 1, values + index, shiftCount * sizeof(b3Mat33));
 
-	list->Insert(e);
+	for (uint32 k = i + 1; k < rowCount + 1; ++k)
+	{
+		++rowPtrs[k];
+	}
+	++blockCount;
+
+	columns[index] = j;
+	values[index].SetZero();
 
-	return e->value;
+	return values + index;
 }
 
 inline void b3SparseMat33::SetZero(uint32 i, uint32 j)
 {
-	B3_ASSERT(i < rowCount);
-	B3_ASSERT(j < rowCount);
-
-	b3RowEntryList* list = rows + i;
-
-	b3RowEntry* e = list->Search(j);
-	if (e)
+	b3Mat33* v = Search(i, j);
+	if (v)
 	{
-		list->Remove(e);
-		b3Free(e);
+		v->SetZero();
 	}
 }
 
 inline void b3SparseMat33::SetZeroRow(uint32 i)
 {
 	B3_ASSERT(i < rowCount);
-	b3RowEntryList* list = rows + i;
-	b3RowEntry* e = list->head;
-	while (e)
+	for (uint32 k = rowPtrs[i]; k < rowPtrs[i + 1]; ++k)
 	{
-		b3RowEntry* boom = e;
-		e = e->next;
-		list->Remove(boom);
-		b3Free(boom);
+		values[k].SetZero();
 	}
 }
 
@@ -321,29 +396,122 @@ inline void b3SparseMat33::SetZeroColumn(uint32 j)
 	B3_ASSERT(j < rowCount);
 	for (uint32 i = 0; i < rowCount; ++i)
 	{
-		b3RowEntryList* list = rows + i;
-		b3RowEntry* e = list->Search(j);
-		if (e)
+		SetZero(i, j);
+	}
+}
+
+inline void b3SparseMat33::Merge(const b3SparseMat33& m)
+{
+	B3_ASSERT(rowCount == m.rowCount);
+
+	// Count the blocks of the union of the structures.
+	uint32 unionCount = 0;
+	for (uint32 i = 0; i < rowCount; ++i)
+	{
+		uint32 k1 = rowPtrs[i], end1 = rowPtrs[i + 1];
+		uint32 k2 = m.rowPtrs[i], end2 = m.rowPtrs[i + 1];
+		while (k1 < end1 || k2 < end2)
+		{
+			if (k2 == end2 || (k1 < end1 && columns[k1] < m.columns[k2]))
+			{
+				++k1;
+			}
+			else if (k1 == end1 || m.columns[k2] < columns[k1])
+			{
+				++k2;
+			}
+			else
+			{
+				++k1;
+				++k2;
+			}
+			++unionCount;
+		}
+	}
+
+	if (unionCount == blockCount)
+	{
+		// The structure of the given matrix is contained in this structure.
+		return;
+	}
+
+	uint32* newRowPtrs = (uint32*)b3Alloc((rowCount + 1) * sizeof(uint32));
+	uint32* newColumns = (uint32*)b3Alloc(unionCount * sizeof(uint32));
+	b3Mat33* newValues = (b3Mat33*)b3Alloc(unionCount * sizeof(b3Mat33));
+
+	uint32 index = 0;
+	for (uint32 i = 0; i < rowCount; ++i)
+	{
+		newRowPtrs[i] = index;
+
+		uint32 k1 = rowPtrs[i], end1 = rowPtrs[i + 1];
+		uint32 k2 = m.rowPtrs[i], end2 = m.rowPtrs[i + 1];
+		while (k1 < end1 || k2 < end2)
 		{
-			list->Remove(e);
-			b3Free(e);
+			if (k2 == end2 || (k1 < end1 && columns[k1] < m.columns[k2]))
+			{
+				newColumns[index] = columns[k1];
+				newValues[index] = values[k1];
+				++k1;
+			}
+			else if (k1 == end1 || m.columns[k2] < columns[k1])
+			{
+				newColumns[index] = m.columns[k2];
+				newValues[index].SetZero();
+				++k2;
+			}
+			else
+			{
+				newColumns[index] = columns[k1];
+				newValues[index] = values[k1];
+				++k1;
+				++k2;
+			}
+			++index;
 		}
 	}
+	newRowPtrs[rowCount] = index;
+
+	B3_ASSERT(index == unionCount);
+
+	b3Free(rowPtrs);
+	b3Free(columns);
+	b3Free(values);
+
+	rowPtrs = newRowPtrs;
+	columns = newColumns;
+	values = newValues;
+	blockCapacity = unionCount;
+	blockCount = unionCount;
 }
 
 inline void b3SparseMat33::operator+=(const b3SparseMat33& m)
 {
 	B3_ASSERT(rowCount == m.rowCount);
 
-	for (uint32 i = 0; i < m.rowCount; ++i)
+	if (HasStructure(m))
 	{
-		b3RowEntryList* list = m.rows + i;
+		for (uint32 k = 0; k < blockCount; ++k)
+		{
+			values[k] += m.values[k];
+		}
+		return;
+	}
 
-		for (b3RowEntry* e = list->head; e; e = e->next)
+	Merge(m);
+
+	for (uint32 i = 0; i < rowCount; ++i)
+	{
+		// The structure of the given matrix is a subset of this structure.
+		uint32 k1 = rowPtrs[i];
+		for (uint32 k2 = m.rowPtrs[i]; k2 < m.rowPtrs[i + 1]; ++k2)
 		{
-			uint32 j = e->column;
+			while (columns[k1] < m.columns[k2])
+			{
+				++k1;
+			}
 
-			(*this)(i, j) += e->value;
+			values[k1] += m.values[k2];
 		}
 	}
 }
@@ -352,15 +520,29 @@ inline void b3SparseMat33::operator-=(const b3SparseMat33& m)
 {
 	B3_ASSERT(rowCount == m.rowCount);
 
-	for (uint32 i = 0; i < m.rowCount; ++i)
+	if (HasStructure(m))
 	{
-		b3RowEntryList* list = m.rows + i;
+		for (uint32 k = 0; k < blockCount; ++k)
+		{
+			values[k] -= m.values[k];
+		}
+		return;
+	}
+
+	Merge(m);
 
-		for (b3RowEntry* e = list->head; e; e = e->next)
+	for (uint32 i = 0; i < rowCount; ++i)
+	{
+		// The structure of the given matrix is a subset of this structure.
+		uint32 k1 = rowPtrs[i];
+		for (uint32 k2 = m.rowPtrs[i]; k2 < m.rowPtrs[i + 1]; ++k2)
 		{
-			uint32 j = e->column;
+			while (columns[k1] < m.columns[k2])
+			{
+				++k1;
+			}
 
-			(*this)(i, j) -= e->value;
+			values[k1] -= m.values[k2];
 		}
 	}
 }
@@ -368,15 +550,36 @@ inline void b3SparseMat33::operator-=(const b3SparseMat33& m)
 inline void b3SparseMat33::operator+=(const b3DiagMat33& m)
 {
 	B3_ASSERT(rowCount == m.n);
+
 	for (uint32 i = 0; i < m.n; ++i)
 	{
-		(*this)(i, i) += m[i];
+		uint32 index = SearchIndex(i, i);
+		if (index == B3_MAX_U32)
+		{
+			// Merge the diagonal into the structure at once.
+			b3SparseMat33 diagonal(rowCount);
+			diagonal.Reserve(rowCount);
+			for (uint32 j = 0; j < rowCount; ++j)
+			{
+				diagonal.rowPtrs[j] = j;
+				diagonal.columns[j] = j;
+			}
+			diagonal.rowPtrs[rowCount] = rowCount;
+			diagonal.blockCount = rowCount;
+
+			Merge(diagonal);
+
+			index = SearchIndex(i, i);
+		}
+
+		values[index] += m[i];
 	}
 }
 
 inline void b3SparseMat33::operator-=(const b3DiagMat33& m)
 {
 	B3_ASSERT(rowCount == m.n);
+
 	for (uint32 i = 0; i < m.n; ++i)
 	{
 		(*this)(i, i) -= m[i];
@@ -428,12 +631,10 @@ inline void b3SparseMat33::CreateMatrix(scalar* out) const
 
 	for (uint32 i = 0; i < rowCount; ++i)
 	{
-		b3RowEntryList* list = rows + i;
-
-		for (b3RowEntry* e = list->head; e; e = e->next)
+		for (uint32 k = rowPtrs[i]; k < rowPtrs[i + 1]; ++k)
 		{
-			uint32 j = e->column;
-			b3Mat33 a = e->value;
+			uint32 j = columns[k];
+			b3Mat33 a = values[k];
 
 			for (uint32 ii = 0; ii < 3; ++ii)
 			{
@@ -483,31 +684,33 @@ inline void b3Sub(b3SparseMat33& out, const b3DiagMat33& a, const b3SparseMat33&
 {
 	B3_ASSERT(out.rowCount == a.n);
 
-	for (uint32 i = 0; i < a.n; ++i)
+	// out = -b + a
+	out = b;
+	
+	for (uint32 k = 0; k < out.blockCount; ++k)
 	{
-		out(i, i) = a[i];
+		out.values[k] = -out.values[k];
 	}
 
-	out -= b;
+	out += a;
 }
 
 inline void b3Mul(b3DenseVec3& out, const b3SparseMat33& A, const b3DenseVec3& v)
 {
 	B3_ASSERT(A.rowCount == out.n);
-
-	out.SetZero();
+	B3_ASSERT(out.v != v.v);
 
 	for (uint32 i = 0; i < A.rowCount; ++i)
 	{
-		b3RowEntryList* list = A.rows + i;
+		b3Vec3 sum;
+		sum.SetZero();
 
-		for (b3RowEntry* e = list->head; e; e = e->next)
+		for (uint32 k = A.rowPtrs[i]; k < A.rowPtrs[i + 1]; ++k)
 		{
-			uint32 j = e->column;
-			b3Mat33 a = e->value;
-
-			out[i] += a * v[j];
+			sum += A.values[k] * v[A.columns[k]];
 		}
+
+		out[i] = sum;
 	}
 }
 
@@ -522,13 +725,9 @@ inline void b3Mul(b3SparseMat33& out, scalar s, const b3SparseMat33& B)
 
 	out = B;
 
-	for (uint32 i = 0; i < out.rowCount; ++i)
+	for (uint32 k = 0; k < out.blockCount; ++k)
 	{
-		b3RowEntryList* list = out.rows + i;
-		for (b3RowEntry* e = list->head; e; e = e->next)
-		{
-			e->value = s * e->value;
-		}
+		out.values[k] = s * out.values[k];
 	}
 }
 
@@ -545,10 +744,9 @@ inline void b3Mul(b3SparseMat33& out, const b3DiagMat33& A, const b3SparseMat33&
 	// cij = aii * bij
 	for (uint32 i = 0; i < out.rowCount; ++i)
 	{
-		b3RowEntryList* list = out.rows + i;
-		for (b3RowEntry* e = list->head; e; e = e->next)
+		for (uint32 k = out.rowPtrs[i]; k < out.rowPtrs[i + 1]; ++k)
 		{
-			e->value = A[i] * e->value;
+			out.values[k] = A[i] * out.values[k];
 		}
 	}
 }
@@ -564,14 +762,10 @@ inline void b3Mul(b3SparseMat33& out, const b3SparseMat33& A, const b3DiagMat33&
 	// [a11 a12] * [b11 0 ] = [a11 * b11  a12 * b22]
 	// [a21 a22]   [0  b22]   [a21 * b11  a22 * b22]
 	// cij = aij * bjj
-	for (uint32 i = 0; i < out.rowCount; ++i)
+	for (uint32 k = 0; k < out.blockCount; ++k)
 	{
-		b3RowEntryList* list = out.rows + i;
-		for (b3RowEntry* e = list->head; e; e = e->next)
-		{
-			uint32 j = e->column;
-			e->value = e->value * B[j];
-		}
+		uint32 j = out.columns[k];
+		out.values[k] = out.values[k] * B[j];
 	}
 }
 
@@ -645,4 +839,4 @@ inline b3SparseMat33 operator*(const b3SparseMat33& A, const b3DiagMat33& B)
 	return result;
 }
 
-#endif
\ No newline at end of file
+#endif
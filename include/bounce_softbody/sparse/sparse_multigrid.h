@@ -0,0 +1,122 @@
+/*
+* Copyright (c) 2016-2019 Irlan Robson
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B3_SPARSE_MULTIGRID_H
+#define B3_SPARSE_MULTIGRID_H
+
+#include <bounce_softbody/sparse/sparse_mat33.h>
+
+struct b3DiagMat33;
+
+// Maximum number of levels in a multigrid hierarchy.
+const uint32 b3_maxMultigridLevels = 12;
+
+// Maximum number of rows of the coarsest level that is solved directly.
+const uint32 b3_multigridCoarseRowCount = 64;
+
+// A rectangular block sparse matrix in block compressed row format.
+// This is used for the transfer operators between two levels.
+struct b3MultigridOperator
+{
+	uint32 rowCount;
+	uint32 blockCount;
+	uint32* rowPtrs;
+	uint32* columns;
+	b3Mat33* values;
+};
+
+// A level of the multigrid hierarchy.
+struct b3MultigridLevel
+{
+	// The matrix of this level.
+	b3SparseMat33 A;
+	
+	// The constraint filter of this level.
+	b3Mat33* S;
+	
+	// The inverse of the diagonal blocks of A.
+	b3Mat33* invDiagonal;
+	
+	// The index of the diagonal block of each row.
+	uint32* diagonalIndices;
+
+	// The aggregate of each row.
+	uint32* aggregates;
+
+	// The prolongation operator P to this level from the next coarser level.
+	// The index in P of the block in each block of A.
+	b3MultigridOperator P;
+	uint32* prolongationIndices;
+
+	// The restriction operator R = P^T.
+	// The index in P of each block in R.
+	b3MultigridOperator R;
+	uint32* restrictionIndices;
+
+	// The product A * P.
+	b3MultigridOperator AP;
+
+	// Solution, right hand side and residual.
+	b3Vec3* x;
+	b3Vec3* b;
+	b3Vec3* r;
+};
+
+// Smoothed aggregation algebraic multigrid preconditioner for a 
+// pre-filtered system S * A * S^T + I - S. 
+// The hierarchy is built from the block structure of the matrix and kept 
+// until the structure changes. Only the numerical values are recomputed otherwise. 
+// See "Smoothed Aggregation Multigrid for Cloth Simulation", Tamstorf et al.
+struct b3SparseMultigrid
+{
+	b3SparseMultigrid();
+	~b3SparseMultigrid();
+
+	// Compute the hierarchy of a given matrix. 
+	// Optionally pass the constraint filter of the matrix.
+	void Compute(const b3SparseMat33& A, const b3DiagMat33* S);
+
+	// Solve M * x = b, where M is one symmetric V-cycle.
+	void Solve(b3Vec3* x, const b3Vec3* b) const;
+
+	// Get the number of bytes allocated by the hierarchy.
+	uint32 GetByteCount() const;
+
+	// Number of levels.
+	uint32 levelCount;
+	
+	// Levels ordered from fine to coarse.
+	b3MultigridLevel levels[b3_maxMultigridLevels];
+
+	// Dense lower Cholesky factor of the coarsest matrix if it is small.
+	uint32 coarseSize;
+	scalar* coarseL;
+
+	// Scratch array with one entry per row of the finest level.
+	uint32* markers;
+private:
+	void Destroy();
+	
+	void BuildHierarchy();
+	
+	void ComputeLevel(uint32 index);
+	
+	void SolveLevel(uint32 index) const;
+};
+
+#endif
@@ -0,0 +1,99 @@
+/*
+* Copyright (c) 2016-2019 Irlan Robson
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B3_SPARSE_PRECONDITIONER_H
+#define B3_SPARSE_PRECONDITIONER_H
+
+#include <bounce_softbody/common/math/mat33.h>
+
+struct b3DenseVec3;
+struct b3SparseMat33;
+struct b3DiagMat33;
+struct b3SparseMultigrid;
+
+// Preconditioner types.
+enum b3PreconditionerType
+{
+	e_jacobiPreconditioner, // inverse of the diagonal
+	e_blockJacobiPreconditioner, // inverse of the 3x3 diagonal blocks
+	e_incompleteCholeskyPreconditioner, // block incomplete Cholesky factorization with zero fill-in, IC(0)
+	e_multigridPreconditioner, // one V-cycle of smoothed aggregation algebraic multigrid
+};
+
+// A preconditioner M for a positive-definite sparse matrix A used by the CG solver.
+// A computed preconditioner remains valid for matrices with the same block structure, 
+// so it can be reused while the matrix changes little.
+struct b3SparsePreconditioner
+{
+	b3SparsePreconditioner();
+	~b3SparsePreconditioner();
+
+	// Compute the preconditioner of a given matrix.
+	void Compute(const b3SparseMat33& A);
+
+	// Compute the preconditioner of a given pre-filtered matrix S * A * S^T + I - S.
+	// Only the multigrid preconditioner uses the constraint filter S.
+	void Compute(const b3SparseMat33& A, const b3DiagMat33* S);
+
+	// Compute a Jacobi or block-Jacobi preconditioner from the diagonal blocks of a matrix.
+	// This is used when the matrix is not stored.
+	void Compute(const b3DiagMat33& D);
+
+	// Return true if this preconditioner was computed for a matrix with the 
+	// same dimension and number of blocks as a given matrix.
+	// The incomplete Cholesky and multigrid preconditioners also need the same block structure.
+	bool IsCompatible(const b3SparseMat33& A) const;
+
+	// Solve M * x = r for a range of rows.
+	// This is only valid for Jacobi and block-Jacobi preconditioners.
+	// Return r . x over the rows.
+	scalar Solve(b3DenseVec3& x, const b3DenseVec3& r, uint32 rowBegin, uint32 rowEnd) const;
+
+	// Solve M * x = r.
+	// The incomplete Cholesky and multigrid preconditioners are applied sequentially.
+	void Solve(b3DenseVec3& x, const b3DenseVec3& r) const;
+
+	// Get the number of bytes allocated by this preconditioner.
+	uint32 GetByteCount() const;
+
+	// Preconditioner type. This must be set before computing the preconditioner.
+	b3PreconditionerType type;
+
+	// Dimension and number of blocks of the source matrix.
+	uint32 rowCount;
+	uint32 blockCount;
+
+	// Jacobi: inverse of the diagonal.
+	b3Vec3* invDiagonal;
+
+	// Block-Jacobi: inverse of the diagonal blocks.
+	// IC(0): inverse of the diagonal blocks of the factor L.
+	b3Mat33* invBlocks;
+
+	// IC(0): strictly lower blocks of the factor L in block compressed row format.
+	// The capacity is the number of allocated lower blocks.
+	uint32 lowerCapacity;
+	uint32* lowerRowPtrs;
+	uint32* lowerColumns;
+	b3Mat33* lowerValues;
+
+	// Multigrid: the hierarchy of levels.
+	b3SparseMultigrid* multigrid;
+};
+
+#endif
@@ -23,14 +23,47 @@
 
 struct b3DenseVec3;
 struct b3SparseMat33;
+struct b3SparsePreconditioner;
+
+class b3ThreadPool;
+class b3SparseWorkspace;
+
+// A linear operator that computes matrix-vector products without storing the matrix.
+class b3SparseOperator
+{
+public:
+	// Compute y = A * x.
+	virtual void Multiply(b3DenseVec3& y, const b3DenseVec3& x) const = 0;
+};
 
 // Input for CG solver.
 struct b3SolveCGInput
 {
+	b3SolveCGInput()
+	{
+		A = nullptr;
+		symmetric = false;
+		op = nullptr;
+		preconditioner = nullptr;
+		threadPool = nullptr;
+		workspace = nullptr;
+		warmStarting = false;
+		mixedPrecision = false;
+		refinementIterations = 0;
+	}
+
 	const b3SparseMat33* A; // A in Ax = b
+	bool symmetric; // A stores only the diagonal and upper blocks of a symmetric matrix. The preconditioner must be Jacobi or block-Jacobi.
+	const b3SparseOperator* op; // optional operator applied instead of A. A preconditioner must be given.
 	const b3DenseVec3* b; // b in Ax = b
 	uint32 maxIterations; // maximum CG iterations
 	scalar tolerance; // allowed error
+	const b3SparsePreconditioner* preconditioner; // optional preconditioner computed for A or a matrix with the same structure
+	b3ThreadPool* threadPool; // optional thread pool for the matrix and vector operations
+	b3SparseWorkspace* workspace; // optional persistent memory for the temporary vectors
+	bool warmStarting; // measure the error relative to a zero initial guess so a good initial guess saves iterations
+	bool mixedPrecision; // accumulate the dot products in scalar64, and the residual too if A stores both triangles. The vectors and the matrix stay in scalar.
+	uint32 refinementIterations; // maximum number of iterative refinement steps after the solve. Each step solves for a correction of the solution using up to maxIterations iterations.
 };
 
 // Output of CG solver.
@@ -43,7 +76,8 @@ struct b3SolveCGOutput
 
 // Solve Ax = b using a preconditioned Conjugate Gradient method.
 // The system matrix A must be a positive-definite matrix.
-// This solver uses Jacobi preconditioner.
+// This solver uses the Jacobi preconditioner if no preconditioner is given.
+// The result does not depend on the number of threads of the thread pool.
 bool b3SparseSolveCG(b3SolveCGOutput* output, const b3SolveCGInput* input);
 
 #endif
\ No newline at end of file
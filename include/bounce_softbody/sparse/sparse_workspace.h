@@ -0,0 +1,95 @@
+/*
+* Copyright (c) 2016-2019 Irlan Robson
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef B3_SPARSE_WORKSPACE_H
+#define B3_SPARSE_WORKSPACE_H
+
+#include <bounce_softbody/common/settings.h>
+
+struct b3DenseVec3;
+struct b3DiagMat33;
+struct b3SparseMat33;
+
+// Persistent memory for the sparse solvers.
+// A solver takes its vectors and matrices from a workspace and returns them in reverse order. 
+// Returned objects keep their memory for the next solve, so solving a system 
+// of the same size again doesn't allocate memory.
+class b3SparseWorkspace
+{
+public:
+	b3SparseWorkspace();
+	~b3SparseWorkspace();
+
+	// Take a vector with a given number of elements. The elements are undefined.
+	b3DenseVec3* AllocateDenseVec3(uint32 n);
+	void FreeDenseVec3(b3DenseVec3* v);
+
+	// Take a diagonal matrix with a given number of elements. The elements are undefined.
+	b3DiagMat33* AllocateDiagMat33(uint32 n);
+	void FreeDiagMat33(b3DiagMat33* m);
+
+	// Take a sparse matrix. Its dimension and blocks are undefined. 
+	// The block arrays are reused when the matrix is assigned.
+	b3SparseMat33* AllocateSparseMat33();
+	void FreeSparseMat33(b3SparseMat33* m);
+
+	// Take a block of memory.
+	void* Allocate(uint32 size);
+	void Free(void* p);
+
+	// Get the number of bytes kept by the objects of this workspace.
+	uint32 GetByteCount() const;
+private:
+	// A block of memory.
+	struct b3Block
+	{
+		~b3Block()
+		{
+			b3Free(data);
+		}
+
+		uint32 size;
+		void* data;
+	};
+
+	// A stack of persistent objects.
+	template <typename T>
+	struct b3Pool
+	{
+		T** objects;
+		uint32 capacity;
+		uint32 count; // number of created objects
+		uint32 top; // number of objects in use
+	};
+
+	template <typename T>
+	static T* Take(b3Pool<T>& pool);
+
+	template <typename T>
+	static void Return(b3Pool<T>& pool, T* object);
+
+	template <typename T>
+	static void Destroy(b3Pool<T>& pool);
+
+	b3Pool<b3DenseVec3> m_vectors;
+	b3Pool<b3DiagMat33> m_diagonals;
+	b3Pool<b3SparseMat33> m_matrices;
+	b3Pool<b3Block> m_blocks;
+};
+
+#endif
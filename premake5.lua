@@ -190,3 +190,25 @@ workspace(solution_name)
 		filter {}
 		
 		links { "glad", "glfw", "imgui", "bounce_softbody" }
+		
+	project "bench"
+		kind "ConsoleApp"
+		language "C++"
+		location ( solution_dir .. action )
+		includedirs 
+		{ 
+				bounce_softbody_inc_dir
+		}
+		
+		files 
+		{ 
+			examples_dir .. "/bench/**.h",
+			examples_dir .. "/bench/**.cpp",
+		}
+		
+		filter "system:linux" 
+			links { "pthread" }
+		
+		filter {}
+		
+		links { "bounce_softbody" }
@@ -0,0 +1,365 @@
+/*
+* Copyright (c) 2016-2019 Irlan Robson
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <bounce_softbody/collision/geometry/mesh_generator.h>
+
+// Write the two triangles of each quad in a (H + 1) x (W + 1) vertex grid.
+static uint32 b3BuildQuads(b3Triangle* triangles, uint32 H, uint32 W)
+{
+	uint32 triangleCount = 0;
+	for (uint32 i = 0; i < H; ++i)
+	{
+		for (uint32 j = 0; j < W; ++j)
+		{
+			// 1*|----|*4
+			//   |----|
+			// 2*|----|*3
+			uint32 v1 = i * (W + 1) + j;
+			uint32 v2 = (i + 1) * (W + 1) + j;
+			uint32 v3 = (i + 1) * (W + 1) + j + 1;
+			uint32 v4 = i * (W + 1) + j + 1;
+
+			b3Triangle* t1 = triangles + triangleCount++;
+			t1->v1 = v1;
+			t1->v2 = v2;
+			t1->v3 = v3;
+
+			t1->u1 = B3_NULL_VERTEX;
+			t1->u2 = B3_NULL_VERTEX;
+			t1->u3 = B3_NULL_VERTEX;
+
+			b3Triangle* t2 = triangles + triangleCount++;
+			t2->v1 = v3;
+			t2->v2 = v4;
+			t2->v3 = v1;
+
+			t2->u1 = B3_NULL_VERTEX;
+			t2->u2 = B3_NULL_VERTEX;
+			t2->u3 = B3_NULL_VERTEX;
+		}
+	}
+	return triangleCount;
+}
+
+static void b3AllocMesh(b3Mesh* mesh, uint32 vertexCount, uint32 triangleCount)
+{
+	mesh->vertexCount = vertexCount;
+	mesh->vertices = (b3Vec3*)b3Alloc(vertexCount * sizeof(b3Vec3));
+	mesh->triangleCount = triangleCount;
+	mesh->triangles = (b3Triangle*)b3Alloc(triangleCount * sizeof(b3Triangle));
+}
+
+void b3BuildGridMesh(b3Mesh* mesh, uint32 H, uint32 W)
+{
+	B3_ASSERT(H > 0 && W > 0);
+
+	b3AllocMesh(mesh, (H + 1) * (W + 1), 2 * H * W);
+
+	b3Vec3 center;
+	center.x = scalar(0.5) * scalar(W);
+	center.y = scalar(0);
+	center.z = scalar(0.5) * scalar(H);
+
+	for (uint32 i = 0; i <= H; ++i)
+	{
+		for (uint32 j = 0; j <= W; ++j)
+		{
+			b3Vec3 v;
+			v.Set(scalar(j), scalar(0), scalar(i));
+			mesh->vertices[i * (W + 1) + j] = v - center;
+		}
+	}
+
+	uint32 triangleCount = b3BuildQuads(mesh->triangles, H, W);
+	B3_ASSERT(triangleCount == mesh->triangleCount);
+	B3_NOT_USED(triangleCount);
+}
+
+void b3BuildSphereMesh(b3Mesh* mesh, uint32 H, uint32 W)
+{
+	B3_ASSERT(H > 0 && W > 0);
+
+	b3AllocMesh(mesh, (H + 1) * (W + 1), 2 * H * W);
+
+	// Latitude increment in range [0, pi]
+	scalar kThetaInc = B3_PI / scalar(H);
+
+	// Longitude increment in range [0, 2*pi]
+	scalar kPhiInc = scalar(2) * B3_PI / scalar(W);
+
+	for (uint32 i = 0; i <= H; ++i)
+	{
+		// Plane to spherical coordinates
+		scalar theta = scalar(i) * kThetaInc;
+		scalar cos_theta = cos(theta);
+		scalar sin_theta = sin(theta);
+
+		for (uint32 j = 0; j <= W; ++j)
+		{
+			scalar phi = scalar(j) * kPhiInc;
+			scalar cos_phi = cos(phi);
+			scalar sin_phi = sin(phi);
+
+			// Spherical to Cartesian coordinates
+			b3Vec3 p;
+			p.x = sin_theta * sin_phi;
+			p.y = cos_theta;
+			p.z = sin_theta * cos_phi;
+
+			mesh->vertices[i * (W + 1) + j] = p;
+		}
+	}
+
+	uint32 triangleCount = b3BuildQuads(mesh->triangles, H, W);
+	B3_ASSERT(triangleCount == mesh->triangleCount);
+	B3_NOT_USED(triangleCount);
+}
+
+void b3BuildCylinderMesh(b3Mesh* mesh, uint32 H, uint32 W)
+{
+	B3_ASSERT(H > 0 && W > 1);
+
+	b3AllocMesh(mesh, (H + 1) * (W + 1), 2 * H * W + 2 * (W - 1));
+
+	// Angular increment in range [0, 2*pi]
+	scalar kPhiInc = scalar(2) * B3_PI / scalar(W);
+
+	// Longitude increment in range [0, 1]
+	scalar kYInc = scalar(1) / scalar(H);
+
+	for (uint32 i = 0; i <= H; ++i)
+	{
+		// Plane to cylindrical coordinates
+		scalar y = scalar(i) * kYInc;
+
+		for (uint32 j = 0; j <= W; ++j)
+		{
+			scalar phi = scalar(j) * kPhiInc;
+			scalar cos_phi = cos(phi);
+			scalar sin_phi = sin(phi);
+
+			// Cylindrical to Cartesian coordinates
+			b3Vec3 p;
+			p.x = cos_phi;
+			p.y = y - scalar(0.5); // Centralize
+			p.z = sin_phi;
+
+			mesh->vertices[i * (W + 1) + j] = p;
+		}
+	}
+
+	uint32 triangleCount = b3BuildQuads(mesh->triangles, H, W);
+
+	// Lower and upper caps
+	for (uint32 i2 = 1; i2 < W; ++i2)
+	{
+		uint32 i3 = i2 + 1;
+
+		b3Triangle* t1 = mesh->triangles + triangleCount++;
+		t1->v1 = 0;
+		t1->v2 = i2;
+		t1->v3 = i3;
+
+		t1->u1 = B3_NULL_VERTEX;
+		t1->u2 = B3_NULL_VERTEX;
+		t1->u3 = B3_NULL_VERTEX;
+
+		// Flip order to ensure CCW
+		b3Triangle* t2 = mesh->triangles + triangleCount++;
+		t2->v1 = H * (W + 1) + i3;
+		t2->v2 = H * (W + 1) + i2;
+		t2->v3 = H * (W + 1);
+
+		t2->u1 = B3_NULL_VERTEX;
+		t2->u2 = B3_NULL_VERTEX;
+		t2->u3 = B3_NULL_VERTEX;
+	}
+
+	B3_ASSERT(triangleCount == mesh->triangleCount);
+}
+
+void b3FreeMesh(b3Mesh* mesh)
+{
+	b3Free(mesh->vertices);
+	b3Free(mesh->triangles);
+	mesh->vertices = nullptr;
+	mesh->triangles = nullptr;
+	mesh->vertexCount = 0;
+	mesh->triangleCount = 0;
+}
+
+// Add the two triangles of a boundary quad.
+static void b3AddQuad(b3TetMesh* mesh, uint32 v1, uint32 v2, uint32 v3, uint32 v4)
+{
+	b3Triangle* t1 = mesh->triangles + mesh->triangleCount++;
+	t1->v1 = v1;
+	t1->v2 = v2;
+	t1->v3 = v3;
+
+	t1->u1 = B3_NULL_VERTEX;
+	t1->u2 = B3_NULL_VERTEX;
+	t1->u3 = B3_NULL_VERTEX;
+
+	b3Triangle* t2 = mesh->triangles + mesh->triangleCount++;
+	t2->v1 = v3;
+	t2->v2 = v4;
+	t2->v3 = v1;
+
+	t2->u1 = B3_NULL_VERTEX;
+	t2->u2 = B3_NULL_VERTEX;
+	t2->u3 = B3_NULL_VERTEX;
+}
+
+static void b3AddTetrahedron(b3TetMesh* mesh, uint32 v1, uint32 v2, uint32 v3, uint32 v4)
+{
+	b3Tetrahedron* t = mesh->tetrahedrons + mesh->tetrahedronCount++;
+	t->v1 = v1;
+	t->v2 = v2;
+	t->v3 = v3;
+	t->v4 = v4;
+}
+
+void b3BuildBoxTetMesh(b3TetMesh* mesh, uint32 H, uint32 W, uint32 D)
+{
+	B3_ASSERT(H > 0 && W > 0 && D > 0);
+
+	mesh->vertexCount = (H + 1) * (W + 1) * (D + 1);
+	mesh->vertices = (b3Vec3*)b3Alloc(mesh->vertexCount * sizeof(b3Vec3));
+	
+	uint32 triangleCapacity = 4 * H * W + 4 * H * D + 4 * W * D;
+	mesh->triangleCount = 0;
+	mesh->triangles = (b3Triangle*)b3Alloc(triangleCapacity * sizeof(b3Triangle));
+
+	uint32 tetrahedronCapacity = 5 * H * W * D;
+	mesh->tetrahedronCount = 0;
+	mesh->tetrahedrons = (b3Tetrahedron*)b3Alloc(tetrahedronCapacity * sizeof(b3Tetrahedron));
+
+#define B3_BOX_VERTEX(i, j, k) (((i) * (W + 1) + (j)) * (D + 1) + (k))
+
+	b3Vec3 center;
+	center.x = scalar(0.5) * scalar(W);
+	center.y = scalar(0.5) * scalar(H);
+	center.z = scalar(0.5) * scalar(D);
+
+	for (uint32 i = 0; i <= H; ++i)
+	{
+		for (uint32 j = 0; j <= W; ++j)
+		{
+			for (uint32 k = 0; k <= D; ++k)
+			{
+				b3Vec3 v;
+				v.Set(scalar(j), scalar(i), scalar(k));
+				mesh->vertices[B3_BOX_VERTEX(i, j, k)] = v - center;
+			}
+		}
+	}
+
+	// x-y planes
+	for (uint32 i = 0; i < H; ++i)
+	{
+		for (uint32 j = 0; j < W; ++j)
+		{
+			b3AddQuad(mesh, B3_BOX_VERTEX(i, j, 0), B3_BOX_VERTEX(i + 1, j, 0), B3_BOX_VERTEX(i + 1, j + 1, 0), B3_BOX_VERTEX(i, j + 1, 0));
+			b3AddQuad(mesh, B3_BOX_VERTEX(i + 1, j + 1, D), B3_BOX_VERTEX(i + 1, j, D), B3_BOX_VERTEX(i, j, D), B3_BOX_VERTEX(i, j + 1, D));
+		}
+	}
+
+	// y-z planes
+	for (uint32 i = 0; i < H; ++i)
+	{
+		for (uint32 k = 0; k < D; ++k)
+		{
+			b3AddQuad(mesh, B3_BOX_VERTEX(i, 0, k), B3_BOX_VERTEX(i, 0, k + 1), B3_BOX_VERTEX(i + 1, 0, k + 1), B3_BOX_VERTEX(i + 1, 0, k));
+			b3AddQuad(mesh, B3_BOX_VERTEX(i + 1, W, k + 1), B3_BOX_VERTEX(i, W, k + 1), B3_BOX_VERTEX(i, W, k), B3_BOX_VERTEX(i + 1, W, k));
+		}
+	}
+
+	// x-z planes
+	for (uint32 j = 0; j < W; ++j)
+	{
+		for (uint32 k = 0; k < D; ++k)
+		{
+			b3AddQuad(mesh, B3_BOX_VERTEX(0, j, k), B3_BOX_VERTEX(0, j + 1, k), B3_BOX_VERTEX(0, j + 1, k + 1), B3_BOX_VERTEX(0, j, k + 1));
+			b3AddQuad(mesh, B3_BOX_VERTEX(H, j + 1, k + 1), B3_BOX_VERTEX(H, j + 1, k), B3_BOX_VERTEX(H, j, k), B3_BOX_VERTEX(H, j, k + 1));
+		}
+	}
+
+	B3_ASSERT(mesh->triangleCount == triangleCapacity);
+
+	for (uint32 i = 0; i < H; ++i)
+	{
+		for (uint32 j = 0; j < W; ++j)
+		{
+			for (uint32 k = 0; k < D; ++k)
+			{
+				//     4*-----8* 
+				//     /|     /|
+				//    / |    / |
+				//  3*-----7*  |
+				//   | 1*--|--5*
+				//   | /   |  /
+				//   |/    | /
+				//  2*-----6*
+				uint32 v1 = B3_BOX_VERTEX(i, j, k);
+				uint32 v2 = B3_BOX_VERTEX(i, j, k + 1);
+				uint32 v3 = B3_BOX_VERTEX(i + 1, j, k + 1);
+				uint32 v4 = B3_BOX_VERTEX(i + 1, j, k);
+
+				uint32 v5 = B3_BOX_VERTEX(i, j + 1, k);
+				uint32 v6 = B3_BOX_VERTEX(i, j + 1, k + 1);
+				uint32 v7 = B3_BOX_VERTEX(i + 1, j + 1, k + 1);
+				uint32 v8 = B3_BOX_VERTEX(i + 1, j + 1, k);
+
+				// Alternate the split so that the faces of neighbour cubes match.
+				if ((i + j + k) % 2 == 1)
+				{
+					b3AddTetrahedron(mesh, v2, v6, v7, v5);
+					b3AddTetrahedron(mesh, v5, v7, v4, v8);
+					b3AddTetrahedron(mesh, v2, v4, v7, v3);
+					b3AddTetrahedron(mesh, v2, v5, v4, v1);
+					b3AddTetrahedron(mesh, v2, v7, v4, v5);
+				}
+				else
+				{
+					b3AddTetrahedron(mesh, v6, v1, v3, v2);
+					b3AddTetrahedron(mesh, v6, v8, v1, v5);
+					b3AddTetrahedron(mesh, v6, v3, v8, v7);
+					b3AddTetrahedron(mesh, v1, v8, v3, v4);
+					b3AddTetrahedron(mesh, v6, v1, v8, v3);
+				}
+			}
+		}
+	}
+
+#undef B3_BOX_VERTEX
+
+	B3_ASSERT(mesh->tetrahedronCount == tetrahedronCapacity);
+}
+
+void b3FreeTetMesh(b3TetMesh* mesh)
+{
+	b3Free(mesh->vertices);
+	b3Free(mesh->triangles);
+	b3Free(mesh->tetrahedrons);
+	mesh->vertices = nullptr;
+	mesh->triangles = nullptr;
+	mesh->tetrahedrons = nullptr;
+	mesh->vertexCount = 0;
+	mesh->triangleCount = 0;
+	mesh->tetrahedronCount = 0;
+}
@@ -75,6 +75,8 @@ b3BlockAllocator::b3BlockAllocator()
 	{
 		new (m_blockPools + i) b3BlockPool(b3_blockSizes[i]);
 	}
+	m_largeCount = 0;
+	m_largeBytes = 0;
 }
 
 b3BlockAllocator::~b3BlockAllocator()
@@ -97,6 +99,8 @@ void* b3BlockAllocator::Allocate(uint32 size)
 	
 	if (size > b3_maxBlockSize)
 	{
+		++m_largeCount;
+		m_largeBytes += size;
 		return b3Alloc(size);
 	}
 
@@ -117,6 +121,9 @@ void b3BlockAllocator::Free(void* p, uint32 size)
 
 	if (size > b3_maxBlockSize)
 	{
+		B3_ASSERT(m_largeCount > 0);
+		--m_largeCount;
+		m_largeBytes -= size;
 		b3Free(p);
 		return;
 	}
@@ -125,4 +132,24 @@ void b3BlockAllocator::Free(void* p, uint32 size)
 	B3_ASSERT(0 <= index && index < b3_blockSizeCount);
 
 	m_blockPools[index].Free(p);
+}
+
+void b3BlockAllocator::GetStats(b3BlockAllocatorStats* stats) const
+{
+	stats->chunkBytes = 0;
+	stats->blockBytes = 0;
+	for (uint32 i = 0; i < b3_blockSizeCount; ++i)
+	{
+		const b3BlockPool* pool = m_blockPools + i;
+		
+		stats->blockSizes[i] = pool->GetBlockSize();
+		stats->chunkCounts[i] = pool->GetChunkCount();
+		stats->blockCounts[i] = pool->GetBlockCount();
+		
+		stats->chunkBytes += pool->GetChunkCount() * b3_blockCount * pool->GetBlockSize();
+		stats->blockBytes += pool->GetBlockCount() * pool->GetBlockSize();
+	}
+
+	stats->largeCount = m_largeCount;
+	stats->largeBytes = m_largeBytes;
 }
\ No newline at end of file
@@ -25,6 +25,7 @@ b3BlockPool::b3BlockPool(uint32 blockSize)
 
 	m_chunks = nullptr;
 	m_chunkCount = 0;
+	m_blockCount = 0;
 
 	// Pre-allocate some chunks
 	b3Chunk* chunk = (b3Chunk*)b3Alloc(sizeof(b3Chunk) + m_chunkSize);
@@ -64,6 +65,8 @@ b3BlockPool::~b3BlockPool()
 
 void* b3BlockPool::Allocate()
 {
+	++m_blockCount;
+
 	if (m_chunks)
 	{
 		if (m_chunks->freeBlocks)
@@ -124,6 +127,9 @@ void b3BlockPool::Free(void* p)
 	memset(p, 0xfd, m_blockSize);
 #endif
 
+	B3_ASSERT(m_blockCount > 0);
+	--m_blockCount;
+
 	b3Block* block = (b3Block*)p;
 	block->next = m_chunks->freeBlocks;
 	m_chunks->freeBlocks = block;
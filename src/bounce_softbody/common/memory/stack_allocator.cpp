@@ -17,20 +17,46 @@
 */
 
 #include <bounce_softbody/common/memory/stack_allocator.h>
+#include <bounce_softbody/common/math/math.h>
 
-b3StackAllocator::b3StackAllocator() 
+b3StackAllocator::b3StackAllocator(uint32 capacity) 
 {
-	m_blockCapacity = 256;
-	m_blocks = (b3Block*)b3Alloc(m_blockCapacity * sizeof(b3Block));
+	m_blockCapacity = 0;
+	m_blocks = nullptr;
 	m_blockCount = 0;
-	m_allocatedSize = 0;
+	m_memory = nullptr;
+	m_capacity = 0;
+	m_index = 0;
+	m_allocation = 0;
+	m_maxAllocation = 0;
+	m_parentCount = 0;
+
+	Reserve(capacity);
 }
 
 b3StackAllocator::~b3StackAllocator() 
 {
-	B3_ASSERT(m_allocatedSize == 0);
+	B3_ASSERT(m_index == 0);
 	B3_ASSERT(m_blockCount == 0);
 	b3Free(m_blocks);
+	b3Free(m_memory);
+}
+
+void b3StackAllocator::Reserve(uint32 capacity)
+{
+	B3_ASSERT(m_blockCount == 0);
+
+	// Keep the blocks aligned.
+	capacity = (capacity + b3_stackAlignment - 1) & ~(b3_stackAlignment - 1);
+
+	if (capacity <= m_capacity)
+	{
+		return;
+	}
+
+	b3Free(m_memory);
+	m_memory = (uint8*)b3Alloc(capacity);
+	m_capacity = capacity;
 }
 
 void* b3StackAllocator::Allocate(uint32 size) 
@@ -39,28 +65,38 @@ void* b3StackAllocator::Allocate(uint32 size)
 	{
 		// Then duplicate capacity if needed.
 		b3Block* oldBlocks = m_blocks;
-		m_blockCapacity *= 2;
+		m_blockCapacity = m_blockCapacity > 0 ? 2 * m_blockCapacity : 32;
 		m_blocks = (b3Block*)b3Alloc(m_blockCapacity * sizeof(b3Block));
-		memcpy(m_blocks, oldBlocks, m_blockCount * sizeof(b3Block));
+		if (m_blockCount > 0)
+		{
+			memcpy(m_blocks, oldBlocks, m_blockCount * sizeof(b3Block));
+		}
 		b3Free(oldBlocks);
 	}
 
+	// Keep the next block aligned.
+	size = (size + b3_stackAlignment - 1) & ~(b3_stackAlignment - 1);
+
 	b3Block* block = m_blocks + m_blockCount;
 	block->size = size;
-	if (m_allocatedSize + size > b3_maxStackSize) 
+	if (m_index + size > m_capacity) 
 	{
 		// Allocate with parent allocator.
 		block->data = (uint8*) b3Alloc(size);
 		block->parent = true;
+		++m_parentCount;
 	}
 	else 
 	{
 		// Use this stack memory.
-		block->data = m_memory + m_allocatedSize;
+		block->data = m_memory + m_index;
 		block->parent = false;
-		m_allocatedSize += size;
+		m_index += size;
 	}
 	
+	m_allocation += size;
+	m_maxAllocation = b3Max(m_maxAllocation, m_allocation);
+
 	++m_blockCount;
 
 	return block->data;
@@ -77,7 +113,16 @@ void b3StackAllocator::Free(void* p)
 	}
 	else 
 	{
-		m_allocatedSize -= block->size;
+		m_index -= block->size;
 	}
+	
+	m_allocation -= block->size;
+	
 	--m_blockCount;
+
+	if (m_blockCount == 0 && m_maxAllocation > m_capacity)
+	{
+		// Grow to the peak usage. 
+		Reserve(m_maxAllocation);
+	}
 }
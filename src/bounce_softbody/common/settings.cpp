@@ -27,16 +27,54 @@ uint32 b3_maxAllocCalls = 0;
 
 b3Version b3_version = { 0, 0, 0 };
 
+static void* b3DefaultAlloc(uint32 size)
+{
+	return malloc(size);
+}
+
+static void b3DefaultFree(void* block)
+{
+	free(block);
+}
+
+static b3AllocFcn* b3_allocFcn = b3DefaultAlloc;
+static b3FreeFcn* b3_freeFcn = b3DefaultFree;
+
+static thread_local b3AllocCounters b3_allocCounters = { 0, 0, 0 };
+
+void b3SetAllocator(b3AllocFcn* allocFcn, b3FreeFcn* freeFcn)
+{
+	B3_ASSERT((allocFcn == nullptr) == (freeFcn == nullptr));
+	b3_allocFcn = allocFcn ? allocFcn : b3DefaultAlloc;
+	b3_freeFcn = freeFcn ? freeFcn : b3DefaultFree;
+}
+
 void* b3Alloc(uint32 size) 
 {
 	++b3_allocCalls;
 	b3_maxAllocCalls = b3Max(b3_maxAllocCalls, b3_allocCalls);
-	return malloc(size);
+	
+	++b3_allocCounters.allocCalls;
+	b3_allocCounters.allocBytes += size;
+
+	return b3_allocFcn(size);
 }
 
 void b3Free(void* block) 
 {
-	return free(block);
+	if (block == nullptr)
+	{
+		return;
+	}
+
+	++b3_allocCounters.freeCalls;
+
+	b3_freeFcn(block);
+}
+
+const b3AllocCounters& b3GetAllocCounters()
+{
+	return b3_allocCounters;
 }
 
 void b3Log(const char* text, ...) 
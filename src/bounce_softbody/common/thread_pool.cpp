@@ -0,0 +1,181 @@
+/*
+* Copyright (c) 2016-2019 Irlan Robson
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <bounce_softbody/common/thread_pool.h>
+#include <bounce_softbody/common/math/math.h>
+
+b3ThreadPool::b3ThreadPool()
+{
+	m_threadCount = 1;
+	m_workerCount = 0;
+	m_workers = nullptr;
+	m_generation = 0;
+	m_busyCount = 0;
+	m_exit = false;
+	m_fcn = nullptr;
+	m_context = nullptr;
+	m_count = 0;
+	m_grainSize = 1;
+	m_next = 0;
+}
+
+b3ThreadPool::~b3ThreadPool()
+{
+	StopWorkers();
+}
+
+void b3ThreadPool::SetThreadCount(uint32 count)
+{
+	if (count == 0)
+	{
+		count = 1;
+	}
+
+	if (count == m_threadCount)
+	{
+		return;
+	}
+
+	StopWorkers();
+	
+	m_threadCount = count;
+
+	StartWorkers();
+}
+
+void b3ThreadPool::StartWorkers()
+{
+	B3_ASSERT(m_workerCount == 0);
+
+	m_exit = false;
+	m_workerCount = m_threadCount - 1;
+	if (m_workerCount == 0)
+	{
+		return;
+	}
+
+	m_workers = (std::thread*)b3Alloc(m_workerCount * sizeof(std::thread));
+	for (uint32 i = 0; i < m_workerCount; ++i)
+	{
+		new (m_workers + i) std::thread(&b3ThreadPool::WorkerLoop, this, m_generation);
+	}
+}
+
+void b3ThreadPool::StopWorkers()
+{
+	if (m_workerCount == 0)
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_exit = true;
+	}
+	m_workCondition.notify_all();
+
+	for (uint32 i = 0; i < m_workerCount; ++i)
+	{
+		m_workers[i].join();
+		m_workers[i].~thread();
+	}
+
+	b3Free(m_workers);
+	m_workers = nullptr;
+	m_workerCount = 0;
+}
+
+void b3ThreadPool::WorkerLoop(uint32 generation)
+{
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_workCondition.wait(lock, [this, generation]() { return m_exit || m_generation != generation; });
+			
+			if (m_exit)
+			{
+				return;
+			}
+
+			generation = m_generation;
+		}
+
+		Execute();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			--m_busyCount;
+			if (m_busyCount == 0)
+			{
+				m_doneCondition.notify_one();
+			}
+		}
+	}
+}
+
+void b3ThreadPool::Execute()
+{
+	for (;;)
+	{
+		uint32 begin = m_next.fetch_add(m_grainSize);
+		if (begin >= m_count)
+		{
+			break;
+		}
+
+		uint32 end = b3Min(begin + m_grainSize, m_count);
+		
+		m_fcn(m_context, begin, end);
+	}
+}
+
+void b3ThreadPool::ParallelFor(uint32 count, uint32 grainSize, b3ParallelForFcn* fcn, void* context)
+{
+	B3_ASSERT(grainSize > 0);
+
+	if (count == 0)
+	{
+		return;
+	}
+
+	// Run small loops on the calling thread.
+	if (m_workerCount == 0 || count <= grainSize)
+	{
+		fcn(context, 0, count);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_fcn = fcn;
+		m_context = context;
+		m_count = count;
+		m_grainSize = grainSize;
+		m_next = 0;
+		m_busyCount = m_workerCount;
+		++m_generation;
+	}
+	m_workCondition.notify_all();
+
+	Execute();
+
+	// Wait for the workers.
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_doneCondition.wait(lock, [this]() { return m_busyCount == 0; });
+}
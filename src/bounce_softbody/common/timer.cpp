@@ -0,0 +1,47 @@
+/*
+* Copyright (c) 2016-2019 Irlan Robson
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <bounce_softbody/common/timer.h>
+
+#if B3_PROFILE
+
+#include <chrono>
+
+typedef std::chrono::steady_clock b3Clock;
+
+static uint64 b3GetTicks()
+{
+	return uint64(std::chrono::duration_cast<std::chrono::nanoseconds>(b3Clock::now().time_since_epoch()).count());
+}
+
+b3Timer::b3Timer()
+{
+	m_start = b3GetTicks();
+}
+
+void b3Timer::Reset()
+{
+	m_start = b3GetTicks();
+}
+
+scalar64 b3Timer::GetMilliseconds() const
+{
+	return scalar64(b3GetTicks() - m_start) * 1.0e-6;
+}
+
+#endif
@@ -27,6 +27,90 @@
 #include <bounce_softbody/dynamics/fixtures/world_fixture.h>
 #include <bounce_softbody/dynamics/contacts/sphere_shape_contact.h>
 #include <bounce_softbody/common/draw.h>
+#include <bounce_softbody/common/timer.h>
+
+// Push an edge to the front of a particle list.
+template <typename T>
+static inline void b3PushEdge(T*& list, T* edge)
+{
+	edge->prev = nullptr;
+	edge->next = list;
+	if (list)
+	{
+		list->prev = edge;
+	}
+	list = edge;
+}
+
+// Remove an edge from a particle list.
+template <typename T>
+static inline void b3RemoveEdge(T*& list, T* edge)
+{
+	if (edge->prev)
+	{
+		edge->prev->next = edge->next;
+	}
+
+	if (edge->next)
+	{
+		edge->next->prev = edge->prev;
+	}
+
+	if (edge == list)
+	{
+		list = edge->next;
+	}
+}
+
+// Find the triangle with the given particles in any order 
+// by walking the triangles sharing the first particle.
+static b3TriangleFixture* b3FindTriangle(b3Particle* p1, b3Particle* p2, b3Particle* p3)
+{
+	for (b3FixtureEdge* e = p1->GetTriangleList(); e; e = e->next)
+	{
+		b3TriangleFixture* t = (b3TriangleFixture*)e->fixture;
+
+		b3Particle* tp1 = t->GetParticle1();
+		b3Particle* tp2 = t->GetParticle2();
+		b3Particle* tp3 = t->GetParticle3();
+
+		bool hasP2 = tp1 == p2 || tp2 == p2 || tp3 == p2;
+		bool hasP3 = tp1 == p3 || tp2 == p3 || tp3 == p3;
+
+		if (hasP2 && hasP3)
+		{
+			return t;
+		}
+	}
+
+	return nullptr;
+}
+
+// Find the tetrahedron with the given particles in any order 
+// by walking the tetrahedrons sharing the first particle.
+static b3TetrahedronFixture* b3FindTetrahedron(b3Particle* p1, b3Particle* p2, b3Particle* p3, b3Particle* p4)
+{
+	for (b3FixtureEdge* e = p1->GetTetrahedronList(); e; e = e->next)
+	{
+		b3TetrahedronFixture* t = (b3TetrahedronFixture*)e->fixture;
+
+		b3Particle* tp1 = t->GetParticle1();
+		b3Particle* tp2 = t->GetParticle2();
+		b3Particle* tp3 = t->GetParticle3();
+		b3Particle* tp4 = t->GetParticle4();
+
+		bool hasP2 = tp1 == p2 || tp2 == p2 || tp3 == p2 || tp4 == p2;
+		bool hasP3 = tp1 == p3 || tp2 == p3 || tp3 == p3 || tp4 == p3;
+		bool hasP4 = tp1 == p4 || tp2 == p4 || tp3 == p4 || tp4 == p4;
+
+		if (hasP2 && hasP3 && hasP4)
+		{
+			return t;
+		}
+	}
+
+	return nullptr;
+}
 
 b3Body::b3Body()
 {
@@ -48,15 +132,55 @@ b3Body::b3Body()
 	m_fixtureList = nullptr;
 	m_fixtureCount = 0;
 
+	m_solverAllocator = &m_stackAllocator;
+
 	m_contactManager.m_body = this;
 	m_contactManager.m_allocator = &m_blockAllocator;
 	
 	m_gravity.SetZero();
+
+	m_topologyChanged = false;
+
+	m_colorForces = nullptr;
+	m_colorOffsets = nullptr;
+	m_colorCount = 0;
+
+	m_preconditioner.type = e_jacobiPreconditioner;
+	m_preconditionerInterval = 1;
+	m_preconditionerAge = 1;
+
+	m_warmStarting = false;
+	m_adaptiveSubTolerance = false;
+	m_lineSearch = false;
+	m_matrixFree = false;
+	m_direct = false;
+	m_particleOrdering = e_creationOrdering;
+	m_symmetricStorage = false;
+	m_mixedPrecision = false;
+	m_refinementIterations = 0;
+
+	memset(&m_profile, 0, sizeof(b3Profile));
+	memset(&m_stats, 0, sizeof(b3SolverStats));
+	memset(&m_stepAllocCounters, 0, sizeof(b3AllocCounters));
+	m_stepStackParentCount = 0;
 }
 
 b3Body::~b3Body()
 {
-	// None of the objects use b3Alloc.
+	// The block allocator frees the particles, fixtures and contacts.
+	// Forces larger than the block size use b3Alloc, so destroy the forces.
+	b3Force* f = m_forceList;
+	while (f)
+	{
+		b3Force* next = f->m_next;
+		b3Force::Destroy(f, &m_blockAllocator);
+		f = next;
+	}
+
+	// The particle storage, the pattern, the workspace, the thread pool,
+	// the preconditioner and the direct solver free their own memory.
+	b3Free(m_colorForces);
+	b3Free(m_colorOffsets);
 }
 
 b3Particle* b3Body::CreateParticle(const b3ParticleDef& def)
@@ -74,9 +198,21 @@ b3Particle* b3Body::CreateParticle(const b3ParticleDef& def)
 	m_particleList = p;
 	++m_particleCount;
 
+	m_topologyChanged = true;
+
 	return p;
 }
 
+void b3Body::CreateParticles(b3Particle** particles, const b3ParticleDef* defs, uint32 count)
+{
+	m_particleStorage.Reserve(m_particleStorage.count + count);
+
+	for (uint32 i = 0; i < count; ++i)
+	{
+		particles[i] = CreateParticle(defs[i]);
+	}
+}
+
 void b3Body::DestroyParticle(b3Particle* p)
 {
 	// Delete the attached objects.
@@ -102,6 +238,11 @@ void b3Body::DestroyParticle(b3Particle* p)
 
 	--m_particleCount;
 
+	// Move the last particle state into the state of this particle.
+	m_particleStorage.Remove(p->m_solverId);
+
+	m_topologyChanged = true;
+
 	p->~b3Particle();
 	m_blockAllocator.Free(p, sizeof(b3Particle));
 }
@@ -120,12 +261,40 @@ b3Force* b3Body::CreateForce(const b3ForceDef& def)
 	}
 	m_forceList = f;
 	++m_forceCount;
+
+	// Add to the particle lists.
+	b3Particle* ps[b3_maxForceParticles];
+	uint32 count = f->GetParticles(ps);
+	for (uint32 i = 0; i < count; ++i)
+	{
+		b3ForceEdge* edge = f->m_edges + i;
+		edge->force = f;
+		b3PushEdge(ps[i]->m_forceList, edge);
+	}
 	
+	m_topologyChanged = true;
+
 	return f;
 }
 
+void b3Body::CreateForces(b3Force** forces, const b3ForceDef* const* defs, uint32 count)
+{
+	for (uint32 i = 0; i < count; ++i)
+	{
+		forces[i] = CreateForce(*defs[i]);
+	}
+}
+
 void b3Body::DestroyForce(b3Force* f)
 {
+	// Remove from the particle lists.
+	b3Particle* ps[b3_maxForceParticles];
+	uint32 count = f->GetParticles(ps);
+	for (uint32 i = 0; i < count; ++i)
+	{
+		b3RemoveEdge(ps[i]->m_forceList, f->m_edges + i);
+	}
+
 	// Remove from body list.
 	if (f->m_prev)
 	{
@@ -144,6 +313,8 @@ void b3Body::DestroyForce(b3Force* f)
 
 	--m_forceCount;
 
+	m_topologyChanged = true;
+
 	// Call the factory
 	b3Force::Destroy(f, &m_blockAllocator);
 }
@@ -151,14 +322,24 @@ void b3Body::DestroyForce(b3Force* f)
 b3SphereFixture* b3Body::CreateSphere(const b3SphereFixtureDef& def)
 {
 	// Check if the fixture exists.
-	for (b3SphereFixture* s = m_sphereList; s; s = s->m_next)
+	if (def.p->m_sphere)
 	{
-		if (s->m_p == def.p)
-		{
-			return s;
-		}
+		return def.p->m_sphere;
 	}
 	
+	return InsertSphere(def);
+}
+
+void b3Body::CreateSpheres(b3SphereFixture** spheres, const b3SphereFixtureDef* defs, uint32 count)
+{
+	for (uint32 i = 0; i < count; ++i)
+	{
+		spheres[i] = CreateSphere(defs[i]);
+	}
+}
+
+b3SphereFixture* b3Body::InsertSphere(const b3SphereFixtureDef& def)
+{
 	void* mem = m_blockAllocator.Allocate(sizeof(b3SphereFixture));
 	b3SphereFixture* s = new (mem)b3SphereFixture(def, this);
 	
@@ -172,6 +353,12 @@ b3SphereFixture* b3Body::CreateSphere(const b3SphereFixtureDef& def)
 	m_sphereList = s;
 	++m_sphereCount;
 
+	// Attach to the particle.
+	def.p->m_sphere = s;
+
+	// Find the contacts of the sphere in the next step.
+	m_contactManager.AddSphere(s);
+
 	return s;
 }
 
@@ -180,6 +367,11 @@ void b3Body::DestroySphere(b3SphereFixture* s)
 	// Destroy attached objects.
 	s->DestroyContacts();
 
+	m_contactManager.RemoveSphere(s);
+
+	// Detach from the particle.
+	s->m_p->m_sphere = nullptr;
+
 	// Remove from body list.
 	if (s->m_prev)
 	{
@@ -205,19 +397,43 @@ void b3Body::DestroySphere(b3SphereFixture* s)
 b3TriangleFixture* b3Body::CreateTriangle(const b3TriangleFixtureDef& def)
 {
 	// Check if the fixture exists.
-	b3Particle * p1 = def.p1, * p2 = def.p2, * p3 = def.p3;
-	for (b3TriangleFixture* t = m_triangleList; t; t = t->m_next)
+	b3TriangleFixture* t = b3FindTriangle(def.p1, def.p2, def.p3);
+	if (t)
+	{
+		return t;
+	}
+	
+	t = InsertTriangle(def);
+
+	// Reset the mass of the particles.
+	t->m_p1->ResetMass();
+	t->m_p2->ResetMass();
+	t->m_p3->ResetMass();
+
+	return t;
+}
+
+void b3Body::CreateTriangles(b3TriangleFixture** triangles, const b3TriangleFixtureDef* defs, uint32 count)
+{
+	for (uint32 i = 0; i < count; ++i)
 	{
-		bool hasP1 = t->m_p1 == p1 || t->m_p2 == p1 || t->m_p3 == p1;
-		bool hasP2 = t->m_p1 == p2 || t->m_p2 == p2 || t->m_p3 == p2;
-		bool hasP3 = t->m_p1 == p3 || t->m_p2 == p3 || t->m_p3 == p3;
+		const b3TriangleFixtureDef& def = defs[i];
 
-		if (hasP1 && hasP2 && hasP3)
+		b3TriangleFixture* t = b3FindTriangle(def.p1, def.p2, def.p3);
+		if (t == nullptr)
 		{
-			return t;
+			t = InsertTriangle(def);
 		}
+
+		triangles[i] = t;
 	}
-	
+
+	// Reset the body mass
+	ResetMass();
+}
+
+b3TriangleFixture* b3Body::InsertTriangle(const b3TriangleFixtureDef& def)
+{
 	void* mem = m_blockAllocator.Allocate(sizeof(b3TriangleFixture));
 	b3TriangleFixture* t = new (mem)b3TriangleFixture(def, this);
 
@@ -235,8 +451,14 @@ b3TriangleFixture* b3Body::CreateTriangle(const b3TriangleFixtureDef& def)
 	m_triangleList = t;
 	++m_triangleCount;
 
-	// Reset the body mass
-	ResetMass();
+	// Add to the particle lists.
+	b3Particle* ps[3] = { t->m_p1, t->m_p2, t->m_p3 };
+	for (uint32 i = 0; i < 3; ++i)
+	{
+		b3FixtureEdge* edge = t->m_edges + i;
+		edge->fixture = t;
+		b3PushEdge(ps[i]->m_triangleList, edge);
+	}
 
 	return t;
 }
@@ -246,6 +468,13 @@ void b3Body::DestroyTriangle(b3TriangleFixture* t)
 	// Destroy tree proxy.
 	m_tree.DestroyProxy(t->m_proxyId);
 
+	// Remove from the particle lists.
+	b3Particle* ps[3] = { t->m_p1, t->m_p2, t->m_p3 };
+	for (uint32 i = 0; i < 3; ++i)
+	{
+		b3RemoveEdge(ps[i]->m_triangleList, t->m_edges + i);
+	}
+
 	// Remove from body list.
 	if (t->m_prev)
 	{
@@ -267,27 +496,54 @@ void b3Body::DestroyTriangle(b3TriangleFixture* t)
 	t->~b3TriangleFixture();
 	m_blockAllocator.Free(t, sizeof(b3TriangleFixture));
 
-	// Reset the body mass
-	ResetMass();
+	// Reset the mass of the particles.
+	for (uint32 i = 0; i < 3; ++i)
+	{
+		ps[i]->ResetMass();
+	}
 }
 
 b3TetrahedronFixture* b3Body::CreateTetrahedron(const b3TetrahedronFixtureDef& def)
 {
 	// Check if the fixture exists.
-	b3Particle * p1 = def.p1, * p2 = def.p2, * p3 = def.p3, * p4 = def.p4;
-	for (b3TetrahedronFixture* t = m_tetrahedronList; t; t = t->m_next)
+	b3TetrahedronFixture* t = b3FindTetrahedron(def.p1, def.p2, def.p3, def.p4);
+	if (t)
+	{
+		return t;
+	}
+
+	t = InsertTetrahedron(def);
+
+	// Reset the mass of the particles.
+	t->m_p1->ResetMass();
+	t->m_p2->ResetMass();
+	t->m_p3->ResetMass();
+	t->m_p4->ResetMass();
+
+	return t;
+}
+
+void b3Body::CreateTetrahedrons(b3TetrahedronFixture** tetrahedrons, const b3TetrahedronFixtureDef* defs, uint32 count)
+{
+	for (uint32 i = 0; i < count; ++i)
 	{
-		bool hasP1 = t->m_p1 == p1 || t->m_p2 == p1 || t->m_p3 == p1 || t->m_p4 == p1;
-		bool hasP2 = t->m_p1 == p2 || t->m_p2 == p2 || t->m_p3 == p2 || t->m_p4 == p2;
-		bool hasP3 = t->m_p1 == p3 || t->m_p2 == p3 || t->m_p3 == p3 || t->m_p4 == p3;
-		bool hasP4 = t->m_p1 == p4 || t->m_p2 == p4 || t->m_p3 == p4 || t->m_p4 == p4;
+		const b3TetrahedronFixtureDef& def = defs[i];
 
-		if (hasP1 && hasP2 && hasP3 && hasP4)
+		b3TetrahedronFixture* t = b3FindTetrahedron(def.p1, def.p2, def.p3, def.p4);
+		if (t == nullptr)
 		{
-			return t;
+			t = InsertTetrahedron(def);
 		}
+
+		tetrahedrons[i] = t;
 	}
 
+	// Reset the body mass.
+	ResetMass();
+}
+
+b3TetrahedronFixture* b3Body::InsertTetrahedron(const b3TetrahedronFixtureDef& def)
+{
 	void* mem = m_blockAllocator.Allocate(sizeof(b3TetrahedronFixture));
 	b3TetrahedronFixture* t = new (mem)b3TetrahedronFixture(def, this);
 
@@ -301,14 +557,27 @@ b3TetrahedronFixture* b3Body::CreateTetrahedron(const b3TetrahedronFixtureDef& d
 	m_tetrahedronList = t;
 	++m_tetrahedronCount;
 
-	// Reset the body mass.
-	ResetMass();
+	// Add to the particle lists.
+	b3Particle* ps[4] = { t->m_p1, t->m_p2, t->m_p3, t->m_p4 };
+	for (uint32 i = 0; i < 4; ++i)
+	{
+		b3FixtureEdge* edge = t->m_edges + i;
+		edge->fixture = t;
+		b3PushEdge(ps[i]->m_tetrahedronList, edge);
+	}
 
 	return t;
 }
 
 void b3Body::DestroyTetrahedron(b3TetrahedronFixture* t)
 {
+	// Remove from the particle lists.
+	b3Particle* ps[4] = { t->m_p1, t->m_p2, t->m_p3, t->m_p4 };
+	for (uint32 i = 0; i < 4; ++i)
+	{
+		b3RemoveEdge(ps[i]->m_tetrahedronList, t->m_edges + i);
+	}
+
 	// Remove from body list.
 	if (t->m_prev)
 	{
@@ -330,8 +599,11 @@ void b3Body::DestroyTetrahedron(b3TetrahedronFixture* t)
 	t->~b3TetrahedronFixture();
 	m_blockAllocator.Free(t, sizeof(b3TetrahedronFixture));
 
-	// Reset the body mass
-	ResetMass();
+	// Reset the mass of the particles.
+	for (uint32 i = 0; i < 4; ++i)
+	{
+		ps[i]->ResetMass();
+	}
 }
 
 b3WorldFixture* b3Body::CreateFixture(const b3WorldFixtureDef& def)
@@ -350,6 +622,9 @@ b3WorldFixture* b3Body::CreateFixture(const b3WorldFixtureDef& def)
 	m_fixtureList = f;
 	++m_fixtureCount;
 
+	// Add to the contact manager tree.
+	m_contactManager.AddFixture(f);
+
 	return f;
 }
 
@@ -358,6 +633,9 @@ void b3Body::DestroyFixture(b3WorldFixture* f)
 	// Destroy attached contacts.
 	f->DestroyContacts();
 
+	// Remove from the contact manager tree.
+	m_contactManager.RemoveFixture(f);
+
 	// Remove from the body list.
 	if (f->m_prev)
 	{
@@ -383,31 +661,37 @@ void b3Body::DestroyFixture(b3WorldFixture* f)
 
 scalar b3Body::GetEnergy() const
 {
+	const scalar* masses = m_particleStorage.masses;
+	const b3Vec3* velocities = m_particleStorage.velocities;
+
 	scalar E = scalar(0);
-	for (b3Particle* p = m_particleList; p; p = p->m_next)
+	for (uint32 i = 0; i < m_particleStorage.count; ++i)
 	{
-		E += p->m_mass * b3Dot(p->m_velocity, p->m_velocity);
+		E += masses[i] * b3Dot(velocities[i], velocities[i]);
 	}
 	return scalar(0.5) * E;
 }
 
 void b3Body::ResetMass()
 {
+	scalar* masses = m_particleStorage.masses;
+	scalar* invMasses = m_particleStorage.invMasses;
+
 	// Clear masses. 
 	// Only touch fixture masses because there can be external particles.
 	for (b3TriangleFixture* t = m_triangleList; t; t = t->m_next)
 	{
-		t->m_p1->m_mass = scalar(0);
-		t->m_p2->m_mass = scalar(0);
-		t->m_p3->m_mass = scalar(0);
+		masses[t->m_p1->m_solverId] = scalar(0);
+		masses[t->m_p2->m_solverId] = scalar(0);
+		masses[t->m_p3->m_solverId] = scalar(0);
 	}
 
 	for (b3TetrahedronFixture* t = m_tetrahedronList; t; t = t->m_next)
 	{
-		t->m_p1->m_mass = scalar(0);
-		t->m_p2->m_mass = scalar(0);
-		t->m_p3->m_mass = scalar(0);
-		t->m_p4->m_mass = scalar(0);
+		masses[t->m_p1->m_solverId] = scalar(0);
+		masses[t->m_p2->m_solverId] = scalar(0);
+		masses[t->m_p3->m_solverId] = scalar(0);
+		masses[t->m_p4->m_solverId] = scalar(0);
 	}
 
 	// Accumulate contribution of each fixture.
@@ -420,9 +704,9 @@ void b3Body::ResetMass()
 
 		scalar mass = t->m_density * t->m_area;
 
-		p1->m_mass += inv3 * mass;
-		p2->m_mass += inv3 * mass;
-		p3->m_mass += inv3 * mass;
+		masses[p1->m_solverId] += inv3 * mass;
+		masses[p2->m_solverId] += inv3 * mass;
+		masses[p3->m_solverId] += inv3 * mass;
 	}
 
 	const scalar inv4 = scalar(1) / scalar(4);
@@ -435,32 +719,34 @@ void b3Body::ResetMass()
 
 		scalar mass = t->m_density * t->m_volume;
 
-		p1->m_mass += inv4 * mass;
-		p2->m_mass += inv4 * mass;
-		p3->m_mass += inv4 * mass;
-		p4->m_mass += inv4 * mass;
+		masses[p1->m_solverId] += inv4 * mass;
+		masses[p2->m_solverId] += inv4 * mass;
+		masses[p3->m_solverId] += inv4 * mass;
+		masses[p4->m_solverId] += inv4 * mass;
 	}
 
 	// Invert
-	for (b3Particle* p = m_particleList; p; p = p->m_next)
+	for (uint32 i = 0; i < m_particleStorage.count; ++i)
 	{
+		b3Particle* p = m_particleStorage.particles[i];
+
 		// Static and kinematic particles have zero mass.
 		if (p->m_type == e_staticParticle || p->m_type == e_kinematicParticle)
 		{
-			p->m_mass = scalar(0);
-			p->m_invMass = scalar(0);
+			masses[i] = scalar(0);
+			invMasses[i] = scalar(0);
 			continue;
 		}
 
-		if (p->m_mass > scalar(0))
+		if (masses[i] > scalar(0))
 		{
-			p->m_invMass = scalar(1) / p->m_mass;
+			invMasses[i] = scalar(1) / masses[i];
 		}
 		else
 		{
 			// Force all dynamic particles to have non-zero mass.
-			p->m_mass = scalar(1);
-			p->m_invMass = scalar(1);
+			masses[i] = scalar(1);
+			invMasses[i] = scalar(1);
 		}
 	}
 }
@@ -520,24 +806,326 @@ bool b3Body::RayCastSingle(b3BodyRayCastSingleOutput* output, const b3Vec3& p1,
 	return false;
 }
 
+void b3Body::SetPattern(b3SparseMat33* pattern, bool upper)
+{
+	// The solver ids are the indices of the particles in the storage.
+	B3_ASSERT(m_particleStorage.count == m_particleCount);
+
+	// Particles and contacts only contribute to the diagonal blocks.
+	uint32 indexCount = m_particleCount;
+	for (b3Force* f = m_forceList; f; f = f->m_next)
+	{
+		b3Particle* ps[b3_maxForceParticles];
+		uint32 count = f->GetParticles(ps);
+		indexCount += count * count;
+	}
+
+	b3BlockIndex* indices = (b3BlockIndex*)m_solverAllocator->Allocate(indexCount * sizeof(b3BlockIndex));
+
+	uint32 index = 0;
+	for (b3Particle* p = m_particleList; p; p = p->m_next)
+	{
+		indices[index].row = p->m_solverId;
+		indices[index].column = p->m_solverId;
+		++index;
+	}
+
+	for (b3Force* f = m_forceList; f; f = f->m_next)
+	{
+		b3Particle* ps[b3_maxForceParticles];
+		uint32 count = f->GetParticles(ps);
+
+		for (uint32 i = 0; i < count; ++i)
+		{
+			for (uint32 j = 0; j < count; ++j)
+			{
+				uint32 row = ps[i]->m_solverId;
+				uint32 column = ps[j]->m_solverId;
+				if (upper && row > column)
+				{
+					continue;
+				}
+
+				indices[index].row = row;
+				indices[index].column = column;
+				++index;
+			}
+		}
+	}
+
+	pattern->Resize(m_particleCount);
+	pattern->SetStructure(indices, index);
+
+	m_solverAllocator->Free(indices);
+}
+
+void b3Body::UpdatePattern()
+{
+	SetPattern(&m_pattern, m_symmetricStorage);
+
+	// Map the blocks of each force to fixed slots in the structure.
+	for (b3Force* f = m_forceList; f; f = f->m_next)
+	{
+		b3Particle* ps[b3_maxForceParticles];
+		uint32 count = f->GetParticles(ps);
+
+		for (uint32 i = 0; i < count; ++i)
+		{
+			for (uint32 j = 0; j < count; ++j)
+			{
+				uint32 row = ps[i]->m_solverId;
+				uint32 column = ps[j]->m_solverId;
+				if (m_symmetricStorage && row > column)
+				{
+					f->m_slots[i * count + j] = B3_MAX_U32;
+					continue;
+				}
+
+				uint32 slot = m_pattern.SearchIndex(row, column);
+				B3_ASSERT(slot != B3_MAX_U32);
+				f->m_slots[i * count + j] = slot;
+			}
+		}
+	}
+}
+
+void b3Body::ColorForces()
+{
+	b3Free(m_colorForces);
+	b3Free(m_colorOffsets);
+
+	m_colorForces = (b3Force**)b3Alloc(m_forceCount * sizeof(b3Force*));
+
+	b3Force** forces = (b3Force**)m_solverAllocator->Allocate(m_forceCount * sizeof(b3Force*));
+	uint32* colors = (uint32*)m_solverAllocator->Allocate(m_forceCount * sizeof(uint32));
+	uint32* uncolored = (uint32*)m_solverAllocator->Allocate(m_forceCount * sizeof(uint32));
+	uint64* particleColors = (uint64*)m_solverAllocator->Allocate(m_particleCount * sizeof(uint64));
+
+	uint32 forceCount = 0;
+	for (b3Force* f = m_forceList; f; f = f->m_next)
+	{
+		uncolored[forceCount] = forceCount;
+		forces[forceCount] = f;
+		++forceCount;
+	}
+
+	// Greedy coloring in passes of 64 colors.
+	// A particle keeps a bit for each color of the current pass used by its forces.
+	// Forces that can't be colored in a pass are deferred to the next pass.
+	uint32 colorCount = 0;
+	uint32 uncoloredCount = forceCount;
+	while (uncoloredCount > 0)
+	{
+		for (uint32 i = 0; i < m_particleCount; ++i)
+		{
+			particleColors[i] = 0;
+		}
+
+		uint32 passColorCount = 0;
+		uint32 deferredCount = 0;
+		for (uint32 i = 0; i < uncoloredCount; ++i)
+		{
+			uint32 index = uncolored[i];
+			b3Force* f = forces[index];
+
+			b3Particle* ps[b3_maxForceParticles];
+			uint32 count = f->GetParticles(ps);
+
+			uint64 usedColors = 0;
+			for (uint32 j = 0; j < count; ++j)
+			{
+				usedColors |= particleColors[ps[j]->m_solverId];
+			}
+
+			if (usedColors == ~uint64(0))
+			{
+				uncolored[deferredCount++] = index;
+				continue;
+			}
+
+			uint32 color = 0;
+			while (usedColors & (uint64(1) << color))
+			{
+				++color;
+			}
+
+			for (uint32 j = 0; j < count; ++j)
+			{
+				particleColors[ps[j]->m_solverId] |= uint64(1) << color;
+			}
+
+			colors[index] = colorCount + color;
+
+			passColorCount = b3Max(passColorCount, color + 1);
+		}
+
+		colorCount += passColorCount;
+		uncoloredCount = deferredCount;
+	}
+
+	// With a particle ordering the forces of a color are also sorted 
+	// by their first particle, so they access the particle state in order.
+	// This is a stable counting sort.
+	uint32* sorted = uncolored;
+	if (m_particleOrdering == e_creationOrdering)
+	{
+		for (uint32 i = 0; i < forceCount; ++i)
+		{
+			sorted[i] = i;
+		}
+	}
+	else
+	{
+		uint32* keys = (uint32*)m_solverAllocator->Allocate(forceCount * sizeof(uint32));
+		uint32* offsets = (uint32*)m_solverAllocator->Allocate((m_particleCount + 1) * sizeof(uint32));
+		for (uint32 i = 0; i < m_particleCount + 1; ++i)
+		{
+			offsets[i] = 0;
+		}
+
+		for (uint32 i = 0; i < forceCount; ++i)
+		{
+			b3Particle* ps[b3_maxForceParticles];
+			uint32 count = forces[i]->GetParticles(ps);
+
+			uint32 key = B3_MAX_U32;
+			for (uint32 j = 0; j < count; ++j)
+			{
+				key = b3Min(key, ps[j]->m_solverId);
+			}
+			keys[i] = key;
+
+			++offsets[key + 1];
+		}
+
+		for (uint32 i = 0; i < m_particleCount; ++i)
+		{
+			offsets[i + 1] += offsets[i];
+		}
+
+		for (uint32 i = 0; i < forceCount; ++i)
+		{
+			sorted[offsets[keys[i]]++] = i;
+		}
+
+		m_solverAllocator->Free(offsets);
+		m_solverAllocator->Free(keys);
+	}
+
+	// Sort the forces by color preserving the list order.
+	m_colorCount = colorCount;
+	m_colorOffsets = (uint32*)b3Alloc((m_colorCount + 1) * sizeof(uint32));
+	for (uint32 i = 0; i < m_colorCount + 1; ++i)
+	{
+		m_colorOffsets[i] = 0;
+	}
+
+	for (uint32 i = 0; i < forceCount; ++i)
+	{
+		++m_colorOffsets[colors[i] + 1];
+	}
+
+	for (uint32 i = 0; i < m_colorCount; ++i)
+	{
+		m_colorOffsets[i + 1] += m_colorOffsets[i];
+	}
+
+	for (uint32 k = 0; k < forceCount; ++k)
+	{
+		uint32 i = sorted[k];
+		m_colorForces[m_colorOffsets[colors[i]]++] = forces[i];
+	}
+
+	// The offsets now point to the end of each color. Shift them back.
+	for (uint32 i = m_colorCount; i > 0; --i)
+	{
+		m_colorOffsets[i] = m_colorOffsets[i - 1];
+	}
+	m_colorOffsets[0] = 0;
+
+	m_solverAllocator->Free(particleColors);
+	m_solverAllocator->Free(uncolored);
+	m_solverAllocator->Free(colors);
+	m_solverAllocator->Free(forces);
+}
+
+void b3Body::OrderParticles()
+{
+	uint32* order = (uint32*)m_solverAllocator->Allocate(m_particleCount * sizeof(uint32));
+
+	if (m_particleOrdering == e_cuthillMcKeeOrdering)
+	{
+		// The force graph is the full block structure of the Jacobians.
+		b3SparseMat33 graph;
+		SetPattern(&graph, false);
+		b3ComputeCuthillMcKeeOrdering(order, graph, m_solverAllocator);
+	}
+	else
+	{
+		B3_ASSERT(m_particleOrdering == e_mortonOrdering);
+		b3ComputeMortonOrdering(order, m_particleStorage.positions, m_particleCount, m_solverAllocator);
+	}
+
+	m_particleStorage.Permute(order, m_solverAllocator);
+
+	m_solverAllocator->Free(order);
+}
+
 void b3Body::Solve(const b3TimeStep& step)
 {
+	if (m_topologyChanged)
+	{
+		if (m_particleOrdering != e_creationOrdering)
+		{
+			OrderParticles();
+		}
+
+		UpdatePattern();
+		ColorForces();
+		m_topologyChanged = false;
+
+		// Recompute the preconditioner for the new structure.
+		m_preconditionerAge = m_preconditionerInterval;
+
+		// Recompute the symbolic factorization for the new structure.
+		m_directSolver.Reset();
+
+		// The accelerations of the old structure are poor predictions.
+		for (uint32 i = 0; i < m_particleStorage.count; ++i)
+		{
+			m_particleStorage.accelerations[i].SetZero();
+		}
+	}
+
+	bool updatePreconditioner = m_preconditionerAge >= m_preconditionerInterval;
+	if (updatePreconditioner)
+	{
+		m_preconditionerAge = 0;
+	}
+	++m_preconditionerAge;
+
 	b3BodySolverDef solverDef;
-	solverDef.allocator = &m_stackAllocator;
-	solverDef.particleCapacity = m_particleCount;
+	solverDef.allocator = m_solverAllocator;
+	solverDef.workspace = &m_workspace;
+	solverDef.profile = &m_profile;
+	solverDef.stats = &m_stats;
+	solverDef.pattern = &m_pattern;
+	solverDef.threadPool = &m_threadPool;
+	solverDef.colorCount = m_colorCount;
+	solverDef.colorOffsets = m_colorOffsets;
+	solverDef.preconditioner = &m_preconditioner;
+	solverDef.updatePreconditioner = updatePreconditioner;
+	solverDef.directSolver = m_direct ? &m_directSolver : nullptr;
+	solverDef.particles = &m_particleStorage;
 	solverDef.forceCapacity = m_forceCount;
 	solverDef.contactCapacity = m_contactManager.m_contactCount;
 	
 	b3BodySolver solver(solverDef);
 
-	for (b3Particle* p = m_particleList; p; p = p->m_next)
-	{
-		solver.Add(p);
-	}
-
-	for (b3Force* f = m_forceList; f; f = f->m_next)
+	// Forces are solved in color order.
+	for (uint32 i = 0; i < m_forceCount; ++i)
 	{
-		solver.Add(f);
+		solver.Add(m_colorForces[i]);
 	}
 
 	for (b3SphereAndShapeContact* c = m_contactManager.m_contactList; c; c = c->m_next)
@@ -556,30 +1144,63 @@ void b3Body::Step(scalar dt, uint32 forceIterations, uint32 forceSubIterations)
 	step.dt = dt;
 	step.forceIterations = forceIterations;
 	step.forceSubIterations = forceSubIterations;
+	step.warmStarting = m_warmStarting;
+	step.adaptiveSubTolerance = m_adaptiveSubTolerance;
+	step.lineSearch = m_lineSearch;
+	step.matrixFree = m_matrixFree;
+	step.symmetricStorage = m_symmetricStorage;
+	step.mixedPrecision = m_mixedPrecision;
+	step.refinementIterations = m_refinementIterations;
 	step.inv_dt = dt > scalar(0) ? scalar(1) / dt : scalar(0);
 	
+	memset(&m_profile, 0, sizeof(b3Profile));
+	memset(&m_stats, 0, sizeof(b3SolverStats));
+
+	b3AllocCounters allocCounters = b3GetAllocCounters();
+	uint32 stackParentCount = m_solverAllocator->GetParentAllocationCount();
+
+	b3Timer stepTimer;
+
 	// Update contacts. This is where some contacts are ceased.
-	m_contactManager.UpdateContacts();
+	{
+		b3Timer timer;
+		m_contactManager.UpdateContacts();
+		m_profile.updateContacts = timer.GetMilliseconds();
+	}
 
 	// Clear internal forces before accumulating them inside the solver.
-	for (b3Force* f = m_forceList; f; f = f->m_next)
 	{
-		f->ClearForces();
+		b3Timer timer;
+		for (b3Force* f = m_forceList; f; f = f->m_next)
+		{
+			f->ClearForces();
+		}
+		m_profile.clearForces = timer.GetMilliseconds();
 	}
 
 	// Integrate state, solve constraints. 
 	if (step.dt > scalar(0))
 	{
+		b3Timer timer;
 		Solve(step);
+		m_profile.solve = timer.GetMilliseconds();
+
+		m_statsHistory.Add(m_stats);
 	}
 
 	// Clear external forces and translations.
-	for (b3Particle* p = m_particleList; p; p = p->m_next)
 	{
-		p->m_force.SetZero();
-		p->m_translation.SetZero();
+		b3Timer timer;
+		for (uint32 i = 0; i < m_particleStorage.count; ++i)
+		{
+			m_particleStorage.forces[i].SetZero();
+			m_particleStorage.translations[i].SetZero();
+		}
+		m_profile.clearForces += timer.GetMilliseconds();
 	}
 
+	b3Timer timer;
+
 	// Synchronize triangles.
 	for (b3TriangleFixture* t = m_triangleList; t; t = t->m_next)
 	{
@@ -587,9 +1208,9 @@ void b3Body::Step(scalar dt, uint32 forceIterations, uint32 forceSubIterations)
 		b3Particle* p2 = t->m_p2;
 		b3Particle* p3 = t->m_p3;
 
-		b3Vec3 v1 = p1->m_velocity;
-		b3Vec3 v2 = p2->m_velocity;
-		b3Vec3 v3 = p3->m_velocity;
+		b3Vec3 v1 = p1->GetVelocity();
+		b3Vec3 v2 = p2->GetVelocity();
+		b3Vec3 v3 = p3->GetVelocity();
 
 		// Center velocity
 		b3Vec3 velocity = (v1 + v2 + v3) / scalar(3);
@@ -599,8 +1220,58 @@ void b3Body::Step(scalar dt, uint32 forceIterations, uint32 forceSubIterations)
 		t->Synchronize(displacement);
 	}
 
+	// Synchronize spheres.
+	m_contactManager.SynchronizeSpheres();
+
+	m_profile.synchronize = timer.GetMilliseconds();
+	timer.Reset();
+
 	// Find new contacts
 	m_contactManager.FindNewContacts();
+
+	m_profile.findContacts = timer.GetMilliseconds();
+	m_profile.step = stepTimer.GetMilliseconds();
+
+	const b3AllocCounters& counters = b3GetAllocCounters();
+	m_stepAllocCounters.allocCalls = counters.allocCalls - allocCounters.allocCalls;
+	m_stepAllocCounters.freeCalls = counters.freeCalls - allocCounters.freeCalls;
+	m_stepAllocCounters.allocBytes = counters.allocBytes - allocCounters.allocBytes;
+	m_stepStackParentCount = m_solverAllocator->GetParentAllocationCount() - stackParentCount;
+}
+
+void b3Body::GetMemoryStats(b3MemoryStats* stats) const
+{
+	m_blockAllocator.GetStats(&stats->blockAllocator);
+
+	stats->stackCapacity = m_solverAllocator->GetCapacity();
+	stats->stackMaxAllocation = m_solverAllocator->GetMaxAllocation();
+	stats->stackParentAllocations = m_solverAllocator->GetParentAllocationCount();
+
+	stats->particleBytes = m_particleStorage.GetByteCount();
+
+	stats->patternBytes = m_pattern.GetByteCount();
+	if (m_colorOffsets)
+	{
+		stats->patternBytes += m_forceCount * sizeof(b3Force*) + (m_colorCount + 1) * sizeof(uint32);
+	}
+
+	stats->workspaceBytes = m_workspace.GetByteCount();
+
+	stats->factorBytes = m_directSolver.GetByteCount();
+
+	stats->preconditionerBytes = m_preconditioner.GetByteCount();
+
+	stats->contactBytes = m_contactManager.GetByteCount();
+
+	stats->totalBytes = stats->blockAllocator.chunkBytes + stats->blockAllocator.largeBytes;
+	stats->totalBytes += stats->stackCapacity;
+	stats->totalBytes += stats->particleBytes + stats->patternBytes + stats->workspaceBytes;
+	stats->totalBytes += stats->factorBytes + stats->preconditionerBytes + stats->contactBytes;
+
+	stats->stepAllocCalls = uint32(m_stepAllocCounters.allocCalls);
+	stats->stepFreeCalls = uint32(m_stepAllocCounters.freeCalls);
+	stats->stepAllocBytes = uint32(m_stepAllocCounters.allocBytes);
+	stats->stepStackParentAllocations = m_stepStackParentCount;
 }
 
 void b3Body::DebugDraw(b3Draw* draw) const
@@ -609,17 +1280,17 @@ void b3Body::DebugDraw(b3Draw* draw) const
 	{
 		if (p->m_type == e_staticParticle)
 		{
-			draw->DrawPoint(p->m_position, 4.0, b3Color_white);	
+			draw->DrawPoint(p->GetPosition(), 4.0, b3Color_white);	
 		}
 
 		if (p->m_type == e_kinematicParticle)
 		{
-			draw->DrawPoint(p->m_position, 4.0, b3Color_blue);
+			draw->DrawPoint(p->GetPosition(), 4.0, b3Color_blue);
 		}
 
 		if (p->m_type == e_dynamicParticle)
 		{
-			draw->DrawPoint(p->m_position, 4.0, b3Color_green);
+			draw->DrawPoint(p->GetPosition(), 4.0, b3Color_green);
 		}
 	}
 
@@ -629,9 +1300,9 @@ void b3Body::DebugDraw(b3Draw* draw) const
 		b3Particle* p2 = t->m_p2;
 		b3Particle* p3 = t->m_p3;
 
-		b3Vec3 v1 = p1->m_position;
-		b3Vec3 v2 = p2->m_position;
-		b3Vec3 v3 = p3->m_position;
+		b3Vec3 v1 = p1->GetPosition();
+		b3Vec3 v2 = p2->GetPosition();
+		b3Vec3 v3 = p3->GetPosition();
 
 		b3Vec3 c = (v1 + v2 + v3) / scalar(3);
 
@@ -696,10 +1367,10 @@ void b3Body::DebugDraw(b3Draw* draw) const
 		b3Particle* p3 = t->m_p3;
 		b3Particle* p4 = t->m_p4;
 
-		b3Vec3 v1 = p1->m_position;
-		b3Vec3 v2 = p2->m_position;
-		b3Vec3 v3 = p3->m_position;
-		b3Vec3 v4 = p4->m_position;
+		b3Vec3 v1 = p1->GetPosition();
+		b3Vec3 v2 = p2->GetPosition();
+		b3Vec3 v3 = p3->GetPosition();
+		b3Vec3 v4 = p4->GetPosition();
 
 		b3Vec3 c = (v1 + v2 + v3 + v4) / scalar(4);
 
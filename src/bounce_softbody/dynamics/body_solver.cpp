@@ -19,39 +19,41 @@
 #include <bounce_softbody/dynamics/body_solver.h>
 #include <bounce_softbody/dynamics/force_solver.h>
 #include <bounce_softbody/dynamics/time_step.h>
-#include <bounce_softbody/dynamics/particle.h>
 #include <bounce_softbody/dynamics/forces/force.h>
 #include <bounce_softbody/dynamics/contacts/contact.h>
 #include <bounce_softbody/common/memory/stack_allocator.h>
+#include <bounce_softbody/common/timer.h>
+#include <bounce_softbody/sparse/sparse_workspace.h>
 
 b3BodySolver::b3BodySolver(const b3BodySolverDef& def)
 {
 	m_allocator = def.allocator;
+	m_workspace = def.workspace;
+	m_profile = def.profile;
+	m_stats = def.stats;
+	m_pattern = def.pattern;
+	m_threadPool = def.threadPool;
+	m_colorCount = def.colorCount;
+	m_colorOffsets = def.colorOffsets;
+	m_preconditioner = def.preconditioner;
+	m_updatePreconditioner = def.updatePreconditioner;
+	m_directSolver = def.directSolver;
 
-	m_particleCapacity = def.particleCapacity;
-	m_particleCount = 0;
-	m_particles = (b3Particle**)m_allocator->Allocate(m_particleCapacity * sizeof(b3Particle*));
+	m_particles = def.particles;
 
 	m_forceCapacity = def.forceCapacity;
 	m_forceCount = 0;
-	m_forces = (b3Force**)m_allocator->Allocate(m_forceCapacity * sizeof(b3Force*));;
+	m_forces = (b3Force**)m_workspace->Allocate(m_forceCapacity * sizeof(b3Force*));;
 
 	m_contactCapacity = def.contactCapacity;
 	m_contactCount = 0;
-	m_contacts = (b3Contact**)m_allocator->Allocate(m_contactCapacity * sizeof(b3Contact*));
+	m_contacts = (b3Contact**)m_workspace->Allocate(m_contactCapacity * sizeof(b3Contact*));
 }
 
 b3BodySolver::~b3BodySolver()
 {
-	m_allocator->Free(m_contacts);
-	m_allocator->Free(m_forces);
-	m_allocator->Free(m_particles);
-}
-
-void b3BodySolver::Add(b3Particle* p)
-{
-	p->m_solverId = m_particleCount;
-	m_particles[m_particleCount++] = p;
+	m_workspace->Free(m_contacts);
+	m_workspace->Free(m_forces);
 }
 
 void b3BodySolver::Add(b3Force* f)
@@ -67,11 +69,22 @@ void b3BodySolver::Add(b3Contact* c)
 void b3BodySolver::Solve(const b3TimeStep& step, const b3Vec3& gravity)
 {
 	{
+		b3Timer timer;
+
 		// Solve internal dynamics.
 		b3ForceSolverDef forceSolverDef;
 		forceSolverDef.step = step;
 		forceSolverDef.allocator = m_allocator;
-		forceSolverDef.particleCount = m_particleCount;
+		forceSolverDef.workspace = m_workspace;
+		forceSolverDef.profile = m_profile;
+		forceSolverDef.stats = m_stats;
+		forceSolverDef.pattern = m_pattern;
+		forceSolverDef.threadPool = m_threadPool;
+		forceSolverDef.colorCount = m_colorCount;
+		forceSolverDef.colorOffsets = m_colorOffsets;
+		forceSolverDef.preconditioner = m_preconditioner;
+		forceSolverDef.updatePreconditioner = m_updatePreconditioner;
+		forceSolverDef.directSolver = m_directSolver;
 		forceSolverDef.particles = m_particles;
 		forceSolverDef.forceCount = m_forceCount;
 		forceSolverDef.forces = m_forces;
@@ -81,13 +94,19 @@ void b3BodySolver::Solve(const b3TimeStep& step, const b3Vec3& gravity)
 		b3ForceSolver forceSolver(forceSolverDef);
 
 		forceSolver.Solve(gravity);
+
+		m_profile->solveForces = timer.GetMilliseconds();
 	}
 
 	{
+		b3Timer timer;
+
 		// Solve friction constraints.
 		for (uint32 i = 0; i < m_contactCount; ++i)
 		{
 			m_contacts[i]->ApplyFriction(step, gravity);
 		}
+
+		m_profile->friction = timer.GetMilliseconds();
 	}
 }
\ No newline at end of file
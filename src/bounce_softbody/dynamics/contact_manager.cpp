@@ -28,20 +28,195 @@ b3ContactManager::b3ContactManager()
 {
 	m_contactList = nullptr;
 	m_contactCount = 0;
+	m_moveBuffer = nullptr;
+	m_moveCount = 0;
+	m_moveCapacity = 0;
+	m_querySphere = nullptr;
+	m_pairBuckets = nullptr;
+	m_pairBucketCount = 0;
 }
 
-void b3ContactManager::AddPair(b3SphereFixture* fixture1, b3WorldFixture* fixture2)
+b3ContactManager::~b3ContactManager()
 {
-	// Check if there is a contact between the two entities.
-	for (b3SphereAndShapeContact* c = m_contactList; c; c = c->m_next)
+	b3Free(m_moveBuffer);
+	b3Free(m_pairBuckets);
+}
+
+uint32 b3ContactManager::GetByteCount() const
+{
+	return m_moveCapacity * sizeof(b3SphereFixture*) + m_pairBucketCount * sizeof(b3SphereAndShapeContact*);
+}
+
+void b3ContactManager::AddFixture(b3WorldFixture* fixture)
+{
+	fixture->m_proxyId = m_fixtureTree.CreateProxy(fixture->ComputeAABB(), fixture);
+
+	// All spheres must be tested against the new fixture.
+	for (b3SphereFixture* s = m_body->m_sphereList; s; s = s->m_next)
+	{
+		BufferMove(s);
+	}
+}
+
+void b3ContactManager::RemoveFixture(b3WorldFixture* fixture)
+{
+	m_fixtureTree.DestroyProxy(fixture->m_proxyId);
+	fixture->m_proxyId = B3_NULL_DYNAMIC_NODE;
+}
+
+void b3ContactManager::AddSphere(b3SphereFixture* fixture)
+{
+	fixture->m_aabb = fixture->ComputeAABB();
+	fixture->m_aabb.Extend(B3_AABB_EXTENSION);
+	fixture->m_moveIndex = B3_MAX_U32;
+	
+	BufferMove(fixture);
+}
+
+void b3ContactManager::RemoveSphere(b3SphereFixture* fixture)
+{
+	if (fixture->m_moveIndex == B3_MAX_U32)
+	{
+		return;
+	}
+
+	B3_ASSERT(m_moveBuffer[fixture->m_moveIndex] == fixture);
+	m_moveBuffer[fixture->m_moveIndex] = nullptr;
+	fixture->m_moveIndex = B3_MAX_U32;
+}
+
+void b3ContactManager::TouchSphere(b3SphereFixture* fixture)
+{
+	BufferMove(fixture);
+}
+
+void b3ContactManager::BufferMove(b3SphereFixture* fixture)
+{
+	if (fixture->m_moveIndex != B3_MAX_U32)
+	{
+		// Already buffered.
+		return;
+	}
+
+	if (m_moveCount == m_moveCapacity)
+	{
+		// Duplicate capacity.
+		m_moveCapacity = m_moveCapacity > 0 ? 2 * m_moveCapacity : 64;
+
+		b3SphereFixture** oldMoveBuffer = m_moveBuffer;
+		m_moveBuffer = (b3SphereFixture**)b3Alloc(m_moveCapacity * sizeof(b3SphereFixture*));
+		if (m_moveCount > 0)
+		{
+			memcpy(m_moveBuffer, oldMoveBuffer, m_moveCount * sizeof(b3SphereFixture*));
+		}
+		b3Free(oldMoveBuffer);
+	}
+
+	fixture->m_moveIndex = m_moveCount;
+	m_moveBuffer[m_moveCount++] = fixture;
+}
+
+void b3ContactManager::SynchronizeSpheres()
+{
+	for (b3SphereFixture* s = m_body->m_sphereList; s; s = s->m_next)
+	{
+		b3AABB aabb = s->ComputeAABB();
+		if (s->m_aabb.Contains(aabb))
+		{
+			// The pairs of the sphere can't change.
+			continue;
+		}
+
+		s->m_aabb = aabb;
+		s->m_aabb.Extend(B3_AABB_EXTENSION);
+
+		BufferMove(s);
+	}
+}
+
+// Hash a sphere and fixture pair.
+static B3_FORCE_INLINE uint32 b3HashPair(const b3SphereFixture* fixture1, const b3WorldFixture* fixture2)
+{
+	uint64 key = uint64(size_t(fixture1)) * 0x9E3779B97F4A7C15ull;
+	key ^= uint64(size_t(fixture2)) + (key >> 29);
+	key *= 0xBF58476D1CE4E5B9ull;
+	return uint32(key ^ (key >> 32));
+}
+
+b3SphereAndShapeContact* b3ContactManager::FindPair(b3SphereFixture* fixture1, b3WorldFixture* fixture2) const
+{
+	if (m_pairBucketCount == 0)
+	{
+		return nullptr;
+	}
+
+	uint32 bucket = b3HashPair(fixture1, fixture2) & (m_pairBucketCount - 1);
+	for (b3SphereAndShapeContact* c = m_pairBuckets[bucket]; c; c = c->m_hashNext)
 	{
 		if (c->m_fixture1 == fixture1 && c->m_fixture2 == fixture2)
 		{
-			// A contact already exists.
-			return;
+			return c;
 		}
 	}
 
+	return nullptr;
+}
+
+void b3ContactManager::RehashPairs(uint32 bucketCount)
+{
+	B3_ASSERT((bucketCount & (bucketCount - 1)) == 0);
+
+	b3Free(m_pairBuckets);
+
+	m_pairBucketCount = bucketCount;
+	m_pairBuckets = (b3SphereAndShapeContact**)b3Alloc(m_pairBucketCount * sizeof(b3SphereAndShapeContact*));
+	memset(m_pairBuckets, 0, m_pairBucketCount * sizeof(b3SphereAndShapeContact*));
+
+	for (b3SphereAndShapeContact* c = m_contactList; c; c = c->m_next)
+	{
+		uint32 bucket = b3HashPair(c->m_fixture1, c->m_fixture2) & (m_pairBucketCount - 1);
+		c->m_hashNext = m_pairBuckets[bucket];
+		m_pairBuckets[bucket] = c;
+	}
+}
+
+void b3ContactManager::InsertPair(b3SphereAndShapeContact* c)
+{
+	// Keep the load factor below one.
+	// The contact is already in the contact list.
+	if (m_contactCount > m_pairBucketCount)
+	{
+		RehashPairs(m_pairBucketCount > 0 ? 2 * m_pairBucketCount : 64);
+		return;
+	}
+
+	uint32 bucket = b3HashPair(c->m_fixture1, c->m_fixture2) & (m_pairBucketCount - 1);
+	c->m_hashNext = m_pairBuckets[bucket];
+	m_pairBuckets[bucket] = c;
+}
+
+void b3ContactManager::RemovePair(b3SphereAndShapeContact* c)
+{
+	uint32 bucket = b3HashPair(c->m_fixture1, c->m_fixture2) & (m_pairBucketCount - 1);
+	
+	b3SphereAndShapeContact** link = m_pairBuckets + bucket;
+	while (*link != c)
+	{
+		B3_ASSERT(*link != nullptr);
+		link = &(*link)->m_hashNext;
+	}
+	*link = c->m_hashNext;
+}
+
+void b3ContactManager::AddPair(b3SphereFixture* fixture1, b3WorldFixture* fixture2)
+{
+	// Check if there is a contact between the two entities.
+	if (FindPair(fixture1, fixture2))
+	{
+		// A contact already exists.
+		return;
+	}
+
 	// Should the entities collide with each other?
 	if (fixture1->m_p->m_type != e_dynamicParticle)
 	{
@@ -60,25 +235,51 @@ void b3ContactManager::AddPair(b3SphereFixture* fixture1, b3WorldFixture* fixtur
 	}
 	m_contactList = c;
 	++m_contactCount;
+
+	// Push the contact to the sphere list of contacts.
+	c->m_spherePrev = nullptr;
+	c->m_sphereNext = fixture1->m_contactList;
+	if (fixture1->m_contactList)
+	{
+		fixture1->m_contactList->m_spherePrev = c;
+	}
+	fixture1->m_contactList = c;
+
+	// Add to the pair table.
+	InsertPair(c);
+}
+
+bool b3ContactManager::Report(uint32 proxyId)
+{
+	b3WorldFixture* fixture = (b3WorldFixture*)m_fixtureTree.GetUserData(proxyId);
+	
+	AddPair(m_querySphere, fixture);
+
+	// Keep looking for overlapping fixtures.
+	return true;
 }
 
 void b3ContactManager::FindNewContacts()
 {
-	// Run a simple broadphase loop.
-	for (b3SphereFixture* f1 = m_body->m_sphereList; f1; f1 = f1->m_next)
+	// Only the spheres that moved can have new pairs.
+	for (uint32 i = 0; i < m_moveCount; ++i)
 	{
-		b3AABB aabb1 = f1->ComputeAABB();
-
-		for (b3WorldFixture* f2 = m_body->m_fixtureList; f2; f2 = f2->m_next)
+		m_querySphere = m_moveBuffer[i];
+		
+		if (m_querySphere == nullptr)
 		{
-			b3AABB aabb2 = f2->ComputeAABB();
-
-			if (b3TestOverlap(aabb1, aabb2))
-			{
-				AddPair(f1, f2);
-			}
+			// Sphere was removed.
+			continue;
 		}
+
+		m_querySphere->m_moveIndex = B3_MAX_U32;
+
+		m_fixtureTree.Query(this, m_querySphere->m_aabb);
 	}
+
+	// Reset the move buffer for the next step.
+	m_moveCount = 0;
+	m_querySphere = nullptr;
 }
 
 void b3ContactManager::Destroy(b3SphereAndShapeContact* c)
@@ -101,6 +302,27 @@ void b3ContactManager::Destroy(b3SphereAndShapeContact* c)
 
 	--m_contactCount;
 
+	// Remove from the sphere.
+	b3SphereFixture* fixture1 = c->m_fixture1;
+	
+	if (c->m_spherePrev)
+	{
+		c->m_spherePrev->m_sphereNext = c->m_sphereNext;
+	}
+
+	if (c->m_sphereNext)
+	{
+		c->m_sphereNext->m_spherePrev = c->m_spherePrev;
+	}
+
+	if (c == fixture1->m_contactList)
+	{
+		fixture1->m_contactList = c->m_sphereNext;
+	}
+
+	// Remove from the pair table.
+	RemovePair(c);
+
 	// Call the factory.
 	b3SphereAndShapeContact::Destroy(c, m_allocator);
 }
@@ -125,10 +347,10 @@ void b3ContactManager::UpdateContacts()
 			continue;
 		}
 
-		b3AABB aabb1 = f1->ComputeAABB();
-		b3AABB aabb2 = f2->ComputeAABB();
+		const b3AABB& aabb1 = f1->m_aabb;
+		const b3AABB& aabb2 = m_fixtureTree.GetFatAABB(f2->m_proxyId);
 
-		// Destroy the contact if AABBs are not overlapping.
+		// Destroy the contact if the fat AABBs are not overlapping.
 		bool overlap = b3TestOverlap(aabb1, aabb2);
 		if (overlap == false)
 		{
@@ -24,6 +24,7 @@
 #include <bounce_softbody/collision/geometry/sphere.h>
 #include <bounce_softbody/sparse/sparse_force_solver.h>
 #include <bounce_softbody/sparse/sparse_mat33.h>
+#include <bounce_softbody/sparse/diag_mat33.h>
 #include <bounce_softbody/sparse/dense_vec3.h>
 #include <bounce_softbody/common/math/vec2.h>
 #include <bounce_softbody/common/memory/block_allocator.h>
@@ -44,6 +45,9 @@ b3SphereAndShapeContact::b3SphereAndShapeContact(b3SphereFixture* fixture1, b3Wo
 {
 	m_prev = nullptr;
 	m_next = nullptr;
+	m_spherePrev = nullptr;
+	m_sphereNext = nullptr;
+	m_hashNext = nullptr;
 	m_fixture1 = fixture1;
 	m_fixture2 = fixture2;
 	m_normalForce = scalar(0);
@@ -55,8 +59,6 @@ void b3SphereAndShapeContact::ApplyForces(const b3SparseForceSolverData* data)
 	const b3DenseVec3& x = *data->x;
 	const b3DenseVec3& v = *data->v;
 	b3DenseVec3& f = *data->f;
-	b3SparseMat33& dfdx = *data->dfdx;
-	b3SparseMat33& dfdv = *data->dfdv;
 
 	b3Particle* p1 = m_fixture1->m_p;
 
@@ -119,7 +121,14 @@ void b3SphereAndShapeContact::ApplyForces(const b3SparseForceSolverData* data)
 
 		// Apply 
 		f[i1] += f1;
-		dfdx(i1, i1) += K11;
+		if (data->dfdx)
+		{
+			(*data->dfdx)(i1, i1) += K11;
+		}
+		else
+		{
+			(*data->dfdx_diag)[i1] += K11;
+		}
 
 		// Accumulate normal force magnitude for friction.
 		m_normalForce += b3Length(f1);
@@ -138,7 +147,14 @@ void b3SphereAndShapeContact::ApplyForces(const b3SparseForceSolverData* data)
 
 		// Apply force and Jacobian
 		f[i1] += f1;
-		dfdv(i1, i1) += K11;
+		if (data->dfdv)
+		{
+			(*data->dfdv)(i1, i1) += K11;
+		}
+		else
+		{
+			(*data->dfdv_diag)[i1] += K11;
+		}
 	}
 }
 
@@ -156,9 +172,11 @@ void b3SphereAndShapeContact::ApplyFriction(const b3TimeStep& step, const b3Vec3
 	b3Vec3 tangent2 = b3Cross(tangent1, normal);
 
 	b3Particle* p1 = m_fixture1->m_p;
+	b3ParticleStorage* storage = p1->m_storage;
+	uint32 i1 = p1->m_solverId;
 	
-	b3Vec3 v1 = p1->m_velocity;
-	scalar im1 = p1->m_invMass;
+	b3Vec3 v1 = storage->velocities[i1];
+	scalar im1 = storage->invMasses[i1];
 
 	scalar friction = b3MixFriction(m_fixture1->m_friction, m_fixture2->m_friction);
 
@@ -185,7 +203,7 @@ void b3SphereAndShapeContact::ApplyFriction(const b3TimeStep& step, const b3Vec3
 
 	v1 += im1 * P;
 
-	p1->m_velocity = v1;
+	storage->velocities[i1] = v1;
 }
 
 void b3SphereAndShapeContact::Update()
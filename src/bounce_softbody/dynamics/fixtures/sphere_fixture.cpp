@@ -25,27 +25,21 @@ b3SphereFixture::b3SphereFixture(const b3SphereFixtureDef& def, b3Body* body) :
 {
 	m_type = e_sphereFixture;
 	m_p = def.p;
+	m_moveIndex = B3_MAX_U32;
+	m_contactList = nullptr;
 	m_prev = nullptr;
 	m_next = nullptr;
 }
 
 b3AABB b3SphereFixture::ComputeAABB() const
 {
-	return b3AABB(m_p->m_position, m_radius);
+	return b3AABB(m_p->GetPosition(), m_radius);
 }
 
 void b3SphereFixture::DestroyContacts()
 {
-	b3SphereAndShapeContact* c = m_body->m_contactManager.m_contactList;
-	while (c)
+	while (m_contactList)
 	{
-		b3SphereAndShapeContact* c0 = c;
-		c = c->m_next;
-
-		if (c0->m_fixture1 == this)
-		{
-			m_body->m_contactManager.Destroy(c0);
-			continue;
-		}
+		m_body->m_contactManager.Destroy(m_contactList);
 	}
 }
\ No newline at end of file
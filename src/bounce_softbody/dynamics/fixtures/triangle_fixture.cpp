@@ -43,8 +43,8 @@ b3TriangleFixture::b3TriangleFixture(const b3TriangleFixtureDef& def, b3Body* bo
 b3AABB b3TriangleFixture::ComputeAABB() const
 {
 	b3AABB aabb;
-	aabb.lowerBound = b3Min(m_p1->m_position, b3Min(m_p2->m_position, m_p3->m_position));
-	aabb.upperBound = b3Max(m_p1->m_position, b3Max(m_p2->m_position, m_p3->m_position));
+	aabb.lowerBound = b3Min(m_p1->GetPosition(), b3Min(m_p2->GetPosition(), m_p3->GetPosition()));
+	aabb.upperBound = b3Max(m_p1->GetPosition(), b3Max(m_p2->GetPosition(), m_p3->GetPosition()));
 	aabb.Extend(m_radius);
 	return aabb;
 }
@@ -59,8 +59,8 @@ bool b3TriangleFixture::RayCast(b3RayCastOutput* output, const b3RayCastInput& i
 {
 	b3TriangleShape triangle;
 	triangle.m_radius = m_radius;
-	triangle.m_vertex1 = m_p1->m_position;
-	triangle.m_vertex2 = m_p2->m_position;
-	triangle.m_vertex3 = m_p3->m_position;
+	triangle.m_vertex1 = m_p1->GetPosition();
+	triangle.m_vertex2 = m_p2->GetPosition();
+	triangle.m_vertex3 = m_p3->GetPosition();
 	return triangle.RayCast(output, input);
 }
\ No newline at end of file
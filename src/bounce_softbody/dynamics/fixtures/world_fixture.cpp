@@ -34,6 +34,7 @@ b3WorldFixture::b3WorldFixture()
 	m_prev = nullptr;
 	m_next = nullptr;
 	m_friction = scalar(0);
+	m_proxyId = B3_MAX_U32;
 }
 
 void b3WorldFixture::Create(b3BlockAllocator* allocator, b3Body* body, const b3WorldFixtureDef& def)
@@ -17,6 +17,7 @@
 */
 
 #include <bounce_softbody/dynamics/force_solver.h>
+#include <bounce_softbody/dynamics/solver_stats.h>
 #include <bounce_softbody/dynamics/particle.h>
 #include <bounce_softbody/dynamics/forces/force.h>
 #include <bounce_softbody/dynamics/contacts/contact.h>
@@ -24,21 +25,25 @@
 #include <bounce_softbody/sparse/dense_vec3.h>
 #include <bounce_softbody/sparse/diag_mat33.h>
 #include <bounce_softbody/sparse/sparse_mat33.h>
+#include <bounce_softbody/sparse/sparse_workspace.h>
 #include <bounce_softbody/common/memory/stack_allocator.h>
-
-// Number of non-linear iterations.
-uint32 b3_forceSolverIterations = 0;
-
-// Min/max number of inner iterations.
-uint32 b3_forceSolverMinSubIterations = B3_MAX_U32;
-uint32 b3_forceSolverMaxSubIterations = 0;
+#include <bounce_softbody/common/thread_pool.h>
 
 b3ForceSolver::b3ForceSolver(const b3ForceSolverDef& def)
 {
 	m_step = def.step;
 	m_allocator = def.allocator;
+	m_workspace = def.workspace;
+	m_profile = def.profile;
+	m_stats = def.stats;
+	m_pattern = def.pattern;
+	m_threadPool = def.threadPool;
+	m_colorCount = def.colorCount;
+	m_colorOffsets = def.colorOffsets;
+	m_preconditioner = def.preconditioner;
+	m_updatePreconditioner = def.updatePreconditioner;
+	m_directSolver = def.directSolver;
 
-	m_particleCount = def.particleCount;
 	m_particles = def.particles;
 
 	m_forceCount = def.forceCount;
@@ -52,31 +57,77 @@ b3ForceSolver::~b3ForceSolver()
 {
 }
 
+// Number of forces applied by a thread at once.
+const uint32 b3_forceGrainSize = 64;
+
+struct b3ApplyForcesTask
+{
+	b3Force** forces;
+	const b3SparseForceSolverData* data;
+};
+
+struct b3MultiplyJacobiansTask
+{
+	b3Force** forces;
+	const b3SparseForceProductData* data;
+};
+
 class b3ForceModel : public b3SparseForceModel
 {
 public:
 	void ApplyForces(const b3SparseForceSolverData* data);
 
-	uint32 m_particleCount;
-	b3Particle** m_particles;
+	// Apply the forces in a range of a color.
+	static void ApplyForces(void* context, uint32 begin, uint32 end);
+
+	// Particles and contacts contribute only diagonal blocks.
+	void MultiplyJacobians(const b3SparseForceProductData* data);
+
+	// Multiply the Jacobians of the forces in a range of a color.
+	static void MultiplyJacobians(void* context, uint32 begin, uint32 end);
+
+	const b3ParticleStorage* m_particles;
 
 	uint32 m_forceCount;
 	b3Force** m_forces;
 
 	uint32 m_contactCount;
 	b3Contact** m_contacts;
+
+	b3ThreadPool* m_threadPool;
+
+	uint32 m_colorCount;
+	const uint32* m_colorOffsets;
 };
 
+void b3ForceModel::ApplyForces(void* context, uint32 begin, uint32 end)
+{
+	b3ApplyForcesTask* task = (b3ApplyForcesTask*)context;
+	for (uint32 i = begin; i < end; ++i)
+	{
+		task->forces[i]->ApplyForces(task->data);
+	}
+}
+
 void b3ForceModel::ApplyForces(const b3SparseForceSolverData* data)
 {
-	for (uint32 i = 0; i < m_particleCount; ++i)
+	for (uint32 i = 0; i < m_particles->count; ++i)
 	{
-		m_particles[i]->ApplyForces(data);
+		m_particles->particles[i]->ApplyForces(data);
 	}
 
-	for (uint32 i = 0; i < m_forceCount; ++i)
+	// Forces of the same color don't share particles and can be applied in parallel.
+	// Colors are applied in order, so the result is the same for any number of threads.
+	for (uint32 i = 0; i < m_colorCount; ++i)
 	{
-		m_forces[i]->ApplyForces(data);
+		uint32 begin = m_colorOffsets[i];
+		uint32 end = m_colorOffsets[i + 1];
+
+		b3ApplyForcesTask task;
+		task.forces = m_forces + begin;
+		task.data = data;
+
+		m_threadPool->ParallelFor(end - begin, b3_forceGrainSize, ApplyForces, &task);
 	}
 
 	for (uint32 i = 0; i < m_contactCount; ++i)
@@ -85,35 +136,64 @@ void b3ForceModel::ApplyForces(const b3SparseForceSolverData* data)
 	}
 }
 
-void b3ForceSolver::Solve(const b3Vec3& gravity)
+void b3ForceModel::MultiplyJacobians(void* context, uint32 begin, uint32 end)
 {
-	b3DenseVec3 x0(m_particleCount);
-	b3DenseVec3 v0(m_particleCount);
-	b3DenseVec3 fe(m_particleCount);
-	b3DenseVec3 y(m_particleCount);
-	b3DenseVec3 x(m_particleCount);
-	b3DenseVec3 v(m_particleCount);
-	b3DiagMat33 M(m_particleCount);
-	b3DiagMat33 S(m_particleCount);
-	b3DenseVec3 z(m_particleCount);
-	
-	for (uint32 i = 0; i < m_particleCount; ++i)
+	b3MultiplyJacobiansTask* task = (b3MultiplyJacobiansTask*)context;
+	for (uint32 i = begin; i < end; ++i)
+	{
+		task->forces[i]->MultiplyJacobians(task->data);
+	}
+}
+
+void b3ForceModel::MultiplyJacobians(const b3SparseForceProductData* data)
+{
+	// Forces of the same color write to different rows.
+	for (uint32 i = 0; i < m_colorCount; ++i)
 	{
-		b3Particle* p = m_particles[i];
+		uint32 begin = m_colorOffsets[i];
+		uint32 end = m_colorOffsets[i + 1];
+
+		b3MultiplyJacobiansTask task;
+		task.forces = m_forces + begin;
+		task.data = data;
+
+		m_threadPool->ParallelFor(end - begin, b3_forceGrainSize, MultiplyJacobians, &task);
+	}
+}
+
+void b3ForceSolver::Solve(const b3Vec3& gravity)
+{
+	uint32 particleCount = m_particles->count;
+	b3Particle** particles = m_particles->particles;
+	const scalar* masses = m_particles->masses;
+
+	// The solver writes the new positions and velocities 
+	// directly into the particle storage.
+	b3DenseVec3 x(m_particles->positions, particleCount);
+	b3DenseVec3 v(m_particles->velocities, particleCount);
+	b3DenseVec3 y(m_particles->translations, particleCount);
 
-		x0[i] = p->m_position;
-		v0[i] = p->m_velocity;
-		fe[i] = p->m_force;
-		y[i] = p->m_translation;
-		z[i].SetZero();
+	b3DenseVec3& x0 = *m_workspace->AllocateDenseVec3(particleCount);
+	b3DenseVec3& v0 = *m_workspace->AllocateDenseVec3(particleCount);
+	b3DenseVec3& fe = *m_workspace->AllocateDenseVec3(particleCount);
+	b3DiagMat33& M = *m_workspace->AllocateDiagMat33(particleCount);
+	b3DiagMat33& S = *m_workspace->AllocateDiagMat33(particleCount);
+	b3DenseVec3& z = *m_workspace->AllocateDenseVec3(particleCount);
+	
+	x0.Copy(x);
+	v0.Copy(v);
+	memcpy(fe.v, m_particles->forces, particleCount * sizeof(b3Vec3));
+	z.SetZero();
 
-		if (p->m_type == e_dynamicParticle)
+	for (uint32 i = 0; i < particleCount; ++i)
+	{
+		if (particles[i]->m_type == e_dynamicParticle)
 		{
-			B3_ASSERT(p->m_mass > scalar(0));
-			M[i] = b3Mat33Diagonal(p->m_mass);
+			B3_ASSERT(masses[i] > scalar(0));
+			M[i] = b3Mat33Diagonal(masses[i]);
 
 			// Apply weight
-			fe[i] += p->m_mass * gravity;
+			fe[i] += masses[i] * gravity;
 
 			// Set as unconstrained particle.
 			S[i].SetIdentity();
@@ -131,19 +211,21 @@ void b3ForceSolver::Solve(const b3Vec3& gravity)
 
 	// Prepare the force model.
 	b3ForceModel forceModel;
-	forceModel.m_particleCount = m_particleCount;
 	forceModel.m_particles = m_particles;
 	forceModel.m_forceCount = m_forceCount;
 	forceModel.m_forces = m_forces;
 	forceModel.m_contactCount = m_contactCount;
 	forceModel.m_contacts = m_contacts;
+	forceModel.m_threadPool = m_threadPool;
+	forceModel.m_colorCount = m_colorCount;
+	forceModel.m_colorOffsets = m_colorOffsets;
 
 	// Prepare input.
 	b3SolveBEInput solverInput;
 	solverInput.forceModel = &forceModel;
 	solverInput.h = m_step.dt;
 	solverInput.inv_h = m_step.inv_dt;
-	solverInput.dofCount = m_particleCount;
+	solverInput.dofCount = particleCount;
 	solverInput.x0 = &x0; 
 	solverInput.v0 = &v0;
 	solverInput.fe = &fe;
@@ -151,30 +233,73 @@ void b3ForceSolver::Solve(const b3Vec3& gravity)
 	solverInput.y = &y;
 	solverInput.S = &S;
 	solverInput.z = &z;
+	solverInput.pattern = m_pattern;
 	solverInput.maxIterations = m_step.forceIterations;
 	solverInput.maxSubIterations = m_step.forceSubIterations;
+	solverInput.adaptiveSubTolerance = m_step.adaptiveSubTolerance;
+	solverInput.lineSearch = m_step.lineSearch;
+	solverInput.matrixFree = m_step.matrixFree;
+	solverInput.symmetric = m_step.symmetricStorage;
+	solverInput.mixedPrecision = m_step.mixedPrecision;
+	solverInput.refinementIterations = m_step.refinementIterations;
+	solverInput.preconditioner = m_preconditioner;
+	solverInput.updatePreconditioner = m_updatePreconditioner;
+	solverInput.directSolver = m_directSolver;
+	solverInput.threadPool = m_threadPool;
+	solverInput.workspace = m_workspace;
+
+	// Predict the velocity change from the acceleration of the last step.
+	b3DenseVec3* dv = nullptr;
+	if (m_step.warmStarting)
+	{
+		dv = m_workspace->AllocateDenseVec3(particleCount);
+		for (uint32 i = 0; i < particleCount; ++i)
+		{
+			(*dv)[i] = m_step.dt * m_particles->accelerations[i];
+		}
+		solverInput.dv = dv;
+	}
 	
 	// Prepare output.
 	b3SolveBEOutput solverOutput;
 	solverOutput.x = &x;
 	solverOutput.v = &v;
-	solverOutput.minSubIterations = b3_forceSolverMinSubIterations;
-	solverOutput.maxSubIterations = b3_forceSolverMaxSubIterations;
+	solverOutput.history = m_stats->history;
+	solverOutput.historyCapacity = b3_maxSolverStatsIterations;
 
 	// Integrate F = ma.
 	b3SparseSolveBE(&solverOutput, &solverInput);
 
-	// Track non-linear iterations.
-	b3_forceSolverIterations = solverOutput.iterations;
-	
-	// Track min-max sub-iterations.
-	b3_forceSolverMinSubIterations = solverOutput.minSubIterations;
-	b3_forceSolverMaxSubIterations = solverOutput.maxSubIterations;
+	// Keep the acceleration for warm starting the next step.
+	for (uint32 i = 0; i < particleCount; ++i)
+	{
+		m_particles->accelerations[i] = m_step.inv_dt * (v[i] - v0[i]);
+	}
+
+	// Track the solver statistics.
+	m_stats->iterations = solverOutput.iterations;
+	m_stats->historyCount = solverOutput.historyCount;
+	m_stats->minSubIterations = solverOutput.minSubIterations;
+	m_stats->maxSubIterations = solverOutput.maxSubIterations;
+	m_stats->error = solverOutput.error;
+	m_stats->lineSearchFailures = solverOutput.lineSearchFailures;
+	m_stats->blockCount = solverOutput.blockCount;
+	m_stats->particleCount = particleCount;
+	m_stats->forceCount = m_forceCount;
+	m_stats->contactCount = m_contactCount;
+
+	// Track the time spent in the integrator.
+	m_profile->assembly = solverOutput.assemblyTime;
+	m_profile->solveCG = solverOutput.solveTime;
 
-	// Copy buffers back to the particles.
-	for (uint32 i = 0; i < m_particleCount; ++i)
+	if (dv)
 	{
-		m_particles[i]->m_position = x[i];
-		m_particles[i]->m_velocity = v[i];
+		m_workspace->FreeDenseVec3(dv);
 	}
+	m_workspace->FreeDenseVec3(&z);
+	m_workspace->FreeDiagMat33(&S);
+	m_workspace->FreeDiagMat33(&M);
+	m_workspace->FreeDenseVec3(&fe);
+	m_workspace->FreeDenseVec3(&v0);
+	m_workspace->FreeDenseVec3(&x0);
 }
\ No newline at end of file
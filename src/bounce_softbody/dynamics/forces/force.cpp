@@ -23,6 +23,8 @@
 #include <bounce_softbody/dynamics/forces/mouse_force.h>
 #include <bounce_softbody/dynamics/forces/triangle_element_force.h>
 #include <bounce_softbody/dynamics/forces/tetrahedron_element_force.h>
+#include <bounce_softbody/sparse/sparse_mat33.h>
+#include <bounce_softbody/sparse/diag_mat33.h>
 #include <bounce_softbody/common/memory/block_allocator.h>
 
 b3Force* b3Force::Create(const b3ForceDef* def, b3BlockAllocator* allocator)
@@ -138,4 +140,25 @@ b3Force::b3Force()
 	m_userIndex = B3_MAX_U32;
 	m_prev = nullptr;
 	m_next = nullptr;
+}
+
+void b3Force::AddJacobian(b3SparseMat33* J, b3DiagMat33* D, const b3Mat33* K, const uint32* indices, uint32 count) const
+{
+	if (J)
+	{
+		for (uint32 k = 0; k < count * count; ++k)
+		{
+			if (m_slots[k] != B3_MAX_U32)
+			{
+				J->values[m_slots[k]] += K[k];
+			}
+		}
+	}
+	else
+	{
+		for (uint32 i = 0; i < count; ++i)
+		{
+			(*D)[indices[i]] += K[i * count + i];
+		}
+	}
 }
\ No newline at end of file
@@ -40,6 +40,8 @@ b3MouseForce::b3MouseForce(const b3MouseForceDef* def)
 	m_f2.SetZero();
 	m_f3.SetZero();
 	m_f4.SetZero();
+	m_Kx.SetZero();
+	m_Kv.SetZero();
 }
 
 bool b3MouseForce::Contains(const b3Particle* particle) const
@@ -55,18 +57,26 @@ void b3MouseForce::ClearForces()
 	m_f4.SetZero();
 }
 
+uint32 b3MouseForce::GetParticles(b3Particle* particles[b3_maxForceParticles]) const
+{
+	particles[0] = m_p1;
+	particles[1] = m_p2;
+	particles[2] = m_p3;
+	particles[3] = m_p4;
+	return 4;
+}
+
 void b3MouseForce::ApplyForces(const b3SparseForceSolverData* data)
 {
 	uint32 i1 = m_p1->m_solverId;
 	uint32 i2 = m_p2->m_solverId;
 	uint32 i3 = m_p3->m_solverId;
 	uint32 i4 = m_p4->m_solverId;
+	uint32 indices[4] = { i1, i2, i3, i4 };
 
 	b3DenseVec3& x = *data->x;
 	b3DenseVec3& v = *data->v;
 	b3DenseVec3& f = *data->f;
-	b3SparseMat33& dfdx = *data->dfdx;
-	b3SparseMat33& dfdv = *data->dfdv;
 
 	b3Vec3 x1 = x[i1];
 	b3Vec3 x2 = x[i2];
@@ -89,6 +99,9 @@ void b3MouseForce::ApplyForces(const b3SparseForceSolverData* data)
 	b3Vec3 d = x1 - c2;
 	scalar L = b3Length(d);
 
+	m_Kx.SetZero();
+	m_Kv.SetZero();
+
 	if (L > scalar(0))
 	{
 		scalar inv_L = scalar(1) / L;
@@ -165,25 +178,10 @@ void b3MouseForce::ApplyForces(const b3SparseForceSolverData* data)
 					}
 				}
 
-				dfdx(i1, i1) += K[0][0];
-				dfdx(i1, i2) += K[0][1];
-				dfdx(i1, i3) += K[0][2];
-				dfdx(i1, i4) += K[0][3];
-
-				dfdx(i2, i1) += K[1][0];
-				dfdx(i2, i2) += K[1][1];
-				dfdx(i2, i3) += K[1][2];
-				dfdx(i2, i4) += K[1][3];
-
-				dfdx(i3, i1) += K[2][0];
-				dfdx(i3, i2) += K[2][1];
-				dfdx(i3, i3) += K[2][2];
-				dfdx(i3, i4) += K[2][3];
-
-				dfdx(i4, i1) += K[3][0];
-				dfdx(i4, i2) += K[3][1];
-				dfdx(i4, i3) += K[3][2];
-				dfdx(i4, i4) += K[3][3];
+				// K_ij = c_i * c_j * Kx, where c = (1, -w2, -w3, -w4)
+				m_Kx = -m_ks * (b3Outer(n, n) + C * A);
+
+				AddJacobian(data->dfdx, data->dfdx_diag, &K[0][0], indices, 4);
 			}
 		}
 
@@ -222,25 +220,36 @@ void b3MouseForce::ApplyForces(const b3SparseForceSolverData* data)
 				}
 			}
 
-			dfdv(i1, i1) += K[0][0];
-			dfdv(i1, i2) += K[0][1];
-			dfdv(i1, i3) += K[0][2];
-			dfdv(i1, i4) += K[0][3];
-
-			dfdv(i2, i1) += K[1][0];
-			dfdv(i2, i2) += K[1][1];
-			dfdv(i2, i3) += K[1][2];
-			dfdv(i2, i4) += K[1][3];
-
-			dfdv(i3, i1) += K[2][0];
-			dfdv(i3, i2) += K[2][1];
-			dfdv(i3, i3) += K[2][2];
-			dfdv(i3, i4) += K[2][3];
-
-			dfdv(i4, i1) += K[3][0];
-			dfdv(i4, i2) += K[3][1];
-			dfdv(i4, i3) += K[3][2];
-			dfdv(i4, i4) += K[3][3];
+			m_Kv = -m_kd * b3Outer(n, n);
+
+			AddJacobian(data->dfdv, data->dfdv_diag, &K[0][0], indices, 4);
 		}
 	}
+}
+
+void b3MouseForce::MultiplyJacobians(const b3SparseForceProductData* data) const
+{
+	const b3DenseVec3& p = *data->p;
+	b3DenseVec3& q = *data->q;
+
+	uint32 indices[4] = { m_p1->m_solverId, m_p2->m_solverId, m_p3->m_solverId, m_p4->m_solverId };
+	scalar c[4] = { scalar(1), -m_w2, -m_w3, -m_w4 };
+
+	// K_ij = c_i * c_j * K
+	b3Mat33 K = data->a * m_Kx + data->b * m_Kv;
+
+	b3Vec3 s; 
+	s.SetZero();
+	for (uint32 i = 0; i < 4; ++i)
+	{
+		s += c[i] * p[indices[i]];
+	}
+
+	for (uint32 i = 0; i < 4; ++i)
+	{
+		uint32 index = indices[i];
+
+		// Skip the diagonal block
+		q[index] += c[i] * (K * (s - c[i] * p[index]));
+	}
 }
\ No newline at end of file
@@ -60,6 +60,9 @@ b3ShearForce::b3ShearForce(const b3ShearForceDef* def)
 	m_f1.SetZero();
 	m_f2.SetZero();
 	m_f3.SetZero();
+	m_dCdx[0].SetZero();
+	m_dCdx[1].SetZero();
+	m_dCdx[2].SetZero();
 
 	scalar u1 = def->u1, v1 = def->v1;
 	scalar u2 = def->u2, v2 = def->v2;
@@ -103,6 +106,14 @@ void b3ShearForce::ClearForces()
 	m_f3.SetZero();
 }
 
+uint32 b3ShearForce::GetParticles(b3Particle* particles[b3_maxForceParticles]) const
+{
+	particles[0] = m_p1;
+	particles[1] = m_p2;
+	particles[2] = m_p3;
+	return 3;
+}
+
 void b3ShearForce::ApplyForces(const b3SparseForceSolverData* data)
 {
 	scalar alpha = m_alpha;
@@ -117,12 +128,11 @@ void b3ShearForce::ApplyForces(const b3SparseForceSolverData* data)
 	uint32 i1 = m_p1->m_solverId;
 	uint32 i2 = m_p2->m_solverId;
 	uint32 i3 = m_p3->m_solverId;
+	uint32 indices[3] = { i1, i2, i3 };
 
 	b3DenseVec3& x = *data->x;
 	b3DenseVec3& v = *data->v;
 	b3DenseVec3& f = *data->f;
-	b3SparseMat33& dfdx = *data->dfdx;
-	b3SparseMat33& dfdv = *data->dfdv;
 
 	b3Vec3 x1 = x[i1];
 	b3Vec3 x2 = x[i2];
@@ -145,6 +155,7 @@ void b3ShearForce::ApplyForces(const b3SparseForceSolverData* data)
 	for (uint32 i = 0; i < 3; ++i)
 	{
 		dCdx[i] = alpha * (dwudx[i] * wv + dwvdx[i] * wu);
+		m_dCdx[i] = dCdx[i];
 	}
 
 	if (m_ks > scalar(0))
@@ -180,17 +191,7 @@ void b3ShearForce::ApplyForces(const b3SparseForceSolverData* data)
 			}
 		}
 
-		dfdx(i1, i1) += K[0][0];
-		dfdx(i1, i2) += K[0][1];
-		dfdx(i1, i3) += K[0][2];
-
-		dfdx(i2, i1) += K[1][0];
-		dfdx(i2, i2) += K[1][1];
-		dfdx(i2, i3) += K[1][2];
-
-		dfdx(i3, i1) += K[2][0];
-		dfdx(i3, i2) += K[2][1];
-		dfdx(i3, i3) += K[2][2];
+		AddJacobian(data->dfdx, data->dfdx_diag, &K[0][0], indices, 3);
 	}
 
 	if (m_kd > scalar(0))
@@ -230,16 +231,33 @@ void b3ShearForce::ApplyForces(const b3SparseForceSolverData* data)
 			}
 		}
 
-		dfdv(i1, i1) += K[0][0];
-		dfdv(i1, i2) += K[0][1];
-		dfdv(i1, i3) += K[0][2];
+		AddJacobian(data->dfdv, data->dfdv_diag, &K[0][0], indices, 3);
+	}
+}
+
+void b3ShearForce::MultiplyJacobians(const b3SparseForceProductData* data) const
+{
+	const b3DenseVec3& p = *data->p;
+	b3DenseVec3& q = *data->q;
+
+	uint32 indices[3] = { m_p1->m_solverId, m_p2->m_solverId, m_p3->m_solverId };
+
+	// K_ij = -k * dCdx_i * dCdx_j^T
+	scalar k = data->a * m_ks + data->b * m_kd;
 
-		dfdv(i2, i1) += K[1][0];
-		dfdv(i2, i2) += K[1][1];
-		dfdv(i2, i3) += K[1][2];
+	scalar dCdp = scalar(0);
+	for (uint32 i = 0; i < 3; ++i)
+	{
+		dCdp += b3Dot(m_dCdx[i], p[indices[i]]);
+	}
+
+	for (uint32 i = 0; i < 3; ++i)
+	{
+		uint32 index = indices[i];
+		
+		// Skip the diagonal block
+		scalar s = dCdp - b3Dot(m_dCdx[i], p[index]);
 
-		dfdv(i3, i1) += K[2][0];
-		dfdv(i3, i2) += K[2][1];
-		dfdv(i3, i3) += K[2][2];
+		q[index] -= k * s * m_dCdx[i];
 	}
 }
\ No newline at end of file
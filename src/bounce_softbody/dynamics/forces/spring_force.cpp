@@ -45,6 +45,8 @@ b3SpringForce::b3SpringForce(const b3SpringForceDef* def)
 	m_kd = def->dampingStiffness;
 	m_f1.SetZero();
 	m_f2.SetZero();
+	m_Kx.SetZero();
+	m_Kv.SetZero();
 }
 
 bool b3SpringForce::Contains(const b3Particle* particle) const
@@ -58,16 +60,22 @@ void b3SpringForce::ClearForces()
 	m_f2.SetZero();
 }
 
+uint32 b3SpringForce::GetParticles(b3Particle* particles[b3_maxForceParticles]) const
+{
+	particles[0] = m_p1;
+	particles[1] = m_p2;
+	return 2;
+}
+
 void b3SpringForce::ApplyForces(const b3SparseForceSolverData* data)
 {
 	b3DenseVec3& x = *data->x;
 	b3DenseVec3& v = *data->v;
 	b3DenseVec3& f = *data->f;
-	b3SparseMat33& dfdx = *data->dfdx;
-	b3SparseMat33& dfdv = *data->dfdv;
 
 	uint32 i1 = m_p1->m_solverId;
 	uint32 i2 = m_p2->m_solverId;
+	uint32 indices[2] = { i1, i2 };
 
 	b3Vec3 x1 = x[i1];
 	b3Vec3 v1 = v[i1];
@@ -81,6 +89,9 @@ void b3SpringForce::ApplyForces(const b3SparseForceSolverData* data)
 
 	scalar L = b3Length(dx);
 
+	m_Kx.SetZero();
+	m_Kv.SetZero();
+
 	if (L > scalar(0))
 	{
 		b3Vec3 n = dx / L;
@@ -107,10 +118,10 @@ void b3SpringForce::ApplyForces(const b3SparseForceSolverData* data)
 				b3Mat33 K21 = K12;
 				b3Mat33 K22 = K11;
 
-				dfdx(i1, i1) += K11;
-				dfdx(i1, i2) += K12;
-				dfdx(i2, i1) += K21;
-				dfdx(i2, i2) += K22;
+				b3Mat33 K[4] = { K11, K12, K21, K22 };
+				AddJacobian(data->dfdx, data->dfdx_diag, K, indices, 2);
+
+				m_Kx = K11;
 			}
 		}
 
@@ -134,10 +145,25 @@ void b3SpringForce::ApplyForces(const b3SparseForceSolverData* data)
 			b3Mat33 K21 = K12;
 			b3Mat33 K22 = K11;
 
-			dfdv(i1, i1) += K11;
-			dfdv(i1, i2) += K12;
-			dfdv(i2, i1) += K21;
-			dfdv(i2, i2) += K22;
+			b3Mat33 K[4] = { K11, K12, K21, K22 };
+			AddJacobian(data->dfdv, data->dfdv_diag, K, indices, 2);
+
+			m_Kv = K11;
 		}
 	}
+}
+
+void b3SpringForce::MultiplyJacobians(const b3SparseForceProductData* data) const
+{
+	const b3DenseVec3& p = *data->p;
+	b3DenseVec3& q = *data->q;
+
+	uint32 i1 = m_p1->m_solverId;
+	uint32 i2 = m_p2->m_solverId;
+
+	// K12 = K21 = -K11
+	b3Mat33 K12 = -(data->a * m_Kx + data->b * m_Kv);
+
+	q[i1] += K12 * p[i2];
+	q[i2] += K12 * p[i1];
 }
\ No newline at end of file
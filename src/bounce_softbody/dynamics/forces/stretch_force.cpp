@@ -75,6 +75,10 @@ b3StretchForce::b3StretchForce(const b3StretchForceDef* def)
 	m_f1.SetZero();
 	m_f2.SetZero();
 	m_f3.SetZero();
+	m_n_u.SetZero();
+	m_n_v.SetZero();
+	m_kxn_u = m_kxt_u = m_kvn_u = scalar(0);
+	m_kxn_v = m_kxt_v = m_kvn_v = scalar(0);
 
 	scalar u1 = def->u1, v1 = def->v1;
 	scalar u2 = def->u2, v2 = def->v2;
@@ -118,6 +122,14 @@ void b3StretchForce::ClearForces()
 	m_f3.SetZero();
 }
 
+uint32 b3StretchForce::GetParticles(b3Particle* particles[b3_maxForceParticles]) const
+{
+	particles[0] = m_p1;
+	particles[1] = m_p2;
+	particles[2] = m_p3;
+	return 3;
+}
+
 void b3StretchForce::ApplyForces(const b3SparseForceSolverData* data)
 {
 	scalar alpha = m_alpha;
@@ -132,12 +144,11 @@ void b3StretchForce::ApplyForces(const b3SparseForceSolverData* data)
 	uint32 i1 = m_p1->m_solverId;
 	uint32 i2 = m_p2->m_solverId;
 	uint32 i3 = m_p3->m_solverId;
+	uint32 indices[3] = { i1, i2, i3 };
 
 	b3DenseVec3& x = *data->x;
 	b3DenseVec3& v = *data->v;
 	b3DenseVec3& f = *data->f;
-	b3SparseMat33& dfdx = *data->dfdx;
-	b3SparseMat33& dfdv = *data->dfdv;
 
 	b3Vec3 x1 = x[i1];
 	b3Vec3 x2 = x[i2];
@@ -158,10 +169,14 @@ void b3StretchForce::ApplyForces(const b3SparseForceSolverData* data)
 	b3Vec3 wv = inv_det * (-du2 * dx1 + du1 * dx2);
 	scalar len_wv = b3Length(wv);
 
+	m_kxn_u = m_kxt_u = m_kvn_u = scalar(0);
+	m_kxn_v = m_kxt_v = m_kvn_v = scalar(0);
+
 	if (len_wu > scalar(0))
 	{
 		scalar inv_len_wu = scalar(1) / len_wu;
 		b3Vec3 n_wu = inv_len_wu * wu;
+		m_n_u = n_wu;
 
 		// Jacobian
 		b3Vec3 dCudx[3];
@@ -209,17 +224,13 @@ void b3StretchForce::ApplyForces(const b3SparseForceSolverData* data)
 				}
 			}
 
-			dfdx(i1, i1) += K[0][0];
-			dfdx(i1, i2) += K[0][1];
-			dfdx(i1, i3) += K[0][2];
-
-			dfdx(i2, i1) += K[1][0];
-			dfdx(i2, i2) += K[1][1];
-			dfdx(i2, i3) += K[1][2];
+			m_kxn_u = -m_ks_u * alpha * alpha;
+			if (len_wu > m_b_u)
+			{
+				m_kxt_u = -m_ks_u * Cu * alpha * inv_len_wu;
+			}
 
-			dfdx(i3, i1) += K[2][0];
-			dfdx(i3, i2) += K[2][1];
-			dfdx(i3, i3) += K[2][2];
+			AddJacobian(data->dfdx, data->dfdx_diag, &K[0][0], indices, 3);
 		}
 
 		if (m_kd_u > scalar(0))
@@ -258,17 +269,9 @@ void b3StretchForce::ApplyForces(const b3SparseForceSolverData* data)
 				}
 			}
 
-			dfdv(i1, i1) += K[0][0];
-			dfdv(i1, i2) += K[0][1];
-			dfdv(i1, i3) += K[0][2];
+			m_kvn_u = -m_kd_u * alpha * alpha;
 
-			dfdv(i2, i1) += K[1][0];
-			dfdv(i2, i2) += K[1][1];
-			dfdv(i2, i3) += K[1][2];
-
-			dfdv(i3, i1) += K[2][0];
-			dfdv(i3, i2) += K[2][1];
-			dfdv(i3, i3) += K[2][2];
+			AddJacobian(data->dfdv, data->dfdv_diag, &K[0][0], indices, 3);
 		}
 	}
 
@@ -276,6 +279,7 @@ void b3StretchForce::ApplyForces(const b3SparseForceSolverData* data)
 	{
 		scalar inv_len_wv = scalar(1) / len_wv;
 		b3Vec3 n_wv = inv_len_wv * wv;
+		m_n_v = n_wv;
 
 		// Jacobian
 		b3Vec3 dCvdx[3];
@@ -323,17 +327,13 @@ void b3StretchForce::ApplyForces(const b3SparseForceSolverData* data)
 				}
 			}
 
-			dfdx(i1, i1) += K[0][0];
-			dfdx(i1, i2) += K[0][1];
-			dfdx(i1, i3) += K[0][2];
-
-			dfdx(i2, i1) += K[1][0];
-			dfdx(i2, i2) += K[1][1];
-			dfdx(i2, i3) += K[1][2];
+			m_kxn_v = -m_ks_v * alpha * alpha;
+			if (len_wv > m_b_v)
+			{
+				m_kxt_v = -m_ks_v * Cv * alpha * inv_len_wv;
+			}
 
-			dfdx(i3, i1) += K[2][0];
-			dfdx(i3, i2) += K[2][1];
-			dfdx(i3, i3) += K[2][2];
+			AddJacobian(data->dfdx, data->dfdx_diag, &K[0][0], indices, 3);
 		}
 
 		if (m_kd_v > scalar(0))
@@ -373,17 +373,43 @@ void b3StretchForce::ApplyForces(const b3SparseForceSolverData* data)
 				}
 			}
 
-			dfdv(i1, i1) += K[0][0];
-			dfdv(i1, i2) += K[0][1];
-			dfdv(i1, i3) += K[0][2];
+			m_kvn_v = -m_kd_v * alpha * alpha;
 
-			dfdv(i2, i1) += K[1][0];
-			dfdv(i2, i2) += K[1][1];
-			dfdv(i2, i3) += K[1][2];
-
-			dfdv(i3, i1) += K[2][0];
-			dfdv(i3, i2) += K[2][1];
-			dfdv(i3, i3) += K[2][2];
+			AddJacobian(data->dfdv, data->dfdv_diag, &K[0][0], indices, 3);
 		}
 	}
+}
+
+// Multiply the off-diagonal blocks K_ij = w_i * w_j * (kn * n * n^T + kt * (I - n * n^T)) 
+// of the Jacobian in one direction by a vector.
+static void b3MultiplyStretch(b3DenseVec3& q, const b3DenseVec3& p, const uint32 indices[3], 
+	const b3Vec3& w, const b3Vec3& n, scalar kn, scalar kt)
+{
+	b3Vec3 s = w[0] * p[indices[0]] + w[1] * p[indices[1]] + w[2] * p[indices[2]];
+
+	for (uint32 i = 0; i < 3; ++i)
+	{
+		uint32 index = indices[i];
+
+		// Skip the diagonal block
+		b3Vec3 r = s - w[i] * p[index];
+
+		b3Vec3 rn = b3Dot(n, r) * n;
+
+		q[index] += w[i] * (kn * rn + kt * (r - rn));
+	}
+}
+
+void b3StretchForce::MultiplyJacobians(const b3SparseForceProductData* data) const
+{
+	const b3DenseVec3& p = *data->p;
+	b3DenseVec3& q = *data->q;
+
+	uint32 indices[3] = { m_p1->m_solverId, m_p2->m_solverId, m_p3->m_solverId };
+
+	scalar a = data->a;
+	scalar b = data->b;
+
+	b3MultiplyStretch(q, p, indices, m_dwudx, m_n_u, a * m_kxn_u + b * m_kvn_u, a * m_kxt_u);
+	b3MultiplyStretch(q, p, indices, m_dwvdx, m_n_v, a * m_kxn_v + b * m_kvn_v, a * m_kxt_v);
 }
\ No newline at end of file
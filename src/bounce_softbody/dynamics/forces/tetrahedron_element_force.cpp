@@ -21,6 +21,7 @@
 #include <bounce_softbody/sparse/sparse_force_solver.h>
 #include <bounce_softbody/sparse/dense_vec3.h>
 #include <bounce_softbody/sparse/sparse_mat33.h>
+#include <bounce_softbody/sparse/diag_mat33.h>
 
 // This work is based on the paper "Interactive Virtual Materials" written by 
 // Matthias Mueller Fischer
@@ -268,6 +269,15 @@ void b3TetrahedronElementForce::ClearForces()
 {
 }
 
+uint32 b3TetrahedronElementForce::GetParticles(b3Particle* particles[b3_maxForceParticles]) const
+{
+	particles[0] = m_p1;
+	particles[1] = m_p2;
+	particles[2] = m_p3;
+	particles[3] = m_p4;
+	return 4;
+}
+
 // Extract rotation from deformation
 // "A Robust Method to Extract the Rotational Part of Deformations", Matthias Muller et al.
 static b3Quat b3ExtractRotation(const b3Mat33& A, const b3Quat& q0, uint32 maxIterations = 32)
@@ -316,14 +326,12 @@ void b3TetrahedronElementForce::ApplyForces(const b3SparseForceSolverData* data)
 	const b3DenseVec3& v = *data->v;
 	
 	b3DenseVec3& f = *data->f;
-	
-	b3SparseMat33& dfdx = *data->dfdx;
-	b3SparseMat33& dfdv = *data->dfdv;
 
 	uint32 i1 = m_p1->m_solverId;
 	uint32 i2 = m_p2->m_solverId;
 	uint32 i3 = m_p3->m_solverId;
 	uint32 i4 = m_p4->m_solverId;
+	uint32 indices[4] = { i1, i2, i3, i4 };
 
 	b3Vec3 x1 = m_x1;
 	b3Vec3 x2 = m_x2;
@@ -375,20 +383,33 @@ void b3TetrahedronElementForce::ApplyForces(const b3SparseForceSolverData* data)
 		}
 	}
 
-	uint32 is[4] = { i1, i2, i3, i4 };
-	
-	for (uint32 i = 0; i < 4; ++i)
+	if (data->dfdx)
 	{
-		uint32 vi = is[i];
-
-		for (uint32 j = 0; j < 4; ++j)
+		b3SparseMat33& dfdx = *data->dfdx;
+		for (uint32 i = 0; i < 4; ++i)
 		{
-			uint32 vj = is[j];
+			for (uint32 j = 0; j < 4; ++j)
+			{
+				uint32 slot = m_slots[4 * i + j];
+				if (slot == B3_MAX_U32)
+				{
+					continue;
+				}
 
-			b3Mat33 k = K[i + 4 * j];
+				b3Mat33 k = K[i + 4 * j];
 
+				// Negate K
+				dfdx.values[slot] -= k;
+			}
+		}
+	}
+	else
+	{
+		b3DiagMat33& dfdx = *data->dfdx_diag;
+		for (uint32 i = 0; i < 4; ++i)
+		{
 			// Negate K
-			dfdx(vi, vj) -= k;
+			dfdx[indices[i]] -= K[i + 4 * i];
 		}
 	}
 
@@ -446,19 +467,73 @@ void b3TetrahedronElementForce::ApplyForces(const b3SparseForceSolverData* data)
 		f[i3] -= fds[2];
 		f[i4] -= fds[3];
 
-		for (uint32 i = 0; i < 4; ++i)
+		if (data->dfdv)
 		{
-			uint32 vi = is[i];
-
-			for (uint32 j = 0; j < 4; ++j)
+			b3SparseMat33& dfdv = *data->dfdv;
+			for (uint32 i = 0; i < 4; ++i)
+			{
+				for (uint32 j = 0; j < 4; ++j)
+				{
+					uint32 slot = m_slots[4 * i + j];
+					if (slot == B3_MAX_U32)
+					{
+						continue;
+					}
+
+					b3Mat33 k = K[i + 4 * j];
+
+					// Negate K
+					dfdv.values[slot] -= m_stiffnessDamping * k;
+				}
+			}
+		}
+		else
+		{
+			b3DiagMat33& dfdv = *data->dfdv_diag;
+			for (uint32 i = 0; i < 4; ++i)
 			{
-				uint32 vj = is[j];
+				// Negate K
+				dfdv[indices[i]] -= m_stiffnessDamping * K[i + 4 * i];
+			}
+		}
+	}
+}
 
-				b3Mat33 k = K[i + 4 * j];
+void b3TetrahedronElementForce::MultiplyJacobians(const b3SparseForceProductData* data) const
+{
+	const b3DenseVec3& p = *data->p;
+	b3DenseVec3& q = *data->q;
 
-				// Negate K
-				dfdv(vi, vj) -= m_stiffnessDamping * k;
+	uint32 indices[4] = { m_p1->m_solverId, m_p2->m_solverId, m_p3->m_solverId, m_p4->m_solverId };
+
+	// dfdv = k * dfdx 
+	scalar kd = m_stiffnessDamping > scalar(0) ? m_stiffnessDamping : scalar(0);
+	scalar k = data->a + data->b * kd;
+
+	// Rotation of the last call to ApplyForces
+	b3Mat33 R = m_q.GetRotationMatrix();
+	b3Mat33 RT = b3Transpose(R);
+
+	// Unrotate the vectors
+	b3Vec3 ps[4];
+	for (uint32 i = 0; i < 4; ++i)
+	{
+		ps[i] = RT * p[indices[i]];
+	}
+
+	// dfdx_ij = -R * K_ij * R^T
+	for (uint32 i = 0; i < 4; ++i)
+	{
+		b3Vec3 s;
+		s.SetZero();
+		for (uint32 j = 0; j < 4; ++j)
+		{
+			if (i != j)
+			{
+				s += m_K[i + 4 * j] * ps[j];
 			}
 		}
+
+		q[indices[i]] -= k * (R * s);
 	}
 }
\ No newline at end of file
@@ -21,6 +21,7 @@
 #include <bounce_softbody/sparse/sparse_force_solver.h>
 #include <bounce_softbody/sparse/dense_vec3.h>
 #include <bounce_softbody/sparse/sparse_mat33.h>
+#include <bounce_softbody/sparse/diag_mat33.h>
 
 // Implementation of "Adaptive cloth simulation using corotational finite elements" by 
 // Jan Bender and Crispin Deul.
@@ -196,6 +197,9 @@ b3TriangleElementForce::b3TriangleElementForce(const b3TriangleElementForceDef*
 	m_v2 = def->v2;
 	m_v3 = def->v3;
 	m_stiffnessDamping = def->stiffnessDamping;
+	m_R.SetIdentity();
+	m_px.SetZero();
+	m_py.SetZero();
 
 	ResetElementData();
 }
@@ -282,19 +286,25 @@ void b3TriangleElementForce::ClearForces()
 {
 }
 
+uint32 b3TriangleElementForce::GetParticles(b3Particle* particles[b3_maxForceParticles]) const
+{
+	particles[0] = m_p1;
+	particles[1] = m_p2;
+	particles[2] = m_p3;
+	return 3;
+}
+
 void b3TriangleElementForce::ApplyForces(const b3SparseForceSolverData* data)
 {
 	const b3DenseVec3& p = *data->x;
 	const b3DenseVec3& v = *data->v;
 
 	b3DenseVec3& f = *data->f;
-	
-	b3SparseMat33& dfdx = *data->dfdx;
-	b3SparseMat33& dfdv = *data->dfdv;
 
 	uint32 i1 = m_p1->m_solverId;
 	uint32 i2 = m_p2->m_solverId;
 	uint32 i3 = m_p3->m_solverId;
+	uint32 indices[3] = { i1, i2, i3 };
 
 	b3Vec3 p1 = p[i1];
 	b3Vec3 p2 = p[i2];
@@ -344,6 +354,11 @@ void b3TriangleElementForce::ApplyForces(const b3SparseForceSolverData* data)
 	// Inverse rotation
 	b3Mat22 RT = b3Transpose(R);
 
+	// Keep the frame for matrix-free products
+	m_R = R;
+	m_px = px;
+	m_py = py;
+
 	// 2D displacements in unrotated frame
 	b3Vec2 us[3];
 	us[0] = RT * x1 - m_x1;
@@ -410,20 +425,33 @@ void b3TriangleElementForce::ApplyForces(const b3SparseForceSolverData* data)
 		}
 	}
 
-	uint32 is[3] = { i1, i2, i3 };
-
-	for (uint32 i = 0; i < 3; ++i)
+	if (data->dfdx)
 	{
-		uint32 vi = is[i];
-
-		for (uint32 j = 0; j < 3; ++j)
+		b3SparseMat33& dfdx = *data->dfdx;
+		for (uint32 i = 0; i < 3; ++i)
 		{
-			uint32 vj = is[j];
+			for (uint32 j = 0; j < 3; ++j)
+			{
+				uint32 slot = m_slots[3 * i + j];
+				if (slot == B3_MAX_U32)
+				{
+					continue;
+				}
 
-			b3Mat33 k = K[i + 3 * j];
+				b3Mat33 k = K[i + 3 * j];
 
+				// Negate K 
+				dfdx.values[slot] -= k;
+			}
+		}
+	}
+	else
+	{
+		b3DiagMat33& dfdx = *data->dfdx_diag;
+		for (uint32 i = 0; i < 3; ++i)
+		{
 			// Negate K 
-			dfdx(vi, vj) -= k;
+			dfdx[indices[i]] -= K[i + 3 * i];
 		}
 	}
 
@@ -450,19 +478,74 @@ void b3TriangleElementForce::ApplyForces(const b3SparseForceSolverData* data)
 		f[i2] -= fds[1];
 		f[i3] -= fds[2];
 
-		for (uint32 i = 0; i < 3; ++i)
+		if (data->dfdv)
 		{
-			uint32 vi = is[i];
-
-			for (uint32 j = 0; j < 3; ++j)
+			b3SparseMat33& dfdv = *data->dfdv;
+			for (uint32 i = 0; i < 3; ++i)
+			{
+				for (uint32 j = 0; j < 3; ++j)
+				{
+					uint32 slot = m_slots[3 * i + j];
+					if (slot == B3_MAX_U32)
+					{
+						continue;
+					}
+
+					b3Mat33 k = K[i + 3 * j];
+
+					// Negate K
+					dfdv.values[slot] -= m_stiffnessDamping * k;
+				}
+			}
+		}
+		else
+		{
+			b3DiagMat33& dfdv = *data->dfdv_diag;
+			for (uint32 i = 0; i < 3; ++i)
 			{
-				uint32 vj = is[j];
+				// Negate K
+				dfdv[indices[i]] -= m_stiffnessDamping * K[i + 3 * i];
+			}
+		}
+	}
+}
 
-				b3Mat33 k = K[i + 3 * j];
+void b3TriangleElementForce::MultiplyJacobians(const b3SparseForceProductData* data) const
+{
+	const b3DenseVec3& p = *data->p;
+	b3DenseVec3& q = *data->q;
 
-				// Negate K
-				dfdv(vi, vj) -= m_stiffnessDamping * k;
+	uint32 indices[3] = { m_p1->m_solverId, m_p2->m_solverId, m_p3->m_solverId };
+
+	// dfdv = k * dfdx 
+	scalar kd = m_stiffnessDamping > scalar(0) ? m_stiffnessDamping : scalar(0);
+	scalar k = data->a + data->b * kd;
+
+	b3Mat22 RT = b3Transpose(m_R);
+
+	// Project the vectors to 2D and unrotate
+	b3Vec2 ps[3];
+	for (uint32 i = 0; i < 3; ++i)
+	{
+		b3Vec3 pi = p[indices[i]];
+		ps[i] = RT * b3Vec2(b3Dot(m_px, pi), b3Dot(m_py, pi));
+	}
+
+	// dfdx_ij = -P^T * R * K_ij * R^T * P
+	for (uint32 i = 0; i < 3; ++i)
+	{
+		b3Vec2 s;
+		s.SetZero();
+		for (uint32 j = 0; j < 3; ++j)
+		{
+			if (i != j)
+			{
+				s += m_K[i + 3 * j] * ps[j];
 			}
 		}
+
+		s = m_R * s;
+
+		q[indices[i]] -= k * (s.x * m_px + s.y * m_py);
 	}
 }
\ No newline at end of file
@@ -26,30 +26,42 @@
 #include <bounce_softbody/sparse/sparse_force_solver.h>
 #include <bounce_softbody/sparse/dense_vec3.h>
 #include <bounce_softbody/sparse/sparse_mat33.h>
+#include <bounce_softbody/sparse/diag_mat33.h>
 
 b3Particle::b3Particle(const b3ParticleDef& def, b3Body* body)
 {
 	m_body = body;
 	m_type = def.type;
-	m_position = def.position;
-	m_velocity = def.velocity;
-	m_force.SetZero();
-	m_translation.SetZero();
 	m_damping = def.damping;
 
+	m_storage = &body->m_particleStorage;
+	m_solverId = m_storage->Add(this);
+
+	uint32 i = m_solverId;
+	m_storage->positions[i] = def.position;
+	m_storage->velocities[i] = def.velocity;
+	m_storage->forces[i].SetZero();
+	m_storage->translations[i].SetZero();
+	m_storage->accelerations[i].SetZero();
+
 	if (m_type == e_dynamicParticle)
 	{
-		m_mass = scalar(1);
-		m_invMass = scalar(1);
+		m_storage->masses[i] = scalar(1);
+		m_storage->invMasses[i] = scalar(1);
 	}
 	else
 	{
-		m_mass = scalar(0);
-		m_invMass = scalar(0);
+		m_storage->masses[i] = scalar(0);
+		m_storage->invMasses[i] = scalar(0);
 	}
 
 	m_userIndex = def.userIndex;
 	m_userData = def.userData;
+
+	m_sphere = nullptr;
+	m_triangleList = nullptr;
+	m_tetrahedronList = nullptr;
+	m_forceList = nullptr;
 	
 	m_prev = nullptr;
 	m_next = nullptr;
@@ -64,118 +76,131 @@ void b3Particle::SetType(b3ParticleType type)
 
 	m_type = type;
 
+	uint32 i = m_solverId;
+
 	if (m_type == e_staticParticle || m_type == e_kinematicParticle)
 	{
-		m_mass = scalar(0);
-		m_invMass = scalar(0);
+		m_storage->masses[i] = scalar(0);
+		m_storage->invMasses[i] = scalar(0);
 	}
 	else
 	{
-		m_body->ResetMass();
+		ResetMass();
 	}
 
-	m_force.SetZero();
-	m_translation.SetZero();
+	m_storage->forces[i].SetZero();
+	m_storage->translations[i].SetZero();
+	m_storage->accelerations[i].SetZero();
 
 	if (type == e_staticParticle)
 	{
-		m_velocity.SetZero();
+		m_storage->velocities[i].SetZero();
 		SynchronizeFixtures();
 	}
 
 	DestroyContacts();
+
+	// The sphere of the particle might have new contacts.
+	if (m_sphere)
+	{
+		m_body->m_contactManager.TouchSphere(m_sphere);
+	}
 }
 
-void b3Particle::DestroyFixtures()
+void b3Particle::ResetMass()
 {
+	uint32 i = m_solverId;
+	scalar* masses = m_storage->masses;
+	scalar* invMasses = m_storage->invMasses;
+
+	// Static and kinematic particles have zero mass.
+	if (m_type == e_staticParticle || m_type == e_kinematicParticle)
+	{
+		masses[i] = scalar(0);
+		invMasses[i] = scalar(0);
+		return;
+	}
+
+	// Accumulate contribution of each fixture in the same order as b3Body::ResetMass.
+	// A particle that isn't shared by any fixture keeps its mass.
+	if (m_triangleList || m_tetrahedronList)
 	{
-		// Destroy spheres
-		b3SphereFixture* s = m_body->m_sphereList;
-		while (s)
+		scalar mass = scalar(0);
+
+		const scalar inv3 = scalar(1) / scalar(3);
+		for (b3FixtureEdge* e = m_triangleList; e; e = e->next)
 		{
-			b3SphereFixture* s0 = s;
-			s = s->m_next;
+			b3TriangleFixture* t = (b3TriangleFixture*)e->fixture;
+			mass += inv3 * (t->m_density * t->m_area);
+		}
 
-			if (s0->m_p == this)
-			{
-				m_body->DestroySphere(s0);
-			}
+		const scalar inv4 = scalar(1) / scalar(4);
+		for (b3FixtureEdge* e = m_tetrahedronList; e; e = e->next)
+		{
+			b3TetrahedronFixture* t = (b3TetrahedronFixture*)e->fixture;
+			mass += inv4 * (t->m_density * t->m_volume);
 		}
+
+		masses[i] = mass;
 	}
 
+	if (masses[i] > scalar(0))
 	{
-		// Destroy triangles
-		b3TriangleFixture* t = m_body->m_triangleList;
-		while (t)
-		{
-			b3TriangleFixture* t0 = t;
-			t = t->m_next;
+		invMasses[i] = scalar(1) / masses[i];
+	}
+	else
+	{
+		// Force all dynamic particles to have non-zero mass.
+		masses[i] = scalar(1);
+		invMasses[i] = scalar(1);
+	}
+}
 
-			if (t0->m_p1 == this || t0->m_p2 == this || t0->m_p3 == this)
-			{
-				m_body->DestroyTriangle(t0);
-			}
-		}
+void b3Particle::DestroyFixtures()
+{
+	// Destroy sphere
+	if (m_sphere)
+	{
+		m_body->DestroySphere(m_sphere);
 	}
 
+	// Destroy triangles
+	while (m_triangleList)
 	{
-		// Destroy tetrahedrons
-		b3TetrahedronFixture* t = m_body->m_tetrahedronList;
-		while (t)
-		{
-			b3TetrahedronFixture* t0 = t;
-			t = t->m_next;
+		m_body->DestroyTriangle((b3TriangleFixture*)m_triangleList->fixture);
+	}
 
-			if (t0->m_p1 == this || t0->m_p2 == this || t0->m_p3 == this || t0->m_p4 == this)
-			{
-				m_body->DestroyTetrahedron(t0);
-			}
-		}
+	// Destroy tetrahedrons
+	while (m_tetrahedronList)
+	{
+		m_body->DestroyTetrahedron((b3TetrahedronFixture*)m_tetrahedronList->fixture);
 	}
 }
 
 void b3Particle::DestroyForces()
 {
-	b3Force* f = m_body->m_forceList;
-	while (f)
+	while (m_forceList)
 	{
-		b3Force* f0 = f;
-		f = f->m_next;
-
-		if (f0->Contains(this))
-		{
-			m_body->DestroyForce(f0);
-		}
+		m_body->DestroyForce(m_forceList->force);
 	}
 }
 
 void b3Particle::DestroyContacts()
 {
-	// Destroy shape contacts
-	b3SphereAndShapeContact* c = m_body->m_contactManager.m_contactList;
-	while (c)
+	// Only the sphere of the particle can be in contact.
+	if (m_sphere)
 	{
-		if (c->m_fixture1->m_p == this)
-		{
-			b3SphereAndShapeContact* quack = c;
-			c = c->m_next;
-			m_body->m_contactManager.Destroy(quack);
-			continue;
-		}
-
-		c = c->m_next;
+		m_sphere->DestroyContacts();
 	}
 }
 
 void b3Particle::SynchronizeFixtures()
 {
 	// Synchronize triangles
-	for (b3TriangleFixture* t = m_body->m_triangleList; t; t = t->m_next)
+	for (b3FixtureEdge* e = m_triangleList; e; e = e->next)
 	{
-		if (t->m_p1 == this || t->m_p2 == this || t->m_p3 == this)
-		{
-			t->Synchronize(b3Vec3_zero);
-		}
+		b3TriangleFixture* t = (b3TriangleFixture*)e->fixture;
+		t->Synchronize(b3Vec3_zero);
 	}
 }
 
@@ -183,18 +208,27 @@ void b3Particle::ApplyForces(const b3SparseForceSolverData* data)
 {
 	const b3DenseVec3& v = *data->v;
 	b3DenseVec3& f = *data->f;
-	b3SparseMat33& dfdv = *data->dfdv;
 
 	uint32 i = m_solverId;
 
 	if (m_damping > scalar(0))
 	{
-		b3Vec3 fd = -m_damping * m_mass * v[i];
+		scalar mass = m_storage->masses[i];
+
+		b3Vec3 fd = -m_damping * mass * v[i];
 
 		// Mass damping force
 		f[i] += fd;
 
 		// Jacobian
-		dfdv(i, i) += b3Mat33Diagonal(-m_damping * m_mass);
+		b3Mat33 K = b3Mat33Diagonal(-m_damping * mass);
+		if (data->dfdv)
+		{
+			(*data->dfdv)(i, i) += K;
+		}
+		else
+		{
+			(*data->dfdv_diag)[i] += K;
+		}
 	}
 }
\ No newline at end of file
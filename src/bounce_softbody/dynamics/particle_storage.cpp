@@ -0,0 +1,333 @@
+/*
+* Copyright (c) 2016-2019 Irlan Robson
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <bounce_softbody/dynamics/particle_storage.h>
+#include <bounce_softbody/dynamics/particle.h>
+#include <bounce_softbody/common/memory/stack_allocator.h>
+#include <bounce_softbody/sparse/sparse_mat33.h>
+
+#include <algorithm>
+
+b3ParticleStorage::b3ParticleStorage()
+{
+	count = 0;
+	capacity = 0;
+	particles = nullptr;
+	positions = nullptr;
+	velocities = nullptr;
+	forces = nullptr;
+	translations = nullptr;
+	accelerations = nullptr;
+	masses = nullptr;
+	invMasses = nullptr;
+}
+
+b3ParticleStorage::~b3ParticleStorage()
+{
+	b3Free(particles);
+	b3Free(positions);
+	b3Free(velocities);
+	b3Free(forces);
+	b3Free(translations);
+	b3Free(accelerations);
+	b3Free(masses);
+	b3Free(invMasses);
+}
+
+// Reallocate an array keeping the first elements.
+template <typename T>
+static void b3Grow(T*& array, uint32 count, uint32 capacity)
+{
+	T* old = array;
+	array = (T*)b3Alloc(capacity * sizeof(T));
+	if (count > 0)
+	{
+		memcpy(array, old, count * sizeof(T));
+	}
+	b3Free(old);
+}
+
+void b3ParticleStorage::Reserve(uint32 _capacity)
+{
+	if (_capacity <= capacity)
+	{
+		return;
+	}
+
+	capacity = _capacity;
+
+	b3Grow(particles, count, capacity);
+	b3Grow(positions, count, capacity);
+	b3Grow(velocities, count, capacity);
+	b3Grow(forces, count, capacity);
+	b3Grow(translations, count, capacity);
+	b3Grow(accelerations, count, capacity);
+	b3Grow(masses, count, capacity);
+	b3Grow(invMasses, count, capacity);
+}
+
+uint32 b3ParticleStorage::GetByteCount() const
+{
+	// Keep in sync with Reserve.
+	uint32 elementSize = 0;
+	elementSize += sizeof(*particles);
+	elementSize += sizeof(*positions);
+	elementSize += sizeof(*velocities);
+	elementSize += sizeof(*forces);
+	elementSize += sizeof(*translations);
+	elementSize += sizeof(*accelerations);
+	elementSize += sizeof(*masses);
+	elementSize += sizeof(*invMasses);
+	return capacity * elementSize;
+}
+
+uint32 b3ParticleStorage::Add(b3Particle* particle)
+{
+	if (count == capacity)
+	{
+		Reserve(capacity > 0 ? 2 * capacity : 64);
+	}
+
+	uint32 index = count++;
+	particles[index] = particle;
+	return index;
+}
+
+void b3ParticleStorage::Remove(uint32 index)
+{
+	B3_ASSERT(index < count);
+
+	uint32 last = --count;
+	if (index == last)
+	{
+		return;
+	}
+
+	particles[index] = particles[last];
+	positions[index] = positions[last];
+	velocities[index] = velocities[last];
+	forces[index] = forces[last];
+	translations[index] = translations[last];
+	accelerations[index] = accelerations[last];
+	masses[index] = masses[last];
+	invMasses[index] = invMasses[last];
+
+	particles[index]->m_solverId = index;
+}
+
+// Gather the elements of an array in a given order.
+template <typename T>
+static void b3Gather(T* array, const uint32* order, uint32 count, void* buffer)
+{
+	T* temp = (T*)buffer;
+	for (uint32 i = 0; i < count; ++i)
+	{
+		temp[i] = array[order[i]];
+	}
+	memcpy(array, temp, count * sizeof(T));
+}
+
+void b3ParticleStorage::Permute(const uint32* order, b3StackAllocator* allocator)
+{
+	uint32 elementSize = b3Max(uint32(sizeof(b3Vec3)), uint32(sizeof(b3Particle*)));
+	void* buffer = allocator->Allocate(count * elementSize);
+
+	b3Gather(particles, order, count, buffer);
+	b3Gather(positions, order, count, buffer);
+	b3Gather(velocities, order, count, buffer);
+	b3Gather(forces, order, count, buffer);
+	b3Gather(translations, order, count, buffer);
+	b3Gather(accelerations, order, count, buffer);
+	b3Gather(masses, order, count, buffer);
+	b3Gather(invMasses, order, count, buffer);
+
+	allocator->Free(buffer);
+
+	for (uint32 i = 0; i < count; ++i)
+	{
+		particles[i]->m_solverId = i;
+	}
+}
+
+void b3ComputeCuthillMcKeeOrdering(uint32* order, const b3SparseMat33& pattern, b3StackAllocator* allocator)
+{
+	uint32 n = pattern.rowCount;
+
+	// The degree of a row is the number of its off-diagonal blocks.
+	uint32* degrees = (uint32*)allocator->Allocate(n * sizeof(uint32));
+	uint32 maxDegree = 0;
+	for (uint32 i = 0; i < n; ++i)
+	{
+		B3_ASSERT(pattern.rowPtrs[i + 1] > pattern.rowPtrs[i]);
+		degrees[i] = pattern.rowPtrs[i + 1] - pattern.rowPtrs[i] - 1;
+		maxDegree = b3Max(maxDegree, degrees[i]);
+	}
+
+	// Sort the rows by degree for choosing the first row of each component.
+	uint32* offsets = (uint32*)allocator->Allocate((maxDegree + 2) * sizeof(uint32));
+	for (uint32 i = 0; i < maxDegree + 2; ++i)
+	{
+		offsets[i] = 0;
+	}
+
+	for (uint32 i = 0; i < n; ++i)
+	{
+		++offsets[degrees[i] + 1];
+	}
+
+	for (uint32 i = 0; i < maxDegree + 1; ++i)
+	{
+		offsets[i + 1] += offsets[i];
+	}
+
+	uint32* sorted = (uint32*)allocator->Allocate(n * sizeof(uint32));
+	for (uint32 i = 0; i < n; ++i)
+	{
+		sorted[offsets[degrees[i]]++] = i;
+	}
+
+	bool* visited = (bool*)allocator->Allocate(n * sizeof(bool));
+	for (uint32 i = 0; i < n; ++i)
+	{
+		visited[i] = false;
+	}
+
+	// Breadth-first search from a row of minimum degree in each component.
+	// The neighbors of a row are visited in increasing degree. 
+	// The order array is the queue of the search.
+	uint32 head = 0, tail = 0;
+	for (uint32 s = 0; s < n; ++s)
+	{
+		uint32 start = sorted[s];
+		if (visited[start])
+		{
+			continue;
+		}
+
+		visited[start] = true;
+		order[tail++] = start;
+
+		while (head < tail)
+		{
+			uint32 i = order[head++];
+
+			uint32 first = tail;
+			for (uint32 p = pattern.rowPtrs[i]; p < pattern.rowPtrs[i + 1]; ++p)
+			{
+				uint32 j = pattern.columns[p];
+				if (visited[j] == false)
+				{
+					visited[j] = true;
+					order[tail++] = j;
+				}
+			}
+
+			// Insertion sort
+			for (uint32 k = first + 1; k < tail; ++k)
+			{
+				uint32 j = order[k];
+				uint32 m = k;
+				while (m > first && degrees[order[m - 1]] > degrees[j])
+				{
+					order[m] = order[m - 1];
+					--m;
+				}
+				order[m] = j;
+			}
+		}
+	}
+
+	B3_ASSERT(tail == n);
+
+	allocator->Free(visited);
+	allocator->Free(sorted);
+	allocator->Free(offsets);
+	allocator->Free(degrees);
+
+	// Reverse
+	for (uint32 i = 0; i < n / 2; ++i)
+	{
+		b3Swap(order[i], order[n - 1 - i]);
+	}
+}
+
+// Spread the lower 10 bits of a value to every third bit.
+static inline uint32 b3SpreadBits(uint32 x)
+{
+	x &= 0x000003FF;
+	x = (x | (x << 16)) & 0xFF0000FF;
+	x = (x | (x << 8)) & 0x0300F00F;
+	x = (x | (x << 4)) & 0x030C30C3;
+	x = (x | (x << 2)) & 0x09249249;
+	return x;
+}
+
+struct b3MortonPredicate
+{
+	bool operator()(uint32 i1, uint32 i2) const
+	{
+		if (codes[i1] != codes[i2])
+		{
+			return codes[i1] < codes[i2];
+		}
+		return i1 < i2;
+	}
+
+	const uint32* codes;
+};
+
+void b3ComputeMortonOrdering(uint32* order, const b3Vec3* points, uint32 count, b3StackAllocator* allocator)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	b3Vec3 lower = points[0], upper = points[0];
+	for (uint32 i = 1; i < count; ++i)
+	{
+		lower = b3Min(lower, points[i]);
+		upper = b3Max(upper, points[i]);
+	}
+
+	// Quantize the points to a grid of 1024 cells along the longest axis.
+	b3Vec3 d = upper - lower;
+	scalar extent = b3Max(d.x, b3Max(d.y, d.z));
+	scalar scale = extent > scalar(0) ? scalar(1023) / extent : scalar(0);
+
+	uint32* codes = (uint32*)allocator->Allocate(count * sizeof(uint32));
+	for (uint32 i = 0; i < count; ++i)
+	{
+		b3Vec3 q = scale * (points[i] - lower);
+		
+		uint32 x = uint32(q.x);
+		uint32 y = uint32(q.y);
+		uint32 z = uint32(q.z);
+
+		codes[i] = (b3SpreadBits(x) << 2) | (b3SpreadBits(y) << 1) | b3SpreadBits(z);
+
+		order[i] = i;
+	}
+
+	b3MortonPredicate predicate;
+	predicate.codes = codes;
+
+	std::sort(order, order + count, predicate);
+
+	allocator->Free(codes);
+}
@@ -0,0 +1,67 @@
+/*
+* Copyright (c) 2016-2019 Irlan Robson
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <bounce_softbody/dynamics/solver_stats.h>
+
+b3SolverStatsHistory::b3SolverStatsHistory()
+{
+	m_stats = nullptr;
+	m_capacity = 0;
+	m_count = 0;
+	m_head = 0;
+}
+
+b3SolverStatsHistory::~b3SolverStatsHistory()
+{
+	b3Free(m_stats);
+}
+
+void b3SolverStatsHistory::SetCapacity(uint32 capacity)
+{
+	b3Free(m_stats);
+	m_stats = nullptr;
+	
+	m_capacity = capacity;
+	if (m_capacity > 0)
+	{
+		m_stats = (b3SolverStats*)b3Alloc(m_capacity * sizeof(b3SolverStats));
+	}
+
+	Clear();
+}
+
+void b3SolverStatsHistory::Add(const b3SolverStats& stats)
+{
+	if (m_capacity == 0)
+	{
+		return;
+	}
+
+	m_stats[m_head] = stats;
+	m_head = (m_head + 1) % m_capacity;
+	if (m_count < m_capacity)
+	{
+		++m_count;
+	}
+}
+
+void b3SolverStatsHistory::Clear()
+{
+	m_count = 0;
+	m_head = 0;
+}
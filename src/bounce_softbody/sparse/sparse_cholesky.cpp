@@ -0,0 +1,864 @@
+/*
+* Copyright (c) 2016-2019 Irlan Robson
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <bounce_softbody/sparse/sparse_cholesky.h>
+#include <bounce_softbody/sparse/sparse_mat33.h>
+#include <bounce_softbody/sparse/dense_vec3.h>
+
+b3SparseCholesky::b3SparseCholesky()
+{
+	rowCount = 0;
+	blockCount = 0;
+	permutation = nullptr;
+	inversePermutation = nullptr;
+	factorBlockCount = 0;
+	columnPtrs = nullptr;
+	rows = nullptr;
+	values = nullptr;
+	rowPtrs = nullptr;
+	rowColumns = nullptr;
+	diagonal = nullptr;
+	invDiagonal = nullptr;
+	work = nullptr;
+	next = nullptr;
+	y = nullptr;
+}
+
+b3SparseCholesky::~b3SparseCholesky()
+{
+	Reset();
+}
+
+void b3SparseCholesky::Reset()
+{
+	b3Free(permutation);
+	b3Free(inversePermutation);
+	b3Free(columnPtrs);
+	b3Free(rows);
+	b3Free(values);
+	b3Free(rowPtrs);
+	b3Free(rowColumns);
+	b3Free(diagonal);
+	b3Free(invDiagonal);
+	b3Free(work);
+	b3Free(next);
+	b3Free(y);
+
+	rowCount = 0;
+	blockCount = 0;
+	permutation = nullptr;
+	inversePermutation = nullptr;
+	factorBlockCount = 0;
+	columnPtrs = nullptr;
+	rows = nullptr;
+	values = nullptr;
+	rowPtrs = nullptr;
+	rowColumns = nullptr;
+	diagonal = nullptr;
+	invDiagonal = nullptr;
+	work = nullptr;
+	next = nullptr;
+	y = nullptr;
+}
+
+bool b3SparseCholesky::IsCompatible(const b3SparseMat33& A) const
+{
+	return permutation != nullptr && rowCount == A.rowCount && blockCount == A.blockCount;
+}
+
+uint32 b3SparseCholesky::GetByteCount() const
+{
+	if (permutation == nullptr)
+	{
+		return 0;
+	}
+
+	uint32 n = rowCount;
+
+	uint32 byteCount = 0;
+	byteCount += 3 * n * sizeof(uint32); // permutation, inversePermutation, next
+	byteCount += 2 * (n + 1) * sizeof(uint32); // columnPtrs, rowPtrs
+	byteCount += factorBlockCount * (2 * sizeof(uint32) + sizeof(b3Mat33)); // rows, rowColumns, values
+	byteCount += 3 * n * sizeof(b3Mat33); // diagonal, invDiagonal, work
+	byteCount += n * sizeof(b3Vec3); // y
+	return byteCount;
+}
+
+// A growable array of indices.
+struct b3IndexArray
+{
+	uint32* indices;
+	uint32 count;
+	uint32 capacity;
+};
+
+static void b3PushIndex(b3IndexArray& a, uint32 index)
+{
+	if (a.count == a.capacity)
+	{
+		uint32 capacity = a.capacity > 0 ? 2 * a.capacity : 8;
+		uint32* indices = (uint32*)b3Alloc(capacity * sizeof(uint32));
+		if (a.count > 0)
+		{
+			memcpy(indices, a.indices, a.count * sizeof(uint32));
+		}
+		b3Free(a.indices);
+		a.indices = indices;
+		a.capacity = capacity;
+	}
+
+	a.indices[a.count++] = index;
+}
+
+// Lists of the variables of each approximate degree.
+struct b3DegreeLists
+{
+	uint32* head; // first variable of a degree
+	uint32* next;
+	uint32* prev;
+	uint32 minDegree;
+};
+
+static void b3InsertVariable(b3DegreeLists& lists, uint32 i, uint32 degree)
+{
+	uint32 first = lists.head[degree];
+	lists.next[i] = first;
+	lists.prev[i] = B3_MAX_U32;
+	if (first != B3_MAX_U32)
+	{
+		lists.prev[first] = i;
+	}
+	lists.head[degree] = i;
+	lists.minDegree = b3Min(lists.minDegree, degree);
+}
+
+static void b3RemoveVariable(b3DegreeLists& lists, uint32 i, uint32 degree)
+{
+	if (lists.prev[i] != B3_MAX_U32)
+	{
+		lists.next[lists.prev[i]] = lists.next[i];
+	}
+	else
+	{
+		lists.head[degree] = lists.next[i];
+	}
+
+	if (lists.next[i] != B3_MAX_U32)
+	{
+		lists.prev[lists.next[i]] = lists.prev[i];
+	}
+}
+
+// States of the nodes of the quotient graph.
+enum b3QuotientNodeState
+{
+	e_variableNode, // a principal supervariable
+	e_elementNode, // an eliminated supervariable
+	e_absorbedNode, // an element absorbed by another element
+	e_mergedNode // a variable merged into a supervariable
+};
+
+// Compute a fill-reducing ordering using the approximate minimum degree algorithm.
+// The elimination graph is represented implicitly by a quotient graph of variables and elements.
+// An element is an eliminated supervariable whose neighbours form a clique, so the cliques are never stored.
+// A variable i is adjacent to the elements E_i and to the variables A_i. 
+// An element e is adjacent to the variables L_e.
+// - Element absorption: the elements adjacent to a pivot are absorbed by the new element.
+// - Aggressive absorption: an element whose variables are all in the new element is absorbed.
+// - Approximate degrees: the external degree of a variable is bounded in terms of |L_e \ L_p|.
+// - Supervariables: variables with the same adjacency are merged and eliminated together.
+// - Mass elimination: a variable adjacent only to the new element is eliminated with the pivot.
+// See "An approximate minimum degree ordering algorithm", Amestoy, Davis and Duff.
+static void b3ComputeAMD(uint32* permutation, const b3SparseMat33& A)
+{
+	uint32 n = A.rowCount;
+	if (n == 0)
+	{
+		return;
+	}
+
+	b3IndexArray* elements = (b3IndexArray*)b3Alloc(n * sizeof(b3IndexArray)); // E_i
+	b3IndexArray* adjacency = (b3IndexArray*)b3Alloc(n * sizeof(b3IndexArray)); // A_i or L_e
+	uint32* state = (uint32*)b3Alloc(n * sizeof(uint32));
+	uint32* size = (uint32*)b3Alloc(n * sizeof(uint32)); // number of variables of a supervariable
+	uint32* degree = (uint32*)b3Alloc(n * sizeof(uint32)); // approximate external degree or |L_e|
+	uint32* nextMember = (uint32*)b3Alloc(n * sizeof(uint32));
+	uint32* lastMember = (uint32*)b3Alloc(n * sizeof(uint32));
+	uint32* marks = (uint32*)b3Alloc(n * sizeof(uint32));
+	uint32* external = (uint32*)b3Alloc(n * sizeof(uint32)); // |L_e \ L_p|
+	uint32* externalPivot = (uint32*)b3Alloc(n * sizeof(uint32));
+	uint32* hash = (uint32*)b3Alloc(n * sizeof(uint32));
+	uint32* hashHead = (uint32*)b3Alloc(n * sizeof(uint32));
+	uint32* hashNext = (uint32*)b3Alloc(n * sizeof(uint32));
+
+	b3DegreeLists lists;
+	lists.head = (uint32*)b3Alloc(n * sizeof(uint32));
+	lists.next = (uint32*)b3Alloc(n * sizeof(uint32));
+	lists.prev = (uint32*)b3Alloc(n * sizeof(uint32));
+	lists.minDegree = n;
+
+	for (uint32 i = 0; i < n; ++i)
+	{
+		b3IndexArray& Ai = adjacency[i];
+		Ai.indices = nullptr;
+		Ai.count = 0;
+		Ai.capacity = 0;
+
+		for (uint32 k = A.rowPtrs[i]; k < A.rowPtrs[i + 1]; ++k)
+		{
+			uint32 j = A.columns[k];
+			if (j != i)
+			{
+				b3PushIndex(Ai, j);
+			}
+		}
+
+		b3IndexArray& Ei = elements[i];
+		Ei.indices = nullptr;
+		Ei.count = 0;
+		Ei.capacity = 0;
+
+		state[i] = e_variableNode;
+		size[i] = 1;
+		degree[i] = Ai.count;
+		nextMember[i] = B3_MAX_U32;
+		lastMember[i] = i;
+		marks[i] = 0;
+		externalPivot[i] = B3_MAX_U32;
+		hashHead[i] = B3_MAX_U32;
+		lists.head[i] = B3_MAX_U32;
+	}
+
+	// Insert in reverse order so that ties are taken in increasing order first.
+	for (uint32 i = n; i > 0; --i)
+	{
+		b3InsertVariable(lists, i - 1, degree[i - 1]);
+	}
+
+	uint32 stamp = 0;
+	uint32 orderedCount = 0;
+
+	while (orderedCount < n)
+	{
+		// Select a variable of minimum approximate degree.
+		while (lists.head[lists.minDegree] == B3_MAX_U32)
+		{
+			++lists.minDegree;
+			B3_ASSERT(lists.minDegree < n);
+		}
+
+		uint32 p = lists.head[lists.minDegree];
+		b3RemoveVariable(lists, p, degree[p]);
+
+		// Form the new element L_p = (A_p U L_e for e in E_p) \ p.
+		++stamp;
+		marks[p] = stamp;
+
+		b3IndexArray Lp;
+		Lp.indices = nullptr;
+		Lp.count = 0;
+		Lp.capacity = 0;
+
+		uint32 LpSize = 0;
+
+		for (uint32 q = 0; q < adjacency[p].count; ++q)
+		{
+			uint32 j = adjacency[p].indices[q];
+			if (state[j] == e_variableNode && marks[j] != stamp)
+			{
+				marks[j] = stamp;
+				b3PushIndex(Lp, j);
+				LpSize += size[j];
+			}
+		}
+
+		for (uint32 q = 0; q < elements[p].count; ++q)
+		{
+			uint32 e = elements[p].indices[q];
+			if (state[e] != e_elementNode)
+			{
+				continue;
+			}
+
+			for (uint32 r = 0; r < adjacency[e].count; ++r)
+			{
+				uint32 j = adjacency[e].indices[r];
+				if (state[j] == e_variableNode && marks[j] != stamp)
+				{
+					marks[j] = stamp;
+					b3PushIndex(Lp, j);
+					LpSize += size[j];
+				}
+			}
+
+			// Element absorption.
+			state[e] = e_absorbedNode;
+			b3Free(adjacency[e].indices);
+			adjacency[e].indices = nullptr;
+			adjacency[e].count = 0;
+			adjacency[e].capacity = 0;
+		}
+
+		b3Free(adjacency[p].indices);
+		b3Free(elements[p].indices);
+		elements[p].indices = nullptr;
+		elements[p].count = 0;
+		elements[p].capacity = 0;
+
+		state[p] = e_elementNode;
+		adjacency[p] = Lp;
+
+		// The variables of L_p are reinserted with their new degrees.
+		for (uint32 q = 0; q < Lp.count; ++q)
+		{
+			uint32 i = Lp.indices[q];
+			b3RemoveVariable(lists, i, degree[i]);
+		}
+
+		// Compute |L_e \ L_p| for the other elements adjacent to L_p.
+		for (uint32 q = 0; q < Lp.count; ++q)
+		{
+			uint32 i = Lp.indices[q];
+			const b3IndexArray& Ei = elements[i];
+			for (uint32 r = 0; r < Ei.count; ++r)
+			{
+				uint32 e = Ei.indices[r];
+				if (state[e] != e_elementNode)
+				{
+					continue;
+				}
+
+				if (externalPivot[e] != p)
+				{
+					externalPivot[e] = p;
+					external[e] = degree[e];
+				}
+
+				B3_ASSERT(external[e] >= size[i]);
+				external[e] -= size[i];
+			}
+		}
+
+		// Update the variables of L_p.
+		for (uint32 q = 0; q < Lp.count; ++q)
+		{
+			uint32 i = Lp.indices[q];
+
+			uint32 bound = 0;
+			uint32 h = 0;
+
+			// Remove the absorbed elements from E_i and sum |L_e \ L_p|.
+			b3IndexArray& Ei = elements[i];
+			uint32 count = 0;
+			for (uint32 r = 0; r < Ei.count; ++r)
+			{
+				uint32 e = Ei.indices[r];
+				if (state[e] != e_elementNode || e == p)
+				{
+					continue;
+				}
+
+				if (external[e] == 0)
+				{
+					// Aggressive absorption.
+					state[e] = e_absorbedNode;
+					b3Free(adjacency[e].indices);
+					adjacency[e].indices = nullptr;
+					adjacency[e].count = 0;
+					adjacency[e].capacity = 0;
+					continue;
+				}
+
+				bound += external[e];
+				h += e;
+				Ei.indices[count++] = e;
+			}
+			Ei.count = count;
+
+			// Remove the variables of L_p, which are adjacent through p, and the merged variables from A_i.
+			b3IndexArray& Ai = adjacency[i];
+			count = 0;
+			for (uint32 r = 0; r < Ai.count; ++r)
+			{
+				uint32 j = Ai.indices[r];
+				if (state[j] != e_variableNode || marks[j] == stamp)
+				{
+					continue;
+				}
+
+				bound += size[j];
+				h += j;
+				Ai.indices[count++] = j;
+			}
+			Ai.count = count;
+
+			if (Ei.count == 0 && Ai.count == 0)
+			{
+				// Mass elimination.
+				// The variable is adjacent only to p, so it is eliminated with p.
+				state[i] = e_mergedNode;
+				size[p] += size[i];
+				nextMember[lastMember[p]] = i;
+				lastMember[p] = lastMember[i];
+				LpSize -= size[i];
+
+				b3Free(Ei.indices);
+				b3Free(Ai.indices);
+				Ei.indices = nullptr;
+				Ei.capacity = 0;
+				Ai.indices = nullptr;
+				Ai.capacity = 0;
+				continue;
+			}
+
+			b3PushIndex(Ei, p);
+
+			// Approximate external degree.
+			uint32 LpExternal = LpSize - size[i];
+			degree[i] = b3Min(degree[i], bound) + LpExternal;
+			hash[i] = h % n;
+		}
+
+		// Find the supervariables in L_p.
+		// Variables with the same elements and variables are indistinguishable.
+		for (uint32 q = 0; q < Lp.count; ++q)
+		{
+			uint32 i = Lp.indices[q];
+			if (state[i] == e_variableNode)
+			{
+				hashNext[i] = hashHead[hash[i]];
+				hashHead[hash[i]] = i;
+			}
+		}
+
+		for (uint32 q = 0; q < Lp.count; ++q)
+		{
+			uint32 i = Lp.indices[q];
+			if (state[i] != e_variableNode || hashHead[hash[i]] == B3_MAX_U32)
+			{
+				continue;
+			}
+
+			uint32 bucket = hash[i];
+			for (uint32 u = hashHead[bucket]; u != B3_MAX_U32; u = hashNext[u])
+			{
+				if (state[u] != e_variableNode)
+				{
+					continue;
+				}
+
+				++stamp;
+				for (uint32 r = 0; r < elements[u].count; ++r)
+				{
+					marks[elements[u].indices[r]] = stamp;
+				}
+				for (uint32 r = 0; r < adjacency[u].count; ++r)
+				{
+					marks[adjacency[u].indices[r]] = stamp;
+				}
+
+				for (uint32 v = hashNext[u]; v != B3_MAX_U32; v = hashNext[v])
+				{
+					if (state[v] != e_variableNode)
+					{
+						continue;
+					}
+
+					if (elements[v].count != elements[u].count || adjacency[v].count != adjacency[u].count)
+					{
+						continue;
+					}
+
+					bool same = true;
+					for (uint32 r = 0; r < elements[v].count && same; ++r)
+					{
+						same = marks[elements[v].indices[r]] == stamp;
+					}
+					for (uint32 r = 0; r < adjacency[v].count && same; ++r)
+					{
+						same = marks[adjacency[v].indices[r]] == stamp;
+					}
+
+					if (same)
+					{
+						// Merge v into u.
+						// v was external to u.
+						degree[u] = degree[u] > size[v] ? degree[u] - size[v] : 0;
+						size[u] += size[v];
+						state[v] = e_mergedNode;
+						nextMember[lastMember[u]] = v;
+						lastMember[u] = lastMember[v];
+
+						b3Free(elements[v].indices);
+						b3Free(adjacency[v].indices);
+						elements[v].indices = nullptr;
+						elements[v].count = 0;
+						elements[v].capacity = 0;
+						adjacency[v].indices = nullptr;
+						adjacency[v].count = 0;
+						adjacency[v].capacity = 0;
+					}
+				}
+			}
+
+			hashHead[bucket] = B3_MAX_U32;
+		}
+
+		// Remove the merged variables from L_p and reinsert the variables.
+		uint32 remainingCount = n - orderedCount - size[p];
+
+		uint32 count = 0;
+		LpSize = 0;
+		for (uint32 q = 0; q < Lp.count; ++q)
+		{
+			uint32 i = Lp.indices[q];
+			if (state[i] != e_variableNode)
+			{
+				continue;
+			}
+
+			degree[i] = b3Min(degree[i], remainingCount - size[i]);
+			b3InsertVariable(lists, i, degree[i]);
+
+			LpSize += size[i];
+			Lp.indices[count++] = i;
+		}
+		Lp.count = count;
+
+		adjacency[p] = Lp;
+		degree[p] = LpSize;
+
+		// Order the variables of the pivot.
+		for (uint32 v = p; v != B3_MAX_U32; v = nextMember[v])
+		{
+			permutation[orderedCount++] = v;
+		}
+
+		B3_ASSERT(orderedCount == n - remainingCount);
+	}
+
+	for (uint32 i = 0; i < n; ++i)
+	{
+		b3Free(elements[i].indices);
+		b3Free(adjacency[i].indices);
+	}
+
+	b3Free(lists.prev);
+	b3Free(lists.next);
+	b3Free(lists.head);
+	b3Free(hashNext);
+	b3Free(hashHead);
+	b3Free(hash);
+	b3Free(externalPivot);
+	b3Free(external);
+	b3Free(marks);
+	b3Free(lastMember);
+	b3Free(nextMember);
+	b3Free(degree);
+	b3Free(size);
+	b3Free(state);
+	b3Free(adjacency);
+	b3Free(elements);
+}
+
+// The ordering is computed by the approximate minimum degree algorithm.
+// The block structure of L is computed from the elimination tree of P * A * P^T.
+// The rows of a row of L are the nodes of the subtree of the elimination tree 
+// reached from the lower blocks of the row of P * A * P^T.
+// See "A compact row storage scheme for Cholesky factors using elimination trees", Liu.
+void b3SparseCholesky::Analyze(const b3SparseMat33& A)
+{
+	Reset();
+
+	uint32 n = A.rowCount;
+
+	rowCount = n;
+	blockCount = A.blockCount;
+
+	permutation = (uint32*)b3Alloc(n * sizeof(uint32));
+	inversePermutation = (uint32*)b3Alloc(n * sizeof(uint32));
+	columnPtrs = (uint32*)b3Alloc((n + 1) * sizeof(uint32));
+
+	b3ComputeAMD(permutation, A);
+
+	for (uint32 k = 0; k < n; ++k)
+	{
+		inversePermutation[permutation[k]] = k;
+	}
+
+	// Compute the elimination tree.
+	uint32* parent = (uint32*)b3Alloc(n * sizeof(uint32));
+	uint32* ancestor = (uint32*)b3Alloc(n * sizeof(uint32));
+	for (uint32 k = 0; k < n; ++k)
+	{
+		parent[k] = B3_MAX_U32;
+		ancestor[k] = B3_MAX_U32;
+
+		uint32 row = permutation[k];
+		for (uint32 q = A.rowPtrs[row]; q < A.rowPtrs[row + 1]; ++q)
+		{
+			// Walk up to the root of the subtree, compressing the path to k.
+			uint32 i = inversePermutation[A.columns[q]];
+			while (i < k)
+			{
+				uint32 next = ancestor[i];
+				ancestor[i] = k;
+				if (next == B3_MAX_U32)
+				{
+					parent[i] = k;
+					break;
+				}
+				i = next;
+			}
+		}
+	}
+
+	b3Free(ancestor);
+
+	// Count the blocks of each column of L.
+	uint32* marks = (uint32*)b3Alloc(n * sizeof(uint32));
+	next = (uint32*)b3Alloc(n * sizeof(uint32));
+
+	for (uint32 k = 0; k < n + 1; ++k)
+	{
+		columnPtrs[k] = 0;
+	}
+
+	for (uint32 k = 0; k < n; ++k)
+	{
+		marks[k] = k;
+
+		uint32 row = permutation[k];
+		for (uint32 q = A.rowPtrs[row]; q < A.rowPtrs[row + 1]; ++q)
+		{
+			for (uint32 i = inversePermutation[A.columns[q]]; i < k && marks[i] != k; i = parent[i])
+			{
+				++columnPtrs[i + 1];
+				marks[i] = k;
+			}
+		}
+	}
+
+	for (uint32 k = 0; k < n; ++k)
+	{
+		columnPtrs[k + 1] += columnPtrs[k];
+		next[k] = columnPtrs[k];
+	}
+
+	factorBlockCount = columnPtrs[n];
+	rows = (uint32*)b3Alloc(factorBlockCount * sizeof(uint32));
+	values = (b3Mat33*)b3Alloc(factorBlockCount * sizeof(b3Mat33));
+
+	// Store the rows of each column of L.
+	// Rows are visited in increasing order, so the rows of each column are sorted.
+	for (uint32 k = 0; k < n; ++k)
+	{
+		marks[k] = k;
+
+		uint32 row = permutation[k];
+		for (uint32 q = A.rowPtrs[row]; q < A.rowPtrs[row + 1]; ++q)
+		{
+			for (uint32 i = inversePermutation[A.columns[q]]; i < k && marks[i] != k; i = parent[i])
+			{
+				rows[next[i]++] = k;
+				marks[i] = k;
+			}
+		}
+	}
+
+	b3Free(marks);
+	b3Free(parent);
+
+	// Transpose the structure of L.
+	rowPtrs = (uint32*)b3Alloc((n + 1) * sizeof(uint32));
+	rowColumns = (uint32*)b3Alloc(factorBlockCount * sizeof(uint32));
+
+	for (uint32 i = 0; i < n + 1; ++i)
+	{
+		rowPtrs[i] = 0;
+	}
+
+	for (uint32 q = 0; q < factorBlockCount; ++q)
+	{
+		++rowPtrs[rows[q] + 1];
+	}
+
+	for (uint32 i = 0; i < n; ++i)
+	{
+		rowPtrs[i + 1] += rowPtrs[i];
+		next[i] = rowPtrs[i];
+	}
+
+	// Columns are visited in increasing order, so the columns of each row are sorted.
+	for (uint32 k = 0; k < n; ++k)
+	{
+		for (uint32 q = columnPtrs[k]; q < columnPtrs[k + 1]; ++q)
+		{
+			rowColumns[next[rows[q]]++] = k;
+		}
+	}
+
+	diagonal = (b3Mat33*)b3Alloc(n * sizeof(b3Mat33));
+	invDiagonal = (b3Mat33*)b3Alloc(n * sizeof(b3Mat33));
+	work = (b3Mat33*)b3Alloc(n * sizeof(b3Mat33));
+	y = (b3Vec3*)b3Alloc(n * sizeof(b3Vec3));
+}
+
+// Return true if a symmetric 3x3 matrix is positive definite.
+static bool b3IsPositiveDefinite(const b3Mat33& A)
+{
+	scalar d1 = A.x.x;
+	scalar d2 = A.x.x * A.y.y - A.x.y * A.y.x;
+	scalar d3 = b3Det(A.x, A.y, A.z);
+	return d1 > scalar(0) && d2 > scalar(0) && d3 > scalar(0);
+}
+
+// Zero the entries of a block of L that are negligible against the unit diagonal.
+// Fill blocks of weakly coupled particles decay towards denormal numbers otherwise, 
+// which are very slow on most processors.
+static inline void b3FlushTiny(b3Mat33& A)
+{
+	const scalar tolerance = B3_EPSILON * B3_EPSILON;
+
+	for (uint32 i = 0; i < 3; ++i)
+	{
+		for (uint32 j = 0; j < 3; ++j)
+		{
+			if (b3Abs(A[i][j]) < tolerance)
+			{
+				A[i][j] = scalar(0);
+			}
+		}
+	}
+}
+
+// Left-looking factorization. The column k of L is computed from the columns j < k
+// with a block in the row k. The next block of each column is tracked,
+// which is the block in the row k when column k is computed.
+bool b3SparseCholesky::Factorize(const b3SparseMat33& A)
+{
+	B3_ASSERT(IsCompatible(A));
+
+	uint32 n = rowCount;
+
+	for (uint32 j = 0; j < n; ++j)
+	{
+		next[j] = columnPtrs[j];
+	}
+
+	for (uint32 k = 0; k < n; ++k)
+	{
+		// Scatter the column k of P * A * P^T on and below the diagonal.
+		work[k].SetZero();
+		for (uint32 q = columnPtrs[k]; q < columnPtrs[k + 1]; ++q)
+		{
+			work[rows[q]].SetZero();
+		}
+
+		// A is symmetric, so the column is the transposed row.
+		uint32 row = permutation[k];
+		for (uint32 p = A.rowPtrs[row]; p < A.rowPtrs[row + 1]; ++p)
+		{
+			uint32 i = inversePermutation[A.columns[p]];
+			if (i >= k)
+			{
+				work[i] += b3Transpose(A.values[p]);
+			}
+		}
+
+		// Subtract L_ij * D_j * L_kj^T for the columns j with a block in the row k.
+		for (uint32 r = rowPtrs[k]; r < rowPtrs[k + 1]; ++r)
+		{
+			uint32 j = rowColumns[r];
+			uint32 p = next[j]++;
+
+			B3_ASSERT(rows[p] == k);
+
+			b3Mat33 W = diagonal[j] * b3Transpose(values[p]);
+
+			for (uint32 q = p; q < columnPtrs[j + 1]; ++q)
+			{
+				work[rows[q]] -= values[q] * W;
+			}
+		}
+
+		b3Mat33 D = work[k];
+		if (b3IsPositiveDefinite(D) == false)
+		{
+			return false;
+		}
+
+		diagonal[k] = D;
+		invDiagonal[k] = b3SymInverse(D);
+
+		for (uint32 q = columnPtrs[k]; q < columnPtrs[k + 1]; ++q)
+		{
+			values[q] = work[rows[q]] * invDiagonal[k];
+			b3FlushTiny(values[q]);
+		}
+	}
+
+	return true;
+}
+
+void b3SparseCholesky::Solve(b3DenseVec3& x, const b3DenseVec3& b)
+{
+	B3_ASSERT(x.n == rowCount);
+	B3_ASSERT(b.n == rowCount);
+
+	uint32 n = rowCount;
+
+	for (uint32 k = 0; k < n; ++k)
+	{
+		y[k] = b[permutation[k]];
+	}
+
+	// Solve L * z = y
+	for (uint32 k = 0; k < n; ++k)
+	{
+		b3Vec3 yk = y[k];
+		for (uint32 q = columnPtrs[k]; q < columnPtrs[k + 1]; ++q)
+		{
+			y[rows[q]] -= values[q] * yk;
+		}
+	}
+
+	// Solve D * w = z
+	for (uint32 k = 0; k < n; ++k)
+	{
+		y[k] = invDiagonal[k] * y[k];
+	}
+
+	// Solve L^T * x = w
+	for (uint32 k = n; k > 0; --k)
+	{
+		uint32 j = k - 1;
+
+		b3Vec3 yj = y[j];
+		for (uint32 q = columnPtrs[j]; q < columnPtrs[j + 1]; ++q)
+		{
+			yj -= b3MulT(values[q], y[rows[q]]);
+		}
+		y[j] = yj;
+	}
+
+	for (uint32 k = 0; k < n; ++k)
+	{
+		x[permutation[k]] = y[k];
+	}
+}
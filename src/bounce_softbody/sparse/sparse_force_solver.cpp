@@ -21,6 +21,70 @@
 #include <bounce_softbody/sparse/diag_mat33.h>
 #include <bounce_softbody/sparse/sparse_mat33.h>
 #include <bounce_softbody/sparse/sparse_solver.h>
+#include <bounce_softbody/sparse/sparse_preconditioner.h>
+#include <bounce_softbody/sparse/sparse_cholesky.h>
+#include <bounce_softbody/sparse/sparse_workspace.h>
+#include <bounce_softbody/common/timer.h>
+
+// Apply the forces and Jacobians at the current iterate.
+static void b3ApplyForces(b3SparseForceModel* forceModel, const b3SparseForceSolverData* data)
+{
+	data->f->SetZero();
+	if (data->dfdx)
+	{
+		data->dfdx->SetZero();
+		data->dfdv->SetZero();
+	}
+	else
+	{
+		data->dfdx_diag->SetZero();
+		data->dfdv_diag->SetZero();
+	}
+
+	forceModel->ApplyForces(data);
+}
+
+// The pre-filtered system matrix S * A * S^T + I - S applied without storing A.
+// Since S and S^T are diagonal, the diagonal blocks of the pre-filtered matrix are stored 
+// and the off-diagonal blocks of A = M - h * dfdv - h * h * dfdx are applied by the force model.
+class b3MatrixFreeOperator : public b3SparseOperator
+{
+public:
+	void Multiply(b3DenseVec3& out, const b3DenseVec3& in) const
+	{
+		const b3DiagMat33& S = *m_S;
+		const b3DiagMat33& ST = *m_ST;
+		const b3DiagMat33& D = *m_D;
+		b3DenseVec3& u = *m_u;
+
+		for (uint32 i = 0; i < in.n; ++i)
+		{
+			u[i] = ST[i] * in[i];
+		}
+
+		out.SetZero();
+
+		b3SparseForceProductData data;
+		data.a = -m_h * m_h;
+		data.b = -m_h;
+		data.p = &u;
+		data.q = &out;
+
+		m_forceModel->MultiplyJacobians(&data);
+
+		for (uint32 i = 0; i < in.n; ++i)
+		{
+			out[i] = S[i] * out[i] + D[i] * in[i];
+		}
+	}
+
+	scalar m_h;
+	b3SparseForceModel* m_forceModel;
+	const b3DiagMat33* m_S;
+	const b3DiagMat33* m_ST;
+	const b3DiagMat33* m_D; // diagonal blocks of the pre-filtered matrix
+	b3DenseVec3* m_u; // temporary
+};
 
 // Time integration using Backward/Implicit Euler:
 //
@@ -117,6 +181,14 @@ void b3SparseSolveBE(b3SolveBEOutput* output, const b3SolveBEInput* input)
 	const b3DenseVec3& y = *input->y;
 	const b3DiagMat33& S = *input->S;
 	const b3DenseVec3& z = *input->z;
+	const b3SparseMat33& pattern = *input->pattern;
+	b3SparsePreconditioner* preconditioner = input->preconditioner;
+	
+	bool matrixFree = input->matrixFree;
+	bool symmetric = input->symmetric && matrixFree == false;
+
+	// The direct solver requires the full assembled matrix.
+	b3SparseCholesky* directSolver = matrixFree || symmetric ? nullptr : input->directSolver;
 
 	uint32 maxIterations = input->maxIterations;
 	scalar epsilon = input->tolerance;
@@ -124,86 +196,577 @@ void b3SparseSolveBE(b3SolveBEOutput* output, const b3SolveBEInput* input)
 	uint32 maxSubIterations = input->maxSubIterations;
 	scalar subEpsilon = input->subTolerance;
 
+	// Use a temporary workspace if no workspace is given.
+	b3SparseWorkspace localWorkspace;
+	b3SparseWorkspace* workspace = input->workspace;
+	if (workspace == nullptr)
+	{
+		workspace = &localWorkspace;
+	}
+
 	// S^T
-	b3DiagMat33 ST(dofCount);
+	b3DiagMat33& ST = *workspace->AllocateDiagMat33(dofCount);
 	b3Transpose(ST, S);
 
-	b3DiagMat33 I(dofCount);
+	b3Mat33 I;
 	I.SetIdentity();
 
 	// Keep track initial guess.
-	b3DenseVec3 py(dofCount);
-	py.SetZero();
+	b3DenseVec3& py = *workspace->AllocateDenseVec3(dofCount);
+	if (input->dv)
+	{
+		// Warm start the first inner solve with the predicted velocity change.
+		// y = S * (dv - z) keeps the constrained degrees of freedom at the desired solution.
+		const b3DenseVec3& dv = *input->dv;
+		for (uint32 i = 0; i < dofCount; ++i)
+		{
+			py[i] = S[i] * (dv[i] - z[i]);
+		}
+	}
+	else
+	{
+		py.SetZero();
+	}
 
-	b3DenseVec3 x = x0;
-	b3DenseVec3 v = v0;
+	b3DenseVec3& x = *output->x;
+	b3DenseVec3& v = *output->v;
+	x = x0;
+	v = v0;
 
 	scalar error0 = scalar(0);
 	scalar error = scalar(0);
 
+	// The Jacobians and the system matrix share the precomputed block structure.
+	b3SparseMat33* dfdx = nullptr;
+	b3SparseMat33* dfdv = nullptr;
+	b3SparseMat33* pA = nullptr;
+	if (matrixFree == false)
+	{
+		dfdx = workspace->AllocateSparseMat33();
+		dfdv = workspace->AllocateSparseMat33();
+		pA = workspace->AllocateSparseMat33();
+		*dfdx = pattern;
+		*dfdv = pattern;
+		*pA = pattern;
+	}
+
+	b3DenseVec3& fi = *workspace->AllocateDenseVec3(dofCount);
+	b3DenseVec3& pb = *workspace->AllocateDenseVec3(dofCount);
+
+	// Matrix-free mode stores the diagonal blocks of the Jacobians and of the pre-filtered matrix.
+	b3DiagMat33* dfdx_diag = nullptr;
+	b3DiagMat33* dfdv_diag = nullptr;
+	b3DiagMat33* pD = nullptr;
+	b3DenseVec3* dx = nullptr;
+	b3DenseVec3* u = nullptr;
+	
+	// Used if the given preconditioner requires the matrix or both of its triangles.
+	b3SparsePreconditioner blockJacobi;
+
+	// Matrix-vector products of the Jacobians in symmetric storage.
+	b3DenseVec3* dfdx_dx_sum = nullptr;
+	b3DenseVec3* Az = nullptr;
+	if (symmetric)
+	{
+		dfdx_dx_sum = workspace->AllocateDenseVec3(dofCount);
+		Az = workspace->AllocateDenseVec3(dofCount);
+
+		if (preconditioner && 
+			preconditioner->type != e_jacobiPreconditioner && preconditioner->type != e_blockJacobiPreconditioner)
+		{
+			blockJacobi.type = e_blockJacobiPreconditioner;
+			preconditioner = &blockJacobi;
+		}
+	}
+	
+	b3MatrixFreeOperator op;
+	
+	// True if the initial guess z is non-zero.
+	bool hasGuess = false;
+
+	if (matrixFree)
+	{
+		dfdx_diag = workspace->AllocateDiagMat33(dofCount);
+		dfdv_diag = workspace->AllocateDiagMat33(dofCount);
+		pD = workspace->AllocateDiagMat33(dofCount);
+		dx = workspace->AllocateDenseVec3(dofCount);
+		Az = workspace->AllocateDenseVec3(dofCount);
+		u = workspace->AllocateDenseVec3(dofCount);
+
+		if (preconditioner == nullptr || 
+			(preconditioner->type != e_jacobiPreconditioner && preconditioner->type != e_blockJacobiPreconditioner))
+		{
+			blockJacobi.type = e_blockJacobiPreconditioner;
+			preconditioner = &blockJacobi;
+		}
+
+		op.m_h = h;
+		op.m_forceModel = forceModel;
+		op.m_S = &S;
+		op.m_ST = &ST;
+		op.m_D = pD;
+		op.m_u = u;
+
+		for (uint32 i = 0; i < dofCount; ++i)
+		{
+			if (z[i].x != scalar(0) || z[i].y != scalar(0) || z[i].z != scalar(0))
+			{
+				hasGuess = true;
+				break;
+			}
+		}
+	}
+
+	// The line search needs the iterate at the start of the step.
+	b3DenseVec3* vi = nullptr;
+	if (input->lineSearch)
+	{
+		vi = workspace->AllocateDenseVec3(dofCount);
+
+		// Start from positions consistent with the velocities, 
+		// so every iterate has the same non-linear residual.
+		for (uint32 i = 0; i < dofCount; ++i)
+		{
+			x[i] = x0[i] + h * v[i] + y[i];
+		}
+	}
+
+	b3SparseForceSolverData solverData;
+	solverData.h = h;
+	solverData.inv_h = inv_h;
+	solverData.x = &x;
+	solverData.v = &v;
+	solverData.f = &fi;
+	solverData.dfdx = dfdx;
+	solverData.dfdv = dfdv;
+	solverData.dfdx_diag = dfdx_diag;
+	solverData.dfdv_diag = dfdv_diag;
+
+	output->assemblyTime = 0.0;
+	output->solveTime = 0.0;
+	output->historyCount = 0;
+	output->lineSearchFailures = 0;
+
+	// Set when the forces were applied at the current iterate by the line search.
+	bool forcesApplied = false;
+
+	// Outer residual norm and forcing term of the previous iteration.
+	scalar residual0 = scalar(0);
+	scalar eta0 = scalar(0);
+
 	uint32 iteration = 0;
 
 	while (iteration < maxIterations)
 	{
-		b3DenseVec3 fi(dofCount);
-		fi.SetZero();
-
-		b3SparseMat33 dfdx(dofCount);
-		b3SparseMat33 dfdv(dofCount);
-
-		b3SparseForceSolverData solverData;
-		solverData.h = h;
-		solverData.inv_h = inv_h;
-		solverData.x = &x;
-		solverData.v = &v;
-		solverData.f = &fi;
-		solverData.dfdx = &dfdx;
-		solverData.dfdv = &dfdv;
-		
-		forceModel->ApplyForces(&solverData);
+		b3Timer timer;
 
-		b3SparseMat33 A = M - h * dfdv - (h * h) * dfdx;
-		
-		b3DenseVec3 b = M * (v0 - v) + h * (fe + fi) + h * dfdx * (x0 - x + h * v + y);
+		if (forcesApplied == false)
+		{
+			b3ApplyForces(forceModel, &solverData);
+		}
+		forcesApplied = false;
+
+		scalar residualSquared = scalar(0);
+		if (matrixFree)
+		{
+			// dfdx * (x0 - x + h * v + y)
+			b3DenseVec3& dfdx_dx = *Az;
+			for (uint32 i = 0; i < dofCount; ++i)
+			{
+				(*dx)[i] = x0[i] - x[i] + h * v[i] + y[i];
+				dfdx_dx[i] = (*dfdx_diag)[i] * (*dx)[i];
+			}
+
+			b3SparseForceProductData productData;
+			productData.a = scalar(1);
+			productData.b = scalar(0);
+			productData.p = dx;
+			productData.q = &dfdx_dx;
+			forceModel->MultiplyJacobians(&productData);
+
+			for (uint32 i = 0; i < dofCount; ++i)
+			{
+				b3Vec3 b = M[i] * (v0[i] - v[i]) + h * (fe[i] + fi[i]) + h * dfdx_dx[i];
+
+				pb[i] = S[i] * b;
+			}
+
+			for (uint32 i = 0; i < dofCount; ++i)
+			{
+				b3Mat33 A_ii = M[i] - h * (*dfdv_diag)[i] - (h * h) * (*dfdx_diag)[i];
+				
+				(*pD)[i] = S[i] * A_ii * ST[i] + I - S[i];
+
+				if (hasGuess)
+				{
+					(*Az)[i] = A_ii * z[i];
+				}
+			}
+
+			if (hasGuess)
+			{
+				// A * z
+				productData.a = -h * h;
+				productData.b = -h;
+				productData.p = &z;
+				productData.q = Az;
+				forceModel->MultiplyJacobians(&productData);
+
+				for (uint32 i = 0; i < dofCount; ++i)
+				{
+					pb[i] -= S[i] * (*Az)[i];
+				}
+			}
+
+			for (uint32 i = 0; i < dofCount; ++i)
+			{
+				residualSquared += b3LengthSquared(pb[i]);
+			}
+		}
+		else
+		{
+			// A force model may have inserted blocks that are not in the structure.
+			// Blocks are never removed, so equal block counts imply equal structures.
+			if (dfdx->blockCount != pA->blockCount || dfdv->blockCount != pA->blockCount)
+			{
+				pA->Merge(*dfdx);
+				pA->Merge(*dfdv);
+				dfdx->Merge(*pA);
+				dfdv->Merge(*pA);
+			}
+		}
+
+		if (symmetric)
+		{
+			// An upper block (i, j) contributes to the rows i and j.
+			dfdx_dx_sum->SetZero();
+			Az->SetZero();
+
+			for (uint32 i = 0; i < dofCount; ++i)
+			{
+				b3Vec3 dx_i = x0[i] - x[i] + h * v[i] + y[i];
+
+				for (uint32 k = pA->rowPtrs[i]; k < pA->rowPtrs[i + 1]; ++k)
+				{
+					uint32 j = pA->columns[k];
+
+					b3Mat33 A_ij = -h * dfdv->values[k] - (h * h) * dfdx->values[k];
+					if (i == j)
+					{
+						A_ij += M[i];
+					}
+
+					b3Vec3 dx_j = x0[j] - x[j] + h * v[j] + y[j];
+
+					(*dfdx_dx_sum)[i] += dfdx->values[k] * dx_j;
+					(*Az)[i] += A_ij * z[j];
 
-		// Pre-filter as in "Smoothed aggregation multigrid for cloth simulation", 
-		// by Tamstorf, R., T. Jones, and S. McCormick.
-		// A' = S * A * ST + I - S
-		// b' = S * (b - A * z)
-		b3SparseMat33 pA = S * A * ST + I - S;
-		b3DenseVec3 pb = S * (b - A * z);
+					if (i != j)
+					{
+						(*dfdx_dx_sum)[j] += b3MulT(dfdx->values[k], dx_i);
+						(*Az)[j] += b3MulT(A_ij, z[i]);
+					}
+
+					pA->values[k] = S[i] * A_ij * ST[j];
+					if (i == j)
+					{
+						pA->values[k] += I - S[i];
+					}
+				}
+			}
+
+			for (uint32 i = 0; i < dofCount; ++i)
+			{
+				b3Vec3 b = M[i] * (v0[i] - v[i]) + h * (fe[i] + fi[i]) + h * (*dfdx_dx_sum)[i];
+
+				pb[i] = S[i] * (b - (*Az)[i]);
+
+				residualSquared += b3LengthSquared(pb[i]);
+			}
+		}
+		else if (matrixFree == false)
+		{
+			// Assemble A and b and pre-filter them in a single pass over the Jacobian blocks.
+			// Pre-filter as in "Smoothed aggregation multigrid for cloth simulation", 
+			// by Tamstorf, R., T. Jones, and S. McCormick.
+			// A' = S * A * ST + I - S
+			// b' = S * (b - A * z)
+			for (uint32 i = 0; i < dofCount; ++i)
+			{
+				// Row i of dfdx * (x0 - x + h * v + y)
+				b3Vec3 dfdx_dx;
+				dfdx_dx.SetZero();
+
+				// Row i of A * z
+				b3Vec3 Az;
+				Az.SetZero();
+
+				for (uint32 k = pA->rowPtrs[i]; k < pA->rowPtrs[i + 1]; ++k)
+				{
+					uint32 j = pA->columns[k];
+
+					b3Mat33 A_ij = -h * dfdv->values[k] - (h * h) * dfdx->values[k];
+					if (i == j)
+					{
+						A_ij += M[i];
+					}
+
+					b3Vec3 dx = x0[j] - x[j] + h * v[j] + y[j];
+
+					dfdx_dx += dfdx->values[k] * dx;
+					Az += A_ij * z[j];
+
+					pA->values[k] = S[i] * A_ij * ST[j];
+					if (i == j)
+					{
+						pA->values[k] += I - S[i];
+					}
+				}
+
+				b3Vec3 b = M[i] * (v0[i] - v[i]) + h * (fe[i] + fi[i]) + h * dfdx_dx;
+
+				pb[i] = S[i] * (b - Az);
+
+				residualSquared += b3LengthSquared(pb[i]);
+			}
+		}
+
+		scalar residual = b3Sqrt(residualSquared);
+
+		// The line search merit is the norm of the non-linear residual at the iterate, 
+		// which has no linearization term and no desired solution term.
+		scalar merit = scalar(0);
+		if (vi)
+		{
+			scalar meritSquared = scalar(0);
+			for (uint32 i = 0; i < dofCount; ++i)
+			{
+				b3Vec3 r = S[i] * (M[i] * (v0[i] - v[i]) + h * (fe[i] + fi[i]));
+				meritSquared += b3LengthSquared(r);
+			}
+			merit = b3Sqrt(meritSquared);
+		}
+
+		output->assemblyTime += timer.GetMilliseconds();
+		timer.Reset();
+
+		// Factor the matrix if the direct solver is used. 
+		// CG solves the system if the matrix is not positive definite.
+		bool factored = false;
+		if (directSolver)
+		{
+			// The symbolic factorization can only be reused for a matrix with the same structure.
+			if (directSolver->IsCompatible(*pA) == false)
+			{
+				directSolver->Analyze(*pA);
+			}
+
+			factored = directSolver->Factorize(*pA);
+		}
+
+		if (matrixFree)
+		{
+			// The diagonal blocks change in every iteration.
+			preconditioner->Compute(*pD);
+		}
+		else if (factored == false && preconditioner)
+		{
+			// A preconditioner can only be reused for a matrix with the same structure.
+			bool update = iteration == 0 && input->updatePreconditioner;
+			if (update || preconditioner->IsCompatible(*pA) == false)
+			{
+				preconditioner->Compute(*pA, &S);
+			}
+		}
+
+		// Eisenstat-Walker forcing term, choice 2 with gamma = 0.9 and alpha = 2.
+		// "Choosing the forcing terms in an inexact Newton method", by Eisenstat, S. C. and H. F. Walker.
+		scalar eta = subEpsilon;
+		if (input->adaptiveSubTolerance)
+		{
+			scalar etaMax = input->maxSubTolerance;
+			if (iteration == 0 || residual0 == scalar(0))
+			{
+				eta = etaMax;
+			}
+			else
+			{
+				scalar ratio = residual / residual0;
+				eta = scalar(0.9) * ratio * ratio;
+
+				// Safeguard against an early drop of the tolerance.
+				scalar eta1 = scalar(0.9) * eta0 * eta0;
+				if (eta1 > scalar(0.1))
+				{
+					eta = b3Max(eta, eta1);
+				}
+			}
+
+			eta = b3Clamp(eta, subEpsilon, etaMax);
+		}
+
+		residual0 = residual;
+		eta0 = eta;
 
 		// Solve pA * y = pb, 
 		// where y = x - z
 		b3SolveCGInput subInput;
-		subInput.A = &pA;
+		if (matrixFree)
+		{
+			subInput.op = &op;
+		}
+		else
+		{
+			subInput.A = pA;
+			subInput.symmetric = symmetric;
+		}
 		subInput.b = &pb;
 		subInput.maxIterations = maxSubIterations;
-		subInput.tolerance = subEpsilon;
+		subInput.tolerance = eta;
+		subInput.preconditioner = preconditioner;
+		subInput.threadPool = input->threadPool;
+		subInput.workspace = workspace;
+		subInput.warmStarting = iteration == 0 && input->dv != nullptr;
+		subInput.mixedPrecision = input->mixedPrecision;
+		subInput.refinementIterations = input->refinementIterations;
 
 		b3SolveCGOutput subOutput;
 		subOutput.x = &py;
 
-		bool subSolved = b3SparseSolveCG(&subOutput, &subInput);
+		bool subSolved = true;
+		if (factored)
+		{
+			directSolver->Solve(py, pb);
+			subOutput.iterations = 0;
+			subOutput.error = scalar(0);
+		}
+		else
+		{
+			subSolved = b3SparseSolveCG(&subOutput, &subInput);
+		}
+
+		output->solveTime += timer.GetMilliseconds();
+
 		if (subSolved == false)
 		{
 			break;
 		}
 
-		// Recover x = y + z
-		b3DenseVec3 dv = py + z;
-
 		// Track min/max sub-iterations.
 		output->minSubIterations = b3Min(output->minSubIterations, subOutput.iterations);
 		output->maxSubIterations = b3Max(output->maxSubIterations, subOutput.iterations);
 
-		// Solution update 
-		v = v + dv;
-
-		// Position update
-		x = x0 + h * v + y;
+		scalar alpha = scalar(1);
+		bool lineSearchFailed = false;
 		
-		error = b3LengthSquared(dv);
+		if (vi)
+		{
+			timer.Reset();
+			
+			vi->Copy(v);
+
+			// Sufficient decrease condition for inexact Newton steps.
+			// "Globally convergent inexact Newton methods", by Eisenstat, S. C. and H. F. Walker.
+			const scalar t = scalar(1.0e-4);
+
+			// Best trial step
+			scalar bestAlpha = alpha;
+			scalar bestSquared = B3_MAX_SCALAR;
+
+			for (uint32 trial = 0; ; ++trial)
+			{
+				for (uint32 i = 0; i < dofCount; ++i)
+				{
+					// Recover x = y + z
+					b3Vec3 dv = py[i] + z[i];
+					
+					v[i] = (*vi)[i] + alpha * dv;
+					x[i] = x0[i] + h * v[i] + y[i];
+				}
+
+				b3ApplyForces(forceModel, &solverData);
+
+				scalar trialSquared = scalar(0);
+				for (uint32 i = 0; i < dofCount; ++i)
+				{
+					b3Vec3 r = S[i] * (M[i] * (v0[i] - v[i]) + h * (fe[i] + fi[i]));
+					trialSquared += b3LengthSquared(r);
+				}
+
+				scalar bound = (scalar(1) - t * alpha * (scalar(1) - eta)) * merit;
+				if (trialSquared <= bound * bound)
+				{
+					// The forces were applied at the accepted iterate.
+					forcesApplied = true;
+					break;
+				}
+
+				if (trialSquared < bestSquared)
+				{
+					bestAlpha = alpha;
+					bestSquared = trialSquared;
+				}
+
+				if (trial == input->maxLineSearchIterations)
+				{
+					// No trial decreased the residual sufficiently. 
+					// Take the best trial step and report the failure.
+					lineSearchFailed = true;
+					++output->lineSearchFailures;
+
+					if (bestAlpha == alpha)
+					{
+						forcesApplied = true;
+					}
+					else
+					{
+						alpha = bestAlpha;
+						for (uint32 i = 0; i < dofCount; ++i)
+						{
+							b3Vec3 dv = py[i] + z[i];
+
+							v[i] = (*vi)[i] + alpha * dv;
+							x[i] = x0[i] + h * v[i] + y[i];
+						}
+					}
+					break;
+				}
+
+				alpha *= scalar(0.5);
+			}
+
+			output->assemblyTime += timer.GetMilliseconds();
+		}
+
+		error = scalar(0);
+		for (uint32 i = 0; i < dofCount; ++i)
+		{
+			// Recover x = y + z
+			b3Vec3 dv = alpha * (py[i] + z[i]);
+
+			if (vi == nullptr)
+			{
+				// Solution update 
+				v[i] += dv;
+
+				// Position update
+				x[i] = x0[i] + h * v[i] + y[i];
+			}
+
+			error += b3LengthSquared(dv);
+		}
+
+		if (output->historyCount < output->historyCapacity)
+		{
+			b3SolveBEIteration* record = output->history + output->historyCount++;
+			record->subIterations = subOutput.iterations;
+			record->subTolerance = eta;
+			record->subError = subOutput.error;
+			record->residual = residual;
+			record->stepLength = alpha;
+			record->lineSearchFailed = lineSearchFailed;
+			record->error = error;
+		}
 
 		if (iteration == 0)
 		{
@@ -225,8 +788,37 @@ void b3SparseSolveBE(b3SolveBEOutput* output, const b3SolveBEInput* input)
 		++iteration;
 	}
 
-	*output->x = x;
-	*output->v = v;
+	output->blockCount = matrixFree ? dofCount : pA->blockCount;
+
+	if (vi)
+	{
+		workspace->FreeDenseVec3(vi);
+	}
+	if (symmetric)
+	{
+		workspace->FreeDenseVec3(Az);
+		workspace->FreeDenseVec3(dfdx_dx_sum);
+	}
+	if (matrixFree)
+	{
+		workspace->FreeDenseVec3(u);
+		workspace->FreeDenseVec3(Az);
+		workspace->FreeDenseVec3(dx);
+		workspace->FreeDiagMat33(pD);
+		workspace->FreeDiagMat33(dfdv_diag);
+		workspace->FreeDiagMat33(dfdx_diag);
+	}
+	workspace->FreeDenseVec3(&pb);
+	workspace->FreeDenseVec3(&fi);
+	if (matrixFree == false)
+	{
+		workspace->FreeSparseMat33(pA);
+		workspace->FreeSparseMat33(dfdv);
+		workspace->FreeSparseMat33(dfdx);
+	}
+	workspace->FreeDenseVec3(&py);
+	workspace->FreeDiagMat33(&ST);
+
 	output->iterations = iteration;
 	output->error = error;
-}
+}
\ No newline at end of file
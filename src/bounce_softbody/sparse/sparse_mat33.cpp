@@ -0,0 +1,108 @@
+/*
+* Copyright (c) 2016-2019 Irlan Robson
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <bounce_softbody/sparse/sparse_mat33.h>
+
+void b3SparseMat33::SetStructure(const b3BlockIndex* indices, uint32 indexCount)
+{
+	// Bucket the column indices by row.
+	uint32* counts = (uint32*)b3Alloc((rowCount + 1) * sizeof(uint32));
+	for (uint32 i = 0; i < rowCount + 1; ++i)
+	{
+		counts[i] = 0;
+	}
+
+	for (uint32 k = 0; k < indexCount; ++k)
+	{
+		B3_ASSERT(indices[k].row < rowCount);
+		B3_ASSERT(indices[k].column < rowCount);
+		++counts[indices[k].row + 1];
+	}
+
+	for (uint32 i = 0; i < rowCount; ++i)
+	{
+		counts[i + 1] += counts[i];
+	}
+
+	uint32* buckets = (uint32*)b3Alloc(indexCount * sizeof(uint32));
+	for (uint32 k = 0; k < indexCount; ++k)
+	{
+		uint32 i = indices[k].row;
+		buckets[counts[i]++] = indices[k].column;
+	}
+
+	// The counts now point to the end of each bucket.
+	uint32 uniqueCount = 0;
+	uint32 begin = 0;
+	for (uint32 i = 0; i < rowCount; ++i)
+	{
+		uint32 end = counts[i];
+
+		// Insertion sort the row. Rows are short.
+		for (uint32 k = begin + 1; k < end; ++k)
+		{
+			uint32 column = buckets[k];
+			uint32 l = k;
+			while (l > begin && buckets[l - 1] > column)
+			{
+				buckets[l] = buckets[l - 1];
+				--l;
+			}
+			buckets[l] = column;
+		}
+
+		for (uint32 k = begin; k < end; ++k)
+		{
+			if (k == begin || buckets[k] != buckets[k - 1])
+			{
+				++uniqueCount;
+			}
+		}
+
+		begin = end;
+	}
+
+	blockCount = 0;
+	Reserve(uniqueCount);
+
+	// Store the unique columns.
+	begin = 0;
+	for (uint32 i = 0; i < rowCount; ++i)
+	{
+		uint32 end = counts[i];
+
+		rowPtrs[i] = blockCount;
+		for (uint32 k = begin; k < end; ++k)
+		{
+			if (k == begin || buckets[k] != buckets[k - 1])
+			{
+				columns[blockCount] = buckets[k];
+				values[blockCount].SetZero();
+				++blockCount;
+			}
+		}
+
+		begin = end;
+	}
+	rowPtrs[rowCount] = blockCount;
+
+	B3_ASSERT(blockCount == uniqueCount);
+
+	b3Free(buckets);
+	b3Free(counts);
+}
@@ -0,0 +1,954 @@
+/*
+* Copyright (c) 2016-2019 Irlan Robson
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <bounce_softbody/sparse/sparse_multigrid.h>
+#include <bounce_softbody/sparse/diag_mat33.h>
+
+// Number of power iterations used to estimate the spectral radius of D^-1 * A.
+static const uint32 b3_multigridPowerIterations = 10;
+
+// Number of symmetric Gauss-Seidel sweeps on the coarsest level 
+// if it is too large to be solved directly.
+static const uint32 b3_multigridCoarseSweeps = 2;
+
+static void b3FreeOperator(b3MultigridOperator& M)
+{
+	b3Free(M.rowPtrs);
+	b3Free(M.columns);
+	b3Free(M.values);
+	M.rowCount = 0;
+	M.blockCount = 0;
+	M.rowPtrs = nullptr;
+	M.columns = nullptr;
+	M.values = nullptr;
+}
+
+// Allocate the block arrays of an operator after the row pointers were set.
+static void b3AllocateOperator(b3MultigridOperator& M)
+{
+	M.blockCount = M.rowPtrs[M.rowCount];
+	M.columns = (uint32*)b3Alloc(M.blockCount * sizeof(uint32));
+	M.values = (b3Mat33*)b3Alloc(M.blockCount * sizeof(b3Mat33));
+}
+
+// Get the number of bytes allocated by an operator.
+static uint32 b3GetByteCount(const b3MultigridOperator& M)
+{
+	if (M.rowPtrs == nullptr)
+	{
+		return 0;
+	}
+
+	return (M.rowCount + 1) * sizeof(uint32) + M.blockCount * (sizeof(uint32) + sizeof(b3Mat33));
+}
+
+// Sort the columns of a row.
+static void b3SortRow(uint32* columns, uint32 count)
+{
+	for (uint32 i = 1; i < count; ++i)
+	{
+		uint32 column = columns[i];
+		uint32 j = i;
+		while (j > 0 && columns[j - 1] > column)
+		{
+			columns[j] = columns[j - 1];
+			--j;
+		}
+		columns[j] = column;
+	}
+}
+
+// Group the rows of a matrix into aggregates using its block structure. 
+// Return the number of aggregates.
+// See "Algebraic multigrid by smoothed aggregation for second and fourth order elliptic problems", Vanek et al.
+static uint32 b3Aggregate(uint32* aggregates, uint32* seeds, const b3SparseMat33& A)
+{
+	uint32 n = A.rowCount;
+
+	for (uint32 i = 0; i < n; ++i)
+	{
+		aggregates[i] = B3_MAX_U32;
+	}
+
+	uint32 aggregateCount = 0;
+
+	// Phase 1: Create an aggregate from each row whose neighbours are not aggregated.
+	for (uint32 i = 0; i < n; ++i)
+	{
+		if (aggregates[i] != B3_MAX_U32)
+		{
+			continue;
+		}
+
+		bool isolated = true;
+		for (uint32 k = A.rowPtrs[i]; k < A.rowPtrs[i + 1]; ++k)
+		{
+			if (aggregates[A.columns[k]] != B3_MAX_U32)
+			{
+				isolated = false;
+				break;
+			}
+		}
+
+		if (isolated == false)
+		{
+			continue;
+		}
+
+		for (uint32 k = A.rowPtrs[i]; k < A.rowPtrs[i + 1]; ++k)
+		{
+			aggregates[A.columns[k]] = aggregateCount;
+		}
+		++aggregateCount;
+	}
+
+	// Phase 2: Add the remaining rows to a neighbouring aggregate from phase 1.
+	for (uint32 i = 0; i < n; ++i)
+	{
+		seeds[i] = aggregates[i];
+	}
+
+	for (uint32 i = 0; i < n; ++i)
+	{
+		if (aggregates[i] != B3_MAX_U32)
+		{
+			continue;
+		}
+
+		for (uint32 k = A.rowPtrs[i]; k < A.rowPtrs[i + 1]; ++k)
+		{
+			uint32 aggregate = seeds[A.columns[k]];
+			if (aggregate != B3_MAX_U32)
+			{
+				aggregates[i] = aggregate;
+				break;
+			}
+		}
+	}
+
+	// Phase 3: Create aggregates from the rows that are left.
+	for (uint32 i = 0; i < n; ++i)
+	{
+		if (aggregates[i] != B3_MAX_U32)
+		{
+			continue;
+		}
+
+		for (uint32 k = A.rowPtrs[i]; k < A.rowPtrs[i + 1]; ++k)
+		{
+			uint32 j = A.columns[k];
+			if (aggregates[j] == B3_MAX_U32)
+			{
+				aggregates[j] = aggregateCount;
+			}
+		}
+		++aggregateCount;
+	}
+
+	return aggregateCount;
+}
+
+b3SparseMultigrid::b3SparseMultigrid()
+{
+	levelCount = 0;
+	for (uint32 i = 0; i < b3_maxMultigridLevels; ++i)
+	{
+		b3MultigridLevel* level = levels + i;
+		level->S = nullptr;
+		level->invDiagonal = nullptr;
+		level->diagonalIndices = nullptr;
+		level->aggregates = nullptr;
+		level->P.rowCount = 0;
+		level->P.blockCount = 0;
+		level->P.rowPtrs = nullptr;
+		level->P.columns = nullptr;
+		level->P.values = nullptr;
+		level->prolongationIndices = nullptr;
+		level->R = level->P;
+		level->restrictionIndices = nullptr;
+		level->AP = level->P;
+		level->x = nullptr;
+		level->b = nullptr;
+		level->r = nullptr;
+	}
+	coarseSize = 0;
+	coarseL = nullptr;
+	markers = nullptr;
+}
+
+b3SparseMultigrid::~b3SparseMultigrid()
+{
+	Destroy();
+}
+
+uint32 b3SparseMultigrid::GetByteCount() const
+{
+	if (levelCount == 0)
+	{
+		return 0;
+	}
+
+	uint32 byteCount = levels[0].A.rowCount * sizeof(uint32); // markers
+	for (uint32 i = 0; i < levelCount; ++i)
+	{
+		const b3MultigridLevel* level = levels + i;
+		uint32 n = level->A.rowCount;
+
+		byteCount += level->A.GetByteCount();
+		byteCount += 2 * n * sizeof(b3Mat33); // S, invDiagonal
+		byteCount += n * sizeof(uint32); // diagonalIndices
+		byteCount += 3 * n * sizeof(b3Vec3); // x, b, r
+
+		if (level->aggregates)
+		{
+			byteCount += n * sizeof(uint32);
+		}
+
+		if (level->prolongationIndices)
+		{
+			byteCount += level->A.blockCount * sizeof(uint32);
+		}
+
+		if (level->restrictionIndices)
+		{
+			byteCount += level->R.blockCount * sizeof(uint32);
+		}
+
+		byteCount += b3GetByteCount(level->P);
+		byteCount += b3GetByteCount(level->R);
+		byteCount += b3GetByteCount(level->AP);
+	}
+
+	if (coarseL)
+	{
+		byteCount += coarseSize * coarseSize * sizeof(scalar);
+	}
+
+	return byteCount;
+}
+
+void b3SparseMultigrid::Destroy()
+{
+	for (uint32 i = 0; i < levelCount; ++i)
+	{
+		b3MultigridLevel* level = levels + i;
+		b3Free(level->S);
+		b3Free(level->invDiagonal);
+		b3Free(level->diagonalIndices);
+		b3Free(level->aggregates);
+		b3FreeOperator(level->P);
+		b3Free(level->prolongationIndices);
+		b3FreeOperator(level->R);
+		b3Free(level->restrictionIndices);
+		b3FreeOperator(level->AP);
+		b3Free(level->x);
+		b3Free(level->b);
+		b3Free(level->r);
+		level->S = nullptr;
+		level->invDiagonal = nullptr;
+		level->diagonalIndices = nullptr;
+		level->aggregates = nullptr;
+		level->prolongationIndices = nullptr;
+		level->restrictionIndices = nullptr;
+		level->x = nullptr;
+		level->b = nullptr;
+		level->r = nullptr;
+	}
+	levelCount = 0;
+
+	b3Free(coarseL);
+	coarseL = nullptr;
+	coarseSize = 0;
+
+	b3Free(markers);
+	markers = nullptr;
+}
+
+void b3SparseMultigrid::BuildHierarchy()
+{
+	markers = (uint32*)b3Alloc(levels[0].A.rowCount * sizeof(uint32));
+
+	for (uint32 index = 0; index < b3_maxMultigridLevels; ++index)
+	{
+		b3MultigridLevel* level = levels + index;
+		const b3SparseMat33& A = level->A;
+		uint32 n = A.rowCount;
+
+		level->S = (b3Mat33*)b3Alloc(n * sizeof(b3Mat33));
+		level->invDiagonal = (b3Mat33*)b3Alloc(n * sizeof(b3Mat33));
+		level->diagonalIndices = (uint32*)b3Alloc(n * sizeof(uint32));
+		level->x = (b3Vec3*)b3Alloc(n * sizeof(b3Vec3));
+		level->b = (b3Vec3*)b3Alloc(n * sizeof(b3Vec3));
+		level->r = (b3Vec3*)b3Alloc(n * sizeof(b3Vec3));
+
+		for (uint32 i = 0; i < n; ++i)
+		{
+			level->diagonalIndices[i] = A.SearchIndex(i, i);
+			B3_ASSERT(level->diagonalIndices[i] != B3_MAX_U32);
+		}
+
+		levelCount = index + 1;
+
+		if (n <= b3_multigridCoarseRowCount || index + 1 == b3_maxMultigridLevels)
+		{
+			break;
+		}
+
+		level->aggregates = (uint32*)b3Alloc(n * sizeof(uint32));
+		uint32 coarseCount = b3Aggregate(level->aggregates, markers, A);
+
+		if (coarseCount == n)
+		{
+			// The structure can't be coarsened.
+			break;
+		}
+
+		// The structure of P = S * (I - w * D^-1 * A) * P0, 
+		// where P0 maps each row to its aggregate.
+		b3MultigridOperator& P = level->P;
+		P.rowCount = n;
+		P.rowPtrs = (uint32*)b3Alloc((n + 1) * sizeof(uint32));
+
+		for (uint32 c = 0; c < coarseCount; ++c)
+		{
+			markers[c] = B3_MAX_U32;
+		}
+
+		P.rowPtrs[0] = 0;
+		for (uint32 i = 0; i < n; ++i)
+		{
+			uint32 count = 0;
+			for (uint32 k = A.rowPtrs[i]; k < A.rowPtrs[i + 1]; ++k)
+			{
+				uint32 c = level->aggregates[A.columns[k]];
+				if (markers[c] != i)
+				{
+					markers[c] = i;
+					++count;
+				}
+			}
+			P.rowPtrs[i + 1] = P.rowPtrs[i] + count;
+		}
+
+		b3AllocateOperator(P);
+		level->prolongationIndices = (uint32*)b3Alloc(A.blockCount * sizeof(uint32));
+
+		for (uint32 c = 0; c < coarseCount; ++c)
+		{
+			markers[c] = B3_MAX_U32;
+		}
+
+		for (uint32 i = 0; i < n; ++i)
+		{
+			uint32 count = 0;
+			for (uint32 k = A.rowPtrs[i]; k < A.rowPtrs[i + 1]; ++k)
+			{
+				uint32 c = level->aggregates[A.columns[k]];
+				if (markers[c] != i)
+				{
+					markers[c] = i;
+					P.columns[P.rowPtrs[i] + count] = c;
+					++count;
+				}
+			}
+
+			b3SortRow(P.columns + P.rowPtrs[i], count);
+
+			for (uint32 k = A.rowPtrs[i]; k < A.rowPtrs[i + 1]; ++k)
+			{
+				uint32 c = level->aggregates[A.columns[k]];
+				uint32 p = P.rowPtrs[i];
+				while (P.columns[p] != c)
+				{
+					++p;
+				}
+				level->prolongationIndices[k] = p;
+			}
+		}
+
+		// The structure of R = P^T.
+		// The rows of P are visited in order, so the columns of R are sorted.
+		b3MultigridOperator& R = level->R;
+		R.rowCount = coarseCount;
+		R.rowPtrs = (uint32*)b3Alloc((coarseCount + 1) * sizeof(uint32));
+
+		for (uint32 c = 0; c < coarseCount + 1; ++c)
+		{
+			R.rowPtrs[c] = 0;
+		}
+
+		for (uint32 p = 0; p < P.blockCount; ++p)
+		{
+			++R.rowPtrs[P.columns[p] + 1];
+		}
+
+		for (uint32 c = 0; c < coarseCount; ++c)
+		{
+			R.rowPtrs[c + 1] += R.rowPtrs[c];
+		}
+
+		b3AllocateOperator(R);
+		level->restrictionIndices = (uint32*)b3Alloc(R.blockCount * sizeof(uint32));
+
+		for (uint32 c = 0; c < coarseCount; ++c)
+		{
+			markers[c] = R.rowPtrs[c];
+		}
+
+		for (uint32 i = 0; i < n; ++i)
+		{
+			for (uint32 p = P.rowPtrs[i]; p < P.rowPtrs[i + 1]; ++p)
+			{
+				uint32 q = markers[P.columns[p]]++;
+				R.columns[q] = i;
+				level->restrictionIndices[q] = p;
+			}
+		}
+
+		// The structure of A * P.
+		b3MultigridOperator& AP = level->AP;
+		AP.rowCount = n;
+		AP.rowPtrs = (uint32*)b3Alloc((n + 1) * sizeof(uint32));
+
+		for (uint32 c = 0; c < coarseCount; ++c)
+		{
+			markers[c] = B3_MAX_U32;
+		}
+
+		AP.rowPtrs[0] = 0;
+		for (uint32 i = 0; i < n; ++i)
+		{
+			uint32 count = 0;
+			for (uint32 k = A.rowPtrs[i]; k < A.rowPtrs[i + 1]; ++k)
+			{
+				uint32 j = A.columns[k];
+				for (uint32 p = P.rowPtrs[j]; p < P.rowPtrs[j + 1]; ++p)
+				{
+					uint32 c = P.columns[p];
+					if (markers[c] != i)
+					{
+						markers[c] = i;
+						++count;
+					}
+				}
+			}
+			AP.rowPtrs[i + 1] = AP.rowPtrs[i] + count;
+		}
+
+		b3AllocateOperator(AP);
+
+		for (uint32 c = 0; c < coarseCount; ++c)
+		{
+			markers[c] = B3_MAX_U32;
+		}
+
+		for (uint32 i = 0; i < n; ++i)
+		{
+			uint32 count = 0;
+			for (uint32 k = A.rowPtrs[i]; k < A.rowPtrs[i + 1]; ++k)
+			{
+				uint32 j = A.columns[k];
+				for (uint32 p = P.rowPtrs[j]; p < P.rowPtrs[j + 1]; ++p)
+				{
+					uint32 c = P.columns[p];
+					if (markers[c] != i)
+					{
+						markers[c] = i;
+						AP.columns[AP.rowPtrs[i] + count] = c;
+						++count;
+					}
+				}
+			}
+
+			b3SortRow(AP.columns + AP.rowPtrs[i], count);
+		}
+
+		// The structure of the coarse matrix R * A * P.
+		b3SparseMat33& coarseA = levels[index + 1].A;
+		coarseA.Resize(coarseCount);
+
+		for (uint32 c = 0; c < coarseCount; ++c)
+		{
+			markers[c] = B3_MAX_U32;
+		}
+
+		for (uint32 c = 0; c < coarseCount; ++c)
+		{
+			uint32 count = 0;
+			for (uint32 q = R.rowPtrs[c]; q < R.rowPtrs[c + 1]; ++q)
+			{
+				uint32 i = R.columns[q];
+				for (uint32 t = AP.rowPtrs[i]; t < AP.rowPtrs[i + 1]; ++t)
+				{
+					uint32 d = AP.columns[t];
+					if (markers[d] != c)
+					{
+						markers[d] = c;
+						++count;
+					}
+				}
+			}
+			coarseA.rowPtrs[c + 1] = coarseA.rowPtrs[c] + count;
+		}
+
+		coarseA.Reserve(coarseA.rowPtrs[coarseCount]);
+		coarseA.blockCount = coarseA.rowPtrs[coarseCount];
+
+		for (uint32 c = 0; c < coarseCount; ++c)
+		{
+			markers[c] = B3_MAX_U32;
+		}
+
+		for (uint32 c = 0; c < coarseCount; ++c)
+		{
+			uint32 count = 0;
+			for (uint32 q = R.rowPtrs[c]; q < R.rowPtrs[c + 1]; ++q)
+			{
+				uint32 i = R.columns[q];
+				for (uint32 t = AP.rowPtrs[i]; t < AP.rowPtrs[i + 1]; ++t)
+				{
+					uint32 d = AP.columns[t];
+					if (markers[d] != c)
+					{
+						markers[d] = c;
+						coarseA.columns[coarseA.rowPtrs[c] + count] = d;
+						++count;
+					}
+				}
+			}
+
+			b3SortRow(coarseA.columns + coarseA.rowPtrs[c], count);
+		}
+	}
+
+	// Factorize the coarsest level directly if it is small.
+	uint32 coarseRowCount = levels[levelCount - 1].A.rowCount;
+	if (coarseRowCount <= b3_multigridCoarseRowCount)
+	{
+		coarseSize = 3 * coarseRowCount;
+		coarseL = (scalar*)b3Alloc(coarseSize * coarseSize * sizeof(scalar));
+	}
+}
+
+void b3SparseMultigrid::Compute(const b3SparseMat33& A, const b3DiagMat33* S)
+{
+	if (levelCount == 0 || levels[0].A.HasStructure(A) == false)
+	{
+		// The structure changed. Rebuild the hierarchy.
+		Destroy();
+		levels[0].A = A;
+		BuildHierarchy();
+	}
+	else
+	{
+		// Keep a copy of the matrix because the preconditioner may be 
+		// reused after the source matrix is gone.
+		levels[0].A.Copy(A);
+	}
+
+	for (uint32 i = 0; i < A.rowCount; ++i)
+	{
+		if (S)
+		{
+			levels[0].S[i] = (*S)[i];
+		}
+		else
+		{
+			levels[0].S[i].SetIdentity();
+		}
+	}
+
+	for (uint32 i = 0; i < levelCount; ++i)
+	{
+		ComputeLevel(i);
+	}
+
+	if (coarseL == nullptr)
+	{
+		return;
+	}
+
+	// Dense Cholesky factorization of the coarsest matrix.
+	const b3SparseMat33& coarseA = levels[levelCount - 1].A;
+	uint32 n = coarseSize;
+	
+	for (uint32 i = 0; i < n * n; ++i)
+	{
+		coarseL[i] = scalar(0);
+	}
+
+	for (uint32 i = 0; i < coarseA.rowCount; ++i)
+	{
+		for (uint32 k = coarseA.rowPtrs[i]; k < coarseA.rowPtrs[i + 1]; ++k)
+		{
+			uint32 j = coarseA.columns[k];
+			const b3Mat33& a = coarseA.values[k];
+			for (uint32 c = 0; c < 3; ++c)
+			{
+				for (uint32 r = 0; r < 3; ++r)
+				{
+					coarseL[(3 * i + r) * n + 3 * j + c] = a[c][r];
+				}
+			}
+		}
+	}
+
+	for (uint32 j = 0; j < n; ++j)
+	{
+		scalar* Lj = coarseL + j * n;
+		
+		scalar d = Lj[j];
+		for (uint32 k = 0; k < j; ++k)
+		{
+			d -= Lj[k] * Lj[k];
+		}
+
+		// Decouple a singular direction.
+		scalar ljj = d > scalar(0) ? b3Sqrt(d) : scalar(1);
+		scalar inv_ljj = scalar(1) / ljj;
+		Lj[j] = ljj;
+
+		for (uint32 i = j + 1; i < n; ++i)
+		{
+			scalar* Li = coarseL + i * n;
+
+			scalar s = Li[j];
+			for (uint32 k = 0; k < j; ++k)
+			{
+				s -= Li[k] * Lj[k];
+			}
+			Li[j] = d > scalar(0) ? s * inv_ljj : scalar(0);
+		}
+	}
+}
+
+void b3SparseMultigrid::ComputeLevel(uint32 index)
+{
+	b3MultigridLevel* level = levels + index;
+	const b3SparseMat33& A = level->A;
+	uint32 n = A.rowCount;
+
+	for (uint32 i = 0; i < n; ++i)
+	{
+		level->invDiagonal[i] = b3SymInverse(A.values[level->diagonalIndices[i]]);
+	}
+
+	if (index + 1 == levelCount)
+	{
+		return;
+	}
+
+	// Estimate the spectral radius of D^-1 * A using power iterations.
+	// Start from a rough vector because smooth vectors are near the smallest eigenvalues.
+	b3Vec3* x = level->x;
+	b3Vec3* y = level->r;
+	
+	uint32 seed = 1;
+	for (uint32 i = 0; i < n; ++i)
+	{
+		for (uint32 j = 0; j < 3; ++j)
+		{
+			seed = seed * 1664525 + 1013904223;
+			x[i][j] = scalar(seed >> 8) / scalar(1 << 24) - scalar(0.5);
+		}
+	}
+
+	scalar rho = scalar(1);
+	for (uint32 iteration = 0; iteration < b3_multigridPowerIterations; ++iteration)
+	{
+		scalar xx = scalar(0), yy = scalar(0);
+		for (uint32 i = 0; i < n; ++i)
+		{
+			b3Vec3 sum;
+			sum.SetZero();
+			for (uint32 k = A.rowPtrs[i]; k < A.rowPtrs[i + 1]; ++k)
+			{
+				sum += A.values[k] * x[A.columns[k]];
+			}
+			y[i] = level->invDiagonal[i] * sum;
+			
+			xx += b3Dot(x[i], x[i]);
+			yy += b3Dot(y[i], y[i]);
+		}
+
+		if (xx == scalar(0) || yy == scalar(0))
+		{
+			break;
+		}
+
+		rho = b3Sqrt(yy / xx);
+
+		scalar s = scalar(1) / b3Sqrt(yy);
+		for (uint32 i = 0; i < n; ++i)
+		{
+			x[i] = s * y[i];
+		}
+	}
+
+	scalar omega = scalar(4) / (scalar(3) * rho);
+
+	// P = S * (I - w * D^-1 * A) * P0
+	b3MultigridOperator& P = level->P;
+	for (uint32 p = 0; p < P.blockCount; ++p)
+	{
+		P.values[p].SetZero();
+	}
+
+	for (uint32 i = 0; i < n; ++i)
+	{
+		b3Mat33 S = level->S[i];
+		b3Mat33 W = -omega * S * level->invDiagonal[i];
+
+		for (uint32 k = A.rowPtrs[i]; k < A.rowPtrs[i + 1]; ++k)
+		{
+			P.values[level->prolongationIndices[k]] += W * A.values[k];
+		}
+		
+		P.values[level->prolongationIndices[level->diagonalIndices[i]]] += S;
+	}
+
+	// R = P^T
+	b3MultigridOperator& R = level->R;
+	for (uint32 q = 0; q < R.blockCount; ++q)
+	{
+		R.values[q] = b3Transpose(P.values[level->restrictionIndices[q]]);
+	}
+
+	// A * P
+	b3MultigridOperator& AP = level->AP;
+	for (uint32 i = 0; i < n; ++i)
+	{
+		for (uint32 t = AP.rowPtrs[i]; t < AP.rowPtrs[i + 1]; ++t)
+		{
+			markers[AP.columns[t]] = t;
+			AP.values[t].SetZero();
+		}
+
+		for (uint32 k = A.rowPtrs[i]; k < A.rowPtrs[i + 1]; ++k)
+		{
+			uint32 j = A.columns[k];
+			const b3Mat33& a = A.values[k];
+			for (uint32 p = P.rowPtrs[j]; p < P.rowPtrs[j + 1]; ++p)
+			{
+				AP.values[markers[P.columns[p]]] += a * P.values[p];
+			}
+		}
+	}
+
+	// R * A * P
+	b3MultigridLevel* coarseLevel = levels + index + 1;
+	b3SparseMat33& coarseA = coarseLevel->A;
+	for (uint32 c = 0; c < coarseA.rowCount; ++c)
+	{
+		for (uint32 t = coarseA.rowPtrs[c]; t < coarseA.rowPtrs[c + 1]; ++t)
+		{
+			markers[coarseA.columns[t]] = t;
+			coarseA.values[t].SetZero();
+		}
+
+		for (uint32 q = R.rowPtrs[c]; q < R.rowPtrs[c + 1]; ++q)
+		{
+			uint32 i = R.columns[q];
+			const b3Mat33& r = R.values[q];
+			for (uint32 t = AP.rowPtrs[i]; t < AP.rowPtrs[i + 1]; ++t)
+			{
+				coarseA.values[markers[AP.columns[t]]] += r * AP.values[t];
+			}
+		}
+	}
+
+	// An aggregate direction is constrained if it is constrained in all rows of the aggregate.
+	// The coarse matrix is zero in these directions, so filter them as in S * A * S^T + I - S.
+	b3Mat33* coarseS = coarseLevel->S;
+	for (uint32 c = 0; c < coarseA.rowCount; ++c)
+	{
+		coarseS[c].SetZero();
+	}
+
+	for (uint32 i = 0; i < n; ++i)
+	{
+		b3Mat33 S = level->S[i];
+		b3Mat33& G = coarseS[level->aggregates[i]];
+		G.x.x += b3Abs(S.x.x);
+		G.y.y += b3Abs(S.y.y);
+		G.z.z += b3Abs(S.z.z);
+	}
+
+	for (uint32 c = 0; c < coarseA.rowCount; ++c)
+	{
+		b3Mat33& G = coarseS[c];
+		G.x.x = G.x.x > scalar(0) ? scalar(1) : scalar(0);
+		G.y.y = G.y.y > scalar(0) ? scalar(1) : scalar(0);
+		G.z.z = G.z.z > scalar(0) ? scalar(1) : scalar(0);
+
+		b3Mat33& D = coarseA.values[coarseLevel->diagonalIndices[c]];
+		D.x.x += scalar(1) - G.x.x;
+		D.y.y += scalar(1) - G.y.y;
+		D.z.z += scalar(1) - G.z.z;
+	}
+}
+
+// Forward block Gauss-Seidel sweep.
+static void b3ForwardSweep(b3Vec3* x, const b3Vec3* b, const b3SparseMat33& A, const b3Mat33* invDiagonal, const uint32* diagonalIndices)
+{
+	for (uint32 i = 0; i < A.rowCount; ++i)
+	{
+		b3Vec3 sum = b[i];
+		for (uint32 k = A.rowPtrs[i]; k < A.rowPtrs[i + 1]; ++k)
+		{
+			if (k != diagonalIndices[i])
+			{
+				sum -= A.values[k] * x[A.columns[k]];
+			}
+		}
+		x[i] = invDiagonal[i] * sum;
+	}
+}
+
+// Backward block Gauss-Seidel sweep.
+static void b3BackwardSweep(b3Vec3* x, const b3Vec3* b, const b3SparseMat33& A, const b3Mat33* invDiagonal, const uint32* diagonalIndices)
+{
+	for (uint32 row = A.rowCount; row > 0; --row)
+	{
+		uint32 i = row - 1;
+
+		b3Vec3 sum = b[i];
+		for (uint32 k = A.rowPtrs[i]; k < A.rowPtrs[i + 1]; ++k)
+		{
+			if (k != diagonalIndices[i])
+			{
+				sum -= A.values[k] * x[A.columns[k]];
+			}
+		}
+		x[i] = invDiagonal[i] * sum;
+	}
+}
+
+void b3SparseMultigrid::SolveLevel(uint32 index) const
+{
+	const b3MultigridLevel* level = levels + index;
+	const b3SparseMat33& A = level->A;
+	uint32 n = A.rowCount;
+	b3Vec3* x = level->x;
+	const b3Vec3* b = level->b;
+
+	if (index + 1 == levelCount && coarseL)
+	{
+		// Solve L * L^T * x = b
+		scalar* y = &x[0].x;
+		const scalar* c = &b[0].x;
+		
+		for (uint32 i = 0; i < coarseSize; ++i)
+		{
+			const scalar* Li = coarseL + i * coarseSize;
+			scalar s = c[i];
+			for (uint32 k = 0; k < i; ++k)
+			{
+				s -= Li[k] * y[k];
+			}
+			y[i] = s / Li[i];
+		}
+
+		for (uint32 i = coarseSize; i > 0; --i)
+		{
+			uint32 row = i - 1;
+			scalar s = y[row];
+			for (uint32 k = row + 1; k < coarseSize; ++k)
+			{
+				s -= coarseL[k * coarseSize + row] * y[k];
+			}
+			y[row] = s / coarseL[row * coarseSize + row];
+		}
+
+		return;
+	}
+
+	for (uint32 i = 0; i < n; ++i)
+	{
+		x[i].SetZero();
+	}
+
+	if (index + 1 == levelCount)
+	{
+		// The coarsest level is too large to be solved directly.
+		for (uint32 sweep = 0; sweep < b3_multigridCoarseSweeps; ++sweep)
+		{
+			b3ForwardSweep(x, b, A, level->invDiagonal, level->diagonalIndices);
+			b3BackwardSweep(x, b, A, level->invDiagonal, level->diagonalIndices);
+		}
+		return;
+	}
+
+	// Pre-smoothing
+	b3ForwardSweep(x, b, A, level->invDiagonal, level->diagonalIndices);
+
+	// r = b - A * x
+	b3Vec3* r = level->r;
+	for (uint32 i = 0; i < n; ++i)
+	{
+		b3Vec3 sum = b[i];
+		for (uint32 k = A.rowPtrs[i]; k < A.rowPtrs[i + 1]; ++k)
+		{
+			sum -= A.values[k] * x[A.columns[k]];
+		}
+		r[i] = sum;
+	}
+
+	// Restriction
+	const b3MultigridLevel* coarseLevel = levels + index + 1;
+	const b3MultigridOperator& R = level->R;
+	for (uint32 c = 0; c < R.rowCount; ++c)
+	{
+		b3Vec3 sum;
+		sum.SetZero();
+		for (uint32 q = R.rowPtrs[c]; q < R.rowPtrs[c + 1]; ++q)
+		{
+			sum += R.values[q] * r[R.columns[q]];
+		}
+		coarseLevel->b[c] = sum;
+	}
+
+	SolveLevel(index + 1);
+
+	// Prolongation
+	const b3MultigridOperator& P = level->P;
+	for (uint32 i = 0; i < n; ++i)
+	{
+		for (uint32 p = P.rowPtrs[i]; p < P.rowPtrs[i + 1]; ++p)
+		{
+			x[i] += P.values[p] * coarseLevel->x[P.columns[p]];
+		}
+	}
+
+	// Post-smoothing
+	b3BackwardSweep(x, b, A, level->invDiagonal, level->diagonalIndices);
+}
+
+void b3SparseMultigrid::Solve(b3Vec3* x, const b3Vec3* b) const
+{
+	B3_ASSERT(levelCount > 0);
+
+	const b3MultigridLevel* level = levels + 0;
+	uint32 n = level->A.rowCount;
+
+	memcpy(level->b, b, n * sizeof(b3Vec3));
+
+	SolveLevel(0);
+
+	memcpy(x, level->x, n * sizeof(b3Vec3));
+}
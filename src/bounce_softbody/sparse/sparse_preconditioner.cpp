@@ -0,0 +1,469 @@
+/*
+* Copyright (c) 2016-2019 Irlan Robson
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <bounce_softbody/sparse/sparse_preconditioner.h>
+#include <bounce_softbody/sparse/sparse_mat33.h>
+#include <bounce_softbody/sparse/diag_mat33.h>
+#include <bounce_softbody/sparse/dense_vec3.h>
+#include <bounce_softbody/sparse/sparse_multigrid.h>
+
+b3SparsePreconditioner::b3SparsePreconditioner()
+{
+	type = e_jacobiPreconditioner;
+	rowCount = 0;
+	blockCount = 0;
+	invDiagonal = nullptr;
+	invBlocks = nullptr;
+	lowerRowPtrs = nullptr;
+	lowerCapacity = 0;
+	lowerColumns = nullptr;
+	lowerValues = nullptr;
+	multigrid = nullptr;
+}
+
+b3SparsePreconditioner::~b3SparsePreconditioner()
+{
+	b3Free(invDiagonal);
+	b3Free(invBlocks);
+	b3Free(lowerRowPtrs);
+	b3Free(lowerColumns);
+	b3Free(lowerValues);
+	if (multigrid)
+	{
+		multigrid->~b3SparseMultigrid();
+		b3Free(multigrid);
+	}
+}
+
+uint32 b3SparsePreconditioner::GetByteCount() const
+{
+	uint32 byteCount = 0;
+
+	if (invDiagonal)
+	{
+		byteCount += rowCount * sizeof(b3Vec3);
+	}
+
+	if (invBlocks)
+	{
+		byteCount += rowCount * sizeof(b3Mat33);
+	}
+
+	if (lowerRowPtrs)
+	{
+		byteCount += (rowCount + 1) * sizeof(uint32);
+	}
+
+	byteCount += lowerCapacity * (sizeof(uint32) + sizeof(b3Mat33));
+
+	if (multigrid)
+	{
+		byteCount += sizeof(b3SparseMultigrid) + multigrid->GetByteCount();
+	}
+
+	return byteCount;
+}
+
+bool b3SparsePreconditioner::IsCompatible(const b3SparseMat33& A) const
+{
+	if (rowCount != A.rowCount || blockCount != A.blockCount)
+	{
+		return false;
+	}
+
+	if (type == e_jacobiPreconditioner)
+	{
+		return invDiagonal != nullptr;
+	}
+
+	if (type == e_multigridPreconditioner)
+	{
+		// The hierarchy depends on the block structure.
+		return multigrid != nullptr && multigrid->levelCount > 0 && multigrid->levels[0].A.HasStructure(A);
+	}
+
+	if (type == e_incompleteCholeskyPreconditioner)
+	{
+		if (invBlocks == nullptr || lowerRowPtrs == nullptr)
+		{
+			return false;
+		}
+
+		// The factor has the structure of the strictly lower blocks.
+		for (uint32 i = 0; i < rowCount; ++i)
+		{
+			uint32 p = lowerRowPtrs[i];
+			for (uint32 k = A.rowPtrs[i]; k < A.rowPtrs[i + 1] && A.columns[k] < i; ++k, ++p)
+			{
+				if (p == lowerRowPtrs[i + 1] || lowerColumns[p] != A.columns[k])
+				{
+					return false;
+				}
+			}
+
+			if (p != lowerRowPtrs[i + 1])
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	return invBlocks != nullptr;
+}
+
+// Compute the lower Cholesky factor of a 3x3 positive-definite matrix.
+// Return false if the matrix is not positive-definite.
+static bool b3Cholesky(b3Mat33& L, const b3Mat33& A)
+{
+	scalar d0 = A.x.x;
+	if (d0 <= scalar(0))
+	{
+		return false;
+	}
+
+	scalar l00 = b3Sqrt(d0);
+	scalar l10 = A.x.y / l00;
+	scalar l20 = A.x.z / l00;
+
+	scalar d1 = A.y.y - l10 * l10;
+	if (d1 <= scalar(0))
+	{
+		return false;
+	}
+
+	scalar l11 = b3Sqrt(d1);
+	scalar l21 = (A.y.z - l20 * l10) / l11;
+
+	scalar d2 = A.z.z - l20 * l20 - l21 * l21;
+	if (d2 <= scalar(0))
+	{
+		return false;
+	}
+
+	scalar l22 = b3Sqrt(d2);
+
+	L.x.Set(l00, l10, l20);
+	L.y.Set(scalar(0), l11, l21);
+	L.z.Set(scalar(0), scalar(0), l22);
+
+	return true;
+}
+
+// Invert a lower triangular 3x3 matrix.
+static b3Mat33 b3InverseLower(const b3Mat33& L)
+{
+	scalar i00 = scalar(1) / L.x.x;
+	scalar i11 = scalar(1) / L.y.y;
+	scalar i22 = scalar(1) / L.z.z;
+	scalar i10 = -L.x.y * i00 * i11;
+	scalar i21 = -L.y.z * i11 * i22;
+	scalar i20 = -(L.x.z * i00 + L.y.z * i10) * i22;
+
+	b3Mat33 M;
+	M.x.Set(i00, i10, i20);
+	M.y.Set(scalar(0), i11, i21);
+	M.z.Set(scalar(0), scalar(0), i22);
+	return M;
+}
+
+void b3SparsePreconditioner::Compute(const b3SparseMat33& A)
+{
+	Compute(A, nullptr);
+}
+
+void b3SparsePreconditioner::Compute(const b3SparseMat33& A, const b3DiagMat33* S)
+{
+	if (type == e_multigridPreconditioner)
+	{
+		if (multigrid == nullptr)
+		{
+			void* mem = b3Alloc(sizeof(b3SparseMultigrid));
+			multigrid = new (mem) b3SparseMultigrid();
+		}
+
+		// The hierarchy is kept while the block structure doesn't change.
+		multigrid->Compute(A, S);
+
+		rowCount = A.rowCount;
+		blockCount = A.blockCount;
+		return;
+	}
+
+	if (rowCount != A.rowCount)
+	{
+		b3Free(invDiagonal);
+		b3Free(invBlocks);
+		b3Free(lowerRowPtrs);
+		invDiagonal = nullptr;
+		invBlocks = nullptr;
+		lowerRowPtrs = nullptr;
+	}
+
+	rowCount = A.rowCount;
+
+	if (type == e_jacobiPreconditioner)
+	{
+		if (invDiagonal == nullptr)
+		{
+			invDiagonal = (b3Vec3*)b3Alloc(rowCount * sizeof(b3Vec3));
+		}
+
+		for (uint32 i = 0; i < rowCount; ++i)
+		{
+			b3Mat33 a = A(i, i);
+
+			B3_ASSERT(a.x.x > scalar(0));
+			B3_ASSERT(a.y.y > scalar(0));
+			B3_ASSERT(a.z.z > scalar(0));
+
+			invDiagonal[i].Set(scalar(1) / a.x.x, scalar(1) / a.y.y, scalar(1) / a.z.z);
+		}
+
+		blockCount = A.blockCount;
+		return;
+	}
+
+	if (invBlocks == nullptr)
+	{
+		invBlocks = (b3Mat33*)b3Alloc(rowCount * sizeof(b3Mat33));
+	}
+
+	if (type == e_blockJacobiPreconditioner)
+	{
+		for (uint32 i = 0; i < rowCount; ++i)
+		{
+			invBlocks[i] = b3SymInverse(A(i, i));
+		}
+
+		blockCount = A.blockCount;
+		return;
+	}
+
+	B3_ASSERT(type == e_incompleteCholeskyPreconditioner);
+
+	// The columns in a row are sorted, so the strictly lower blocks are a prefix of the row.
+	if (lowerRowPtrs == nullptr)
+	{
+		lowerRowPtrs = (uint32*)b3Alloc((rowCount + 1) * sizeof(uint32));
+	}
+
+	uint32 lowerCount = 0;
+	for (uint32 i = 0; i < rowCount; ++i)
+	{
+		lowerRowPtrs[i] = lowerCount;
+		for (uint32 k = A.rowPtrs[i]; k < A.rowPtrs[i + 1] && A.columns[k] < i; ++k)
+		{
+			++lowerCount;
+		}
+	}
+	lowerRowPtrs[rowCount] = lowerCount;
+
+	// The number of lower blocks can grow while the dimension and the number of blocks stay the same.
+	if (lowerCount > lowerCapacity || lowerValues == nullptr)
+	{
+		b3Free(lowerColumns);
+		b3Free(lowerValues);
+		lowerCapacity = lowerCount;
+		lowerColumns = (uint32*)b3Alloc(lowerCapacity * sizeof(uint32));
+		lowerValues = (b3Mat33*)b3Alloc(lowerCapacity * sizeof(b3Mat33));
+	}
+
+	blockCount = A.blockCount;
+
+	// Row-by-row block IC(0):
+	// L_ij = (A_ij - sum(L_ik * L_jk^T, k < j)) * L_jj^-T
+	// L_ii * L_ii^T = A_ii - sum(L_ik * L_ik^T, k < i)
+	for (uint32 i = 0; i < rowCount; ++i)
+	{
+		uint32 rowBegin = lowerRowPtrs[i];
+		uint32 rowEnd = lowerRowPtrs[i + 1];
+
+		uint32 k = A.rowPtrs[i];
+		for (uint32 p = rowBegin; p < rowEnd; ++p, ++k)
+		{
+			uint32 j = A.columns[k];
+
+			lowerColumns[p] = j;
+
+			b3Mat33 S = A.values[k];
+
+			// Sparse dot product between the computed blocks of row i and the row j.
+			uint32 p1 = rowBegin;
+			uint32 p2 = lowerRowPtrs[j];
+			uint32 end2 = lowerRowPtrs[j + 1];
+			while (p1 < p && p2 < end2)
+			{
+				uint32 c1 = lowerColumns[p1];
+				uint32 c2 = lowerColumns[p2];
+				if (c1 < c2)
+				{
+					++p1;
+				}
+				else if (c2 < c1)
+				{
+					++p2;
+				}
+				else
+				{
+					S -= lowerValues[p1] * b3Transpose(lowerValues[p2]);
+					++p1;
+					++p2;
+				}
+			}
+
+			lowerValues[p] = S * b3Transpose(invBlocks[j]);
+		}
+
+		b3Mat33 D = A(i, i);
+		for (uint32 p = rowBegin; p < rowEnd; ++p)
+		{
+			D -= lowerValues[p] * b3Transpose(lowerValues[p]);
+		}
+
+		b3Mat33 Lii;
+		if (b3Cholesky(Lii, D) == false)
+		{
+			// The incomplete factorization broke down. 
+			// Drop the update of this diagonal block.
+			bool ok = b3Cholesky(Lii, A(i, i));
+			B3_ASSERT(ok);
+			B3_NOT_USED(ok);
+		}
+
+		invBlocks[i] = b3InverseLower(Lii);
+	}
+}
+
+void b3SparsePreconditioner::Compute(const b3DiagMat33& D)
+{
+	B3_ASSERT(type == e_jacobiPreconditioner || type == e_blockJacobiPreconditioner);
+
+	if (rowCount != D.n)
+	{
+		b3Free(invDiagonal);
+		b3Free(invBlocks);
+		b3Free(lowerRowPtrs);
+		invDiagonal = nullptr;
+		invBlocks = nullptr;
+		lowerRowPtrs = nullptr;
+	}
+
+	rowCount = D.n;
+	blockCount = D.n;
+
+	if (type == e_jacobiPreconditioner)
+	{
+		if (invDiagonal == nullptr)
+		{
+			invDiagonal = (b3Vec3*)b3Alloc(rowCount * sizeof(b3Vec3));
+		}
+
+		for (uint32 i = 0; i < rowCount; ++i)
+		{
+			const b3Mat33& a = D[i];
+
+			B3_ASSERT(a.x.x > scalar(0));
+			B3_ASSERT(a.y.y > scalar(0));
+			B3_ASSERT(a.z.z > scalar(0));
+
+			invDiagonal[i].Set(scalar(1) / a.x.x, scalar(1) / a.y.y, scalar(1) / a.z.z);
+		}
+		return;
+	}
+
+	if (invBlocks == nullptr)
+	{
+		invBlocks = (b3Mat33*)b3Alloc(rowCount * sizeof(b3Mat33));
+	}
+
+	for (uint32 i = 0; i < rowCount; ++i)
+	{
+		invBlocks[i] = b3SymInverse(D[i]);
+	}
+}
+
+scalar b3SparsePreconditioner::Solve(b3DenseVec3& x, const b3DenseVec3& r, uint32 rowBegin, uint32 rowEnd) const
+{
+	B3_ASSERT(type == e_jacobiPreconditioner || type == e_blockJacobiPreconditioner);
+
+	scalar result = scalar(0);
+
+	if (type == e_jacobiPreconditioner)
+	{
+		for (uint32 i = rowBegin; i < rowEnd; ++i)
+		{
+			b3Vec3 d = invDiagonal[i];
+			b3Vec3 ri = r[i];
+			x[i].Set(d.x * ri.x, d.y * ri.y, d.z * ri.z);
+			result += b3Dot(ri, x[i]);
+		}
+	}
+	else
+	{
+		for (uint32 i = rowBegin; i < rowEnd; ++i)
+		{
+			x[i] = invBlocks[i] * r[i];
+			result += b3Dot(r[i], x[i]);
+		}
+	}
+
+	return result;
+}
+
+void b3SparsePreconditioner::Solve(b3DenseVec3& x, const b3DenseVec3& r) const
+{
+	if (type == e_multigridPreconditioner)
+	{
+		multigrid->Solve(x.v, r.v);
+		return;
+	}
+
+	if (type != e_incompleteCholeskyPreconditioner)
+	{
+		Solve(x, r, 0, rowCount);
+		return;
+	}
+
+	// Forward substitution
+	// L * y = r
+	for (uint32 i = 0; i < rowCount; ++i)
+	{
+		b3Vec3 sum = r[i];
+		for (uint32 p = lowerRowPtrs[i]; p < lowerRowPtrs[i + 1]; ++p)
+		{
+			sum -= lowerValues[p] * x[lowerColumns[p]];
+		}
+		x[i] = invBlocks[i] * sum;
+	}
+
+	// Backward substitution
+	// L^T * x = y
+	for (uint32 i = rowCount; i > 0; --i)
+	{
+		uint32 row = i - 1;
+
+		x[row] = b3MulT(invBlocks[row], x[row]);
+
+		for (uint32 p = lowerRowPtrs[row]; p < lowerRowPtrs[row + 1]; ++p)
+		{
+			x[lowerColumns[p]] -= b3MulT(lowerValues[p], x[row]);
+		}
+	}
+}
@@ -20,44 +20,779 @@
 #include <bounce_softbody/sparse/sparse_mat33.h>
 #include <bounce_softbody/sparse/diag_mat33.h>
 #include <bounce_softbody/sparse/dense_vec3.h>
+#include <bounce_softbody/sparse/sparse_preconditioner.h>
+#include <bounce_softbody/sparse/sparse_workspace.h>
+#include <bounce_softbody/common/thread_pool.h>
 
-// Conjugated Gradients method. For an introduction to this method see:
-// "An Introduction to the Conjugate Gradient Method Without the Agonizing Pain", by Jonathan Richard Shewchuk.
+#if defined(__AVX__)
+	#include <immintrin.h>
+	#define B3_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define B3_SSE2
+#endif
 
-// Preconditioned Conjugate Gradient algorithm.
-bool b3SparseSolveCG(b3SolveCGOutput* output, const b3SolveCGInput* input)
+// Vector kernels on arrays of n scalars.
+// The single precision versions use SIMD instructions if available.
+
+// y = y + a * x
+static inline void b3Axpy(float* y, float a, const float* x, uint32 n)
 {
-	const b3SparseMat33& A = *input->A;
-	const b3DenseVec3& b = *input->b;
-	uint32 maxIterations = input->maxIterations;
-	scalar epsilon = input->tolerance;
-	b3DenseVec3& x = *output->x;
+	uint32 i = 0;
+#if defined(B3_AVX)
+	__m256 va = _mm256_set1_ps(a);
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256 vy = _mm256_add_ps(_mm256_loadu_ps(y + i), _mm256_mul_ps(va, _mm256_loadu_ps(x + i)));
+		_mm256_storeu_ps(y + i, vy);
+	}
+#elif defined(B3_SSE2)
+	__m128 va = _mm_set1_ps(a);
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128 vy = _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(va, _mm_loadu_ps(x + i)));
+		_mm_storeu_ps(y + i, vy);
+	}
+#endif
+	for (; i < n; ++i)
+	{
+		y[i] += a * x[i];
+	}
+}
 
-	B3_ASSERT(epsilon > scalar(0) && epsilon < scalar(1));
+static inline void b3Axpy(double* y, double a, const double* x, uint32 n)
+{
+	for (uint32 i = 0; i < n; ++i)
+	{
+		y[i] += a * x[i];
+	}
+}
 
-	// Jacobi preconditioner
-	// M = diag(A) 
-	b3DiagMat33 invM(A.rowCount);
-	for (uint32 i = 0; i < A.rowCount; ++i)
+// y = x + b * y
+static inline void b3Xpby(float* y, const float* x, float b, uint32 n)
+{
+	uint32 i = 0;
+#if defined(B3_AVX)
+	__m256 vb = _mm256_set1_ps(b);
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256 vy = _mm256_add_ps(_mm256_loadu_ps(x + i), _mm256_mul_ps(vb, _mm256_loadu_ps(y + i)));
+		_mm256_storeu_ps(y + i, vy);
+	}
+#elif defined(B3_SSE2)
+	__m128 vb = _mm_set1_ps(b);
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128 vy = _mm_add_ps(_mm_loadu_ps(x + i), _mm_mul_ps(vb, _mm_loadu_ps(y + i)));
+		_mm_storeu_ps(y + i, vy);
+	}
+#endif
+	for (; i < n; ++i)
 	{
-		b3Mat33 a = A(i, i);
+		y[i] = x[i] + b * y[i];
+	}
+}
 
-		B3_ASSERT(a.x.x > scalar(0));
-		scalar xx = scalar(1) / a.x.x;
+static inline void b3Xpby(double* y, const double* x, double b, uint32 n)
+{
+	for (uint32 i = 0; i < n; ++i)
+	{
+		y[i] = x[i] + b * y[i];
+	}
+}
 
-		B3_ASSERT(a.y.y > scalar(0));
-		scalar yy = scalar(1) / a.y.y;
+// y = a * x (component-wise)
+// Return x . y
+static inline float b3MulDot(float* y, const float* a, const float* x, uint32 n)
+{
+	uint32 i = 0;
+	float result = 0.0f;
+#if defined(B3_AVX)
+	__m256 sum = _mm256_setzero_ps();
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256 vx = _mm256_loadu_ps(x + i);
+		__m256 vy = _mm256_mul_ps(_mm256_loadu_ps(a + i), vx);
+		_mm256_storeu_ps(y + i, vy);
+		sum = _mm256_add_ps(sum, _mm256_mul_ps(vx, vy));
+	}
+	float lanes[8];
+	_mm256_storeu_ps(lanes, sum);
+	for (uint32 j = 0; j < 8; ++j)
+	{
+		result += lanes[j];
+	}
+#elif defined(B3_SSE2)
+	__m128 sum = _mm_setzero_ps();
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128 vx = _mm_loadu_ps(x + i);
+		__m128 vy = _mm_mul_ps(_mm_loadu_ps(a + i), vx);
+		_mm_storeu_ps(y + i, vy);
+		sum = _mm_add_ps(sum, _mm_mul_ps(vx, vy));
+	}
+	float lanes[4];
+	_mm_storeu_ps(lanes, sum);
+	for (uint32 j = 0; j < 4; ++j)
+	{
+		result += lanes[j];
+	}
+#endif
+	for (; i < n; ++i)
+	{
+		y[i] = a[i] * x[i];
+		result += x[i] * y[i];
+	}
+	return result;
+}
 
-		B3_ASSERT(a.z.z > scalar(0));
-		scalar zz = scalar(1) / a.z.z;
+static inline double b3MulDot(double* y, const double* a, const double* x, uint32 n)
+{
+	double result = 0.0;
+	for (uint32 i = 0; i < n; ++i)
+	{
+		y[i] = a[i] * x[i];
+		result += x[i] * y[i];
+	}
+	return result;
+}
 
-		invM[i] = b3Mat33Diagonal(xx, yy, zz);
+// Return x . y
+static inline float b3Dot(const float* x, const float* y, uint32 n)
+{
+	uint32 i = 0;
+	float result = 0.0f;
+#if defined(B3_AVX)
+	__m256 sum = _mm256_setzero_ps();
+	for (; i + 8 <= n; i += 8)
+	{
+		sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+	}
+	float lanes[8];
+	_mm256_storeu_ps(lanes, sum);
+	for (uint32 j = 0; j < 8; ++j)
+	{
+		result += lanes[j];
+	}
+#elif defined(B3_SSE2)
+	__m128 sum = _mm_setzero_ps();
+	for (; i + 4 <= n; i += 4)
+	{
+		sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(y + i)));
 	}
+	float lanes[4];
+	_mm_storeu_ps(lanes, sum);
+	for (uint32 j = 0; j < 4; ++j)
+	{
+		result += lanes[j];
+	}
+#endif
+	for (; i < n; ++i)
+	{
+		result += x[i] * y[i];
+	}
+	return result;
+}
 
-	b3DenseVec3 r = b - A * x;
-	b3DenseVec3 d = invM * r;
-	scalar delta_new = b3Dot(r, d);
-	scalar delta_0 = delta_new;
+static inline double b3Dot(const double* x, const double* y, uint32 n)
+{
+	double result = 0.0;
+	for (uint32 i = 0; i < n; ++i)
+	{
+		result += x[i] * y[i];
+	}
+	return result;
+}
+
+// Mixed precision versions of the reductions.
+// The products of single precision values are exact in double precision.
+
+// y = a * x (component-wise)
+// Return x . y accumulated in double precision
+static inline double b3MulDot64(float* y, const float* a, const float* x, uint32 n)
+{
+	uint32 i = 0;
+	double result = 0.0;
+#if defined(B3_AVX)
+	__m256d sum = _mm256_setzero_pd();
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128 vx = _mm_loadu_ps(x + i);
+		__m128 vy = _mm_mul_ps(_mm_loadu_ps(a + i), vx);
+		_mm_storeu_ps(y + i, vy);
+		sum = _mm256_add_pd(sum, _mm256_mul_pd(_mm256_cvtps_pd(vx), _mm256_cvtps_pd(vy)));
+	}
+	double lanes[4];
+	_mm256_storeu_pd(lanes, sum);
+	for (uint32 j = 0; j < 4; ++j)
+	{
+		result += lanes[j];
+	}
+#elif defined(B3_SSE2)
+	__m128d sum = _mm_setzero_pd();
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128 vx = _mm_loadu_ps(x + i);
+		__m128 vy = _mm_mul_ps(_mm_loadu_ps(a + i), vx);
+		_mm_storeu_ps(y + i, vy);
+		sum = _mm_add_pd(sum, _mm_mul_pd(_mm_cvtps_pd(vx), _mm_cvtps_pd(vy)));
+		sum = _mm_add_pd(sum, _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(vx, vx)), _mm_cvtps_pd(_mm_movehl_ps(vy, vy))));
+	}
+	double lanes[2];
+	_mm_storeu_pd(lanes, sum);
+	result = lanes[0] + lanes[1];
+#endif
+	for (; i < n; ++i)
+	{
+		y[i] = a[i] * x[i];
+		result += double(x[i]) * double(y[i]);
+	}
+	return result;
+}
+
+static inline double b3MulDot64(double* y, const double* a, const double* x, uint32 n)
+{
+	return b3MulDot(y, a, x, n);
+}
+
+// Return x . y accumulated in double precision
+static inline double b3Dot64(const float* x, const float* y, uint32 n)
+{
+	uint32 i = 0;
+	double result = 0.0;
+#if defined(B3_AVX)
+	__m256d sum = _mm256_setzero_pd();
+	for (; i + 4 <= n; i += 4)
+	{
+		__m256d vx = _mm256_cvtps_pd(_mm_loadu_ps(x + i));
+		__m256d vy = _mm256_cvtps_pd(_mm_loadu_ps(y + i));
+		sum = _mm256_add_pd(sum, _mm256_mul_pd(vx, vy));
+	}
+	double lanes[4];
+	_mm256_storeu_pd(lanes, sum);
+	for (uint32 j = 0; j < 4; ++j)
+	{
+		result += lanes[j];
+	}
+#elif defined(B3_SSE2)
+	__m128d sum = _mm_setzero_pd();
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128 vx = _mm_loadu_ps(x + i);
+		__m128 vy = _mm_loadu_ps(y + i);
+		sum = _mm_add_pd(sum, _mm_mul_pd(_mm_cvtps_pd(vx), _mm_cvtps_pd(vy)));
+		sum = _mm_add_pd(sum, _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(vx, vx)), _mm_cvtps_pd(_mm_movehl_ps(vy, vy))));
+	}
+	double lanes[2];
+	_mm_storeu_pd(lanes, sum);
+	result = lanes[0] + lanes[1];
+#endif
+	for (; i < n; ++i)
+	{
+		result += double(x[i]) * double(y[i]);
+	}
+	return result;
+}
+
+static inline double b3Dot64(const double* x, const double* y, uint32 n)
+{
+	return b3Dot(x, y, n);
+}
+
+// Number of rows processed at once by the parallel kernels.
+// Reductions sum the partial results of the chunks in chunk order.
+// This is fixed so that the result does not depend on the number of threads.
+const uint32 b3_chunkRowCount = 512;
+
+// Shared state of the CG kernels.
+struct b3CGKernelData
+{
+	const b3SparseMat33* A;
+	bool symmetric;
+	const uint32* transposePtrs;
+	const uint32* transposeRows;
+	const uint32* transposeBlocks;
+	const b3SparseOperator* op;
+	const b3DenseVec3* b;
+	const b3SparsePreconditioner* M;
+	b3DenseVec3* x;
+	b3DenseVec3* r;
+	b3DenseVec3* d;
+	b3DenseVec3* q;
+	b3DenseVec3* s;
+	scalar alpha;
+	scalar beta;
+	bool mixedPrecision;
+	scalar64* partials;
+};
+
+static inline scalar* b3Data(b3DenseVec3* v, uint32 row)
+{
+	return &v->v[row].x;
+}
+
+static inline const scalar* b3Data(const b3DenseVec3* v, uint32 row)
+{
+	return &v->v[row].x;
+}
+
+// Get the rows of a chunk.
+static inline void b3GetChunkRows(uint32* begin, uint32* end, uint32 chunk, uint32 rowCount)
+{
+	*begin = chunk * b3_chunkRowCount;
+	*end = b3Min(*begin + b3_chunkRowCount, rowCount);
+}
+
+// Build the transposed index of the strictly upper blocks of A, which is the strictly lower part of a row.
+// Rows gather their lower part instead of scattering the transposed blocks,
+// so the symmetric product runs on the chunks and doesn't depend on the number of threads.
+static void b3BuildTranspose(uint32* ptrs, uint32* rows, uint32* blocks, const b3SparseMat33& A)
+{
+	uint32 n = A.rowCount;
+
+	for (uint32 i = 0; i <= n; ++i)
+	{
+		ptrs[i] = 0;
+	}
+
+	for (uint32 i = 0; i < n; ++i)
+	{
+		for (uint32 k = A.rowPtrs[i]; k < A.rowPtrs[i + 1]; ++k)
+		{
+			uint32 j = A.columns[k];
+			B3_ASSERT(j >= i);
+			if (j != i)
+			{
+				++ptrs[j + 1];
+			}
+		}
+	}
+
+	for (uint32 i = 0; i < n; ++i)
+	{
+		ptrs[i + 1] += ptrs[i];
+	}
+
+	// The rows of a column are in increasing order.
+	for (uint32 i = 0; i < n; ++i)
+	{
+		for (uint32 k = A.rowPtrs[i]; k < A.rowPtrs[i + 1]; ++k)
+		{
+			uint32 j = A.columns[k];
+			if (j != i)
+			{
+				uint32 t = ptrs[j]++;
+				rows[t] = i;
+				blocks[t] = k;
+			}
+		}
+	}
+
+	// Restore the pointers.
+	for (uint32 i = n; i > 0; --i)
+	{
+		ptrs[i] = ptrs[i - 1];
+	}
+	ptrs[0] = 0;
+}
+
+// Return row i of A * v.
+static inline b3Vec3 b3MulRow(const b3CGKernelData* data, uint32 i, const b3DenseVec3& v)
+{
+	const b3SparseMat33& A = *data->A;
+
+	b3Vec3 sum;
+	sum.SetZero();
+	for (uint32 k = A.rowPtrs[i]; k < A.rowPtrs[i + 1]; ++k)
+	{
+		sum += A.values[k] * v[A.columns[k]];
+	}
+
+	if (data->symmetric)
+	{
+		// Lower blocks
+		for (uint32 t = data->transposePtrs[i]; t < data->transposePtrs[i + 1]; ++t)
+		{
+			sum += b3MulT(A.values[data->transposeBlocks[t]], v[data->transposeRows[t]]);
+		}
+	}
+
+	return sum;
+}
+
+// Subtract row i of A * v from s in double precision.
+static inline void b3SubtractRow64(scalar64 s[3], const b3CGKernelData* data, uint32 i, const b3DenseVec3& v)
+{
+	const b3SparseMat33& A = *data->A;
+
+	for (uint32 k = A.rowPtrs[i]; k < A.rowPtrs[i + 1]; ++k)
+	{
+		const b3Mat33& a = A.values[k];
+		const b3Vec3& u = v[A.columns[k]];
+
+		s[0] -= scalar64(a.x.x) * u.x + scalar64(a.y.x) * u.y + scalar64(a.z.x) * u.z;
+		s[1] -= scalar64(a.x.y) * u.x + scalar64(a.y.y) * u.y + scalar64(a.z.y) * u.z;
+		s[2] -= scalar64(a.x.z) * u.x + scalar64(a.y.z) * u.y + scalar64(a.z.z) * u.z;
+	}
+
+	if (data->symmetric)
+	{
+		// Lower blocks
+		for (uint32 t = data->transposePtrs[i]; t < data->transposePtrs[i + 1]; ++t)
+		{
+			const b3Mat33& a = A.values[data->transposeBlocks[t]];
+			const b3Vec3& u = v[data->transposeRows[t]];
+
+			s[0] -= scalar64(a.x.x) * u.x + scalar64(a.x.y) * u.y + scalar64(a.x.z) * u.z;
+			s[1] -= scalar64(a.y.x) * u.x + scalar64(a.y.y) * u.y + scalar64(a.y.z) * u.z;
+			s[2] -= scalar64(a.z.x) * u.x + scalar64(a.z.y) * u.y + scalar64(a.z.z) * u.z;
+		}
+	}
+}
+
+// r = b - A * x
+static void b3ResidualKernel(void* context, uint32 chunkBegin, uint32 chunkEnd)
+{
+	b3CGKernelData* data = (b3CGKernelData*)context;
+	const b3SparseMat33& A = *data->A;
+	const b3DenseVec3& b = *data->b;
+	const b3DenseVec3& x = *data->x;
+	b3DenseVec3& r = *data->r;
+
+	for (uint32 chunk = chunkBegin; chunk < chunkEnd; ++chunk)
+	{
+		uint32 rowBegin, rowEnd;
+		b3GetChunkRows(&rowBegin, &rowEnd, chunk, A.rowCount);
+
+		for (uint32 i = rowBegin; i < rowEnd; ++i)
+		{
+			r[i] = b[i] - b3MulRow(data, i, x);
+		}
+	}
+}
+
+// r = b - A * x accumulated in double precision
+static void b3Residual64Kernel(void* context, uint32 chunkBegin, uint32 chunkEnd)
+{
+	b3CGKernelData* data = (b3CGKernelData*)context;
+	const b3SparseMat33& A = *data->A;
+	const b3DenseVec3& b = *data->b;
+	const b3DenseVec3& x = *data->x;
+	b3DenseVec3& r = *data->r;
+
+	for (uint32 chunk = chunkBegin; chunk < chunkEnd; ++chunk)
+	{
+		uint32 rowBegin, rowEnd;
+		b3GetChunkRows(&rowBegin, &rowEnd, chunk, A.rowCount);
+
+		for (uint32 i = rowBegin; i < rowEnd; ++i)
+		{
+			scalar64 sum[3] = { scalar64(b[i].x), scalar64(b[i].y), scalar64(b[i].z) };
+			b3SubtractRow64(sum, data, i, x);
+			r[i].Set(scalar(sum[0]), scalar(sum[1]), scalar(sum[2]));
+		}
+	}
+}
+
+// r = b - r
+static void b3SubtractKernel(void* context, uint32 chunkBegin, uint32 chunkEnd)
+{
+	b3CGKernelData* data = (b3CGKernelData*)context;
+	const b3DenseVec3& b = *data->b;
+	b3DenseVec3& r = *data->r;
+
+	for (uint32 chunk = chunkBegin; chunk < chunkEnd; ++chunk)
+	{
+		uint32 rowBegin, rowEnd;
+		b3GetChunkRows(&rowBegin, &rowEnd, chunk, r.n);
+
+		for (uint32 i = rowBegin; i < rowEnd; ++i)
+		{
+			r[i] = b[i] - r[i];
+		}
+	}
+}
+
+// Solve M * s = r for the rows of a chunk if M is a (block) Jacobi preconditioner.
+// partial = r . s
+static inline void b3PreconditionChunk(b3CGKernelData* data, uint32 chunk, uint32 rowBegin, uint32 rowEnd)
+{
+	const b3SparsePreconditioner* M = data->M;
+	
+	uint32 n = 3 * (rowEnd - rowBegin);
+
+	if (M->type == e_jacobiPreconditioner)
+	{
+		const scalar* invDiagonal = &M->invDiagonal[rowBegin].x;
+		if (data->mixedPrecision)
+		{
+			data->partials[chunk] = b3MulDot64(b3Data(data->s, rowBegin), invDiagonal, b3Data(data->r, rowBegin), n);
+		}
+		else
+		{
+			data->partials[chunk] = b3MulDot(b3Data(data->s, rowBegin), invDiagonal, b3Data(data->r, rowBegin), n);
+		}
+	}
+	else if (M->type == e_blockJacobiPreconditioner)
+	{
+		if (data->mixedPrecision)
+		{
+			M->Solve(*data->s, *data->r, rowBegin, rowEnd);
+			data->partials[chunk] = b3Dot64(b3Data(data->r, rowBegin), b3Data(data->s, rowBegin), n);
+		}
+		else
+		{
+			data->partials[chunk] = M->Solve(*data->s, *data->r, rowBegin, rowEnd);
+		}
+	}
+}
+
+// Solve M * s = r if M is a (block) Jacobi preconditioner.
+// partial = r . s
+static void b3PreconditionKernel(void* context, uint32 chunkBegin, uint32 chunkEnd)
+{
+	b3CGKernelData* data = (b3CGKernelData*)context;
+	uint32 rowCount = data->r->n;
+
+	for (uint32 chunk = chunkBegin; chunk < chunkEnd; ++chunk)
+	{
+		uint32 rowBegin, rowEnd;
+		b3GetChunkRows(&rowBegin, &rowEnd, chunk, rowCount);
+
+		b3PreconditionChunk(data, chunk, rowBegin, rowEnd);
+	}
+}
+
+// partial = r . s
+static void b3DotKernel(void* context, uint32 chunkBegin, uint32 chunkEnd)
+{
+	b3CGKernelData* data = (b3CGKernelData*)context;
+	uint32 rowCount = data->r->n;
+
+	for (uint32 chunk = chunkBegin; chunk < chunkEnd; ++chunk)
+	{
+		uint32 rowBegin, rowEnd;
+		b3GetChunkRows(&rowBegin, &rowEnd, chunk, rowCount);
+
+		uint32 n = 3 * (rowEnd - rowBegin);
+		if (data->mixedPrecision)
+		{
+			data->partials[chunk] = b3Dot64(b3Data(data->r, rowBegin), b3Data(data->s, rowBegin), n);
+		}
+		else
+		{
+			data->partials[chunk] = b3Dot(b3Data(data->r, rowBegin), b3Data(data->s, rowBegin), n);
+		}
+	}
+}
+
+// q = A * d
+// partial = d . q
+static void b3ProductKernel(void* context, uint32 chunkBegin, uint32 chunkEnd)
+{
+	b3CGKernelData* data = (b3CGKernelData*)context;
+	const b3SparseMat33& A = *data->A;
+	const b3DenseVec3& d = *data->d;
+	b3DenseVec3& q = *data->q;
+
+	for (uint32 chunk = chunkBegin; chunk < chunkEnd; ++chunk)
+	{
+		uint32 rowBegin, rowEnd;
+		b3GetChunkRows(&rowBegin, &rowEnd, chunk, A.rowCount);
+
+		scalar partial = scalar(0);
+		scalar64 partial64 = 0.0;
+		for (uint32 i = rowBegin; i < rowEnd; ++i)
+		{
+			b3Vec3 sum = b3MulRow(data, i, d);
+			q[i] = sum;
+			
+			// Only the sum over the rows is long.
+			scalar dot = b3Dot(d[i], sum);
+			partial += dot;
+			partial64 += dot;
+		}
+		data->partials[chunk] = data->mixedPrecision ? partial64 : scalar64(partial);
+	}
+}
+
+// partial = d . q
+static void b3CurvatureKernel(void* context, uint32 chunkBegin, uint32 chunkEnd)
+{
+	b3CGKernelData* data = (b3CGKernelData*)context;
+	uint32 rowCount = data->d->n;
+
+	for (uint32 chunk = chunkBegin; chunk < chunkEnd; ++chunk)
+	{
+		uint32 rowBegin, rowEnd;
+		b3GetChunkRows(&rowBegin, &rowEnd, chunk, rowCount);
+
+		uint32 n = 3 * (rowEnd - rowBegin);
+		if (data->mixedPrecision)
+		{
+			data->partials[chunk] = b3Dot64(b3Data(data->d, rowBegin), b3Data(data->q, rowBegin), n);
+		}
+		else
+		{
+			data->partials[chunk] = b3Dot(b3Data(data->d, rowBegin), b3Data(data->q, rowBegin), n);
+		}
+	}
+}
+
+// x = x + alpha * d
+static void b3SolutionKernel(void* context, uint32 chunkBegin, uint32 chunkEnd)
+{
+	b3CGKernelData* data = (b3CGKernelData*)context;
+	uint32 rowCount = data->x->n;
+
+	for (uint32 chunk = chunkBegin; chunk < chunkEnd; ++chunk)
+	{
+		uint32 rowBegin, rowEnd;
+		b3GetChunkRows(&rowBegin, &rowEnd, chunk, rowCount);
+
+		uint32 n = 3 * (rowEnd - rowBegin);
+		b3Axpy(b3Data(data->x, rowBegin), data->alpha, b3Data(data->d, rowBegin), n);
+	}
+}
+
+// x = x + alpha * d
+// r = r - alpha * q
+// Solve M * s = r if M is a (block) Jacobi preconditioner.
+// partial = r . s
+static void b3UpdateKernel(void* context, uint32 chunkBegin, uint32 chunkEnd)
+{
+	b3CGKernelData* data = (b3CGKernelData*)context;
+	uint32 rowCount = data->x->n;
+
+	for (uint32 chunk = chunkBegin; chunk < chunkEnd; ++chunk)
+	{
+		uint32 rowBegin, rowEnd;
+		b3GetChunkRows(&rowBegin, &rowEnd, chunk, rowCount);
+
+		uint32 n = 3 * (rowEnd - rowBegin);
+		b3Axpy(b3Data(data->x, rowBegin), data->alpha, b3Data(data->d, rowBegin), n);
+		b3Axpy(b3Data(data->r, rowBegin), -data->alpha, b3Data(data->q, rowBegin), n);
+		
+		b3PreconditionChunk(data, chunk, rowBegin, rowEnd);
+	}
+}
+
+// d = s + beta * d
+static void b3DirectionKernel(void* context, uint32 chunkBegin, uint32 chunkEnd)
+{
+	b3CGKernelData* data = (b3CGKernelData*)context;
+	uint32 rowCount = data->d->n;
+
+	for (uint32 chunk = chunkBegin; chunk < chunkEnd; ++chunk)
+	{
+		uint32 rowBegin, rowEnd;
+		b3GetChunkRows(&rowBegin, &rowEnd, chunk, rowCount);
+
+		uint32 n = 3 * (rowEnd - rowBegin);
+		b3Xpby(b3Data(data->d, rowBegin), b3Data(data->s, rowBegin), data->beta, n);
+	}
+}
+
+// Run a kernel over all chunks.
+static void b3RunKernel(b3ThreadPool* threadPool, uint32 chunkCount, b3ParallelForFcn* kernel, b3CGKernelData* data)
+{
+	if (threadPool)
+	{
+		threadPool->ParallelFor(chunkCount, 1, kernel, data);
+	}
+	else
+	{
+		kernel(data, 0, chunkCount);
+	}
+}
+
+// r = b - A * x
+static void b3Residual(b3ThreadPool* threadPool, uint32 chunkCount, b3CGKernelData* data)
+{
+	if (data->op)
+	{
+		data->op->Multiply(*data->r, *data->x);
+		b3RunKernel(threadPool, chunkCount, b3SubtractKernel, data);
+	}
+	else if (data->mixedPrecision)
+	{
+		b3RunKernel(threadPool, chunkCount, b3Residual64Kernel, data);
+	}
+	else
+	{
+		b3RunKernel(threadPool, chunkCount, b3ResidualKernel, data);
+	}
+}
+
+// q = A * d
+// partial = d . q
+static void b3Product(b3ThreadPool* threadPool, uint32 chunkCount, b3CGKernelData* data)
+{
+	if (data->op)
+	{
+		data->op->Multiply(*data->q, *data->d);
+		b3RunKernel(threadPool, chunkCount, b3CurvatureKernel, data);
+	}
+	else
+	{
+		b3RunKernel(threadPool, chunkCount, b3ProductKernel, data);
+	}
+}
+
+// Sum the partial results in chunk order.
+static scalar b3SumPartials(const b3CGKernelData* data, uint32 chunkCount)
+{
+	const scalar64* partials = data->partials;
+
+	if (data->mixedPrecision)
+	{
+		scalar64 result = 0.0;
+		for (uint32 i = 0; i < chunkCount; ++i)
+		{
+			result += partials[i];
+		}
+		return scalar(result);
+	}
+
+	scalar result = scalar(0);
+	for (uint32 i = 0; i < chunkCount; ++i)
+	{
+		result += scalar(partials[i]);
+	}
+	return result;
+}
+
+// Solve M * s = r for the residual in r.
+// Set fused to true if the update kernel was just run, which already solved M * s = r if M is a (block) Jacobi preconditioner.
+// Return r . s
+static scalar b3Precondition(b3ThreadPool* threadPool, uint32 chunkCount, b3CGKernelData* data, bool fused)
+{
+	b3PreconditionerType type = data->M->type;
+	if (type == e_incompleteCholeskyPreconditioner || type == e_multigridPreconditioner)
+	{
+		// The triangular solves and the smoothing sweeps are sequential.
+		data->M->Solve(*data->s, *data->r);
+		b3RunKernel(threadPool, chunkCount, b3DotKernel, data);
+	}
+	else if (fused == false)
+	{
+		b3RunKernel(threadPool, chunkCount, b3PreconditionKernel, data);
+	}
+
+	return b3SumPartials(data, chunkCount);
+}
+
+// Conjugated Gradients method. For an introduction to this method see:
+// "An Introduction to the Conjugate Gradient Method Without the Agonizing Pain", by Jonathan Richard Shewchuk.
+
+// Run the CG iterations starting from the residual in r and the preconditioned residual in s.
+// delta is r . s on input and on output.
+// Return the number of iterations.
+static uint32 b3Iterate(b3ThreadPool* threadPool, uint32 chunkCount, b3CGKernelData* data, uint32 maxIterations, scalar tolerance, scalar* delta)
+{
+	scalar delta_new = *delta;
+
+	*data->d = *data->s;
 
 	uint32 iteration = 0;
 	for (;;)
@@ -67,40 +802,209 @@ bool b3SparseSolveCG(b3SolveCGOutput* output, const b3SolveCGInput* input)
 			break;
 		}
 
-		if (delta_new <= epsilon * epsilon * delta_0)
+		if (delta_new <= tolerance)
 		{
 			break;
 		}
 
-		b3DenseVec3 q = A * d;
+		// q = A * d
+		b3Product(threadPool, chunkCount, data);
 
-		scalar alpha = delta_new / b3Dot(d, q);
+		data->alpha = delta_new / b3SumPartials(data, chunkCount);
+
+		scalar delta_old = delta_new;
 
-		x = x + alpha * d;
-		
 		// Shewchuk, page 8.
 		// Periodically recompute the correct residual.
 		if (iteration % 50 == 0)
 		{
-			r = b - A * x;
+			b3RunKernel(threadPool, chunkCount, b3SolutionKernel, data);
+			b3Residual(threadPool, chunkCount, data);
+			delta_new = b3Precondition(threadPool, chunkCount, data, false);
 		}
 		else
 		{
-			r = r - alpha * q;
+			b3RunKernel(threadPool, chunkCount, b3UpdateKernel, data);
+			delta_new = b3Precondition(threadPool, chunkCount, data, true);
 		}
 
-		b3DenseVec3 s = invM * r;
+		data->beta = delta_new / delta_old;
 
-		scalar delta_old = delta_new;
+		// d = s + beta * d
+		b3RunKernel(threadPool, chunkCount, b3DirectionKernel, data);
+
+		++iteration;
+	}
 
-		delta_new = b3Dot(r, s);
+	*delta = delta_new;
+	return iteration;
+}
 
-		scalar beta = delta_new / delta_old;
+// Preconditioned Conjugate Gradient algorithm.
+bool b3SparseSolveCG(b3SolveCGOutput* output, const b3SolveCGInput* input)
+{
+	const b3SparseMat33* A = input->A;
+	const b3SparseOperator* op = input->op;
+	const b3DenseVec3& b = *input->b;
+	uint32 maxIterations = input->maxIterations;
+	scalar epsilon = input->tolerance;
+	b3ThreadPool* threadPool = input->threadPool;
+	b3DenseVec3& x = *output->x;
 
-		d = s + beta * d;
+	B3_ASSERT(epsilon > scalar(0) && epsilon < scalar(1));
 
-		++iteration;
+	B3_ASSERT((A == nullptr) != (op == nullptr));
+
+	uint32 n = b.n;
+
+	// Use the Jacobi preconditioner if no preconditioner is given.
+	b3SparsePreconditioner jacobi;
+	const b3SparsePreconditioner* M = input->preconditioner;
+	if (M == nullptr)
+	{
+		B3_ASSERT(A != nullptr);
+		jacobi.type = e_jacobiPreconditioner;
+		jacobi.Compute(*A);
+		M = &jacobi;
+	}
+
+	B3_ASSERT(op != nullptr || M->IsCompatible(*A));
+
+	// The incomplete Cholesky and multigrid preconditioners need both triangles.
+	B3_ASSERT(input->symmetric == false || M->type == e_jacobiPreconditioner || M->type == e_blockJacobiPreconditioner);
+
+	// Use a temporary workspace if no workspace is given.
+	b3SparseWorkspace localWorkspace;
+	b3SparseWorkspace* workspace = input->workspace;
+	if (workspace == nullptr)
+	{
+		workspace = &localWorkspace;
+	}
+
+	b3DenseVec3& r = *workspace->AllocateDenseVec3(n);
+	b3DenseVec3& d = *workspace->AllocateDenseVec3(n);
+	b3DenseVec3& q = *workspace->AllocateDenseVec3(n);
+	b3DenseVec3& s = *workspace->AllocateDenseVec3(n);
+
+	uint32 chunkCount = (n + b3_chunkRowCount - 1) / b3_chunkRowCount;
+	scalar64* partials = (scalar64*)workspace->Allocate(chunkCount * sizeof(scalar64));
+
+	// The lower blocks of a symmetric matrix are the transposed upper blocks.
+	uint32* transposePtrs = nullptr;
+	uint32* transposeRows = nullptr;
+	uint32* transposeBlocks = nullptr;
+	if (input->symmetric)
+	{
+		transposePtrs = (uint32*)workspace->Allocate((n + 1) * sizeof(uint32));
+		transposeRows = (uint32*)workspace->Allocate(A->blockCount * sizeof(uint32));
+		transposeBlocks = (uint32*)workspace->Allocate(A->blockCount * sizeof(uint32));
+		b3BuildTranspose(transposePtrs, transposeRows, transposeBlocks, *A);
+	}
+
+	b3CGKernelData data;
+	data.A = A;
+	data.symmetric = input->symmetric;
+	data.transposePtrs = transposePtrs;
+	data.transposeRows = transposeRows;
+	data.transposeBlocks = transposeBlocks;
+	data.op = op;
+	data.b = &b;
+	data.M = M;
+	data.x = &x;
+	data.r = &r;
+	data.d = &d;
+	data.q = &q;
+	data.s = &s;
+	data.alpha = scalar(0);
+	data.beta = scalar(0);
+	data.mixedPrecision = input->mixedPrecision;
+	data.partials = partials;
+
+	// The error of a warm started solve is relative to the error of a zero initial guess.
+	// Otherwise a good initial guess would only raise the bar.
+	scalar delta_b = scalar(0);
+	if (input->warmStarting)
+	{
+		// r = b
+		r.Copy(b);
+		delta_b = b3Precondition(threadPool, chunkCount, &data, false);
+	}
+
+	// r = b - A * x
+	// d = inv(M) * r
+	b3Residual(threadPool, chunkCount, &data);
+	scalar delta_new = b3Precondition(threadPool, chunkCount, &data, false);
+
+	scalar delta_0 = delta_new;
+	if (input->warmStarting)
+	{
+		if (delta_new > delta_b)
+		{
+			// The initial guess is worse than zero. Discard it.
+			x.SetZero();
+			r.Copy(b);
+			delta_new = b3Precondition(threadPool, chunkCount, &data, false);
+		}
+		
+		delta_0 = delta_b;
+	}
+
+	scalar tolerance = epsilon * epsilon * delta_0;
+
+	uint32 iteration = b3Iterate(threadPool, chunkCount, &data, maxIterations, tolerance, &delta_new);
+
+	// Iterative refinement.
+	// The residual of the current solution is the right hand side of a correction system
+	// because b - A * (x + e) = r - A * e. The correction is solved from zero and
+	// the tolerance of the correction stays relative to the original system.
+	if (input->refinementIterations > 0)
+	{
+		b3DenseVec3& c = *workspace->AllocateDenseVec3(n);
+		b3DenseVec3& e = *workspace->AllocateDenseVec3(n);
+
+		for (uint32 i = 0; i < input->refinementIterations; ++i)
+		{
+			// r = b - A * x
+			// s = inv(M) * r
+			data.b = &b;
+			data.x = &x;
+			b3Residual(threadPool, chunkCount, &data);
+			delta_new = b3Precondition(threadPool, chunkCount, &data, false);
+
+			if (delta_new <= tolerance)
+			{
+				break;
+			}
+
+			// A * e = r
+			c.Copy(r);
+			e.SetZero();
+			data.b = &c;
+			data.x = &e;
+			iteration += b3Iterate(threadPool, chunkCount, &data, maxIterations, tolerance, &delta_new);
+
+			// x = x + e
+			b3Axpy(b3Data(&x, 0), scalar(1), b3Data(&e, 0), 3 * n);
+		}
+
+		data.b = &b;
+		data.x = &x;
+
+		workspace->FreeDenseVec3(&e);
+		workspace->FreeDenseVec3(&c);
+	}
+
+	if (input->symmetric)
+	{
+		workspace->Free(transposeBlocks);
+		workspace->Free(transposeRows);
+		workspace->Free(transposePtrs);
 	}
+	workspace->Free(partials);
+	workspace->FreeDenseVec3(&s);
+	workspace->FreeDenseVec3(&q);
+	workspace->FreeDenseVec3(&d);
+	workspace->FreeDenseVec3(&r);
 
 	output->iterations = iteration;
 	output->error = delta_new;
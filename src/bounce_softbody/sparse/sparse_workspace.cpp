@@ -0,0 +1,200 @@
+/*
+* Copyright (c) 2016-2019 Irlan Robson
+*
+* This software is provided 'as-is', without any express or implied
+* warranty.  In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <bounce_softbody/sparse/sparse_workspace.h>
+#include <bounce_softbody/sparse/dense_vec3.h>
+#include <bounce_softbody/sparse/diag_mat33.h>
+#include <bounce_softbody/sparse/sparse_mat33.h>
+
+template <typename T>
+static void b3InitializePool(T& pool)
+{
+	pool.objects = nullptr;
+	pool.capacity = 0;
+	pool.count = 0;
+	pool.top = 0;
+}
+
+b3SparseWorkspace::b3SparseWorkspace()
+{
+	b3InitializePool(m_vectors);
+	b3InitializePool(m_diagonals);
+	b3InitializePool(m_matrices);
+	b3InitializePool(m_blocks);
+}
+
+b3SparseWorkspace::~b3SparseWorkspace()
+{
+	Destroy(m_vectors);
+	Destroy(m_diagonals);
+	Destroy(m_matrices);
+	Destroy(m_blocks);
+}
+
+// Create an object with no memory.
+static void b3Create(b3DenseVec3* v)
+{
+	new (v) b3DenseVec3(0);
+}
+
+static void b3Create(b3DiagMat33* m)
+{
+	new (m) b3DiagMat33(0);
+}
+
+static void b3Create(b3SparseMat33* m)
+{
+	new (m) b3SparseMat33();
+}
+
+template <typename T>
+static void b3Create(T* block)
+{
+	block->size = 0;
+	block->data = nullptr;
+}
+
+template <typename T>
+T* b3SparseWorkspace::Take(b3Pool<T>& pool)
+{
+	if (pool.top == pool.count)
+	{
+		if (pool.count == pool.capacity)
+		{
+			// Grow the object array.
+			T** oldObjects = pool.objects;
+			pool.capacity = pool.capacity == 0 ? 16 : 2 * pool.capacity;
+			pool.objects = (T**)b3Alloc(pool.capacity * sizeof(T*));
+			if (pool.count > 0)
+			{
+				memcpy(pool.objects, oldObjects, pool.count * sizeof(T*));
+			}
+			b3Free(oldObjects);
+		}
+
+		T* object = (T*)b3Alloc(sizeof(T));
+		b3Create(object);
+		pool.objects[pool.count++] = object;
+	}
+
+	return pool.objects[pool.top++];
+}
+
+template <typename T>
+void b3SparseWorkspace::Return(b3Pool<T>& pool, T* object)
+{
+	B3_ASSERT(pool.top > 0);
+	B3_ASSERT(pool.objects[pool.top - 1] == object);
+	B3_NOT_USED(object);
+	--pool.top;
+}
+
+template <typename T>
+void b3SparseWorkspace::Destroy(b3Pool<T>& pool)
+{
+	B3_ASSERT(pool.top == 0);
+	for (uint32 i = 0; i < pool.count; ++i)
+	{
+		pool.objects[i]->~T();
+		b3Free(pool.objects[i]);
+	}
+	b3Free(pool.objects);
+}
+
+b3DenseVec3* b3SparseWorkspace::AllocateDenseVec3(uint32 n)
+{
+	b3DenseVec3* v = Take(m_vectors);
+	v->Resize(n);
+	return v;
+}
+
+void b3SparseWorkspace::FreeDenseVec3(b3DenseVec3* v)
+{
+	Return(m_vectors, v);
+}
+
+b3DiagMat33* b3SparseWorkspace::AllocateDiagMat33(uint32 n)
+{
+	b3DiagMat33* m = Take(m_diagonals);
+	m->Resize(n);
+	return m;
+}
+
+void b3SparseWorkspace::FreeDiagMat33(b3DiagMat33* m)
+{
+	Return(m_diagonals, m);
+}
+
+b3SparseMat33* b3SparseWorkspace::AllocateSparseMat33()
+{
+	return Take(m_matrices);
+}
+
+void b3SparseWorkspace::FreeSparseMat33(b3SparseMat33* m)
+{
+	Return(m_matrices, m);
+}
+
+void* b3SparseWorkspace::Allocate(uint32 size)
+{
+	b3Block* block = Take(m_blocks);
+	if (block->size < size)
+	{
+		b3Free(block->data);
+		block->size = size;
+		block->data = b3Alloc(size);
+	}
+	return block->data;
+}
+
+void b3SparseWorkspace::Free(void* p)
+{
+	B3_ASSERT(m_blocks.top > 0);
+	b3Block* block = m_blocks.objects[m_blocks.top - 1];
+	B3_ASSERT(block->data == p);
+	Return(m_blocks, block);
+	B3_NOT_USED(p);
+}
+
+
+uint32 b3SparseWorkspace::GetByteCount() const
+{
+	uint32 bytes = 0;
+
+	for (uint32 i = 0; i < m_vectors.count; ++i)
+	{
+		bytes += m_vectors.objects[i]->n * sizeof(b3Vec3);
+	}
+
+	for (uint32 i = 0; i < m_diagonals.count; ++i)
+	{
+		bytes += m_diagonals.objects[i]->n * sizeof(b3Mat33);
+	}
+
+	for (uint32 i = 0; i < m_matrices.count; ++i)
+	{
+		bytes += m_matrices.objects[i]->GetByteCount();
+	}
+
+	for (uint32 i = 0; i < m_blocks.count; ++i)
+	{
+		bytes += m_blocks.objects[i]->size;
+	}
+
+	return bytes;
+}
\ No newline at end of file